@@ -0,0 +1,74 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <functional>
+
+#include "wrapper/matrix/vector.h"
+
+namespace ketcpp {
+  namespace bench {
+    // Best of a few runs, in seconds.
+    inline double measure(const std::function<void()> &f, int repeat = 3) {
+      double best = 1e300;
+      for (int r = 0; r < repeat; ++r) {
+        const auto start = std::chrono::steady_clock::now();
+        f();
+        const std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+      }
+      return best;
+    }
+
+    // Seconds per call, from batches long enough to be timed reliably.
+    inline double measure_per_call(const std::function<void()> &f,
+                                   double min_time = 0.02) {
+      const double once = measure(f, 1);
+      const size_t calls = std::max<size_t>(
+          std::min<double>(min_time / std::max(once, 1e-9), 1 << 20), 1);
+      return measure([&] {
+               for (size_t i = 0; i < calls; ++i) {
+                 f();
+               }
+             }) /
+             calls;
+    }
+
+    template <typename T>
+    wrapper::matrix::MatrixVector<T> make_random(size_t m, size_t n) {
+      wrapper::matrix::MatrixVector<T> a(m, n);
+      std::srand(m * 31 + n);
+      for (size_t i = 0; i < m * n; ++i) {
+        a.data()[i] = T(std::rand() / double(RAND_MAX) - 0.5);
+      }
+      return a;
+    }
+
+    // bench --scaling [max threads]
+    int run_scaling(int argc, char **argv);
+    // bench [--json FILE] [--max-size N] [--filter TEXT]
+    int run_suite(int argc, char **argv);
+  }
+}
@@ -0,0 +1,34 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+
+#include "bench.h"
+
+// Usage:
+//   bench [--json FILE] [--max-size N] [--filter TEXT]
+//     microbenchmarks of every backend and operation, see suite.cc
+//   bench --scaling [max threads]
+//     thread scaling of the parallel kernels, see scaling.cc
+int main(int argc, char **argv) {
+  if (argc > 1 && std::strcmp(argv[1], "--scaling") == 0) {
+    return ketcpp::bench::run_scaling(argc - 2, argv + 2);
+  }
+  return ketcpp::bench::run_suite(argc - 1, argv + 1);
+}
@@ -0,0 +1,90 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench.h"
+#include "wrapper/matrix/default.h"
+#include "wrapper/thread/pool.h"
+
+using namespace ketcpp::wrapper;
+using namespace ketcpp::wrapper::matrix;
+
+namespace {
+  struct Case {
+    std::string name;
+    double work; // operations per run, for the rate column
+    std::string unit;
+    std::function<void()> run;
+  };
+}
+
+// Runs each case with 1, 2, 4, ... threads up to the maximum (the number of
+// hardware threads by default) and prints time, rate and speedup.
+int ketcpp::bench::run_scaling(int argc, char **argv) {
+  size_t max_threads = std::max(std::thread::hardware_concurrency(), 1u);
+  if (argc > 0) {
+    max_threads = std::max(std::atol(argv[0]), 1l);
+  }
+
+  const size_t n_gemm = 1024, n_vector = 1 << 24;
+  auto a = make_random<double>(n_gemm, n_gemm);
+  auto b = make_random<double>(n_gemm, n_gemm);
+  MatrixVector<double> c(n_gemm, n_gemm);
+  auto x = make_random<double>(1, n_vector);
+  auto y = make_random<double>(1, n_vector);
+  double sink = 0;
+
+  std::vector<Case> cases = {
+      {"gemm 1024", 2. * n_gemm * n_gemm * n_gemm, "GFlop/s",
+       [&] { gemm(1., a, b, 0., c); }},
+      {"add 2^24", double(n_vector), "GElem/s", [&] { x += y; }},
+      {"scale 2^24", double(n_vector), "GElem/s", [&] { x *= 0.5; }},
+      {"dot 2^24", 2. * n_vector, "GFlop/s", [&] { sink += x.dot(y); }},
+  };
+
+  std::vector<size_t> thread_counts;
+  for (size_t t = 1; t < max_threads; t *= 2) {
+    thread_counts.push_back(t);
+  }
+  thread_counts.push_back(max_threads);
+
+  std::printf("%-12s %8s %12s %16s %8s\n", "case", "threads", "time [s]",
+              "rate", "speedup");
+  for (const auto &c : cases) {
+    double serial = 0;
+    for (size_t t : thread_counts) {
+      thread::set_num_threads(t);
+      c.run();
+      const double time = measure(c.run);
+      if (t == 1) {
+        serial = time;
+      }
+      std::printf("%-12s %8zu %12.6f %8.3f %-7s %6.2fx\n", c.name.c_str(), t,
+                  time, c.work / time * 1e-9, c.unit.c_str(), serial / time);
+    }
+  }
+  return sink == 12345. ? 1 : 0;
+}
@@ -0,0 +1,274 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "wrapper/matrix/default.h"
+#include "wrapper/thread/pool.h"
+
+using namespace ketcpp::wrapper;
+using namespace ketcpp::wrapper::matrix;
+using ketcpp::bench::make_random;
+using ketcpp::bench::measure_per_call;
+
+namespace {
+  struct Result {
+    std::string backend, type, operation;
+    size_t size;
+    double time, flops, bytes;
+  };
+
+  struct Case {
+    std::string operation;
+    double flops, bytes; // per call
+    std::function<void()> run;
+  };
+
+  template <typename T> struct Backend {
+    std::string name;
+    // Returns nullptr for sizes the backend cannot hold.
+    std::function<std::unique_ptr<MatrixBase<T>>(size_t)> make;
+  };
+
+  template <typename T> struct TypeName;
+  template <> struct TypeName<float> {
+    static const char *get() { return "float"; }
+  };
+  template <> struct TypeName<double> {
+    static const char *get() { return "double"; }
+  };
+
+  template <typename T, int n>
+  std::unique_ptr<MatrixBase<T>> make_array(size_t size) {
+    if (size != n) {
+      return nullptr;
+    }
+    return std::unique_ptr<MatrixBase<T>>(new MatrixArray<T, n, n>());
+  }
+  template <typename T, int n, int m, int... rest>
+  std::unique_ptr<MatrixBase<T>> make_array(size_t size) {
+    auto a = make_array<T, n>(size);
+    return a ? std::move(a) : make_array<T, m, rest...>(size);
+  }
+
+  template <typename T> std::vector<Backend<T>> get_backends() {
+    using Ptr = std::unique_ptr<MatrixBase<T>>;
+    return {
+        {"MatrixArray", make_array<T, 3, 8, 16, 64>},
+        {"MatrixVector",
+         [](size_t n) { return Ptr(new MatrixVector<T>(n, n)); }},
+        {"MatrixEigen",
+         [](size_t n) { return Ptr(new MatrixEigen<T>(n, n)); }},
+        {"MatrixSymmetric",
+         [](size_t n) { return Ptr(new MatrixSymmetric<T>(n)); }},
+        {"MatrixBlockSparse",
+         [](size_t n) { return Ptr(new MatrixBlockSparse<T>(n, n)); }},
+        {"MatrixMapped",
+         [](size_t n) { return Ptr(new MatrixMapped<T>(n, n)); }},
+    };
+  }
+
+  // Operations through the MatrixBase interface. Operands hold random
+  // elements, copied in through the dispatcher.
+  template <typename T>
+  std::vector<Case> get_base_cases(const Backend<T> &backend, size_t n) {
+    std::shared_ptr<MatrixBase<T>> a = backend.make(n), b = backend.make(n);
+    if (!a) {
+      return {};
+    }
+    Dispatcher<T>::convert(*a, make_random<T>(n, n));
+    Dispatcher<T>::convert(*b, make_random<T>(n, n));
+    const double e = double(n) * n, s = sizeof(T);
+    // Equal operands, so that == reads everything.
+    std::shared_ptr<MatrixBase<T>> c = a->copy(), d = a->copy();
+    auto sink = std::make_shared<T>(0);
+    auto factor = std::make_shared<T>(2);
+    return {
+        {"construct", 0, e * s, [backend, n] { backend.make(n); }},
+        {"rows", e, e * s,
+         [a, sink] {
+           for (auto row : a->rows()) {
+             for (auto x : row) {
+               *sink += x;
+             }
+           }
+         }},
+        {"columns", e, e * s,
+         [a, sink] {
+           for (auto column : a->columns()) {
+             for (auto x : column) {
+               *sink += x;
+             }
+           }
+         }},
+        {"add", e, 3 * e * s, [a, b] { *a += *b; }},
+        // Alternates the factor so that repeated calls stay in range.
+        {"scale", e, 2 * e * s,
+         [a, factor] {
+           *a *= *factor;
+           *factor = T(1) / *factor;
+         }},
+        {"multiply", 2 * e * n, 3 * e * s,
+         [a, b] { Dispatcher<T>::multiply(*a, *b); }},
+        {"equal", 0, 2 * e * s, [c, d, sink] { *sink += (*c == *d); }},
+        {"copy", 0, 2 * e * s, [a] { a->copy(); }},
+    };
+  }
+
+  // The same operations through Matrix<T> over MatrixVector.
+  template <typename T> std::vector<Case> get_wrapper_cases(size_t n) {
+    auto a = std::make_shared<Matrix<T>>(make_random<T>(n, n));
+    auto b = std::make_shared<Matrix<T>>(make_random<T>(n, n));
+    auto c = std::make_shared<Matrix<T>>(*a);
+    auto d = std::make_shared<Matrix<T>>(*a);
+    const double e = double(n) * n, s = sizeof(T);
+    auto sink = std::make_shared<T>(0);
+    auto factor = std::make_shared<T>(2);
+    return {
+        {"construct", 0, e * s,
+         [n] { Matrix<T>(std::unique_ptr<MatrixBase<T>>(
+                   new MatrixVector<T>(n, n))); }},
+        {"rows", e, e * s,
+         [a, sink] {
+           for (auto row : a->rows()) {
+             for (auto x : row) {
+               *sink += x;
+             }
+           }
+         }},
+        {"columns", e, e * s,
+         [a, sink] {
+           for (auto column : a->columns()) {
+             for (auto x : column) {
+               *sink += x;
+             }
+           }
+         }},
+        {"add", e, 3 * e * s, [a, b] { *a += *b; }},
+        {"scale", e, 2 * e * s,
+         [a, factor] {
+           *a *= *factor;
+           *factor = T(1) / *factor;
+         }},
+        {"multiply", 2 * e * n, 3 * e * s,
+         [a, b] { Matrix<T> c = *a * *b; }},
+        {"equal", 0, 2 * e * s, [c, d, sink] { *sink += (*c == *d); }},
+        {"copy", 0, 2 * e * s, [a] { Matrix<T> c = *a; }},
+    };
+  }
+
+  struct Options {
+    std::string json;
+    size_t max_size = 4096;
+    std::string filter;
+  };
+
+  template <typename T>
+  void run_type(const Options &options, std::vector<Result> &results) {
+    const char *type = TypeName<T>::get();
+    std::vector<std::pair<std::string, std::function<std::vector<Case>(
+                                           size_t)>>> subjects;
+    for (const auto &backend : get_backends<T>()) {
+      subjects.emplace_back(backend.name, [backend](size_t n) {
+        return get_base_cases(backend, n);
+      });
+    }
+    subjects.emplace_back("Matrix<T>", get_wrapper_cases<T>);
+    for (size_t n : {3, 8, 16, 64, 256, 1024, 4096}) {
+      if (n > options.max_size) {
+        break;
+      }
+      for (const auto &subject : subjects) {
+        if (subject.first.find(options.filter) == std::string::npos) {
+          continue;
+        }
+        for (const auto &c : subject.second(n)) {
+          const double time = measure_per_call(c.run);
+          results.push_back(
+              {subject.first, type, c.operation, n, time, c.flops, c.bytes});
+          std::printf("%-18s %-6s %5zu %-10s %12.3e %9.3f %9.3f\n",
+                      subject.first.c_str(), type, n, c.operation.c_str(),
+                      time, c.flops / time * 1e-9, c.bytes / time * 1e-9);
+          std::fflush(stdout);
+        }
+      }
+    }
+  }
+
+  void write_json(const std::string &path, const std::vector<Result> &results) {
+    std::FILE *fp = std::fopen(path.c_str(), "w");
+    if (fp == nullptr) {
+      std::perror(path.c_str());
+      std::exit(1);
+    }
+    std::fprintf(fp, "{\n  \"version\": 1,\n  \"threads\": %zu,\n",
+                 thread::get_num_threads());
+    std::fprintf(fp, "  \"results\": [");
+    for (size_t i = 0; i < results.size(); ++i) {
+      const auto &r = results[i];
+      std::fprintf(fp,
+                   "%s\n    {\"backend\": \"%s\", \"type\": \"%s\", "
+                   "\"size\": %zu, \"operation\": \"%s\", "
+                   "\"seconds\": %.6e, \"gflops\": %.6g, \"gbytes\": %.6g}",
+                   i ? "," : "", r.backend.c_str(), r.type.c_str(), r.size,
+                   r.operation.c_str(), r.time, r.flops / r.time * 1e-9,
+                   r.bytes / r.time * 1e-9);
+    }
+    std::fprintf(fp, "\n  ]\n}\n");
+    std::fclose(fp);
+  }
+}
+
+// Times construction, iteration through rows() and columns(), +=, *=,
+// products, == and copy for every backend and Matrix<T>, float and double,
+// n x n from 3 up to --max-size. Rates are GFlop/s and GB/s of nominal
+// traffic (each operand read or written once); --filter keeps backends
+// whose name contains the text.
+int ketcpp::bench::run_suite(int argc, char **argv) {
+  Options options;
+  for (int i = 0; i + 1 < argc; i += 2) {
+    if (std::strcmp(argv[i], "--json") == 0) {
+      options.json = argv[i + 1];
+    } else if (std::strcmp(argv[i], "--max-size") == 0) {
+      options.max_size = std::atol(argv[i + 1]);
+    } else if (std::strcmp(argv[i], "--filter") == 0) {
+      options.filter = argv[i + 1];
+    } else {
+      std::fprintf(stderr, "unknown option %s\n", argv[i]);
+      return 1;
+    }
+  }
+
+  std::vector<Result> results;
+  std::printf("%-18s %-6s %5s %-10s %12s %9s %9s\n", "backend", "type", "n",
+              "operation", "time [s]", "GFlop/s", "GB/s");
+  run_type<float>(options, results);
+  run_type<double>(options, results);
+  if (!options.json.empty()) {
+    write_json(options.json, results);
+  }
+  return 0;
+}
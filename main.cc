@@ -17,4 +17,20 @@
  * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-int main(void) { return 0; }
+#include <cstdlib>
+#include <iostream>
+
+#include "wrapper/profile/counters.h"
+
+namespace {
+  void report_profile() {
+    if (ketcpp::wrapper::profile::is_enabled()) {
+      ketcpp::wrapper::profile::report(std::cerr);
+    }
+  }
+}
+
+int main(void) {
+  std::atexit(report_profile);
+  return 0;
+}
@@ -27,21 +27,43 @@
 #include <sstream>
 
 #include "wrapper/matrix/base.h"
+#include "wrapper/matrix/dispatch.h"
+#include "wrapper/matrix/fixed.h"
+#include "wrapper/matrix/gemm.h"
+#include "wrapper/matrix/range.h"
+#include "wrapper/matrix/simd.h"
 
 namespace ketcpp {
   namespace wrapper {
     namespace matrix {
-      template <typename T, size_t m, size_t n = m>
-      class MatrixArray : public MatrixBase<T> {
+      template <typename T, size_t m, size_t n = m,
+                Layout layout = Layout::row_major>
+      class MatrixArray
+          : public MatrixBase<T>,
+            public StridedMatrix<MatrixArray<T, m, n, layout>, T, layout> {
+        template <typename, size_t, size_t, Layout> friend class MatrixArray;
+
       public:
         constexpr static size_t num_rows = m;
         constexpr static size_t num_columns = n;
         constexpr static size_t row_size = n;
         constexpr static size_t column_size = m;
+        // Shapes up to this order use the unrolled kernels in fixed.h
+        // instead of the blocked gemm.
+        constexpr static size_t max_fixed_size = 8;
         size_t get_num_rows() const { return num_rows; }
         size_t get_num_columns() const { return num_columns; }
         size_t get_row_size() const { return row_size; }
         size_t get_column_size() const { return column_size; }
+        T *data() { return storage.data(); }
+        const T *data() const { return storage.data(); }
+        constexpr static Layout storage_layout = layout;
+        constexpr static std::ptrdiff_t row_stride =
+            kernel::get_row_stride(layout, m, n);
+        constexpr static std::ptrdiff_t column_stride =
+            kernel::get_column_stride(layout, m, n);
+        std::ptrdiff_t get_row_stride() const { return row_stride; }
+        std::ptrdiff_t get_column_stride() const { return column_stride; }
 
       private:
         using array = std::array<T, m * n>;
@@ -67,29 +89,29 @@ namespace ketcpp {
           typename std::conditional<
               is_const, typename MatrixArray::array::const_iterator,
               typename MatrixArray::array::iterator>::type iterator;
-          constexpr static size_t row_size = MatrixArray::row_size;
-          constexpr static size_t column_size = MatrixArray::column_size;
+          constexpr static std::ptrdiff_t row_stride = MatrixArray::row_stride;
+          constexpr static std::ptrdiff_t column_stride =
+              MatrixArray::column_stride;
+          // Stride between consecutive positions of this iterator, used to
+          // turn storage distances into element distances.
+          const std::ptrdiff_t step;
 
-        protected:
-          void advance_in_column() { this->iterator += row_size; }
-          void advance_in_row() { this->iterator++; }
-          unique_ptr row_begin() {
-            return std::move(std::make_unique<GenericIterator>(this->iterator));
+          unique_ptr make(decltype(iterator) it, std::ptrdiff_t s) const {
+            return std::make_unique<GenericIterator>(it, s);
           }
+
+        protected:
+          void advance_in_column() { this->iterator += row_stride; }
+          void advance_in_row() { this->iterator += column_stride; }
+          unique_ptr row_begin() { return make(iterator, column_stride); }
           unique_ptr row_end() {
-            return std::move(
-                std::make_unique<GenericIterator>(this->iterator + row_size));
-          }
-          unique_ptr column_begin() {
-            return std::move(std::make_unique<GenericIterator>(this->iterator));
+            return make(iterator + n * column_stride, column_stride);
           }
+          unique_ptr column_begin() { return make(iterator, row_stride); }
           unique_ptr column_end() {
-            return std::move(std::make_unique<GenericIterator>(
-                this->iterator + row_size * column_size));
-          }
-          unique_ptr copy() {
-            return std::move(std::make_unique<GenericIterator>(this->iterator));
+            return make(iterator + m * row_stride, row_stride);
           }
+          unique_ptr copy() { return make(iterator, step); }
           bool operator==(BaseIterator &rhs) const throw(std::bad_cast &) {
             auto &rhs_cast = dynamic_cast<decltype(*this)>(rhs);
             return this->iterator == rhs_cast.iterator;
@@ -101,7 +123,7 @@ namespace ketcpp {
           typename BaseIterator::difference_type
           operator-(const BaseIterator &rhs) const throw(std::bad_cast &) {
             auto &rhs_cast = dynamic_cast<decltype(*this)>(rhs);
-            return this->iterator - rhs_cast.iterator;
+            return (this->iterator - rhs_cast.iterator) / step;
           }
           typename std::conditional<is_const, const T &, T &>::type
           operator*() {
@@ -109,7 +131,8 @@ namespace ketcpp {
           }
 
         public:
-          GenericIterator(decltype(iterator) src) : iterator(src) {}
+          GenericIterator(decltype(iterator) src, std::ptrdiff_t step)
+              : iterator(src), step(step != 0 ? step : 1) {}
         };
         using Iterator = GenericIterator<false>;
         using ConstIterator = GenericIterator<true>;
@@ -117,88 +140,144 @@ namespace ketcpp {
       protected:
         RowVectorConstIterator row_cbegin() const {
           return RowVectorConstIterator(
-              std::make_unique<ConstIterator>(storage.cbegin()));
+              std::make_unique<ConstIterator>(storage.cbegin(), row_stride));
         }
         RowVectorConstIterator row_cend() const {
-          return RowVectorConstIterator(
-              std::move(std::make_unique<ConstIterator>(storage.cend())));
+          return RowVectorConstIterator(std::make_unique<ConstIterator>(
+              storage.cbegin() + m * row_stride, row_stride));
         }
         ColumnVectorConstIterator column_cbegin() const {
           return ColumnVectorConstIterator(
-              std::move(std::make_unique<ConstIterator>(storage.cbegin())));
+              std::make_unique<ConstIterator>(storage.cbegin(), column_stride));
         }
         ColumnVectorConstIterator column_cend() const {
-          return ColumnVectorConstIterator(std::move(
-              std::make_unique<ConstIterator>(storage.cbegin() + row_size)));
+          return ColumnVectorConstIterator(std::make_unique<ConstIterator>(
+              storage.cbegin() + n * column_stride, column_stride));
         }
         RowVectorIterator row_begin() {
-          return RowVectorIterator(std::make_unique<Iterator>(storage.begin()));
+          return RowVectorIterator(
+              std::make_unique<Iterator>(storage.begin(), row_stride));
         }
         RowVectorIterator row_end() {
-          return RowVectorIterator(
-              std::move(std::make_unique<Iterator>(storage.end())));
+          return RowVectorIterator(std::make_unique<Iterator>(
+              storage.begin() + m * row_stride, row_stride));
         }
         ColumnVectorIterator column_begin() {
           return ColumnVectorIterator(
-              std::move(std::make_unique<Iterator>(storage.begin())));
+              std::make_unique<Iterator>(storage.begin(), column_stride));
         }
         ColumnVectorIterator column_end() {
-          return ColumnVectorIterator(std::move(
-              std::make_unique<Iterator>(storage.begin() + row_size)));
+          return ColumnVectorIterator(std::make_unique<Iterator>(
+              storage.begin() + n * column_stride, column_stride));
         }
 
       public:
         MatrixArray(
-            const std::initializer_list<std::initializer_list<float>> &list)
+            const std::initializer_list<std::initializer_list<T>> &list)
             : storage() {
-          auto dest = storage.begin();
-          for (auto i : list) {
-            dest = std::copy(i.begin(), i.end(), dest);
+          size_t i = 0;
+          for (const auto &row : list) {
+            size_t j = 0;
+            for (const T &x : row) {
+              (*this)(i, j++) = x;
+            }
+            ++i;
           }
         }
-        MatrixArray(const std::initializer_list<float> &list) : storage() {
-          std::copy(list.begin(), list.end(), storage.begin());
+        // Elements in row-major order, whatever the storage layout.
+        MatrixArray(const std::initializer_list<T> &list) : storage() {
+          size_t k = 0;
+          for (const T &x : list) {
+            (*this)(k / n, k % n) = x;
+            ++k;
+          }
         }
         MatrixArray() = default;
 
         bool operator==(const MatrixArray &rhs) const {
-          return std::equal(this->storage.cbegin(), this->storage.cend(),
-                            rhs.storage.cbegin());
-        }
-        Base &operator+=(const Base &rhsbase) {
-          try {
-            auto &rhs = dynamic_cast<const MatrixArray &>(rhsbase);
-            std::transform(this->storage.cbegin(), this->storage.cend(),
-                           rhs.storage.cbegin(), this->storage.begin(),
-                           [](T l, T r) -> T { return l + r; });
-            return *this;
-          } catch (std::bad_cast &ex) {
-            return Base::operator+=(rhsbase);
-          }
+          return simd::equal(this->storage.size(), this->storage.data(),
+                             rhs.storage.data());
+        }
+        bool operator==(const Base &rhs) const {
+          return Dispatcher<T>::compare(*this, rhs);
+        }
+        Base &operator+=(const Base &rhs) {
+          Dispatcher<T>::add(*this, rhs);
+          return *this;
         }
 
         Base &operator*=(T rhs) {
-          std::transform(this->storage.cbegin(), this->storage.cend(),
-                         this->storage.begin(),
-                         [rhs](T l) -> T { return l * rhs; });
+          KETCPP_PROFILE_UNARY(scale, *this, storage.size(),
+                               2. * storage.size() * sizeof(T), 0);
+          simd::scale(this->storage.size(), rhs, this->storage.data(),
+                      this->storage.data());
           return *this;
         }
         using MatrixBase<T>::operator*;
         template <size_t l>
-        MatrixArray<T, m, l> operator*(const MatrixArray<T, n, l> &rhs) const {
-          MatrixArray<T, m, l> buf;
-          auto lr = this->rows().begin();
-          for (auto br = buf.rows().begin(); br != buf.rows().end();
-               ++br, ++lr) {
-            auto rc = rhs.columns().begin();
-            for (auto b = br.begin(); b != br.end(); ++b, ++rc) {
-              *b = std::inner_product(lr.begin(), lr.end(), rc.begin(), 0);
+        MatrixArray<T, m, l, layout>
+        operator*(const MatrixArray<T, n, l, layout> &rhs) const {
+          KETCPP_PROFILE_BINARY(multiply, *this, rhs, 2. * m * n * l,
+                                (m * n + n * l + m * l) * sizeof(T), 1);
+          MatrixArray<T, m, l, layout> buf;
+          if (m <= max_fixed_size && n <= max_fixed_size &&
+              l <= max_fixed_size) {
+            // Column-major storage of a matrix is the row-major storage of
+            // its transpose, and C^T = B^T * A^T.
+            if (layout == Layout::row_major) {
+              kernel::fixed::multiply<T, m, n, l>(this->storage.data(),
+                                                  rhs.storage.data(),
+                                                  buf.storage.data());
+            } else {
+              kernel::fixed::multiply<T, l, n, m>(rhs.storage.data(),
+                                                  this->storage.data(),
+                                                  buf.storage.data());
             }
+          } else {
+            gemm<T>(m, l, n, T(1), this->storage.data(), row_stride,
+                    column_stride, rhs.storage.data(), rhs.row_stride,
+                    rhs.column_stride, T(0), buf.storage.data(),
+                    buf.row_stride, buf.column_stride);
           }
           return std::move(buf);
         }
 
+        MatrixArray<T, n, m, layout> transpose() const {
+          MatrixArray<T, n, m, layout> buf;
+          if (layout == Layout::row_major) {
+            kernel::fixed::transpose<T, m, n>(this->storage.data(),
+                                              buf.storage.data());
+          } else {
+            kernel::fixed::transpose<T, n, m>(this->storage.data(),
+                                              buf.storage.data());
+          }
+          return buf;
+        }
+        T determinant() const {
+          static_assert(m == n, "determinant needs a square matrix");
+          return kernel::fixed::determinant<T, n>(this->storage.data());
+        }
+        // Throws std::domain_error if the matrix is singular.
+        MatrixArray inverse() const {
+          static_assert(m == n, "inverse needs a square matrix");
+          MatrixArray buf;
+          kernel::fixed::inverse<T, n>(this->storage.data(),
+                                       buf.storage.data());
+          return buf;
+        }
+        // Cross product of column (3 x 1) or row (1 x 3) vectors.
+        MatrixArray cross(const MatrixArray &rhs) const {
+          static_assert(m * n == 3 && (m == 1 || n == 1),
+                        "cross product needs 3-vectors");
+          MatrixArray buf;
+          kernel::fixed::cross(this->storage.data(), rhs.storage.data(),
+                               buf.storage.data());
+          return buf;
+        }
+
         std::unique_ptr<MatrixBase<T>> copy() const {
+          KETCPP_PROFILE_UNARY(copy, *this, 0,
+                               2. * storage.size() * sizeof(T), 1);
           std::unique_ptr<MatrixBase<T>> copy;
           copy.reset(new MatrixArray(*this));
           return std::move(copy);
@@ -206,6 +285,13 @@ namespace ketcpp {
 
         ~MatrixArray() {}
       };
+
+      template <typename T, size_t m, size_t n, Layout layout>
+      constexpr Layout MatrixArray<T, m, n, layout>::storage_layout;
+      template <typename T, size_t m, size_t n, Layout layout>
+      constexpr std::ptrdiff_t MatrixArray<T, m, n, layout>::row_stride;
+      template <typename T, size_t m, size_t n, Layout layout>
+      constexpr std::ptrdiff_t MatrixArray<T, m, n, layout>::column_stride;
     }
   }
 }
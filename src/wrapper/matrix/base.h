@@ -19,14 +19,34 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
 #include <functional>
 #include <memory>
+#include <sstream>
 
 #include <infix_iterator.h>
 
 namespace ketcpp {
   namespace wrapper {
     namespace matrix {
+      // Order of elements in dense storage. Row-major matrices keep each
+      // row contiguous, column-major ones each column, as LAPACK does.
+      enum class Layout { row_major, column_major };
+
+      namespace kernel {
+        // Strides of dense m x n storage in layout.
+        constexpr std::ptrdiff_t get_row_stride(Layout layout, size_t,
+                                                size_t n) {
+          return layout == Layout::row_major ? n : 1;
+        }
+        constexpr std::ptrdiff_t get_column_stride(Layout layout, size_t m,
+                                                   size_t) {
+          return layout == Layout::row_major ? 1 : m;
+        }
+      }
+
       template <typename T> class MatrixBase {
       public:
         virtual size_t get_num_rows() const = 0;
@@ -34,6 +54,14 @@ namespace ketcpp {
         virtual size_t get_row_size() const = 0;
         virtual size_t get_column_size() const = 0;
 
+        // Backends with strided storage expose it so that kernels can bypass
+        // the iterators: element (i, j) is
+        // data()[i * get_row_stride() + j * get_column_stride()].
+        virtual T *data() { return nullptr; }
+        virtual const T *data() const { return nullptr; }
+        virtual std::ptrdiff_t get_row_stride() const { return get_row_size(); }
+        virtual std::ptrdiff_t get_column_stride() const { return 1; }
+
       private:
         using iter_traits = std::iterator<std::random_access_iterator_tag, T>;
 
@@ -61,6 +89,7 @@ namespace ketcpp {
           operator*() = 0;
           virtual difference_type
           operator-(const BaseGenericIterator &) const = 0;
+          virtual ~BaseGenericIterator() {}
         };
         template <bool is_const>
         class BaseDelegateGenericIterator : public iter_traits {
@@ -283,6 +312,49 @@ namespace ketcpp {
           return true;
         }
 
+        // Adds alpha to every diagonal element. Only the diagonal is touched,
+        // so sparse backends do not fill in.
+        virtual MatrixBase &add_to_diagonal(T alpha) {
+          const size_t k = std::min(get_num_rows(), get_num_columns());
+          if (data() != nullptr) {
+            const std::ptrdiff_t step = get_row_stride() + get_column_stride();
+            for (size_t i = 0; i < k; ++i) {
+              data()[i * step] += alpha;
+            }
+            return *this;
+          }
+          size_t i = 0;
+          for (auto row = rows().begin(); i < k; ++row, ++i) {
+            auto element = row.begin();
+            for (size_t j = 0; j < i; ++j) {
+              ++element;
+            }
+            *element += alpha;
+          }
+          return *this;
+        }
+
+        virtual T get_frobenius_norm() const {
+          T sum = 0;
+          if (data() != nullptr) {
+            for (size_t i = 0; i < get_num_rows(); ++i) {
+              const T *row = data() + i * get_row_stride();
+              for (size_t j = 0; j < get_num_columns(); ++j) {
+                sum += row[j * get_column_stride()] *
+                       row[j * get_column_stride()];
+              }
+            }
+            return std::sqrt(sum);
+          }
+          for (auto row = rows().begin(); row != rows().end(); ++row) {
+            for (auto element = row.begin(); element != row.end();
+                 ++element) {
+              sum += *element * *element;
+            }
+          }
+          return std::sqrt(sum);
+        }
+
         virtual std::unique_ptr<MatrixBase> copy() const = 0;
 
         virtual ~MatrixBase(){};
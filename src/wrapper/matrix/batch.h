@@ -0,0 +1,270 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+#include "wrapper/matrix/array.h"
+#include "wrapper/matrix/parallel.h"
+#include "wrapper/memory/pool.h"
+#include "wrapper/profile/counters.h"
+#include "wrapper/thread/pool.h"
+
+namespace ketcpp {
+  namespace wrapper {
+    namespace matrix {
+      // A batch of m x n matrices in structure-of-arrays layout: element
+      // (i, j) of every matrix is stored contiguously, so the batched
+      // operations below run their innermost loop over the batch and
+      // vectorize regardless of how small m and n are.
+      template <typename T, size_t m, size_t n = m> class MatrixBatch {
+        template <typename, size_t, size_t> friend class MatrixBatch;
+
+      public:
+        constexpr static size_t num_rows = m;
+        constexpr static size_t num_columns = n;
+        // Lanes processed together in the batched kernels; slices of this
+        // length for every element of all operands stay in cache.
+        constexpr static size_t block_size = 256;
+
+        size_t get_num_rows() const { return num_rows; }
+        size_t get_num_columns() const { return num_columns; }
+        size_t get_batch_size() const { return batch_size; }
+
+        // Element (i, j) of all matrices in the batch.
+        T *data(size_t i, size_t j) {
+          return storage.data() + (i * n + j) * batch_size;
+        }
+        const T *data(size_t i, size_t j) const {
+          return storage.data() + (i * n + j) * batch_size;
+        }
+        T &operator()(size_t k, size_t i, size_t j) { return data(i, j)[k]; }
+        const T &operator()(size_t k, size_t i, size_t j) const {
+          return data(i, j)[k];
+        }
+
+      private:
+        size_t batch_size;
+        std::vector<T, memory::PoolAllocator<T>> storage;
+
+        // Calls f(first, last) on lane blocks of at most block_size lanes,
+        // spread over the thread pool; cost is the work per lane.
+        template <typename F>
+        static void for_blocks(size_t batch_size, size_t cost, F &&f) {
+          const size_t grain =
+              std::max<size_t>(block_size, parallel::grain / cost);
+          thread::parallel_for(
+              0, batch_size, grain, [&f](size_t first, size_t last) {
+                for (size_t b = first; b < last; b += block_size) {
+                  f(b, std::min(b + block_size, last));
+                }
+              });
+        }
+
+      public:
+        explicit MatrixBatch(size_t batch_size = 0)
+            : batch_size(batch_size), storage(m * n * batch_size) {}
+        template <typename Iterator>
+        MatrixBatch(Iterator first, Iterator last)
+            : MatrixBatch(std::distance(first, last)) {
+          for (size_t k = 0; first != last; ++first, ++k) {
+            set(k, *first);
+          }
+        }
+        explicit MatrixBatch(const std::vector<MatrixArray<T, m, n>> &arrays)
+            : MatrixBatch(arrays.begin(), arrays.end()) {}
+
+        MatrixArray<T, m, n> get(size_t k) const {
+          MatrixArray<T, m, n> array;
+          for (size_t e = 0; e < m * n; ++e) {
+            array.data()[e] = storage[e * batch_size + k];
+          }
+          return array;
+        }
+        void set(size_t k, const MatrixArray<T, m, n> &array) {
+          for (size_t e = 0; e < m * n; ++e) {
+            storage[e * batch_size + k] = array.data()[e];
+          }
+        }
+        std::vector<MatrixArray<T, m, n>> to_arrays() const {
+          std::vector<MatrixArray<T, m, n>> arrays(batch_size);
+          for (size_t k = 0; k < batch_size; ++k) {
+            arrays[k] = get(k);
+          }
+          return arrays;
+        }
+
+        bool operator==(const MatrixBatch &rhs) const {
+          return batch_size == rhs.batch_size &&
+                 parallel::equal(storage.size(), storage.data(),
+                                 rhs.storage.data());
+        }
+        bool operator!=(const MatrixBatch &rhs) const {
+          return !(*this == rhs);
+        }
+
+        MatrixBatch &operator+=(const MatrixBatch &rhs) {
+          if (batch_size != rhs.batch_size) {
+            throw std::invalid_argument("batch sizes do not match");
+          }
+          KETCPP_PROFILE_BINARY(add, *this, rhs, storage.size(),
+                                3. * storage.size() * sizeof(T), 0);
+          parallel::add(storage.size(), storage.data(), rhs.storage.data(),
+                        storage.data());
+          return *this;
+        }
+        MatrixBatch &operator*=(T rhs) {
+          KETCPP_PROFILE_UNARY(scale, *this, storage.size(),
+                               2. * storage.size() * sizeof(T), 0);
+          parallel::scale(storage.size(), rhs, storage.data(),
+                          storage.data());
+          return *this;
+        }
+
+        // Multiplies matrix k of this batch by matrix k of rhs for every k.
+        template <size_t l>
+        MatrixBatch<T, m, l> operator*(const MatrixBatch<T, n, l> &rhs) const {
+          if (batch_size != rhs.batch_size) {
+            throw std::invalid_argument("batch sizes do not match");
+          }
+          KETCPP_PROFILE_BINARY(multiply, *this, rhs,
+                                2. * m * n * l * batch_size,
+                                (m * n + n * l + m * l) * batch_size *
+                                    sizeof(T),
+                                1);
+          MatrixBatch<T, m, l> c(batch_size);
+          for_blocks(batch_size, m * n * l, [&](size_t first, size_t last) {
+            for (size_t i = 0; i < m; ++i) {
+              for (size_t j = 0; j < l; ++j) {
+                T *cij = c.data(i, j);
+                for (size_t p = 0; p < n; ++p) {
+                  const T *aip = data(i, p);
+                  const T *bpj = rhs.data(p, j);
+                  for (size_t k = first; k < last; ++k) {
+                    cij[k] += aip[k] * bpj[k];
+                  }
+                }
+              }
+            }
+          });
+          return c;
+        }
+
+        // Solves A_k X_k = B_k for every matrix A_k of this (square) batch
+        // by Gauss-Jordan elimination with partial pivoting. Pivot rows are
+        // chosen lane by lane; the elimination itself runs across lanes.
+        // Throws std::domain_error if any A_k is singular.
+        template <size_t l>
+        MatrixBatch<T, n, l> solve(const MatrixBatch<T, n, l> &rhs) const {
+          static_assert(m == n, "solve needs square matrices");
+          if (batch_size != rhs.batch_size) {
+            throw std::invalid_argument("batch sizes do not match");
+          }
+          MatrixBatch<T, n, l> x = rhs;
+          const size_t lanes = batch_size;
+          for_blocks(lanes, n * n * (n + l), [&](size_t first, size_t last) {
+            const size_t w = last - first;
+            // Scratch copy of the lane block of A, element-major like the
+            // batch itself.
+            std::vector<T> a(n * n * w);
+            for (size_t e = 0; e < n * n; ++e) {
+              std::copy_n(storage.data() + e * lanes + first, w,
+                          a.data() + e * w);
+            }
+            std::vector<T> r(w), f(w);
+            auto at = [&](size_t i, size_t j) {
+              return a.data() + (i * n + j) * w;
+            };
+            auto xt = [&](size_t i, size_t j) { return x.data(i, j) + first; };
+            for (size_t p = 0; p < n; ++p) {
+              for (size_t k = 0; k < w; ++k) {
+                size_t pivot = p;
+                for (size_t i = p + 1; i < n; ++i) {
+                  if (std::abs(at(i, p)[k]) > std::abs(at(pivot, p)[k])) {
+                    pivot = i;
+                  }
+                }
+                if (at(pivot, p)[k] == T(0)) {
+                  throw std::domain_error("matrix is singular");
+                }
+                if (pivot != p) {
+                  for (size_t j = 0; j < n; ++j) {
+                    std::swap(at(p, j)[k], at(pivot, j)[k]);
+                  }
+                  for (size_t j = 0; j < l; ++j) {
+                    std::swap(xt(p, j)[k], xt(pivot, j)[k]);
+                  }
+                }
+              }
+              const T *app = at(p, p);
+              for (size_t k = 0; k < w; ++k) {
+                r[k] = T(1) / app[k];
+              }
+              for (size_t j = 0; j < n; ++j) {
+                T *apj = at(p, j);
+                for (size_t k = 0; k < w; ++k) {
+                  apj[k] *= r[k];
+                }
+              }
+              for (size_t j = 0; j < l; ++j) {
+                T *xpj = xt(p, j);
+                for (size_t k = 0; k < w; ++k) {
+                  xpj[k] *= r[k];
+                }
+              }
+              for (size_t i = 0; i < n; ++i) {
+                if (i == p) {
+                  continue;
+                }
+                std::copy_n(at(i, p), w, f.data());
+                for (size_t j = 0; j < n; ++j) {
+                  T *aij = at(i, j);
+                  const T *apj = at(p, j);
+                  for (size_t k = 0; k < w; ++k) {
+                    aij[k] -= f[k] * apj[k];
+                  }
+                }
+                for (size_t j = 0; j < l; ++j) {
+                  T *xij = xt(i, j);
+                  const T *xpj = xt(p, j);
+                  for (size_t k = 0; k < w; ++k) {
+                    xij[k] -= f[k] * xpj[k];
+                  }
+                }
+              }
+            }
+          });
+          return x;
+        }
+      };
+
+      template <typename T, size_t m, size_t n>
+      constexpr size_t MatrixBatch<T, m, n>::num_rows;
+      template <typename T, size_t m, size_t n>
+      constexpr size_t MatrixBatch<T, m, n>::num_columns;
+      template <typename T, size_t m, size_t n>
+      constexpr size_t MatrixBatch<T, m, n>::block_size;
+    }
+  }
+}
@@ -0,0 +1,653 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "wrapper/matrix/base.h"
+#include "wrapper/matrix/dispatch.h"
+#include "wrapper/matrix/gemm.h"
+#include "wrapper/matrix/parallel.h"
+#include "wrapper/matrix/vector.h"
+#include "wrapper/thread/pool.h"
+
+namespace ketcpp {
+  namespace wrapper {
+    namespace matrix {
+      // Sparse matrix made of dense square blocks, stored in compressed
+      // sparse row form over the block grid: the stored blocks of block row
+      // I are column_indices[row_pointers[I] .. row_pointers[I + 1]], sorted,
+      // and block k occupies values[k * b * b ..] in row-major order. Blocks
+      // on the lower and right edges are padded with zeros to b x b. Blocks
+      // whose largest element is not above the drop tolerance are not kept
+      // by conversions and products.
+      template <typename T> class MatrixBlockSparse : public MatrixBase<T> {
+      public:
+        constexpr static size_t default_block_size = 16;
+
+      private:
+        size_t num_rows, num_columns;
+        size_t block_size;
+        T tolerance;
+        std::vector<size_t> row_pointers;
+        std::vector<size_t> column_indices;
+        std::vector<T> values;
+
+        size_t get_block_area() const { return block_size * block_size; }
+        size_t get_rows_in(size_t bi) const {
+          return std::min(block_size, num_rows - bi * block_size);
+        }
+        size_t get_columns_in(size_t bj) const {
+          return std::min(block_size, num_columns - bj * block_size);
+        }
+
+      public:
+        size_t get_num_rows() const { return num_rows; }
+        size_t get_num_columns() const { return num_columns; }
+        size_t get_row_size() const { return num_columns; }
+        size_t get_column_size() const { return num_rows; }
+        size_t get_block_size() const { return block_size; }
+        T get_tolerance() const { return tolerance; }
+        size_t get_num_block_rows() const { return row_pointers.size() - 1; }
+        size_t get_num_block_columns() const {
+          return (num_columns + block_size - 1) / block_size;
+        }
+        size_t get_num_blocks() const { return column_indices.size(); }
+
+        // Stored block (bi, bj), or nullptr.
+        const T *find_block(size_t bi, size_t bj) const {
+          auto first = column_indices.begin() + row_pointers[bi];
+          auto last = column_indices.begin() + row_pointers[bi + 1];
+          auto it = std::lower_bound(first, last, bj);
+          if (it == last || *it != bj) {
+            return nullptr;
+          }
+          const size_t k = it - column_indices.begin();
+          return values.data() + k * get_block_area();
+        }
+        T *find_block(size_t bi, size_t bj) {
+          return const_cast<T *>(
+              static_cast<const MatrixBlockSparse &>(*this).find_block(bi,
+                                                                       bj));
+        }
+        // Block (bi, bj), inserting a zero block when it is not stored.
+        T *get_block(size_t bi, size_t bj) {
+          auto first = column_indices.begin() + row_pointers[bi];
+          auto last = column_indices.begin() + row_pointers[bi + 1];
+          auto it = std::lower_bound(first, last, bj);
+          const size_t k = it - column_indices.begin();
+          if (it == last || *it != bj) {
+            column_indices.insert(it, bj);
+            values.insert(values.begin() + k * get_block_area(),
+                          get_block_area(), T(0));
+            for (size_t i = bi + 1; i < row_pointers.size(); ++i) {
+              ++row_pointers[i];
+            }
+          }
+          return values.data() + k * get_block_area();
+        }
+
+        // Reading an element outside the stored blocks yields zero; writing
+        // one inserts its block. The generic iterators insert a block only
+        // when a nonzero is written outside the stored ones.
+        const T &operator()(size_t i, size_t j) const {
+          static const T zero = T(0);
+          const T *block = find_block(i / block_size, j / block_size);
+          return block == nullptr ? zero
+                                  : block[i % block_size * block_size +
+                                          j % block_size];
+        }
+        T &operator()(size_t i, size_t j) {
+          T *block = get_block(i / block_size, j / block_size);
+          return block[i % block_size * block_size + j % block_size];
+        }
+
+      private:
+        using Base = MatrixBase<T>;
+        typedef typename Base::RowVectorIterator RowVectorIterator;
+        typedef typename Base::RowElementIterator RowElementIterator;
+        typedef typename Base::ColumnVectorIterator ColumnVectorIterator;
+        typedef typename Base::ColumnElementIterator ColumnElementIterator;
+        typedef typename Base::RowVectorConstIterator RowVectorConstIterator;
+        typedef typename Base::RowElementConstIterator RowElementConstIterator;
+        typedef
+            typename Base::ColumnVectorConstIterator ColumnVectorConstIterator;
+        typedef typename Base::ColumnElementConstIterator
+            ColumnElementConstIterator;
+
+        // Walks the full matrix by linear position i * n + j and looks each
+        // element up in the stored blocks. A mutable iterator hands out an
+        // element outside them as a zero in pending, and writes it back,
+        // inserting its block, only if it has become nonzero by the time
+        // the iterator moves on or is destroyed.
+        template <bool is_const>
+        class GenericIterator
+            : public Base::template BaseGenericIterator<is_const> {
+          using BaseIterator =
+              typename Base::template BaseGenericIterator<is_const>;
+          using unique_ptr = std::unique_ptr<BaseIterator>;
+          constexpr static size_t none = size_t(-1);
+          typename std::conditional<is_const, const MatrixBlockSparse *,
+                                    MatrixBlockSparse *>::type matrix;
+          size_t position;
+          size_t pending_position = none;
+          T pending = T(0);
+
+          unique_ptr make(size_t p) const {
+            return std::make_unique<GenericIterator>(matrix, p);
+          }
+
+          void flush(std::true_type) {}
+          void flush(std::false_type) {
+            if (pending_position != none && pending != T(0)) {
+              (*matrix)(pending_position / matrix->num_columns,
+                        pending_position % matrix->num_columns) = pending;
+            }
+            pending_position = none;
+          }
+          void flush() { flush(std::integral_constant<bool, is_const>()); }
+
+          const T &element(std::true_type) {
+            return (*matrix)(position / matrix->num_columns,
+                             position % matrix->num_columns);
+          }
+          T &element(std::false_type) {
+            flush();
+            const size_t i = position / matrix->num_columns;
+            const size_t j = position % matrix->num_columns;
+            const size_t b = matrix->block_size;
+            T *block = matrix->find_block(i / b, j / b);
+            if (block != nullptr) {
+              return block[i % b * b + j % b];
+            }
+            pending = T(0);
+            pending_position = position;
+            return pending;
+          }
+
+        protected:
+          void advance_in_column() {
+            flush();
+            position += matrix->num_columns;
+          }
+          void advance_in_row() {
+            flush();
+            position++;
+          }
+          unique_ptr row_begin() { return make(position); }
+          unique_ptr row_end() { return make(position + matrix->num_columns); }
+          unique_ptr column_begin() { return make(position); }
+          unique_ptr column_end() {
+            return make(position + matrix->num_rows * matrix->num_columns);
+          }
+          unique_ptr copy() { return make(position); }
+          bool operator==(BaseIterator &rhs) const throw(std::bad_cast &) {
+            auto &rhs_cast = dynamic_cast<decltype(*this)>(rhs);
+            return this->position == rhs_cast.position;
+          }
+          bool operator!=(BaseIterator &rhs) const throw(std::bad_cast &) {
+            auto &rhs_cast = dynamic_cast<decltype(*this)>(rhs);
+            return this->position != rhs_cast.position;
+          }
+          typename BaseIterator::difference_type
+          operator-(const BaseIterator &rhs) const throw(std::bad_cast &) {
+            auto &rhs_cast = dynamic_cast<decltype(*this)>(rhs);
+            return this->position - rhs_cast.position;
+          }
+          typename std::conditional<is_const, const T &, T &>::type
+          operator*() {
+            return element(std::integral_constant<bool, is_const>());
+          }
+
+        public:
+          GenericIterator(decltype(matrix) matrix, size_t position)
+              : matrix(matrix), position(position) {}
+          ~GenericIterator() { flush(); }
+        };
+        using Iterator = GenericIterator<false>;
+        using ConstIterator = GenericIterator<true>;
+
+      protected:
+        RowVectorConstIterator row_cbegin() const {
+          return RowVectorConstIterator(
+              std::make_unique<ConstIterator>(this, 0));
+        }
+        RowVectorConstIterator row_cend() const {
+          return RowVectorConstIterator(
+              std::make_unique<ConstIterator>(this, num_rows * num_columns));
+        }
+        ColumnVectorConstIterator column_cbegin() const {
+          return ColumnVectorConstIterator(
+              std::make_unique<ConstIterator>(this, 0));
+        }
+        ColumnVectorConstIterator column_cend() const {
+          return ColumnVectorConstIterator(
+              std::make_unique<ConstIterator>(this, num_columns));
+        }
+        RowVectorIterator row_begin() {
+          return RowVectorIterator(std::make_unique<Iterator>(this, 0));
+        }
+        RowVectorIterator row_end() {
+          return RowVectorIterator(
+              std::make_unique<Iterator>(this, num_rows * num_columns));
+        }
+        ColumnVectorIterator column_begin() {
+          return ColumnVectorIterator(std::make_unique<Iterator>(this, 0));
+        }
+        ColumnVectorIterator column_end() {
+          return ColumnVectorIterator(
+              std::make_unique<Iterator>(this, num_columns));
+        }
+
+      private:
+        static const MatrixBlockSparse &cast(const Base &matrix) {
+          return static_cast<const MatrixBlockSparse &>(matrix);
+        }
+
+        bool is_negligible(const T *block) const {
+          for (size_t k = 0; k < get_block_area(); ++k) {
+            if (std::abs(block[k]) > tolerance) {
+              return false;
+            }
+          }
+          return true;
+        }
+
+        // Rebuilds the structure from the strided dense matrix src.
+        void assign_dense(const T *src, std::ptrdiff_t rs, std::ptrdiff_t cs) {
+          column_indices.clear();
+          values.clear();
+          std::vector<T> block(get_block_area());
+          for (size_t bi = 0; bi < get_num_block_rows(); ++bi) {
+            for (size_t bj = 0; bj < get_num_block_columns(); ++bj) {
+              std::fill(block.begin(), block.end(), T(0));
+              const T *s = src + bi * block_size * rs + bj * block_size * cs;
+              for (size_t i = 0; i < get_rows_in(bi); ++i) {
+                for (size_t j = 0; j < get_columns_in(bj); ++j) {
+                  block[i * block_size + j] = s[i * rs + j * cs];
+                }
+              }
+              if (!is_negligible(block.data())) {
+                column_indices.push_back(bj);
+                values.insert(values.end(), block.begin(), block.end());
+              }
+            }
+            row_pointers[bi + 1] = column_indices.size();
+          }
+        }
+
+        // Calls f(i, j, x) for every element of the stored blocks.
+        template <typename F> void for_each_element(F &&f) const {
+          for (size_t bi = 0; bi < get_num_block_rows(); ++bi) {
+            for (size_t k = row_pointers[bi]; k < row_pointers[bi + 1]; ++k) {
+              const size_t bj = column_indices[k];
+              const T *block = values.data() + k * get_block_area();
+              for (size_t i = 0; i < get_rows_in(bi); ++i) {
+                for (size_t j = 0; j < get_columns_in(bj); ++j) {
+                  f(bi * block_size + i, bj * block_size + j,
+                    block[i * block_size + j]);
+                }
+              }
+            }
+          }
+        }
+
+        // Adds the stored blocks to the strided dense matrix dest.
+        void add_to_dense(T *dest, std::ptrdiff_t rs,
+                          std::ptrdiff_t cs) const {
+          for (size_t bi = 0; bi < get_num_block_rows(); ++bi) {
+            for (size_t k = row_pointers[bi]; k < row_pointers[bi + 1]; ++k) {
+              const size_t bj = column_indices[k];
+              const T *block = values.data() + k * get_block_area();
+              T *d = dest + bi * block_size * rs + bj * block_size * cs;
+              for (size_t i = 0; i < get_rows_in(bi); ++i) {
+                kernel::strided_axpy(get_columns_in(bj), T(1),
+                                     block + i * block_size, 1, d + i * rs,
+                                     cs);
+              }
+            }
+          }
+        }
+
+        // C = A * B for block-sparse A and strided dense B; block rows of C
+        // are computed in parallel.
+        static std::unique_ptr<Base> multiply_dense(const Base &lhs,
+                                                    const Base &rhs) {
+          const auto &a = cast(lhs);
+          const size_t b = a.block_size, n = rhs.get_num_columns();
+          std::unique_ptr<Base> c(new MatrixVector<T>(a.num_rows, n));
+          T *cd = c->data();
+          const std::ptrdiff_t rsc = c->get_row_stride();
+          const size_t grain =
+              std::max<size_t>(parallel::grain / (b * b * n + 1), 1);
+          thread::parallel_for(
+              0, a.get_num_block_rows(), grain, [&](size_t first, size_t last) {
+                for (size_t bi = first; bi < last; ++bi) {
+                  for (size_t k = a.row_pointers[bi];
+                       k < a.row_pointers[bi + 1]; ++k) {
+                    const size_t bj = a.column_indices[k];
+                    gemm<T>(a.get_rows_in(bi), n, a.get_columns_in(bj), T(1),
+                            a.values.data() + k * a.get_block_area(), b, 1,
+                            rhs.data() + bj * b * rhs.get_row_stride(),
+                            rhs.get_row_stride(), rhs.get_column_stride(),
+                            T(1), cd + bi * b * rsc, rsc, 1);
+                  }
+                }
+              });
+          return c;
+        }
+
+        // C = A * B for strided dense A and block-sparse B; row slices of C
+        // are computed in parallel.
+        static std::unique_ptr<Base> multiply_dense_left(const Base &lhs,
+                                                         const Base &rhs) {
+          const auto &b = cast(rhs);
+          const size_t bs = b.block_size, m = lhs.get_num_rows();
+          std::unique_ptr<Base> c(new MatrixVector<T>(m, b.num_columns));
+          T *cd = c->data();
+          const std::ptrdiff_t rsc = c->get_row_stride();
+          const std::ptrdiff_t rsa = lhs.get_row_stride();
+          const std::ptrdiff_t csa = lhs.get_column_stride();
+          const size_t grain = std::max<size_t>(
+              parallel::grain / (b.values.size() + 1) * bs, bs);
+          thread::parallel_for(0, m, grain, [&](size_t first, size_t last) {
+            for (size_t bj = 0; bj < b.get_num_block_rows(); ++bj) {
+              for (size_t k = b.row_pointers[bj]; k < b.row_pointers[bj + 1];
+                   ++k) {
+                const size_t bk = b.column_indices[k];
+                gemm<T>(last - first, b.get_columns_in(bk), b.get_rows_in(bj),
+                        T(1), lhs.data() + first * rsa + bj * bs * csa, rsa,
+                        csa, b.values.data() + k * b.get_block_area(), bs, 1,
+                        T(1), cd + first * rsc + bk * bs, rsc, 1);
+              }
+            }
+          });
+          return c;
+        }
+
+        // C = A * B for block-sparse A and B, one block row of C at a time
+        // with a dense accumulator; the result keeps the block size and
+        // drop tolerance of A.
+        static std::unique_ptr<Base> multiply_sparse(const Base &lhs,
+                                                     const Base &rhs) {
+          const auto &a = cast(lhs), &b = cast(rhs);
+          if (a.block_size != b.block_size) {
+            return multiply_dense(lhs, *b.to_dense());
+          }
+          const size_t bs = a.block_size, area = a.get_block_area();
+          const size_t num_block_rows = a.get_num_block_rows();
+          const size_t num_block_columns = b.get_num_block_columns();
+          std::vector<std::vector<size_t>> row_columns(num_block_rows);
+          std::vector<std::vector<T>> row_values(num_block_rows);
+          const size_t grain = std::max<size_t>(
+              parallel::grain /
+                  (a.values.size() / std::max<size_t>(num_block_rows, 1) + 1),
+              1);
+          thread::parallel_for(0, num_block_rows, grain, [&](size_t first,
+                                                             size_t last) {
+            std::vector<T> accumulator(num_block_columns * area);
+            std::vector<bool> touched(num_block_columns);
+            for (size_t bi = first; bi < last; ++bi) {
+              std::fill(accumulator.begin(), accumulator.end(), T(0));
+              std::fill(touched.begin(), touched.end(), false);
+              for (size_t k = a.row_pointers[bi]; k < a.row_pointers[bi + 1];
+                   ++k) {
+                const size_t bj = a.column_indices[k];
+                for (size_t l = b.row_pointers[bj]; l < b.row_pointers[bj + 1];
+                     ++l) {
+                  const size_t bk = b.column_indices[l];
+                  touched[bk] = true;
+                  gemm<T>(bs, bs, bs, T(1), a.values.data() + k * area, bs,
+                          b.values.data() + l * area, bs, T(1),
+                          accumulator.data() + bk * area, bs);
+                }
+              }
+              for (size_t bk = 0; bk < num_block_columns; ++bk) {
+                const T *block = accumulator.data() + bk * area;
+                if (touched[bk] && !a.is_negligible(block)) {
+                  row_columns[bi].push_back(bk);
+                  row_values[bi].insert(row_values[bi].end(), block,
+                                        block + area);
+                }
+              }
+            }
+          });
+          std::unique_ptr<MatrixBlockSparse> c(new MatrixBlockSparse(
+              a.num_rows, b.num_columns, bs, a.tolerance));
+          for (size_t bi = 0; bi < num_block_rows; ++bi) {
+            c->column_indices.insert(c->column_indices.end(),
+                                     row_columns[bi].begin(),
+                                     row_columns[bi].end());
+            c->values.insert(c->values.end(), row_values[bi].begin(),
+                             row_values[bi].end());
+            c->row_pointers[bi + 1] = c->column_indices.size();
+          }
+          return std::move(c);
+        }
+
+        static void add_sparse(Base &lhs, const Base &rhs) {
+          auto &a = static_cast<MatrixBlockSparse &>(lhs);
+          const auto &b = cast(rhs);
+          if (a.block_size != b.block_size) {
+            b.for_each_element([&a](size_t i, size_t j, T x) {
+              if (x != T(0)) {
+                a(i, j) += x;
+              }
+            });
+            return;
+          }
+          for (size_t bi = 0; bi < b.get_num_block_rows(); ++bi) {
+            for (size_t k = b.row_pointers[bi]; k < b.row_pointers[bi + 1];
+                 ++k) {
+              T *block = a.get_block(bi, b.column_indices[k]);
+              simd::add(a.get_block_area(), block,
+                        b.values.data() + k * a.get_block_area(), block);
+            }
+          }
+        }
+        // Merges the strided dense operand into the structure block by
+        // block in one pass. Blocks are created only where the dense
+        // operand has a nonzero outside the stored ones.
+        static void add_dense(Base &lhs, const Base &rhs) {
+          auto &a = static_cast<MatrixBlockSparse &>(lhs);
+          const T *b = rhs.data();
+          const std::ptrdiff_t rs = rhs.get_row_stride();
+          const std::ptrdiff_t cs = rhs.get_column_stride();
+          const size_t bs = a.block_size, area = a.get_block_area();
+          std::vector<size_t> pointers(a.row_pointers.size(), 0), columns;
+          std::vector<T> values;
+          columns.reserve(a.column_indices.size());
+          values.reserve(a.values.size());
+          for (size_t bi = 0; bi < a.get_num_block_rows(); ++bi) {
+            size_t k = a.row_pointers[bi];
+            for (size_t bj = 0; bj < a.get_num_block_columns(); ++bj) {
+              const T *src = b + bi * bs * rs + bj * bs * cs;
+              const size_t rows = a.get_rows_in(bi);
+              const size_t cols = a.get_columns_in(bj);
+              const bool stored =
+                  k < a.row_pointers[bi + 1] && a.column_indices[k] == bj;
+              if (!stored) {
+                bool zero = true;
+                for (size_t i = 0; i < rows && zero; ++i) {
+                  for (size_t j = 0; j < cols && zero; ++j) {
+                    zero = src[i * rs + j * cs] == T(0);
+                  }
+                }
+                if (zero) {
+                  continue;
+                }
+                values.resize(values.size() + area, T(0));
+              } else {
+                const T *block = a.values.data() + k++ * area;
+                values.insert(values.end(), block, block + area);
+              }
+              columns.push_back(bj);
+              T *block = values.data() + values.size() - area;
+              for (size_t i = 0; i < rows; ++i) {
+                kernel::strided_axpy(cols, T(1), src + i * rs, cs,
+                                     block + i * bs, 1);
+              }
+            }
+            pointers[bi + 1] = columns.size();
+          }
+          a.row_pointers.swap(pointers);
+          a.column_indices.swap(columns);
+          a.values.swap(values);
+        }
+        static void add_into_dense(Base &lhs, const Base &rhs) {
+          cast(rhs).add_to_dense(lhs.data(), lhs.get_row_stride(),
+                                 lhs.get_column_stride());
+        }
+        static void convert_to_dense(Base &dest, const Base &src) {
+          kernel::scale(dest.get_num_rows(), dest.get_num_columns(), T(0),
+                        dest.data(), dest.get_row_stride(),
+                        dest.get_column_stride());
+          add_into_dense(dest, src);
+        }
+        static void convert_from_dense(Base &dest, const Base &src) {
+          static_cast<MatrixBlockSparse &>(dest).assign_dense(
+              src.data(), src.get_row_stride(), src.get_column_stride());
+        }
+
+        static bool register_kernels() {
+          auto &dispatcher = Dispatcher<T>::get_instance();
+          // Strided stands for every dense backend and layout.
+          using Dense = Strided;
+          using Sparse = MatrixBlockSparse;
+          dispatcher.template define<Operation::add, Sparse, Sparse>(
+              add_sparse);
+          dispatcher.template define<Operation::add, Sparse, Dense>(
+              add_dense);
+          dispatcher.template define<Operation::add, Dense, Sparse>(
+              add_into_dense);
+          dispatcher.template define<Operation::multiply, Sparse, Sparse>(
+              multiply_sparse);
+          dispatcher.template define<Operation::multiply, Sparse, Dense>(
+              multiply_dense);
+          dispatcher.template define<Operation::multiply, Dense, Sparse>(
+              multiply_dense_left);
+          dispatcher.template define<Operation::convert, Dense, Sparse>(
+              convert_to_dense);
+          dispatcher.template define<Operation::convert, Sparse, Dense>(
+              convert_from_dense);
+          return true;
+        }
+        static void ensure_registered() {
+          static const bool registered = register_kernels();
+          (void)registered;
+        }
+
+      public:
+        // Empty (all zero) m x n matrix.
+        MatrixBlockSparse(size_t m, size_t n,
+                          size_t block_size = default_block_size,
+                          T tolerance = T(0))
+            : num_rows(m), num_columns(n), block_size(block_size),
+              tolerance(tolerance),
+              row_pointers((m + block_size - 1) / block_size + 1, 0) {
+          if (block_size == 0) {
+            throw std::invalid_argument("block size must be positive");
+          }
+          ensure_registered();
+        }
+        // Keeps the blocks of src that are not negligible.
+        explicit MatrixBlockSparse(const Base &src,
+                                   size_t block_size = default_block_size,
+                                   T tolerance = T(0))
+            : MatrixBlockSparse(src.get_num_rows(), src.get_num_columns(),
+                                block_size, tolerance) {
+          Dispatcher<T>::convert(*this, src);
+        }
+        MatrixBlockSparse(
+            const std::initializer_list<std::initializer_list<T>> &list,
+            size_t block_size = default_block_size, T tolerance = T(0))
+            : MatrixBlockSparse(MatrixVector<T>(list), block_size,
+                                tolerance) {}
+        MatrixBlockSparse() = delete;
+
+        std::unique_ptr<MatrixVector<T>> to_dense() const {
+          std::unique_ptr<MatrixVector<T>> dense(
+              new MatrixVector<T>(num_rows, num_columns));
+          add_to_dense(dense->data(), dense->get_row_stride(), 1);
+          return dense;
+        }
+
+        // Drops the stored blocks that have become negligible.
+        void prune() {
+          size_t kept = 0, k = 0;
+          for (size_t bi = 0; bi < get_num_block_rows(); ++bi) {
+            for (; k < row_pointers[bi + 1]; ++k) {
+              const T *block = values.data() + k * get_block_area();
+              if (!is_negligible(block)) {
+                column_indices[kept] = column_indices[k];
+                std::copy(block, block + get_block_area(),
+                          values.begin() + kept * get_block_area());
+                ++kept;
+              }
+            }
+            row_pointers[bi + 1] = kept;
+          }
+          column_indices.resize(kept);
+          values.resize(kept * get_block_area());
+        }
+
+        bool operator==(const Base &rhs) const {
+          return Dispatcher<T>::compare(*this, rhs);
+        }
+        Base &operator+=(const Base &rhs) {
+          Dispatcher<T>::add(*this, rhs);
+          return *this;
+        }
+        Base &operator*=(T rhs) {
+          KETCPP_PROFILE_UNARY(scale, *this, values.size(),
+                               2. * values.size() * sizeof(T), 0);
+          parallel::scale(values.size(), rhs, values.data(), values.data());
+          return *this;
+        }
+
+        Base &add_to_diagonal(T alpha) {
+          const size_t k = alpha == T(0) ? 0 : std::min(num_rows, num_columns);
+          for (size_t i = 0; i < k; ++i) {
+            (*this)(i, i) += alpha;
+          }
+          return *this;
+        }
+        T get_frobenius_norm() const {
+          return parallel::norm(values.size(), values.data());
+        }
+
+        std::unique_ptr<MatrixBase<T>> copy() const {
+          KETCPP_PROFILE_UNARY(copy, *this, 0,
+                               2. * values.size() * sizeof(T), 1);
+          std::unique_ptr<MatrixBase<T>> copy;
+          copy.reset(new MatrixBlockSparse(*this));
+          return std::move(copy);
+        }
+
+        ~MatrixBlockSparse() {}
+      };
+    }
+  }
+}
@@ -0,0 +1,302 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cerrno>
+#include <complex>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <typeinfo>
+
+#include "wrapper/matrix/base.h"
+#include "wrapper/matrix/dispatch.h"
+#include "wrapper/matrix/mapped.h"
+#include "wrapper/matrix/symmetric.h"
+#include "wrapper/matrix/vector.h"
+
+namespace ketcpp {
+  namespace wrapper {
+    namespace matrix {
+      // Binary matrix files: a 64-byte header followed by the elements in
+      // native byte order. The payload starts at a 64-byte boundary, so a
+      // mapped file can be used in place.
+      namespace checkpoint {
+        constexpr uint32_t version = 1;
+        constexpr uint32_t byte_order_mark = 0x01020304;
+        constexpr size_t alignment = 64;
+
+        enum class DType : uint32_t {
+          float32 = 1,
+          float64 = 2,
+          complex64 = 3,
+          complex128 = 4
+        };
+        enum class Layout : uint32_t {
+          row_major = 0,
+          column_major = 1,
+          packed_upper = 2
+        };
+        enum class Symmetry : uint32_t { none = 0, symmetric = 1 };
+
+        struct Header {
+          char magic[8];
+          uint32_t version;
+          uint32_t byte_order;
+          DType dtype;
+          Layout layout;
+          Symmetry symmetry;
+          uint32_t reserved;
+          uint64_t num_rows;
+          uint64_t num_columns;
+          uint64_t payload_offset;
+          uint64_t payload_bytes;
+        };
+        static_assert(sizeof(Header) == alignment,
+                      "checkpoint header must fill one alignment unit");
+
+        template <typename T> struct DTypeOf;
+        template <> struct DTypeOf<float> {
+          constexpr static DType value = DType::float32;
+        };
+        template <> struct DTypeOf<double> {
+          constexpr static DType value = DType::float64;
+        };
+        template <> struct DTypeOf<std::complex<float>> {
+          constexpr static DType value = DType::complex64;
+        };
+        template <> struct DTypeOf<std::complex<double>> {
+          constexpr static DType value = DType::complex128;
+        };
+
+        inline const char *get_magic() { return "KETCPPMX"; }
+
+        template <typename T>
+        Header make_header(size_t m, size_t n, Layout layout,
+                           Symmetry symmetry, size_t count) {
+          Header header = {};
+          std::memcpy(header.magic, get_magic(), sizeof(header.magic));
+          header.version = version;
+          header.byte_order = byte_order_mark;
+          header.dtype = DTypeOf<T>::value;
+          header.layout = layout;
+          header.symmetry = symmetry;
+          header.num_rows = m;
+          header.num_columns = n;
+          header.payload_offset = sizeof(Header);
+          header.payload_bytes = count * sizeof(T);
+          return header;
+        }
+
+        // Throws unless header describes a file this build can read as T.
+        template <typename T> void validate(const Header &header) {
+          if (std::memcmp(header.magic, get_magic(), sizeof(header.magic))) {
+            throw std::runtime_error("not a ketcpp matrix checkpoint");
+          }
+          if (header.version != version) {
+            throw std::runtime_error("unsupported checkpoint version");
+          }
+          if (header.byte_order != byte_order_mark) {
+            throw std::runtime_error("checkpoint has foreign byte order");
+          }
+          if (header.dtype != DTypeOf<T>::value) {
+            throw std::runtime_error("checkpoint element type mismatch");
+          }
+          if (header.payload_offset % alignment != 0) {
+            throw std::runtime_error("misaligned checkpoint payload");
+          }
+          const uint64_t m = header.num_rows, n = header.num_columns;
+          uint64_t count;
+          switch (header.layout) {
+          case Layout::row_major:
+          case Layout::column_major:
+            count = m * n;
+            break;
+          case Layout::packed_upper:
+            if (m != n) {
+              throw std::runtime_error("packed checkpoint is not square");
+            }
+            count = n * (n + 1) / 2;
+            break;
+          default:
+            throw std::runtime_error("unsupported checkpoint layout");
+          }
+          if (header.payload_bytes != count * sizeof(T)) {
+            throw std::runtime_error("checkpoint payload size mismatch");
+          }
+        }
+
+        class File {
+          std::FILE *fp;
+
+        public:
+          File(const std::string &path, const char *mode)
+              : fp(std::fopen(path.c_str(), mode)) {
+            if (fp == nullptr) {
+              throw std::system_error(errno, std::generic_category(), path);
+            }
+          }
+          File(const File &) = delete;
+          ~File() {
+            if (fp != nullptr) {
+              std::fclose(fp);
+            }
+          }
+          void write(const void *ptr, size_t bytes) {
+            if (std::fwrite(ptr, 1, bytes, fp) != bytes) {
+              throw std::system_error(errno, std::generic_category(), "write");
+            }
+          }
+          void read(void *ptr, size_t bytes) {
+            if (std::fread(ptr, 1, bytes, fp) != bytes) {
+              throw std::runtime_error("truncated checkpoint");
+            }
+          }
+          void close() {
+            const int status = std::fclose(fp);
+            fp = nullptr;
+            if (status != 0) {
+              throw std::system_error(errno, std::generic_category(), "close");
+            }
+          }
+        };
+
+        template <typename T> Header read_header(File &file) {
+          Header header;
+          file.read(&header, sizeof(header));
+          validate<T>(header);
+          return header;
+        }
+      }
+
+      // Writes matrix to path. Symmetric matrices are stored packed, dense
+      // column-major storage as it is, and other backends as dense
+      // row-major; contiguous storage is written in a single call.
+      template <typename T>
+      void write_checkpoint(const std::string &path,
+                            const MatrixBase<T> &matrix) {
+        using namespace checkpoint;
+        const size_t m = matrix.get_num_rows(), n = matrix.get_num_columns();
+        File file(path, "wb");
+        if (typeid(matrix) == typeid(MatrixSymmetric<T>)) {
+          const auto &s = static_cast<const MatrixSymmetric<T> &>(matrix);
+          const Header header = make_header<T>(
+              m, n, checkpoint::Layout::packed_upper, Symmetry::symmetric,
+              s.get_packed_size());
+          file.write(&header, sizeof(header));
+          file.write(s.packed_data(), header.payload_bytes);
+        } else if (kernel::is_column_major(matrix)) {
+          const Header header = make_header<T>(
+              m, n, checkpoint::Layout::column_major, Symmetry::none, m * n);
+          file.write(&header, sizeof(header));
+          file.write(matrix.data(), header.payload_bytes);
+        } else {
+          std::unique_ptr<MatrixBase<T>> temp;
+          if (!kernel::is_contiguous(matrix)) {
+            temp = kernel::to_strided(matrix);
+          }
+          const MatrixBase<T> &dense = temp ? *temp : matrix;
+          const Header header = make_header<T>(
+              m, n, checkpoint::Layout::row_major, Symmetry::none, m * n);
+          file.write(&header, sizeof(header));
+          file.write(dense.data(), header.payload_bytes);
+        }
+        file.close();
+      }
+
+      // Reads path into a new matrix: MatrixSymmetric for packed files,
+      // MatrixVector in the layout of the file otherwise.
+      template <typename T>
+      std::unique_ptr<MatrixBase<T>> read_checkpoint(const std::string &path) {
+        using namespace checkpoint;
+        File file(path, "rb");
+        const Header header = read_header<T>(file);
+        std::unique_ptr<MatrixBase<T>> matrix;
+        if (header.layout == checkpoint::Layout::packed_upper) {
+          auto s = new MatrixSymmetric<T>(header.num_rows);
+          matrix.reset(s);
+          file.read(s->packed_data(), header.payload_bytes);
+        } else if (header.layout == checkpoint::Layout::column_major) {
+          matrix.reset(new MatrixVectorColumnMajor<T>(header.num_rows,
+                                                      header.num_columns));
+          file.read(matrix->data(), header.payload_bytes);
+        } else {
+          matrix.reset(
+              new MatrixVector<T>(header.num_rows, header.num_columns));
+          file.read(matrix->data(), header.payload_bytes);
+        }
+        return matrix;
+      }
+
+      // Reads path into dest, which must have the shape recorded in the
+      // file and may be any backend.
+      template <typename T>
+      void read_checkpoint(const std::string &path, MatrixBase<T> &dest) {
+        using namespace checkpoint;
+        File file(path, "rb");
+        const Header header = read_header<T>(file);
+        if (header.num_rows != dest.get_num_rows() ||
+            header.num_columns != dest.get_num_columns()) {
+          throw std::invalid_argument("matrix shapes do not match");
+        }
+        if (header.layout == checkpoint::Layout::packed_upper &&
+            typeid(dest) == typeid(MatrixSymmetric<T>)) {
+          file.read(static_cast<MatrixSymmetric<T> &>(dest).packed_data(),
+                    header.payload_bytes);
+        } else if (header.layout == checkpoint::Layout::row_major &&
+                   kernel::is_contiguous(dest)) {
+          file.read(dest.data(), header.payload_bytes);
+        } else if (header.layout == checkpoint::Layout::column_major &&
+                   kernel::is_column_major(dest)) {
+          file.read(dest.data(), header.payload_bytes);
+        } else {
+          file.close();
+          Dispatcher<T>::convert(dest, *read_checkpoint<T>(path));
+        }
+      }
+
+      // Maps a row-major checkpoint in place. Nothing is read until elements
+      // are touched. The file is opened read-only and mapped copy-on-write,
+      // so writes to the matrix never reach it; a file shorter than its
+      // header says throws runtime_error. Packed files cannot be mapped as
+      // a dense matrix and are read instead.
+      template <typename T>
+      std::unique_ptr<MatrixBase<T>> map_checkpoint(const std::string &path) {
+        using namespace checkpoint;
+        Header header;
+        {
+          File file(path, "rb");
+          header = read_header<T>(file);
+        }
+        if (header.layout != checkpoint::Layout::row_major) {
+          return read_checkpoint<T>(path);
+        }
+        return std::unique_ptr<MatrixBase<T>>(
+            new MatrixMapped<T>(path, header.num_rows, header.num_columns,
+                                header.payload_offset,
+                                memory::Sharing::private_copy));
+      }
+    }
+  }
+}
@@ -24,7 +24,17 @@
 
 #include "wrapper/matrix/matrix.h"
 #include "wrapper/matrix/array.h"
+#include "wrapper/matrix/block_sparse.h"
+#include "wrapper/matrix/eigen.h"
+#include "wrapper/matrix/eigensolver.h"
+#include "wrapper/matrix/factorize.h"
+#include "wrapper/matrix/functions.h"
+#include "wrapper/matrix/mapped.h"
+#include "wrapper/matrix/orthogonalizer.h"
+#include "wrapper/matrix/scatter.h"
+#include "wrapper/matrix/symmetric.h"
 #include "wrapper/matrix/vector.h"
+#include "wrapper/matrix/view.h"
 
 namespace ketcpp {
   namespace wrapper {
@@ -44,6 +54,14 @@ namespace ketcpp {
         ptr.reset(new MatrixVector<T>(list));
         return std::move(Matrix<T>(std::move(ptr)));
       }
+
+      template <template <typename> class Backend, typename T>
+      Matrix<T>
+      make_matrix(std::initializer_list<std::initializer_list<T>> list) {
+        std::unique_ptr<MatrixBase<T>> ptr;
+        ptr.reset(new Backend<T>(list));
+        return std::move(Matrix<T>(std::move(ptr)));
+      }
     }
   }
 }
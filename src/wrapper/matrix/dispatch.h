@@ -0,0 +1,475 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <type_traits>
+#include <typeindex>
+#include <unordered_map>
+
+#include "wrapper/matrix/base.h"
+#include "wrapper/matrix/gemm.h"
+#include "wrapper/matrix/parallel.h"
+#include "wrapper/matrix/simd.h"
+#include "wrapper/memory/pool.h"
+#include "wrapper/profile/counters.h"
+
+namespace ketcpp {
+  namespace wrapper {
+    namespace matrix {
+      template <typename T, typename Allocator = memory::PoolAllocator<T>,
+                Layout layout = Layout::row_major>
+      class MatrixVector;
+      template <typename T> class Dispatcher;
+
+      enum class Operation { add, multiply, compare, convert };
+
+      template <typename T, Operation op> struct Signature;
+      template <typename T> struct Signature<T, Operation::add> {
+        using type = void (*)(MatrixBase<T> &lhs, const MatrixBase<T> &rhs);
+      };
+      template <typename T> struct Signature<T, Operation::multiply> {
+        using type = std::unique_ptr<MatrixBase<T>> (*)(
+            const MatrixBase<T> &lhs, const MatrixBase<T> &rhs);
+      };
+      template <typename T> struct Signature<T, Operation::compare> {
+        using type = bool (*)(const MatrixBase<T> &lhs,
+                              const MatrixBase<T> &rhs);
+      };
+      template <typename T> struct Signature<T, Operation::convert> {
+        using type = void (*)(MatrixBase<T> &dest, const MatrixBase<T> &src);
+      };
+
+      namespace kernel {
+        template <typename T> bool is_strided(const MatrixBase<T> &a) {
+          return a.data() != nullptr;
+        }
+
+        template <typename T> bool is_contiguous(const MatrixBase<T> &a) {
+          return a.data() != nullptr && a.get_column_stride() == 1 &&
+                 a.get_row_stride() ==
+                     static_cast<std::ptrdiff_t>(a.get_num_columns());
+        }
+
+        template <typename T> bool is_column_major(const MatrixBase<T> &a) {
+          return a.data() != nullptr && a.get_row_stride() == 1 &&
+                 a.get_column_stride() ==
+                     static_cast<std::ptrdiff_t>(a.get_num_rows());
+        }
+
+        // Dense storage in the same layout, so that both can be handled as
+        // one flat vector.
+        template <typename T>
+        bool is_flat_pair(const MatrixBase<T> &a, const MatrixBase<T> &b) {
+          const size_t m = a.get_num_rows(), n = a.get_num_columns();
+          const bool dense =
+              (a.get_column_stride() == 1 &&
+               a.get_row_stride() == static_cast<std::ptrdiff_t>(n)) ||
+              (a.get_row_stride() == 1 &&
+               a.get_column_stride() == static_cast<std::ptrdiff_t>(m));
+          return a.data() != nullptr && b.data() != nullptr && dense &&
+                 a.get_row_stride() == b.get_row_stride() &&
+                 a.get_column_stride() == b.get_column_stride();
+        }
+
+        // Strides of a with rows and columns swapped when dest keeps its
+        // columns rather than its rows contiguous, so that the line loops
+        // below walk dest along contiguous memory.
+        struct StridedLines {
+          size_t count, length;
+          std::ptrdiff_t dest_line, dest_step, src_line, src_step;
+        };
+        template <typename T>
+        StridedLines get_lines(const MatrixBase<T> &dest,
+                               const MatrixBase<T> &src) {
+          const size_t m = dest.get_num_rows(), n = dest.get_num_columns();
+          if (dest.get_column_stride() != 1 && dest.get_row_stride() == 1) {
+            return StridedLines{n, m, dest.get_column_stride(), 1,
+                                src.get_column_stride(), src.get_row_stride()};
+          }
+          return StridedLines{m, n, dest.get_row_stride(),
+                              dest.get_column_stride(), src.get_row_stride(),
+                              src.get_column_stride()};
+        }
+
+        template <typename T> double size_of(const MatrixBase<T> &a) {
+          return double(a.get_num_rows()) * a.get_num_columns();
+        }
+
+        template <typename T>
+        bool has_same_shape(const MatrixBase<T> &a, const MatrixBase<T> &b) {
+          return a.get_num_rows() == b.get_num_rows() &&
+                 a.get_num_columns() == b.get_num_columns();
+        }
+
+        template <typename T>
+        void strided_scale(size_t n, T a, const T *x, std::ptrdiff_t incx,
+                           T *y, std::ptrdiff_t incy) {
+          if (incx == 1 && incy == 1) {
+            simd::scale(n, a, x, y);
+            return;
+          }
+          for (size_t i = 0; i < n; ++i) {
+            y[i * incy] = a * x[i * incx];
+          }
+        }
+
+        template <typename T>
+        void strided_axpy(size_t n, T a, const T *x, std::ptrdiff_t incx,
+                          T *y, std::ptrdiff_t incy) {
+          if (incx == 1 && incy == 1) {
+            simd::axpy(n, a, x, y);
+            return;
+          }
+          for (size_t i = 0; i < n; ++i) {
+            y[i * incy] += a * x[i * incx];
+          }
+        }
+
+        template <typename T>
+        bool strided_equal(size_t n, const T *x, std::ptrdiff_t incx,
+                           const T *y, std::ptrdiff_t incy) {
+          if (incx == 1 && incy == 1) {
+            return simd::equal(n, x, y);
+          }
+          for (size_t i = 0; i < n; ++i) {
+            if (!(x[i * incx] == y[i * incy])) {
+              return false;
+            }
+          }
+          return true;
+        }
+
+        template <typename T>
+        void strided_copy(size_t n, const T *x, std::ptrdiff_t incx, T *y,
+                          std::ptrdiff_t incy) {
+          if (incx == 1 && incy == 1) {
+            std::copy(x, x + n, y);
+            return;
+          }
+          for (size_t i = 0; i < n; ++i) {
+            y[i * incy] = x[i * incx];
+          }
+        }
+
+        // Kernels for any pair of backends exposing strided storage; a pair
+        // of contiguous operands is handled as one flat vector.
+        template <typename T>
+        void add_strided(MatrixBase<T> &lhs, const MatrixBase<T> &rhs) {
+          const size_t m = lhs.get_num_rows(), n = lhs.get_num_columns();
+          if (is_flat_pair(lhs, rhs)) {
+            parallel::add(m * n, lhs.data(), rhs.data(), lhs.data());
+            return;
+          }
+          const StridedLines l = get_lines(lhs, rhs);
+          for (size_t i = 0; i < l.count; ++i) {
+            strided_axpy(l.length, T(1), rhs.data() + i * l.src_line,
+                         l.src_step, lhs.data() + i * l.dest_line,
+                         l.dest_step);
+          }
+        }
+
+        template <typename T>
+        bool compare_strided(const MatrixBase<T> &lhs,
+                             const MatrixBase<T> &rhs) {
+          const size_t m = lhs.get_num_rows(), n = lhs.get_num_columns();
+          if (is_flat_pair(lhs, rhs)) {
+            return parallel::equal(m * n, lhs.data(), rhs.data());
+          }
+          const StridedLines l = get_lines(lhs, rhs);
+          for (size_t i = 0; i < l.count; ++i) {
+            if (!strided_equal(l.length, lhs.data() + i * l.dest_line,
+                               l.dest_step, rhs.data() + i * l.src_line,
+                               l.src_step)) {
+              return false;
+            }
+          }
+          return true;
+        }
+
+        // Copies between storage whose contiguous directions differ, e.g.
+        // row-major to column-major, in square tiles so that both sides are
+        // read and written a cache line at a time.
+        template <typename T>
+        void transpose_copy(size_t m, size_t n, const T *src,
+                            std::ptrdiff_t rss, std::ptrdiff_t css, T *dest,
+                            std::ptrdiff_t rsd, std::ptrdiff_t csd) {
+          constexpr size_t tile = 32;
+          for (size_t i0 = 0; i0 < m; i0 += tile) {
+            const size_t i1 = std::min(i0 + tile, m);
+            for (size_t j0 = 0; j0 < n; j0 += tile) {
+              const size_t j1 = std::min(j0 + tile, n);
+              for (size_t i = i0; i < i1; ++i) {
+                for (size_t j = j0; j < j1; ++j) {
+                  dest[i * rsd + j * csd] = src[i * rss + j * css];
+                }
+              }
+            }
+          }
+        }
+
+        template <typename T>
+        void convert_strided(MatrixBase<T> &dest, const MatrixBase<T> &src) {
+          const size_t m = dest.get_num_rows(), n = dest.get_num_columns();
+          if (is_flat_pair(dest, src)) {
+            std::copy(src.data(), src.data() + m * n, dest.data());
+            return;
+          }
+          const StridedLines l = get_lines(dest, src);
+          if (l.dest_step == 1 && l.src_step != 1 && l.src_line == 1) {
+            transpose_copy(l.count, l.length, src.data(), l.src_line,
+                           l.src_step, dest.data(), l.dest_line, l.dest_step);
+            return;
+          }
+          for (size_t i = 0; i < l.count; ++i) {
+            strided_copy(l.length, src.data() + i * l.src_line, l.src_step,
+                         dest.data() + i * l.dest_line, l.dest_step);
+          }
+        }
+
+        template <typename T>
+        void convert_generic(MatrixBase<T> &dest, const MatrixBase<T> &src) {
+          auto riters = std::make_pair(dest.rows().begin(), src.rows().begin());
+          for (; riters.first != dest.rows().end();
+               ++riters.first, ++riters.second) {
+            auto &dr = riters.first;
+            auto &sr = riters.second;
+            auto citers = std::make_pair(dr.begin(), sr.begin());
+            for (; citers.first != dr.end(); ++citers.first, ++citers.second) {
+              *citers.first = *citers.second;
+            }
+          }
+        }
+
+        template <typename T>
+        void add_generic(MatrixBase<T> &lhs, const MatrixBase<T> &rhs) {
+          lhs.MatrixBase<T>::operator+=(rhs);
+        }
+
+        template <typename T>
+        bool compare_generic(const MatrixBase<T> &lhs,
+                             const MatrixBase<T> &rhs) {
+          return lhs.MatrixBase<T>::operator==(rhs);
+        }
+
+        template <typename T>
+        std::unique_ptr<MatrixBase<T>>
+        multiply_strided(const MatrixBase<T> &lhs, const MatrixBase<T> &rhs) {
+          std::unique_ptr<MatrixBase<T>> result(
+              new MatrixVector<T>(lhs.get_num_rows(), rhs.get_num_columns()));
+          gemm(T(1), lhs, rhs, T(0), *result);
+          return result;
+        }
+
+        template <typename T>
+        std::unique_ptr<MatrixBase<T>> to_strided(const MatrixBase<T> &src) {
+          std::unique_ptr<MatrixBase<T>> dest(
+              new MatrixVector<T>(src.get_num_rows(), src.get_num_columns()));
+          Dispatcher<T>::convert(*dest, src);
+          return dest;
+        }
+
+        template <typename T>
+        std::unique_ptr<MatrixBase<T>>
+        multiply_generic(const MatrixBase<T> &lhs, const MatrixBase<T> &rhs) {
+          std::unique_ptr<MatrixBase<T>> lhs_temp, rhs_temp;
+          if (!is_strided(lhs)) {
+            lhs_temp = to_strided(lhs);
+          }
+          if (!is_strided(rhs)) {
+            rhs_temp = to_strided(rhs);
+          }
+          return multiply_strided(lhs_temp ? *lhs_temp : lhs,
+                                  rhs_temp ? *rhs_temp : rhs);
+        }
+
+        template <Operation op>
+        using OperationTag = std::integral_constant<Operation, op>;
+
+        template <typename T>
+        typename Signature<T, Operation::add>::type
+        resolve(OperationTag<Operation::add>, const MatrixBase<T> &lhs,
+                const MatrixBase<T> &rhs) {
+          if (is_strided(lhs) && is_strided(rhs)) {
+            return add_strided<T>;
+          }
+          return add_generic<T>;
+        }
+
+        template <typename T>
+        typename Signature<T, Operation::multiply>::type
+        resolve(OperationTag<Operation::multiply>, const MatrixBase<T> &lhs,
+                const MatrixBase<T> &rhs) {
+          if (is_strided(lhs) && is_strided(rhs)) {
+            return multiply_strided<T>;
+          }
+          return multiply_generic<T>;
+        }
+
+        template <typename T>
+        typename Signature<T, Operation::compare>::type
+        resolve(OperationTag<Operation::compare>, const MatrixBase<T> &lhs,
+                const MatrixBase<T> &rhs) {
+          if (is_strided(lhs) && is_strided(rhs)) {
+            return compare_strided<T>;
+          }
+          return compare_generic<T>;
+        }
+
+        template <typename T>
+        typename Signature<T, Operation::convert>::type
+        resolve(OperationTag<Operation::convert>, const MatrixBase<T> &dest,
+                const MatrixBase<T> &src) {
+          if (is_strided(dest) && is_strided(src)) {
+            return convert_strided<T>;
+          }
+          return convert_generic<T>;
+        }
+      }
+
+      // Stands for any operand with strided storage when defining a kernel,
+      // so that one kernel serves every dense backend and layout.
+      struct Strided {};
+
+      // Binary operations between backends, looked up by the dynamic types
+      // of both operands. A kernel defined for the exact pair comes first,
+      // then one defined against Strided when that operand is strided.
+      // Anything else is resolved per call from the capabilities of the
+      // operands: strided operands use the kernels above, the rest goes
+      // through the virtual iterators of MatrixBase. Only defined kernels
+      // are stored, so lookups take a shared lock on a table that changes
+      // only while backends register.
+      template <typename T> class Dispatcher {
+      public:
+        using Base = MatrixBase<T>;
+
+      private:
+        struct Key {
+          std::type_index lhs, rhs;
+          Operation op;
+          bool operator==(const Key &other) const {
+            return lhs == other.lhs && rhs == other.rhs && op == other.op;
+          }
+        };
+        struct Hash {
+          size_t operator()(const Key &key) const {
+            const size_t h = key.lhs.hash_code() * 31 + key.rhs.hash_code();
+            return h * 4 + static_cast<size_t>(key.op);
+          }
+        };
+        using Function = void (*)();
+
+        std::unordered_map<Key, Function, Hash> table;
+        mutable std::shared_timed_mutex mutex;
+
+        Dispatcher() = default;
+
+        Function lookup(const Key &key) const {
+          auto it = table.find(key);
+          return it == table.end() ? nullptr : it->second;
+        }
+
+        template <Operation op>
+        typename Signature<T, op>::type find(const Base &lhs,
+                                             const Base &rhs) {
+          using Kernel = typename Signature<T, op>::type;
+          const std::type_index strided = typeid(Strided);
+          Function f;
+          {
+            std::shared_lock<std::shared_timed_mutex> lock(mutex);
+            f = lookup(Key{typeid(lhs), typeid(rhs), op});
+            if (f == nullptr && kernel::is_strided(rhs)) {
+              f = lookup(Key{typeid(lhs), strided, op});
+            }
+            if (f == nullptr && kernel::is_strided(lhs)) {
+              f = lookup(Key{strided, typeid(rhs), op});
+            }
+          }
+          if (f != nullptr) {
+            return reinterpret_cast<Kernel>(f);
+          }
+          return kernel::resolve(kernel::OperationTag<op>(), lhs, rhs);
+        }
+
+      public:
+        static Dispatcher &get_instance() {
+          static Dispatcher instance;
+          return instance;
+        }
+
+        template <Operation op, typename L, typename R>
+        void define(typename Signature<T, op>::type f) {
+          std::lock_guard<std::shared_timed_mutex> lock(mutex);
+          table[Key{typeid(L), typeid(R), op}] = reinterpret_cast<Function>(f);
+        }
+
+        // Mismatched shapes keep the old behaviour of MatrixBase::operator+=,
+        // which adds the overlapping part.
+        static void add(Base &lhs, const Base &rhs) {
+          KETCPP_PROFILE_BINARY(add, lhs, rhs, kernel::size_of(lhs),
+                                3. * kernel::size_of(lhs) * sizeof(T), 0);
+          if (!kernel::has_same_shape(lhs, rhs)) {
+            kernel::add_generic(lhs, rhs);
+            return;
+          }
+          get_instance().template find<Operation::add>(lhs, rhs)(lhs, rhs);
+        }
+        static std::unique_ptr<Base> multiply(const Base &lhs,
+                                              const Base &rhs) {
+          if (lhs.get_num_columns() != rhs.get_num_rows()) {
+            throw std::invalid_argument("matrix shapes do not match");
+          }
+          KETCPP_PROFILE_BINARY(
+              multiply, lhs, rhs,
+              2. * kernel::size_of(lhs) * rhs.get_num_columns(),
+              (kernel::size_of(lhs) + kernel::size_of(rhs) +
+               double(lhs.get_num_rows()) * rhs.get_num_columns()) *
+                  sizeof(T),
+              1);
+          return get_instance().template find<Operation::multiply>(lhs, rhs)(
+              lhs, rhs);
+        }
+        static bool compare(const Base &lhs, const Base &rhs) {
+          if (!kernel::has_same_shape(lhs, rhs)) {
+            return false;
+          }
+          KETCPP_PROFILE_BINARY(compare, lhs, rhs, 0,
+                                2. * kernel::size_of(lhs) * sizeof(T), 0);
+          return get_instance().template find<Operation::compare>(lhs, rhs)(
+              lhs, rhs);
+        }
+        static void convert(Base &dest, const Base &src) {
+          if (!kernel::has_same_shape(dest, src)) {
+            throw std::invalid_argument("matrix shapes do not match");
+          }
+          get_instance().template find<Operation::convert>(dest, src)(dest,
+                                                                      src);
+        }
+      };
+    }
+  }
+}
+
+#include "wrapper/matrix/vector.h"
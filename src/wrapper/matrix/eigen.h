@@ -0,0 +1,260 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
+
+#include <Eigen/Core>
+
+#include "wrapper/matrix/base.h"
+#include "wrapper/matrix/dispatch.h"
+#include "wrapper/matrix/range.h"
+
+namespace ketcpp {
+  namespace wrapper {
+    namespace matrix {
+      template <typename T>
+      class MatrixEigen : public MatrixBase<T>,
+                          public StridedMatrix<MatrixEigen<T>, T> {
+      private:
+        using matrix =
+            Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+        matrix storage;
+
+      public:
+        size_t get_num_rows() const { return storage.rows(); }
+        size_t get_num_columns() const { return storage.cols(); }
+        size_t get_row_size() const { return storage.cols(); }
+        size_t get_column_size() const { return storage.rows(); }
+        T *data() { return storage.data(); }
+        const T *data() const { return storage.data(); }
+        std::ptrdiff_t get_row_stride() const { return storage.cols(); }
+
+      private:
+        using Base = MatrixBase<T>;
+        typedef typename Base::RowVectorIterator RowVectorIterator;
+        typedef typename Base::RowElementIterator RowElementIterator;
+        typedef typename Base::ColumnVectorIterator ColumnVectorIterator;
+        typedef typename Base::ColumnElementIterator ColumnElementIterator;
+        typedef typename Base::RowVectorConstIterator RowVectorConstIterator;
+        typedef typename Base::RowElementConstIterator RowElementConstIterator;
+        typedef
+            typename Base::ColumnVectorConstIterator ColumnVectorConstIterator;
+        typedef typename Base::ColumnElementConstIterator
+            ColumnElementConstIterator;
+
+        template <bool is_const>
+        class GenericIterator
+            : public Base::template BaseGenericIterator<is_const> {
+          using BaseIterator =
+              typename Base::template BaseGenericIterator<is_const>;
+          using unique_ptr = std::unique_ptr<BaseIterator>;
+          typename std::conditional<is_const, const T *, T *>::type iterator;
+          const size_t num_rows;
+          const size_t num_columns;
+
+        protected:
+          void advance_in_column() { this->iterator += num_columns; }
+          void advance_in_row() { this->iterator++; }
+          unique_ptr row_begin() {
+            return std::move(std::make_unique<GenericIterator>(
+                this->iterator, this->num_rows, this->num_columns));
+          }
+          unique_ptr row_end() {
+            return std::move(std::make_unique<GenericIterator>(
+                this->iterator + this->num_columns, this->num_rows,
+                this->num_columns));
+          }
+          unique_ptr column_begin() {
+            return std::move(std::make_unique<GenericIterator>(
+                this->iterator, this->num_rows, this->num_columns));
+          }
+          unique_ptr column_end() {
+            return std::move(std::make_unique<GenericIterator>(
+                this->iterator + this->num_rows * this->num_columns,
+                this->num_rows, this->num_columns));
+          }
+          unique_ptr copy() {
+            return std::move(std::make_unique<GenericIterator>(
+                this->iterator, this->num_rows, this->num_columns));
+          }
+          bool operator==(BaseIterator &rhs) const throw(std::bad_cast &) {
+            auto &rhs_cast = dynamic_cast<decltype(*this)>(rhs);
+            return this->iterator == rhs_cast.iterator;
+          }
+          bool operator!=(BaseIterator &rhs) const throw(std::bad_cast &) {
+            auto &rhs_cast = dynamic_cast<decltype(*this)>(rhs);
+            return this->iterator != rhs_cast.iterator;
+          }
+          typename BaseIterator::difference_type
+          operator-(const BaseIterator &rhs) const throw(std::bad_cast &) {
+            auto &rhs_cast = dynamic_cast<decltype(*this)>(rhs);
+            return this->iterator - rhs_cast.iterator;
+          }
+          typename std::conditional<is_const, const T &, T &>::type
+          operator*() {
+            return *iterator;
+          }
+
+        public:
+          GenericIterator(decltype(iterator) src, size_t num_rows,
+                          size_t num_columns)
+              : iterator(src), num_rows(num_rows), num_columns(num_columns) {}
+        };
+        using Iterator = GenericIterator<false>;
+        using ConstIterator = GenericIterator<true>;
+
+      protected:
+        RowVectorConstIterator row_cbegin() const {
+          return RowVectorConstIterator(std::make_unique<ConstIterator>(
+              storage.data(), get_num_rows(), get_num_columns()));
+        }
+        RowVectorConstIterator row_cend() const {
+          return RowVectorConstIterator(std::make_unique<ConstIterator>(
+              storage.data() + storage.size(), get_num_rows(),
+              get_num_columns()));
+        }
+        ColumnVectorConstIterator column_cbegin() const {
+          return ColumnVectorConstIterator(std::make_unique<ConstIterator>(
+              storage.data(), get_num_rows(), get_num_columns()));
+        }
+        ColumnVectorConstIterator column_cend() const {
+          return ColumnVectorConstIterator(std::make_unique<ConstIterator>(
+              storage.data() + get_row_size(), get_num_rows(),
+              get_num_columns()));
+        }
+        RowVectorIterator row_begin() {
+          return RowVectorIterator(std::make_unique<Iterator>(
+              storage.data(), get_num_rows(), get_num_columns()));
+        }
+        RowVectorIterator row_end() {
+          return RowVectorIterator(std::make_unique<Iterator>(
+              storage.data() + storage.size(), get_num_rows(),
+              get_num_columns()));
+        }
+        ColumnVectorIterator column_begin() {
+          return ColumnVectorIterator(std::make_unique<Iterator>(
+              storage.data(), get_num_rows(), get_num_columns()));
+        }
+        ColumnVectorIterator column_end() {
+          return ColumnVectorIterator(std::make_unique<Iterator>(
+              storage.data() + get_row_size(), get_num_rows(),
+              get_num_columns()));
+        }
+
+      private:
+        static size_t
+        max_size(const std::initializer_list<std::initializer_list<T>> &list) {
+          const auto max_size_element = std::max_element(
+              list.begin(), list.end(), [](const std::initializer_list<T> &a,
+                                           const std::initializer_list<T> &b) {
+                return a.size() < b.size();
+              });
+          return max_size_element->size();
+        }
+
+        // Eigen's own kernels for pairs of MatrixEigen, registered on first
+        // construction.
+        static void add_eigen(Base &lhs, const Base &rhs) {
+          static_cast<MatrixEigen &>(lhs).storage +=
+              static_cast<const MatrixEigen &>(rhs).storage;
+        }
+        static std::unique_ptr<Base> multiply_eigen(const Base &lhs,
+                                                    const Base &rhs) {
+          return std::make_unique<MatrixEigen>(
+              matrix(static_cast<const MatrixEigen &>(lhs).storage *
+                     static_cast<const MatrixEigen &>(rhs).storage));
+        }
+        static bool register_kernels() {
+          auto &dispatcher = Dispatcher<T>::get_instance();
+          dispatcher.template define<Operation::add, MatrixEigen, MatrixEigen>(
+              add_eigen);
+          dispatcher
+              .template define<Operation::multiply, MatrixEigen, MatrixEigen>(
+                  multiply_eigen);
+          return true;
+        }
+        static void ensure_registered() {
+          static const bool registered = register_kernels();
+          (void)registered;
+        }
+
+      public:
+        MatrixEigen(const std::initializer_list<std::initializer_list<T>> list)
+            : storage(matrix::Zero(list.size(), max_size(list))) {
+          ensure_registered();
+          auto dest = storage.data();
+          for (auto i : list) {
+            std::copy(i.begin(), i.end(), dest);
+            dest += storage.cols();
+          }
+        }
+        MatrixEigen(size_t m, size_t n) : storage(matrix::Zero(m, n)) {
+          ensure_registered();
+        }
+        MatrixEigen(matrix &&src) : storage(std::move(src)) {
+          ensure_registered();
+        }
+        MatrixEigen() = delete;
+
+        bool operator==(const MatrixEigen &rhs) const {
+          return storage == rhs.storage;
+        }
+        bool operator==(const Base &rhs) const {
+          return Dispatcher<T>::compare(*this, rhs);
+        }
+        Base &operator+=(const Base &rhs) {
+          Dispatcher<T>::add(*this, rhs);
+          return *this;
+        }
+
+        Base &operator*=(T rhs) {
+          KETCPP_PROFILE_UNARY(scale, *this, storage.size(),
+                               2. * storage.size() * sizeof(T), 0);
+          storage *= rhs;
+          return *this;
+        }
+        using MatrixBase<T>::operator*;
+        MatrixEigen<T> operator*(const MatrixEigen<T> &rhs) const {
+          KETCPP_PROFILE_BINARY(
+              multiply, *this, rhs,
+              2. * storage.size() * rhs.storage.cols(),
+              (storage.size() + rhs.storage.size() +
+               double(storage.rows()) * rhs.storage.cols()) *
+                  sizeof(T),
+              1);
+          return MatrixEigen<T>(matrix(storage * rhs.storage));
+        }
+
+        std::unique_ptr<MatrixBase<T>> copy() const {
+          KETCPP_PROFILE_UNARY(copy, *this, 0,
+                               2. * storage.size() * sizeof(T), 1);
+          std::unique_ptr<MatrixBase<T>> copy;
+          copy.reset(new MatrixEigen(*this));
+          return std::move(copy);
+        }
+
+        ~MatrixEigen() {}
+      };
+    }
+  }
+}
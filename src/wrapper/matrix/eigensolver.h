@@ -0,0 +1,970 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+#include "wrapper/matrix/array.h"
+#include "wrapper/matrix/base.h"
+#include "wrapper/matrix/dispatch.h"
+#include "wrapper/matrix/gemm.h"
+#include "wrapper/matrix/matrix.h"
+#include "wrapper/matrix/parallel.h"
+#include "wrapper/matrix/simd.h"
+#include "wrapper/matrix/vector.h"
+#include "wrapper/thread/pool.h"
+
+namespace ketcpp {
+  namespace wrapper {
+    namespace matrix {
+      // Eigenvalues in ascending order, with the matching normalized
+      // eigenvectors as the columns of vectors.
+      template <typename T> struct Eigensystem {
+        std::vector<T> values;
+        Matrix<T> vectors;
+      };
+
+      // Passed as num_pairs to ask for the whole spectrum.
+      constexpr size_t all_pairs = std::numeric_limits<size_t>::max();
+
+      namespace kernel {
+        // Dense symmetric eigensolver: Householder reduction to tridiagonal
+        // form, then divide and conquer for the whole spectrum, or bisection
+        // and inverse iteration for the lowest few pairs. Matrices are
+        // row-major with a leading dimension; eigenvectors are stored as
+        // columns.
+        namespace eigensolver {
+          // Reflectors per panel of the reduction and the back
+          // transformation; the trailing updates are GEMMs of this depth.
+          constexpr size_t block_size = 32;
+          // Tridiagonal problems up to this order are solved by implicit QL
+          // instead of being split further.
+          constexpr size_t leaf_size = 32;
+          // Subproblems of divide and conquer from this order on are solved
+          // on two threads.
+          constexpr size_t parallel_size = 256;
+
+          template <typename T> constexpr T epsilon() {
+            return std::numeric_limits<T>::epsilon();
+          }
+          template <typename T> constexpr T safe_minimum() {
+            return std::numeric_limits<T>::min();
+          }
+
+          // Turns x (n elements, stride inc) into a Householder vector v with
+          // v[0] = 1 such that (I - tau v v^T) x = beta e_0, and returns beta.
+          // x is first scaled by a power of two to bring its largest
+          // element near one, as LAPACK's dlarfg rescales, so that tiny
+          // elements neither underflow in the norm nor overflow in v.
+          template <typename T>
+          T householder(size_t n, T *x, std::ptrdiff_t inc, T &tau) {
+            T largest = 0;
+            for (size_t i = 1; i < n; ++i) {
+              largest = std::max(largest, std::abs(x[i * inc]));
+            }
+            if (largest == T(0)) {
+              const T alpha = x[0];
+              x[0] = T(1);
+              tau = T(0);
+              return alpha;
+            }
+            const int exponent = std::ilogb(std::max(largest, std::abs(x[0])));
+            T norm2 = 0;
+            for (size_t i = 1; i < n; ++i) {
+              x[i * inc] = std::ldexp(x[i * inc], -exponent);
+              norm2 += x[i * inc] * x[i * inc];
+            }
+            const T alpha = std::ldexp(x[0], -exponent);
+            x[0] = T(1);
+            const T beta = -std::copysign(std::sqrt(alpha * alpha + norm2),
+                                          alpha);
+            tau = (beta - alpha) / beta;
+            const T scale = T(1) / (alpha - beta);
+            for (size_t i = 1; i < n; ++i) {
+              x[i * inc] *= scale;
+            }
+            return std::ldexp(beta, exponent);
+          }
+
+          // Reduces the symmetric n x n matrix a to tridiagonal form
+          // Q^T a Q with diagonal d and subdiagonal e, where
+          // Q = H_0 H_1 ... H_{n-2} and H_i = I - tau_i v_i v_i^T. v_i is
+          // left in column i of a from row i + 1 on. Panels of block_size
+          // reflectors are built from the untouched trailing matrix plus
+          // their running corrections V W^T + W V^T (as in LAPACK's
+          // sytrd), so that the trailing matrix is updated by two GEMMs per
+          // panel.
+          template <typename T>
+          void tridiagonalize(size_t n, T *a, size_t lda, T *d, T *e,
+                              T *tau) {
+            const size_t nb = block_size;
+            std::vector<T> v(n * nb), w(n * nb), x(n), y(n), c(2 * nb);
+            for (size_t j0 = 0; j0 < n; j0 += nb) {
+              const size_t jb = std::min(nb, n - j0);
+              std::fill(v.begin() + j0 * nb, v.end(), T(0));
+              std::fill(w.begin() + j0 * nb, w.end(), T(0));
+              for (size_t p = 0; p < jb; ++p) {
+                const size_t i = j0 + p;
+                // Bring column i up to date with the panel so far.
+                for (size_t r = i; r < n; ++r) {
+                  T sum = 0;
+                  for (size_t q = 0; q < p; ++q) {
+                    sum += v[r * nb + q] * w[i * nb + q] +
+                           w[r * nb + q] * v[i * nb + q];
+                  }
+                  a[r * lda + i] -= sum;
+                }
+                d[i] = a[i * lda + i];
+                if (i + 1 == n) {
+                  break;
+                }
+                const size_t m = n - i - 1;
+                T *column = a + (i + 1) * lda + i;
+                e[i] = householder(m, column, lda, tau[i]);
+                for (size_t r = 0; r < m; ++r) {
+                  x[r] = column[r * lda];
+                  v[(i + 1 + r) * nb + p] = x[r];
+                }
+                // y = tau (A22 - V W^T - W V^T) x, with A22 the trailing
+                // matrix as of the start of the panel.
+                const T *a22 = a + (i + 1) * lda + i + 1;
+                const T *xp = x.data();
+                T *yp = y.data();
+                const size_t grain =
+                    std::max<size_t>(parallel::grain / (m + 1), 1);
+                thread::parallel_for(
+                    0, m, grain, [=](size_t first, size_t last) {
+                      for (size_t r = first; r < last; ++r) {
+                        yp[r] = simd::dot(m, a22 + r * lda, xp);
+                      }
+                    });
+                std::fill(c.begin(), c.end(), T(0));
+                for (size_t r = 0; r < m; ++r) {
+                  for (size_t q = 0; q < p; ++q) {
+                    c[q] += w[(i + 1 + r) * nb + q] * x[r];
+                    c[nb + q] += v[(i + 1 + r) * nb + q] * x[r];
+                  }
+                }
+                T xy = 0;
+                for (size_t r = 0; r < m; ++r) {
+                  T sum = y[r];
+                  for (size_t q = 0; q < p; ++q) {
+                    sum -= v[(i + 1 + r) * nb + q] * c[q] +
+                           w[(i + 1 + r) * nb + q] * c[nb + q];
+                  }
+                  y[r] = tau[i] * sum;
+                  xy += y[r] * x[r];
+                }
+                const T alpha = -T(0.5) * tau[i] * xy;
+                for (size_t r = 0; r < m; ++r) {
+                  w[(i + 1 + r) * nb + p] = y[r] + alpha * x[r];
+                }
+              }
+              const size_t j1 = j0 + jb;
+              if (j1 < n) {
+                const size_t m = n - j1;
+                T *a22 = a + j1 * lda + j1;
+                gemm<T>(m, m, jb, T(-1), v.data() + j1 * nb, nb, 1,
+                        w.data() + j1 * nb, 1, nb, T(1), a22, lda, 1);
+                gemm<T>(m, m, jb, T(-1), w.data() + j1 * nb, nb, 1,
+                        v.data() + j1 * nb, 1, nb, T(1), a22, lda, 1);
+              }
+            }
+          }
+
+          // z = Q z for the n x k matrix z, with Q from tridiagonalize.
+          // Reflectors are applied block_size at a time in the compact WY
+          // form I - V S V^T, last block first.
+          template <typename T>
+          void apply_reflectors(size_t n, const T *a, size_t lda,
+                                const T *tau, size_t k, T *z, size_t ldz) {
+            if (n < 2 || k == 0) {
+              return;
+            }
+            const size_t num_reflectors = n - 1;
+            const size_t nb = block_size;
+            std::vector<T> v(n * nb), s(nb * nb), u(nb * k), t(nb * k);
+            for (size_t b = (num_reflectors - 1) / nb * nb + nb; b > 0;) {
+              b -= nb;
+              const size_t jb = std::min(nb, num_reflectors - b);
+              // Reflector b + q touches rows b + q + 1 and below; V holds
+              // them from row b + 1 on.
+              const size_t m = n - b - 1;
+              for (size_t r = 0; r < m; ++r) {
+                for (size_t q = 0; q < jb; ++q) {
+                  v[r * jb + q] = r < q ? T(0)
+                                        : r == q ? T(1)
+                                                 : a[(b + 1 + r) * lda + b + q];
+                }
+              }
+              // Upper triangular S with H_b ... H_{b+jb-1} = I - V S V^T.
+              for (size_t q = 0; q < jb; ++q) {
+                s[q * jb + q] = tau[b + q];
+                for (size_t p = 0; p < q; ++p) {
+                  T sum = 0;
+                  for (size_t r = q; r < m; ++r) {
+                    sum += v[r * jb + p] * v[r * jb + q];
+                  }
+                  u[p] = -tau[b + q] * sum;
+                }
+                for (size_t p = 0; p < q; ++p) {
+                  T sum = 0;
+                  for (size_t l = p; l < q; ++l) {
+                    sum += s[p * jb + l] * u[l];
+                  }
+                  s[p * jb + q] = sum;
+                  s[q * jb + p] = T(0);
+                }
+              }
+              T *zb = z + (b + 1) * ldz;
+              gemm<T>(jb, k, m, T(1), v.data(), 1, jb, zb, ldz, 1, T(0),
+                      u.data(), k, 1);
+              gemm<T>(jb, k, jb, T(1), s.data(), jb, 1, u.data(), k, 1, T(0),
+                      t.data(), k, 1);
+              gemm<T>(m, k, jb, T(-1), v.data(), jb, 1, t.data(), k, 1, T(1),
+                      zb, ldz, 1);
+            }
+          }
+
+          // Sorts the n eigenvalues d ascending together with the columns
+          // of the n x n matrix q.
+          template <typename T>
+          void sort_pairs(size_t n, T *d, T *q, size_t ldq) {
+            std::vector<size_t> order(n);
+            std::iota(order.begin(), order.end(), 0);
+            std::stable_sort(order.begin(), order.end(),
+                             [d](size_t i, size_t j) { return d[i] < d[j]; });
+            std::vector<T> values(n), row(n);
+            for (size_t j = 0; j < n; ++j) {
+              values[j] = d[order[j]];
+            }
+            std::copy(values.begin(), values.end(), d);
+            for (size_t i = 0; i < n; ++i) {
+              T *qi = q + i * ldq;
+              for (size_t j = 0; j < n; ++j) {
+                row[j] = qi[order[j]];
+              }
+              std::copy(row.begin(), row.end(), qi);
+            }
+          }
+
+          // Implicit QL with Wilkinson shifts on the tridiagonal matrix with
+          // diagonal d and subdiagonal e (n - 1 elements; e is
+          // overwritten). The rotations are applied to the columns of the
+          // n x n matrix q. Eigenvalues are left unsorted in d. Off-diagonal
+          // elements are negligible by the test of LAPACK's dsteqr,
+          // e_m^2 <= eps^2 |d_m d_m+1| + safe minimum, which still splits
+          // the matrix when its diagonal is at the underflow level.
+          template <typename T>
+          void implicit_ql(size_t n, T *d, T *e, T *q, size_t ldq) {
+            if (n < 2) {
+              return;
+            }
+            const T epsilon2 = epsilon<T>() * epsilon<T>();
+            std::vector<T> off(e, e + n - 1);
+            off.push_back(T(0));
+            for (size_t l = 0; l < n; ++l) {
+              for (size_t iteration = 0;; ++iteration) {
+                size_t m = l;
+                for (; m + 1 < n; ++m) {
+                  if (off[m] * off[m] <=
+                      epsilon2 * std::abs(d[m]) * std::abs(d[m + 1]) +
+                          safe_minimum<T>()) {
+                    break;
+                  }
+                }
+                if (m == l) {
+                  break;
+                }
+                if (iteration == 60) {
+                  throw std::runtime_error(
+                      "tridiagonal QL iteration did not converge");
+                }
+                T g = (d[l + 1] - d[l]) / (T(2) * off[l]);
+                T r = std::hypot(g, T(1));
+                g = d[m] - d[l] + off[l] / (g + std::copysign(r, g));
+                T s = 1, c = 1, p = 0;
+                bool underflow = false;
+                for (size_t i = m; i-- > l;) {
+                  T f = s * off[i];
+                  const T b = c * off[i];
+                  r = std::hypot(f, g);
+                  off[i + 1] = r;
+                  if (r == T(0)) {
+                    d[i + 1] -= p;
+                    off[m] = T(0);
+                    underflow = true;
+                    break;
+                  }
+                  s = f / r;
+                  c = g / r;
+                  g = d[i + 1] - p;
+                  r = (d[i] - g) * s + T(2) * c * b;
+                  p = s * r;
+                  d[i + 1] = g + p;
+                  g = c * r - b;
+                  for (size_t k = 0; k < n; ++k) {
+                    T *qk = q + k * ldq;
+                    f = qk[i + 1];
+                    qk[i + 1] = s * qk[i] + c * f;
+                    qk[i] = c * qk[i] - s * f;
+                  }
+                }
+                if (underflow) {
+                  continue;
+                }
+                d[l] -= p;
+                off[l] = g;
+                off[m] = T(0);
+              }
+            }
+          }
+
+          // Roots of the secular equation 1 + rho sum_j z_j^2 / (p_j - x)
+          // for poles p in ascending order. Root j lies between p_j and
+          // p_{j+1} and is kept as origin[j] + shift[j], with origin[j] the
+          // nearer pole, so that its distance to every pole is accurate.
+          template <typename T>
+          void solve_secular(size_t k, const T *p, const T *z, T rho,
+                             size_t *origin, T *shift) {
+            T norm2 = 0;
+            for (size_t j = 0; j < k; ++j) {
+              norm2 += z[j] * z[j];
+            }
+            auto secular = [=](size_t o, T t) {
+              T sum = 0;
+              for (size_t j = 0; j < k; ++j) {
+                sum += z[j] * z[j] / ((p[j] - p[o]) - t);
+              }
+              return T(1) + rho * sum;
+            };
+            const size_t grain =
+                std::max<size_t>(parallel::grain / (64 * k + 1), 1);
+            thread::parallel_for(0, k, grain, [&](size_t first, size_t last) {
+              for (size_t i = first; i < last; ++i) {
+                T lo, hi;
+                const T gap = i + 1 < k ? p[i + 1] - p[i] : rho * norm2;
+                if (i + 1 == k || secular(i, gap / 2) >= T(0)) {
+                  origin[i] = i;
+                  lo = 0;
+                  hi = i + 1 < k ? gap / 2 : gap;
+                } else {
+                  origin[i] = i + 1;
+                  lo = -gap / 2;
+                  hi = 0;
+                }
+                // Bisection to full relative accuracy of the shift.
+                for (int iteration = 0; iteration < 256; ++iteration) {
+                  const T mid = (lo + hi) / 2;
+                  if (mid == lo || mid == hi ||
+                      hi - lo <= T(2) * epsilon<T>() *
+                                     std::max(std::abs(lo), std::abs(hi))) {
+                    break;
+                  }
+                  if (secular(origin[i], mid) > T(0)) {
+                    hi = mid;
+                  } else {
+                    lo = mid;
+                  }
+                }
+                shift[i] = (lo + hi) / 2;
+              }
+            });
+          }
+
+          // Divide and conquer (Cuppen) on the tridiagonal matrix with
+          // diagonal d and subdiagonal e. On return d holds the eigenvalues
+          // in ascending order and the n x n block of q, which must be
+          // zero, the eigenvectors. The matrix is torn into two halves
+          // coupled by a rank-one term; the halves are solved recursively
+          // and merged through the secular equation, deflating negligible
+          // and nearly equal components. Eigenvectors of the merge come from
+          // the recomputed weights of Gu and Eisenstat, so that they are
+          // orthogonal without reorthogonalization, and are combined with
+          // those of the halves by one GEMM.
+          template <typename T>
+          void divide_conquer(size_t n, T *d, const T *e, T *q, size_t ldq) {
+            if (n <= leaf_size) {
+              for (size_t i = 0; i < n; ++i) {
+                q[i * ldq + i] = T(1);
+              }
+              std::vector<T> off(e, e + (n > 0 ? n - 1 : 0));
+              implicit_ql(n, d, off.data(), q, ldq);
+              sort_pairs(n, d, q, ldq);
+              return;
+            }
+            const size_t m = n / 2;
+            const T coupling = e[m - 1];
+            const T rho = std::abs(coupling);
+            const T sign = coupling < T(0) ? T(-1) : T(1);
+            d[m - 1] -= rho;
+            d[m] -= rho;
+            T *q2 = q + m * ldq + m;
+            if (n >= parallel_size && thread::get_num_threads() > 1) {
+              thread::TaskGroup group;
+              group.run([=] { divide_conquer(m, d, e, q, ldq); });
+              divide_conquer(n - m, d + m, e + m, q2, ldq);
+              group.wait();
+            } else {
+              divide_conquer(m, d, e, q, ldq);
+              divide_conquer(n - m, d + m, e + m, q2, ldq);
+            }
+
+            // The coupling is 2 rho z z^T with z made of the last row of the
+            // first block and the first row of the second, over sqrt 2.
+            const T root2 = std::sqrt(T(2));
+            std::vector<T> z(n);
+            for (size_t j = 0; j < m; ++j) {
+              z[j] = q[(m - 1) * ldq + j] / root2;
+            }
+            for (size_t j = m; j < n; ++j) {
+              z[j] = sign * q[m * ldq + j] / root2;
+            }
+            const T weight = 2 * rho;
+
+            // Merge the two sorted halves of the spectrum.
+            std::vector<size_t> order(n);
+            std::iota(order.begin(), order.end(), 0);
+            std::inplace_merge(order.begin(), order.begin() + m, order.end(),
+                               [d](size_t i, size_t j) { return d[i] < d[j]; });
+            std::vector<T> poles(n), weights(n), columns(n * n);
+            for (size_t j = 0; j < n; ++j) {
+              poles[j] = d[order[j]];
+              weights[j] = z[order[j]];
+              for (size_t i = 0; i < n; ++i) {
+                columns[i * n + j] = q[i * ldq + order[j]];
+              }
+            }
+
+            // Deflation: components with negligible weight keep their
+            // eigenpair; of two nearly equal poles, one is rotated out of
+            // the coupling.
+            T scale = weight;
+            for (size_t j = 0; j < n; ++j) {
+              scale = std::max(scale, std::abs(poles[j]));
+            }
+            const T tolerance = 8 * epsilon<T>() * scale;
+            std::vector<size_t> kept, deflated;
+            const size_t none = n;
+            size_t previous = none;
+            for (size_t j = 0; j < n; ++j) {
+              if (weight * std::abs(weights[j]) <= tolerance) {
+                deflated.push_back(j);
+                continue;
+              }
+              if (previous != none) {
+                const T norm = std::hypot(weights[previous], weights[j]);
+                const T cz = weights[previous] / norm;
+                const T sz = weights[j] / norm;
+                if (std::abs((poles[j] - poles[previous]) * cz * sz) <=
+                    tolerance) {
+                  const T dp = poles[previous], dj = poles[j];
+                  poles[previous] = sz * sz * dp + cz * cz * dj;
+                  poles[j] = cz * cz * dp + sz * sz * dj;
+                  weights[previous] = T(0);
+                  weights[j] = norm;
+                  for (size_t i = 0; i < n; ++i) {
+                    T &qp = columns[i * n + previous];
+                    T &qj = columns[i * n + j];
+                    const T tp = qp, tj = qj;
+                    qp = sz * tp - cz * tj;
+                    qj = cz * tp + sz * tj;
+                  }
+                  deflated.push_back(previous);
+                  previous = j;
+                  continue;
+                }
+                kept.push_back(previous);
+              }
+              previous = j;
+            }
+            if (previous != none) {
+              kept.push_back(previous);
+            }
+
+            // Secular equation of the remaining k x k problem.
+            const size_t k = kept.size();
+            std::vector<T> p(k), w(k), shift(k);
+            std::vector<size_t> origin(k);
+            for (size_t j = 0; j < k; ++j) {
+              p[j] = poles[kept[j]];
+              w[j] = weights[kept[j]];
+            }
+            solve_secular(k, p.data(), w.data(), weight, origin.data(),
+                          shift.data());
+            // Distance from pole i to root j.
+            auto distance = [&](size_t i, size_t j) {
+              return (p[i] - p[origin[j]]) - shift[j];
+            };
+            std::vector<T> u(k * k);
+            const size_t grain =
+                std::max<size_t>(parallel::grain / (k + 1), 1);
+            thread::parallel_for(0, k, grain, [&](size_t first, size_t last) {
+              for (size_t i = first; i < last; ++i) {
+                T product = -distance(i, i) / weight;
+                for (size_t j = 0; j < k; ++j) {
+                  if (j != i) {
+                    product *= distance(i, j) / (p[i] - p[j]);
+                  }
+                }
+                w[i] = std::copysign(std::sqrt(std::abs(product)), w[i]);
+              }
+            });
+            thread::parallel_for(0, k, grain, [&](size_t first, size_t last) {
+              for (size_t j = first; j < last; ++j) {
+                T norm2 = 0;
+                for (size_t i = 0; i < k; ++i) {
+                  const T x = w[i] / distance(i, j);
+                  u[i * k + j] = x;
+                  norm2 += x * x;
+                }
+                const T inverse = T(1) / std::sqrt(norm2);
+                for (size_t i = 0; i < k; ++i) {
+                  u[i * k + j] *= inverse;
+                }
+              }
+            });
+            std::vector<T> gathered(n * k), merged(n * k);
+            for (size_t i = 0; i < n; ++i) {
+              for (size_t j = 0; j < k; ++j) {
+                gathered[i * k + j] = columns[i * n + kept[j]];
+              }
+            }
+            gemm<T>(n, k, k, T(1), gathered.data(), k, u.data(), k, T(0),
+                    merged.data(), k);
+
+            // Write the merged and the deflated pairs back in ascending
+            // order.
+            std::vector<T> values(n);
+            std::vector<const T *> sources(n);
+            std::vector<std::ptrdiff_t> strides(n);
+            std::vector<size_t> slots(n);
+            for (size_t j = 0; j < k; ++j) {
+              values[j] = p[origin[j]] + shift[j];
+              sources[j] = merged.data() + j;
+              strides[j] = k;
+            }
+            for (size_t j = 0; j < deflated.size(); ++j) {
+              values[k + j] = poles[deflated[j]];
+              sources[k + j] = columns.data() + deflated[j];
+              strides[k + j] = n;
+            }
+            std::iota(slots.begin(), slots.end(), 0);
+            std::sort(slots.begin(), slots.end(), [&](size_t i, size_t j) {
+              return values[i] < values[j];
+            });
+            for (size_t j = 0; j < n; ++j) {
+              const size_t from = slots[j];
+              d[j] = values[from];
+              for (size_t i = 0; i < n; ++i) {
+                q[i * ldq + j] = sources[from][i * strides[from]];
+              }
+            }
+          }
+
+          // Number of eigenvalues of the tridiagonal matrix below x, from
+          // the signs of its LDL^T pivots (Sturm count).
+          template <typename T>
+          size_t count_below(size_t n, const T *d, const T *e, T x,
+                             T pivot_min) {
+            size_t count = 0;
+            T pivot = d[0] - x;
+            for (size_t i = 0;; ++i) {
+              if (std::abs(pivot) < pivot_min) {
+                pivot = -pivot_min;
+              }
+              if (pivot < T(0)) {
+                ++count;
+              }
+              if (i + 1 == n) {
+                return count;
+              }
+              pivot = (d[i + 1] - x) - e[i] * e[i] / pivot;
+            }
+          }
+
+          // The k smallest eigenvalues of the tridiagonal matrix, in
+          // ascending order, by bisection on Sturm counts within the
+          // Gershgorin interval.
+          template <typename T>
+          void bisect(size_t n, const T *d, const T *e, size_t k, T *values) {
+            T lower = d[0], upper = d[0], norm = 0;
+            for (size_t i = 0; i < n; ++i) {
+              const T radius = (i > 0 ? std::abs(e[i - 1]) : T(0)) +
+                               (i + 1 < n ? std::abs(e[i]) : T(0));
+              lower = std::min(lower, d[i] - radius);
+              upper = std::max(upper, d[i] + radius);
+              norm = std::max(norm, std::abs(d[i]) + radius);
+            }
+            const T pivot_min =
+                std::max(norm, T(1)) * std::numeric_limits<T>::min();
+            const T slack = 2 * epsilon<T>() * std::max(norm, T(1));
+            lower -= slack;
+            upper += slack;
+            thread::parallel_for(0, k, 1, [=](size_t first, size_t last) {
+              for (size_t j = first; j < last; ++j) {
+                T lo = lower, hi = upper;
+                for (int iteration = 0; iteration < 256; ++iteration) {
+                  const T mid = (lo + hi) / 2;
+                  if (mid == lo || mid == hi ||
+                      hi - lo <= 2 * epsilon<T>() *
+                                     std::max(std::abs(lo), std::abs(hi))) {
+                    break;
+                  }
+                  if (count_below(n, d, e, mid, pivot_min) > j) {
+                    hi = mid;
+                  } else {
+                    lo = mid;
+                  }
+                }
+                values[j] = (lo + hi) / 2;
+              }
+            });
+          }
+
+          // Solves (T - shift I) x = b in place by Gaussian elimination
+          // with partial pivoting; zero pivots are replaced by tiny.
+          template <typename T>
+          void solve_shifted(size_t n, const T *d, const T *e, T shift, T tiny,
+                             T *b) {
+            std::vector<T> diagonal(n), upper1(n, T(0)), upper2(n, T(0)),
+                multiplier(n, T(0));
+            std::vector<char> swapped(n, 0);
+            for (size_t i = 0; i < n; ++i) {
+              diagonal[i] = d[i] - shift;
+              if (i + 1 < n) {
+                upper1[i] = e[i];
+              }
+            }
+            for (size_t i = 0; i + 1 < n; ++i) {
+              const T below = e[i];
+              if (std::abs(diagonal[i]) >= std::abs(below)) {
+                if (diagonal[i] == T(0)) {
+                  diagonal[i] = tiny;
+                }
+                multiplier[i] = below / diagonal[i];
+                diagonal[i + 1] -= multiplier[i] * upper1[i];
+              } else {
+                const T row_diagonal = diagonal[i], row_upper = upper1[i];
+                const T next_upper = i + 2 < n ? upper1[i + 1] : T(0);
+                multiplier[i] = row_diagonal / below;
+                diagonal[i] = below;
+                upper1[i] = diagonal[i + 1];
+                upper2[i] = next_upper;
+                diagonal[i + 1] = row_upper - multiplier[i] * upper1[i];
+                upper1[i + 1] = -multiplier[i] * next_upper;
+                swapped[i] = 1;
+              }
+            }
+            if (diagonal[n - 1] == T(0)) {
+              diagonal[n - 1] = tiny;
+            }
+            for (size_t i = 0; i + 1 < n; ++i) {
+              if (swapped[i]) {
+                std::swap(b[i], b[i + 1]);
+              }
+              b[i + 1] -= multiplier[i] * b[i];
+            }
+            for (size_t i = n; i-- > 0;) {
+              T sum = b[i];
+              if (i + 1 < n) {
+                sum -= upper1[i] * b[i + 1];
+              }
+              if (i + 2 < n) {
+                sum -= upper2[i] * b[i + 2];
+              }
+              b[i] = sum / diagonal[i];
+            }
+          }
+
+          // Eigenvectors of the tridiagonal matrix for the k eigenvalues in
+          // ascending order, as the columns of the n x k matrix z, by
+          // inverse iteration. Eigenvalues closer than a thousandth of the
+          // matrix norm form a cluster whose vectors are orthogonalized
+          // against each other; clusters are independent and run in
+          // parallel.
+          template <typename T>
+          void inverse_iteration(size_t n, const T *d, const T *e, size_t k,
+                                 const T *values, T *z, size_t ldz) {
+            T norm = 0;
+            for (size_t i = 0; i < n; ++i) {
+              norm = std::max(norm, std::abs(d[i]) +
+                                        (i > 0 ? std::abs(e[i - 1]) : T(0)) +
+                                        (i + 1 < n ? std::abs(e[i]) : T(0)));
+            }
+            norm = std::max(norm, std::numeric_limits<T>::min());
+            const T cluster_gap = norm * T(1e-3);
+            const T tiny = epsilon<T>() * norm;
+            std::vector<size_t> clusters = {0};
+            for (size_t j = 1; j < k; ++j) {
+              if (values[j] - values[j - 1] > cluster_gap) {
+                clusters.push_back(j);
+              }
+            }
+            clusters.push_back(k);
+            thread::parallel_for(
+                0, clusters.size() - 1, 1, [&](size_t first, size_t last) {
+                  std::vector<T> x(n);
+                  for (size_t c = first; c < last; ++c) {
+                    T previous = 0;
+                    for (size_t j = clusters[c]; j < clusters[c + 1]; ++j) {
+                      // Separate equal eigenvalues so that each solve
+                      // brings out a different direction.
+                      T shift = values[j];
+                      if (j > clusters[c] && shift - previous < 10 * tiny) {
+                        shift = previous + 10 * tiny;
+                      }
+                      previous = shift;
+                      // Deterministic start with components along every
+                      // eigenvector.
+                      for (size_t i = 0; i < n; ++i) {
+                        x[i] = T(1) + T(0.1) * std::sin(T(i * 7 + j + 1));
+                      }
+                      for (int iteration = 0; iteration < 3; ++iteration) {
+                        solve_shifted(n, d, e, shift, tiny, x.data());
+                        for (size_t l = clusters[c]; l < j; ++l) {
+                          T overlap = 0;
+                          for (size_t i = 0; i < n; ++i) {
+                            overlap += z[i * ldz + l] * x[i];
+                          }
+                          for (size_t i = 0; i < n; ++i) {
+                            x[i] -= overlap * z[i * ldz + l];
+                          }
+                        }
+                        T norm2 = 0;
+                        for (size_t i = 0; i < n; ++i) {
+                          norm2 += x[i] * x[i];
+                        }
+                        const T inverse = T(1) / std::sqrt(norm2);
+                        for (size_t i = 0; i < n; ++i) {
+                          x[i] *= inverse;
+                        }
+                      }
+                      for (size_t i = 0; i < n; ++i) {
+                        z[i * ldz + j] = x[i];
+                      }
+                    }
+                  }
+                });
+          }
+
+          // Power of two that brings the largest element of the tridiagonal
+          // matrix with diagonal d and subdiagonal e into [1, 2), as LAPACK's
+          // dstedc scales its input, so that the solvers neither underflow
+          // nor overflow on very small or very large matrices.
+          template <typename T>
+          int get_scale_exponent(size_t n, const T *d, const T *e) {
+            T norm = 0;
+            for (size_t i = 0; i < n; ++i) {
+              norm = std::max(norm, std::abs(d[i]));
+            }
+            for (size_t i = 0; i + 1 < n; ++i) {
+              norm = std::max(norm, std::abs(e[i]));
+            }
+            return norm > T(0) && std::isfinite(norm) ? std::ilogb(norm) : 0;
+          }
+
+          // Lowest k eigenpairs of the symmetric n x n matrix a, which is
+          // overwritten. Subsets up to half the spectrum are found by
+          // bisection and inverse iteration, larger ones by divide and
+          // conquer, both on the tridiagonal matrix scaled to unit size.
+          template <typename T>
+          void solve(size_t n, T *a, size_t lda, size_t k, T *values, T *z,
+                     size_t ldz) {
+            if (n == 0 || k == 0) {
+              return;
+            }
+            std::vector<T> d(n), e(n), tau(n);
+            tridiagonalize(n, a, lda, d.data(), e.data(), tau.data());
+            const int exponent = get_scale_exponent(n, d.data(), e.data());
+            for (size_t i = 0; i < n; ++i) {
+              d[i] = std::ldexp(d[i], -exponent);
+              e[i] = std::ldexp(e[i], -exponent);
+            }
+            if (2 * k <= n) {
+              bisect(n, d.data(), e.data(), k, values);
+              inverse_iteration(n, d.data(), e.data(), k, values, z, ldz);
+            } else {
+              std::vector<T> q(n * n, T(0));
+              divide_conquer(n, d.data(), e.data(), q.data(), n);
+              std::copy(d.begin(), d.begin() + k, values);
+              for (size_t i = 0; i < n; ++i) {
+                std::copy(q.begin() + i * n, q.begin() + i * n + k,
+                          z + i * ldz);
+              }
+            }
+            for (size_t j = 0; j < k; ++j) {
+              values[j] = std::ldexp(values[j], exponent);
+            }
+            apply_reflectors(n, a, lda, tau.data(), k, z, ldz);
+          }
+
+          // Cyclic Jacobi on an n x n symmetric matrix held in a (row-major,
+          // destroyed). Eigenvalues go to d, unsorted, and the eigenvectors
+          // to the columns of v. Every rotation is exact, so small matrices
+          // get eigenvectors orthogonal to working precision.
+          template <typename T, size_t n> void jacobi(T *a, T *d, T *v) {
+            for (size_t i = 0; i < n; ++i) {
+              for (size_t j = 0; j < n; ++j) {
+                v[i * n + j] = i == j ? T(1) : T(0);
+              }
+            }
+            for (int sweep = 0; sweep < 64; ++sweep) {
+              T off = 0, diagonal = 0;
+              for (size_t i = 0; i < n; ++i) {
+                diagonal += a[i * n + i] * a[i * n + i];
+                for (size_t j = i + 1; j < n; ++j) {
+                  off += a[i * n + j] * a[i * n + j];
+                }
+              }
+              if (off <= epsilon<T>() * epsilon<T>() * diagonal ||
+                  off == T(0)) {
+                break;
+              }
+              for (size_t p = 0; p < n; ++p) {
+                for (size_t r = p + 1; r < n; ++r) {
+                  const T apr = a[p * n + r];
+                  if (apr == T(0)) {
+                    continue;
+                  }
+                  const T theta = (a[r * n + r] - a[p * n + p]) / (2 * apr);
+                  const T t = std::copysign(T(1), theta) /
+                              (std::abs(theta) + std::hypot(theta, T(1)));
+                  const T c = T(1) / std::hypot(t, T(1));
+                  const T s = t * c;
+                  for (size_t k = 0; k < n; ++k) {
+                    const T akp = a[k * n + p], akr = a[k * n + r];
+                    a[k * n + p] = c * akp - s * akr;
+                    a[k * n + r] = s * akp + c * akr;
+                  }
+                  for (size_t k = 0; k < n; ++k) {
+                    const T apk = a[p * n + k], ark = a[r * n + k];
+                    a[p * n + k] = c * apk - s * ark;
+                    a[r * n + k] = s * apk + c * ark;
+                  }
+                  for (size_t k = 0; k < n; ++k) {
+                    const T vkp = v[k * n + p], vkr = v[k * n + r];
+                    v[k * n + p] = c * vkp - s * vkr;
+                    v[k * n + r] = s * vkp + c * vkr;
+                  }
+                }
+              }
+            }
+            for (size_t i = 0; i < n; ++i) {
+              d[i] = a[i * n + i];
+            }
+          }
+        }
+
+        // Packed row-major copy of the lower triangle of the square matrix
+        // a, mirrored into the upper one.
+        template <typename T>
+        std::vector<T> symmetric_copy(const MatrixBase<T> &a) {
+          const size_t n = a.get_num_rows();
+          if (a.get_num_columns() != n) {
+            throw std::invalid_argument("matrix is not square");
+          }
+          std::unique_ptr<MatrixBase<T>> temp;
+          const MatrixBase<T> *src = &a;
+          if (!is_strided(a)) {
+            temp = to_strided(a);
+            src = temp.get();
+          }
+          const T *data = src->data();
+          const std::ptrdiff_t rs = src->get_row_stride();
+          const std::ptrdiff_t cs = src->get_column_stride();
+          std::vector<T> copy(n * n);
+          for (size_t i = 0; i < n; ++i) {
+            for (size_t j = 0; j <= i; ++j) {
+              copy[i * n + j] = copy[j * n + i] = data[i * rs + j * cs];
+            }
+          }
+          return copy;
+        }
+
+        template <typename T, size_t n, Layout layout>
+        Eigensystem<T> jacobi_eigensystem(const MatrixArray<T, n, n, layout> &a,
+                                          size_t num_pairs) {
+          T work[n * n], d[n], v[n * n];
+          for (size_t i = 0; i < n; ++i) {
+            for (size_t j = 0; j <= i; ++j) {
+              work[i * n + j] = work[j * n + i] = a(i, j);
+            }
+          }
+          eigensolver::jacobi<T, n>(work, d, v);
+          size_t order[n];
+          std::iota(order, order + n, 0);
+          std::sort(order, order + n,
+                    [&d](size_t i, size_t j) { return d[i] < d[j]; });
+          const size_t k = std::min(num_pairs, n);
+          std::vector<T> values(k);
+          std::unique_ptr<MatrixBase<T>> vectors(new MatrixVector<T>(n, k));
+          T *z = vectors->data();
+          for (size_t j = 0; j < k; ++j) {
+            values[j] = d[order[j]];
+            for (size_t i = 0; i < n; ++i) {
+              z[i * k + j] = v[i * n + order[j]];
+            }
+          }
+          return {std::move(values), Matrix<T>(std::move(vectors))};
+        }
+      }
+
+      // Eigenvalues and eigenvectors of the symmetric matrix a; only its
+      // lower triangle is read. With num_pairs only the lowest num_pairs
+      // pairs are computed, e.g. the occupied orbitals of a Fock matrix.
+      template <typename T>
+      Eigensystem<T> diagonalize(const MatrixBase<T> &a,
+                                 size_t num_pairs = all_pairs) {
+        std::vector<T> work = kernel::symmetric_copy(a);
+        const size_t n = a.get_num_rows();
+        const size_t k = std::min(num_pairs, n);
+        std::vector<T> values(k);
+        std::unique_ptr<MatrixBase<T>> vectors(new MatrixVector<T>(n, k));
+        kernel::eigensolver::solve(n, work.data(), n, k, values.data(),
+                                   vectors->data(), k);
+        return {std::move(values), Matrix<T>(std::move(vectors))};
+      }
+
+      template <typename T>
+      Eigensystem<T> diagonalize(const Matrix<T> &a,
+                                 size_t num_pairs = all_pairs) {
+        return diagonalize(a.get_base(), num_pairs);
+      }
+
+      // Small fixed-size matrices go through Jacobi rotations on the stack.
+      template <typename T, size_t n, Layout layout>
+      Eigensystem<T> diagonalize(const MatrixArray<T, n, n, layout> &a,
+                                 size_t num_pairs = all_pairs) {
+        if (n > MatrixArray<T, n, n, layout>::max_fixed_size) {
+          return diagonalize(static_cast<const MatrixBase<T> &>(a), num_pairs);
+        }
+        return kernel::jacobi_eigensystem(a, num_pairs);
+      }
+    }
+  }
+}
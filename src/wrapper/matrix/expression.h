@@ -0,0 +1,462 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+#include "wrapper/matrix/base.h"
+#include "wrapper/matrix/dispatch.h"
+#include "wrapper/matrix/gemm.h"
+#include "wrapper/matrix/parallel.h"
+#include "wrapper/matrix/simd.h"
+#include "wrapper/thread/pool.h"
+
+namespace ketcpp {
+  namespace wrapper {
+    namespace matrix {
+      // Lazy matrix arithmetic. An expression is a linear combination of
+      // matrices and of matrix products; it is flattened into a list of
+      // terms when assigned and evaluated into the destination in one pass,
+      // followed by one GEMM per product.
+      //
+      // Every expression type provides value_type, num_terms, num_products,
+      // get_num_rows(), get_num_columns(), get_leaf() and for_each_term().
+      template <typename Derived> class Expression {
+      public:
+        const Derived &derived() const {
+          return static_cast<const Derived &>(*this);
+        }
+      };
+
+      // Wraps a MatrixBase so that it can take part in expressions.
+      template <typename T> class Ref : public Expression<Ref<T>> {
+        const MatrixBase<T> &matrix;
+
+      public:
+        using value_type = T;
+        using stored_type = const Ref;
+        constexpr static size_t num_terms = 1;
+        constexpr static size_t num_products = 0;
+
+        Ref(const MatrixBase<T> &matrix) : matrix(matrix) {}
+        size_t get_num_rows() const { return matrix.get_num_rows(); }
+        size_t get_num_columns() const { return matrix.get_num_columns(); }
+        const MatrixBase<T> *get_leaf(T &coeff) const {
+          coeff = T(1);
+          return &matrix;
+        }
+        template <typename F> void for_each_term(T coeff, F &f) const {
+          f.term(coeff, matrix);
+        }
+      };
+
+      template <typename T> Ref<T> lazy(const MatrixBase<T> &matrix) {
+        return Ref<T>(matrix);
+      }
+
+      template <typename L, typename R>
+      class Sum : public Expression<Sum<L, R>> {
+        typename L::stored_type lhs;
+        typename R::stored_type rhs;
+
+      public:
+        using value_type = typename L::value_type;
+        using stored_type = const Sum;
+        constexpr static size_t num_terms = L::num_terms + R::num_terms;
+        constexpr static size_t num_products =
+            L::num_products + R::num_products;
+
+        Sum(const L &lhs, const R &rhs) : lhs(lhs), rhs(rhs) {
+          if (lhs.get_num_rows() != rhs.get_num_rows() ||
+              lhs.get_num_columns() != rhs.get_num_columns()) {
+            throw std::invalid_argument("matrix shapes do not match");
+          }
+        }
+        size_t get_num_rows() const { return lhs.get_num_rows(); }
+        size_t get_num_columns() const { return lhs.get_num_columns(); }
+        const MatrixBase<value_type> *get_leaf(value_type &) const {
+          return nullptr;
+        }
+        template <typename F> void for_each_term(value_type coeff, F &f) const {
+          lhs.for_each_term(coeff, f);
+          rhs.for_each_term(coeff, f);
+        }
+      };
+
+      template <typename E> class Scaled : public Expression<Scaled<E>> {
+        typename E::stored_type expression;
+        typename E::value_type scalar;
+
+      public:
+        using value_type = typename E::value_type;
+        using stored_type = const Scaled;
+        constexpr static size_t num_terms = E::num_terms;
+        constexpr static size_t num_products = E::num_products;
+
+        Scaled(const E &expression, value_type scalar)
+            : expression(expression), scalar(scalar) {}
+        size_t get_num_rows() const { return expression.get_num_rows(); }
+        size_t get_num_columns() const { return expression.get_num_columns(); }
+        const MatrixBase<value_type> *get_leaf(value_type &coeff) const {
+          auto leaf = expression.get_leaf(coeff);
+          coeff *= scalar;
+          return leaf;
+        }
+        template <typename F> void for_each_term(value_type coeff, F &f) const {
+          expression.for_each_term(coeff * scalar, f);
+        }
+      };
+
+      template <typename L, typename R>
+      class Product : public Expression<Product<L, R>> {
+        typename L::stored_type lhs;
+        typename R::stored_type rhs;
+
+      public:
+        using value_type = typename L::value_type;
+        using stored_type = const Product;
+        constexpr static size_t num_terms = 0;
+        constexpr static size_t num_products = 1;
+
+        Product(const L &lhs, const R &rhs) : lhs(lhs), rhs(rhs) {
+          if (lhs.get_num_columns() != rhs.get_num_rows()) {
+            throw std::invalid_argument("matrix shapes do not match");
+          }
+        }
+        size_t get_num_rows() const { return lhs.get_num_rows(); }
+        size_t get_num_columns() const { return rhs.get_num_columns(); }
+        const MatrixBase<value_type> *get_leaf(value_type &) const {
+          return nullptr;
+        }
+        template <typename F> void for_each_term(value_type coeff, F &f) const {
+          f.product(coeff, lhs, rhs);
+        }
+      };
+
+      template <typename L, typename R>
+      Sum<L, R> operator+(const Expression<L> &lhs, const Expression<R> &rhs) {
+        return Sum<L, R>(lhs.derived(), rhs.derived());
+      }
+      template <typename E>
+      Scaled<E> operator*(const Expression<E> &lhs,
+                          typename E::value_type rhs) {
+        return Scaled<E>(lhs.derived(), rhs);
+      }
+      template <typename E>
+      Scaled<E> operator*(typename E::value_type lhs,
+                          const Expression<E> &rhs) {
+        return Scaled<E>(rhs.derived(), lhs);
+      }
+      template <typename E>
+      Scaled<E> operator/(const Expression<E> &lhs,
+                          typename E::value_type rhs) {
+        return Scaled<E>(lhs.derived(), typename E::value_type(1) / rhs);
+      }
+      template <typename E> Scaled<E> operator-(const Expression<E> &rhs) {
+        return Scaled<E>(rhs.derived(), typename E::value_type(-1));
+      }
+      template <typename L, typename R>
+      Sum<L, Scaled<R>> operator-(const Expression<L> &lhs,
+                                  const Expression<R> &rhs) {
+        return Sum<L, Scaled<R>>(lhs.derived(), -rhs);
+      }
+      template <typename L, typename R>
+      Product<L, R> operator*(const Expression<L> &lhs,
+                              const Expression<R> &rhs) {
+        return Product<L, R>(lhs.derived(), rhs.derived());
+      }
+
+      template <typename E>
+      std::unique_ptr<MatrixBase<typename E::value_type>>
+      evaluate(const Expression<E> &expression);
+
+      namespace kernel {
+        template <typename T>
+        bool same_layout(const MatrixBase<T> &a, const MatrixBase<T> &b) {
+          return a.data() == b.data() &&
+                 a.get_num_rows() == b.get_num_rows() &&
+                 a.get_num_columns() == b.get_num_columns() &&
+                 a.get_row_stride() == b.get_row_stride() &&
+                 a.get_column_stride() == b.get_column_stride();
+        }
+
+        template <typename T>
+        bool overlaps(const MatrixBase<T> &a, const MatrixBase<T> &b) {
+          if (a.data() == nullptr || b.data() == nullptr) {
+            return &a == &b;
+          }
+          auto extent = [](const MatrixBase<T> &x) {
+            const T *first = x.data();
+            const T *last = first +
+                            (x.get_num_rows() - 1) * x.get_row_stride() +
+                            (x.get_num_columns() - 1) * x.get_column_stride();
+            return std::make_pair(std::min(first, last),
+                                  std::max(first, last));
+          };
+          auto ea = extent(a), eb = extent(b);
+          return !(ea.second < eb.first || eb.second < ea.first);
+        }
+
+        template <typename T> struct Term {
+          T coeff;
+          const MatrixBase<T> *matrix;
+        };
+
+        template <typename T> struct ProductTerm {
+          T coeff;
+          const MatrixBase<T> *lhs, *rhs;
+          std::unique_ptr<MatrixBase<T>> lhs_temp, rhs_temp;
+        };
+
+        // Flattened form of an expression. Room is left for the destination
+        // itself (for +=) and for products that must go through a
+        // temporary because they alias the destination.
+        template <typename T, size_t max_terms, size_t max_products>
+        class TermList {
+        public:
+          std::array<Term<T>, max_terms + max_products + 1> terms;
+          size_t num_terms = 0;
+          std::array<ProductTerm<T>, max_products> products;
+          size_t num_products = 0;
+          std::array<std::unique_ptr<MatrixBase<T>>,
+                     max_terms + max_products + 1>
+              temps;
+
+          void term(T coeff, const MatrixBase<T> &matrix) {
+            for (size_t i = 0; i < num_terms; ++i) {
+              if (terms[i].matrix == &matrix ||
+                  (matrix.data() != nullptr &&
+                   same_layout(*terms[i].matrix, matrix))) {
+                terms[i].coeff += coeff;
+                return;
+              }
+            }
+            terms[num_terms++] = {coeff, &matrix};
+          }
+
+          // Products of two leaves that cannot both be fed to gemm go
+          // through the dispatch table and become an ordinary term.
+          template <typename L, typename R>
+          void product(T coeff, const L &lhs, const R &rhs) {
+            T ls, rs;
+            const MatrixBase<T> *l = lhs.get_leaf(ls), *r = rhs.get_leaf(rs);
+            if (l != nullptr && r != nullptr &&
+                (l->data() == nullptr || r->data() == nullptr)) {
+              terms[num_terms].coeff = coeff * ls * rs;
+              own(num_terms++, Dispatcher<T>::multiply(*l, *r));
+              return;
+            }
+            auto &p = products[num_products++];
+            p.coeff = coeff;
+            p.lhs = operand(lhs, p.coeff, p.lhs_temp);
+            p.rhs = operand(rhs, p.coeff, p.rhs_temp);
+          }
+
+          void own(size_t i, std::unique_ptr<MatrixBase<T>> &&temp) {
+            terms[i].matrix = temp.get();
+            temps[i] = std::move(temp);
+          }
+
+        private:
+          template <typename E>
+          static const MatrixBase<T> *
+          operand(const E &e, T &coeff, std::unique_ptr<MatrixBase<T>> &temp) {
+            T scalar;
+            const MatrixBase<T> *leaf = e.get_leaf(scalar);
+            if (leaf == nullptr) {
+              temp = evaluate(e);
+              return temp.get();
+            }
+            coeff *= scalar;
+            if (leaf->data() == nullptr) {
+              temp = to_strided(*leaf);
+              return temp.get();
+            }
+            return leaf;
+          }
+        };
+
+        // dest = sum of terms, one row at a time so that each row of the
+        // destination is loaded and stored once. Blocks of rows are spread
+        // over the thread pool.
+        template <typename T>
+        void combine(MatrixBase<T> &dest, Term<T> *terms, size_t num_terms) {
+          auto alias = std::find_if(terms, terms + num_terms,
+                                    [&dest](const Term<T> &t) {
+                                      return same_layout(*t.matrix, dest);
+                                    });
+          if (alias != terms + num_terms) {
+            std::swap(*alias, terms[0]);
+          }
+          const bool in_place = alias != terms + num_terms;
+          // Recorded as one add per term beyond the first.
+          KETCPP_PROFILE_BINARY(add, dest, *terms[num_terms - 1].matrix,
+                                (num_terms - 1) * size_of(dest),
+                                (num_terms + 1) * size_of(dest) * sizeof(T),
+                                0);
+          const size_t m = dest.get_num_rows(), n = dest.get_num_columns();
+          T *d = dest.data();
+          const std::ptrdiff_t rsd = dest.get_row_stride();
+          const std::ptrdiff_t csd = dest.get_column_stride();
+          const size_t grain = std::max<size_t>(parallel::grain / (n + 1), 1);
+          thread::parallel_for(0, m, grain, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i) {
+              T *row = d + i * rsd;
+              for (size_t k = 0; k < num_terms; ++k) {
+                const auto &t = *terms[k].matrix;
+                const T *src = t.data() + i * t.get_row_stride();
+                const std::ptrdiff_t css = t.get_column_stride();
+                if (k > 0) {
+                  strided_axpy(n, terms[k].coeff, src, css, row, csd);
+                } else if (!in_place || terms[k].coeff != T(1)) {
+                  strided_scale(n, terms[k].coeff, src, css, row, csd);
+                }
+              }
+            }
+          });
+        }
+
+        template <typename T, size_t max_terms, size_t max_products>
+        void evaluate_terms(MatrixBase<T> &dest,
+                            TermList<T, max_terms, max_products> &list) {
+          for (size_t i = 0; i < list.num_products; ++i) {
+            auto &p = list.products[i];
+            if (overlaps(*p.lhs, dest) || overlaps(*p.rhs, dest)) {
+              std::unique_ptr<MatrixBase<T>> temp(new MatrixVector<T>(
+                  p.lhs->get_num_rows(), p.rhs->get_num_columns()));
+              KETCPP_PROFILE_BINARY(
+                  multiply, *p.lhs, *p.rhs,
+                  2. * size_of(*p.lhs) * p.rhs->get_num_columns(),
+                  (size_of(*p.lhs) + size_of(*p.rhs) + size_of(*temp)) *
+                      sizeof(T),
+                  1);
+              gemm(p.coeff, *p.lhs, *p.rhs, T(0), *temp);
+              list.terms[list.num_terms++].coeff = T(1);
+              list.own(list.num_terms - 1, std::move(temp));
+              p.lhs = nullptr;
+            }
+          }
+          for (size_t i = 0; i < list.num_terms; ++i) {
+            const auto &t = *list.terms[i].matrix;
+            if (t.get_num_rows() != dest.get_num_rows() ||
+                t.get_num_columns() != dest.get_num_columns()) {
+              throw std::invalid_argument("matrix shapes do not match");
+            }
+            if (t.data() == nullptr ||
+                (overlaps(t, dest) && !same_layout(t, dest))) {
+              list.own(i, to_strided(t));
+            }
+          }
+          T beta = T(0);
+          if (list.num_terms > 0) {
+            combine(dest, list.terms.data(), list.num_terms);
+            beta = T(1);
+          }
+          for (size_t i = 0; i < list.num_products; ++i) {
+            auto &p = list.products[i];
+            if (p.lhs != nullptr) {
+              KETCPP_PROFILE_BINARY(
+                  multiply, *p.lhs, *p.rhs,
+                  2. * size_of(*p.lhs) * p.rhs->get_num_columns(),
+                  (size_of(*p.lhs) + size_of(*p.rhs) + 2 * size_of(dest)) *
+                      sizeof(T),
+                  0);
+              gemm(p.coeff, *p.lhs, *p.rhs, beta, dest);
+              beta = T(1);
+            }
+          }
+          if (beta == T(0)) {
+            const size_t m = dest.get_num_rows(), n = dest.get_num_columns();
+            kernel::scale(m, n, T(0), dest.data(), dest.get_row_stride(),
+                          dest.get_column_stride());
+          }
+        }
+
+        template <typename E>
+        using TermListFor = TermList<typename E::value_type, E::num_terms,
+                                     E::num_products>;
+      }
+
+      // Evaluates an expression into a new matrix. Sums keep the backend of
+      // their first operand; pure products are returned as MatrixVector.
+      template <typename E>
+      std::unique_ptr<MatrixBase<typename E::value_type>>
+      evaluate(const Expression<E> &expression) {
+        using T = typename E::value_type;
+        const E &e = expression.derived();
+        kernel::TermListFor<E> list;
+        e.for_each_term(T(1), list);
+        std::unique_ptr<MatrixBase<T>> dest;
+        if (list.num_terms > 0 && list.terms[0].matrix->data() != nullptr) {
+          dest = list.terms[0].matrix->copy();
+          if (dest->data() != nullptr) {
+            list.terms[0].matrix = dest.get();
+          } else {
+            dest.reset();
+          }
+        }
+        if (!dest) {
+          dest.reset(new MatrixVector<T>(e.get_num_rows(), e.get_num_columns()));
+        }
+        kernel::evaluate_terms(*dest, list);
+        return dest;
+      }
+
+      // dest = expression, without allocating when dest exposes strided
+      // storage. The shape of dest must match.
+      template <typename T, typename E>
+      void assign(MatrixBase<T> &dest, const Expression<E> &expression) {
+        if (dest.data() == nullptr) {
+          Dispatcher<T>::convert(dest, *evaluate(expression));
+          return;
+        }
+        kernel::TermListFor<E> list;
+        expression.derived().for_each_term(T(1), list);
+        kernel::evaluate_terms(dest, list);
+      }
+
+      // dest += expression
+      template <typename T, typename E>
+      void add_assign(MatrixBase<T> &dest, const Expression<E> &expression) {
+        if (dest.data() == nullptr) {
+          dest += *evaluate(expression);
+          return;
+        }
+        kernel::TermListFor<E> list;
+        expression.derived().for_each_term(T(1), list);
+        list.term(T(1), dest);
+        kernel::evaluate_terms(dest, list);
+      }
+
+      template <typename L, typename R>
+      bool operator==(const Expression<L> &lhs, const Expression<R> &rhs) {
+        return *evaluate(lhs) == *evaluate(rhs);
+      }
+      template <typename L, typename R>
+      bool operator!=(const Expression<L> &lhs, const Expression<R> &rhs) {
+        return !(lhs == rhs);
+      }
+    }
+  }
+}
@@ -0,0 +1,512 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+#include "wrapper/matrix/array.h"
+#include "wrapper/matrix/base.h"
+#include "wrapper/matrix/gemm.h"
+#include "wrapper/matrix/matrix.h"
+#include "wrapper/matrix/parallel.h"
+#include "wrapper/matrix/simd.h"
+#include "wrapper/matrix/vector.h"
+#include "wrapper/matrix/view.h"
+#include "wrapper/thread/pool.h"
+
+namespace ketcpp {
+  namespace wrapper {
+    namespace matrix {
+      namespace kernel {
+        // Blocked factorizations and triangular solves on strided storage.
+        // Each step factors a panel of block_size columns directly and
+        // leaves the O(n^3) part, the update of the trailing matrix, to
+        // gemm, which splits it over the thread pool.
+        namespace factorize {
+          constexpr size_t block_size = 64;
+
+          // B = A^-1 B for the m x m lower triangular A and the m x n B.
+          // Diagonal blocks are solved directly, split over the columns of
+          // B; the rows below are updated by GEMM.
+          template <typename T>
+          void solve_lower(size_t m, size_t n, const T *a, std::ptrdiff_t rsa,
+                           std::ptrdiff_t csa, bool unit, T *b,
+                           std::ptrdiff_t rsb, std::ptrdiff_t csb) {
+            const size_t nb = block_size;
+            for (size_t k0 = 0; k0 < m; k0 += nb) {
+              const size_t kb = std::min(nb, m - k0);
+              const T *akk = a + k0 * rsa + k0 * csa;
+              T *bk = b + k0 * rsb;
+              const size_t grain =
+                  std::max<size_t>(parallel::grain / (kb * kb + 1), 1);
+              thread::parallel_for(
+                  0, n, grain, [=](size_t first, size_t last) {
+                    for (size_t i = 0; i < kb; ++i) {
+                      T *bi = bk + i * rsb;
+                      for (size_t l = 0; l < i; ++l) {
+                        const T ail = akk[i * rsa + l * csa];
+                        const T *bl = bk + l * rsb;
+                        for (size_t j = first; j < last; ++j) {
+                          bi[j * csb] -= ail * bl[j * csb];
+                        }
+                      }
+                      if (!unit) {
+                        const T inverse = T(1) / akk[i * rsa + i * csa];
+                        for (size_t j = first; j < last; ++j) {
+                          bi[j * csb] *= inverse;
+                        }
+                      }
+                    }
+                  });
+              const size_t k1 = k0 + kb;
+              if (k1 < m) {
+                gemm<T>(m - k1, n, kb, T(-1), a + k1 * rsa + k0 * csa, rsa,
+                        csa, bk, rsb, csb, T(1), b + k1 * rsb, rsb, csb);
+              }
+            }
+          }
+
+          // B = A^-1 B for the m x m upper triangular A, from the bottom
+          // block up.
+          template <typename T>
+          void solve_upper(size_t m, size_t n, const T *a, std::ptrdiff_t rsa,
+                           std::ptrdiff_t csa, bool unit, T *b,
+                           std::ptrdiff_t rsb, std::ptrdiff_t csb) {
+            const size_t nb = block_size;
+            for (size_t k1 = m; k1 > 0;) {
+              const size_t kb = (k1 - 1) % nb + 1;
+              const size_t k0 = k1 - kb;
+              const T *akk = a + k0 * rsa + k0 * csa;
+              T *bk = b + k0 * rsb;
+              const size_t grain =
+                  std::max<size_t>(parallel::grain / (kb * kb + 1), 1);
+              thread::parallel_for(
+                  0, n, grain, [=](size_t first, size_t last) {
+                    for (size_t i = kb; i-- > 0;) {
+                      T *bi = bk + i * rsb;
+                      for (size_t l = i + 1; l < kb; ++l) {
+                        const T ail = akk[i * rsa + l * csa];
+                        const T *bl = bk + l * rsb;
+                        for (size_t j = first; j < last; ++j) {
+                          bi[j * csb] -= ail * bl[j * csb];
+                        }
+                      }
+                      if (!unit) {
+                        const T inverse = T(1) / akk[i * rsa + i * csa];
+                        for (size_t j = first; j < last; ++j) {
+                          bi[j * csb] *= inverse;
+                        }
+                      }
+                    }
+                  });
+              if (k0 > 0) {
+                gemm<T>(k0, n, kb, T(-1), a + k0 * csa, rsa, csa, bk, rsb,
+                        csb, T(1), b, rsb, csb);
+              }
+              k1 = k0;
+            }
+          }
+
+          // Right-looking blocked Cholesky: the lower triangle of the
+          // symmetric n x n matrix a becomes L with a = L L^T. The strict
+          // upper triangle is clobbered. Returns false if a is not positive
+          // definite.
+          template <typename T> bool cholesky(size_t n, T *a, size_t lda) {
+            const size_t nb = block_size;
+            for (size_t k0 = 0; k0 < n; k0 += nb) {
+              const size_t kb = std::min(nb, n - k0);
+              const size_t k1 = k0 + kb;
+              for (size_t j = k0; j < k1; ++j) {
+                T *aj = a + j * lda;
+                T pivot = aj[j];
+                for (size_t l = k0; l < j; ++l) {
+                  pivot -= aj[l] * aj[l];
+                }
+                if (!(pivot > T(0))) {
+                  return false;
+                }
+                const T ljj = std::sqrt(pivot);
+                aj[j] = ljj;
+                for (size_t i = j + 1; i < k1; ++i) {
+                  T *ai = a + i * lda;
+                  T sum = ai[j];
+                  for (size_t l = k0; l < j; ++l) {
+                    sum -= ai[l] * aj[l];
+                  }
+                  ai[j] = sum / ljj;
+                }
+              }
+              if (k1 == n) {
+                break;
+              }
+              // L21 = A21 L11^-T, solved as L11 L21^T = A21^T.
+              T *a21 = a + k1 * lda + k0;
+              solve_lower<T>(kb, n - k1, a + k0 * lda + k0, lda, 1, false, a21,
+                             1, lda);
+              // A22 -= L21 L21^T on the lower triangle, a block column at a
+              // time.
+              for (size_t j0 = k1; j0 < n; j0 += nb) {
+                const size_t jb = std::min(nb, n - j0);
+                const T *lj = a + j0 * lda + k0;
+                gemm<T>(n - j0, jb, kb, T(-1), lj, lda, 1, lj, 1, lda, T(1),
+                        a + j0 * lda + j0, lda, 1);
+              }
+            }
+            return true;
+          }
+
+          // Cholesky with symmetric pivoting on the largest remaining
+          // diagonal element: P^T A P = L L^T, where column j of P is
+          // e_{permutation[j]}. Stops when no pivot above tolerance is
+          // left and returns that rank; the first rank columns of the n x n
+          // l are filled, the rest is zero. Columns are computed left
+          // looking, their rows split over the thread pool.
+          template <typename T>
+          size_t cholesky_pivoted(size_t n, const T *a, std::ptrdiff_t rsa,
+                                  std::ptrdiff_t csa, size_t *permutation,
+                                  T *l, size_t ldl, T tolerance) {
+            std::iota(permutation, permutation + n, size_t(0));
+            std::vector<T> diagonal(n);
+            for (size_t i = 0; i < n; ++i) {
+              diagonal[i] = a[i * rsa + i * csa];
+              std::fill(l + i * ldl, l + i * ldl + n, T(0));
+            }
+            for (size_t j = 0; j < n; ++j) {
+              const size_t p =
+                  std::max_element(diagonal.begin() + j, diagonal.end()) -
+                  diagonal.begin();
+              if (!(diagonal[p] > tolerance)) {
+                return j;
+              }
+              if (p != j) {
+                std::swap(permutation[j], permutation[p]);
+                std::swap(diagonal[j], diagonal[p]);
+                std::swap_ranges(l + j * ldl, l + j * ldl + j, l + p * ldl);
+              }
+              const T ljj = std::sqrt(diagonal[j]);
+              T *lj = l + j * ldl;
+              lj[j] = ljj;
+              const T *aj = a + permutation[j] * csa;
+              const size_t grain =
+                  std::max<size_t>(parallel::grain / (j + 1), 1);
+              T *d = diagonal.data();
+              thread::parallel_for(
+                  j + 1, n, grain, [=](size_t first, size_t last) {
+                    for (size_t i = first; i < last; ++i) {
+                      T *li = l + i * ldl;
+                      const T lij = (aj[permutation[i] * rsa] -
+                                     simd::dot(j, li, lj)) /
+                                    ljj;
+                      li[j] = lij;
+                      d[i] -= lij * lij;
+                    }
+                  });
+            }
+            return n;
+          }
+
+          // Right-looking blocked LU with partial pivoting of the n x n a:
+          // P A = L U, L unit lower and U upper, both left in a. Row i was
+          // swapped with row pivots[i], in order of i; whole rows are
+          // swapped. Returns false if a is singular.
+          template <typename T>
+          bool lu(size_t n, T *a, size_t lda, size_t *pivots) {
+            const size_t nb = block_size;
+            for (size_t k0 = 0; k0 < n; k0 += nb) {
+              const size_t kb = std::min(nb, n - k0);
+              const size_t k1 = k0 + kb;
+              for (size_t j = k0; j < k1; ++j) {
+                size_t p = j;
+                for (size_t r = j + 1; r < n; ++r) {
+                  if (std::abs(a[r * lda + j]) > std::abs(a[p * lda + j])) {
+                    p = r;
+                  }
+                }
+                pivots[j] = p;
+                if (a[p * lda + j] == T(0)) {
+                  return false;
+                }
+                if (p != j) {
+                  std::swap_ranges(a + j * lda, a + j * lda + n, a + p * lda);
+                }
+                const T *aj = a + j * lda;
+                const T inverse = T(1) / aj[j];
+                const size_t width = k1 - j - 1;
+                const size_t grain =
+                    std::max<size_t>(parallel::grain / (width + 1), 1);
+                thread::parallel_for(
+                    j + 1, n, grain, [=](size_t first, size_t last) {
+                      for (size_t r = first; r < last; ++r) {
+                        T *ar = a + r * lda;
+                        ar[j] *= inverse;
+                        simd::axpy(width, -ar[j], aj + j + 1, ar + j + 1);
+                      }
+                    });
+              }
+              if (k1 < n) {
+                // U12 = L11^-1 A12, A22 -= L21 U12.
+                solve_lower<T>(kb, n - k1, a + k0 * lda + k0, lda, 1, true,
+                               a + k0 * lda + k1, lda, 1);
+                gemm<T>(n - k1, n - k1, kb, T(-1), a + k1 * lda + k0, lda, 1,
+                        a + k0 * lda + k1, lda, 1, T(1), a + k1 * lda + k1,
+                        lda, 1);
+              }
+            }
+            return true;
+          }
+
+          // B = A^-1 B from the LU factors of A, for the n x m B.
+          template <typename T>
+          void lu_solve(size_t n, const T *a, size_t lda, const size_t *pivots,
+                        size_t m, T *b, std::ptrdiff_t rsb,
+                        std::ptrdiff_t csb) {
+            for (size_t i = 0; i < n; ++i) {
+              if (pivots[i] != i) {
+                for (size_t j = 0; j < m; ++j) {
+                  std::swap(b[i * rsb + j * csb], b[pivots[i] * rsb + j * csb]);
+                }
+              }
+            }
+            solve_lower<T>(n, m, a, lda, 1, true, b, rsb, csb);
+            solve_upper<T>(n, m, a, lda, 1, false, b, rsb, csb);
+          }
+        }
+
+        template <typename T> void check_square(const MatrixBase<T> &a) {
+          if (a.get_num_rows() != a.get_num_columns()) {
+            throw std::invalid_argument("matrix is not square");
+          }
+        }
+      }
+
+      enum class Triangle { lower, upper };
+
+      // Cholesky factor L of the symmetric positive definite a, a = L L^T;
+      // only the lower triangle of a is read. Throws std::domain_error if a
+      // is not positive definite.
+      template <typename T> Matrix<T> cholesky(const MatrixBase<T> &a) {
+        kernel::check_square(a);
+        const size_t n = a.get_num_rows();
+        std::unique_ptr<MatrixBase<T>> l(new MatrixVector<T>(a));
+        T *data = l->data();
+        if (!kernel::factorize::cholesky(n, data, n)) {
+          throw std::domain_error("matrix is not positive definite");
+        }
+        for (size_t i = 0; i < n; ++i) {
+          std::fill(data + i * n + i + 1, data + (i + 1) * n, T(0));
+        }
+        return Matrix<T>(std::move(l));
+      }
+
+      // P^T A P = L L^T for a positive semidefinite A, with L n x rank and
+      // column j of P the unit vector e_{permutation[j]}.
+      template <typename T> struct PivotedCholesky {
+        Matrix<T> factor;
+        std::vector<size_t> permutation;
+        size_t rank;
+      };
+
+      // Stops at pivots of tolerance or below; by default n epsilon times
+      // the largest diagonal element. A low-rank factor of, e.g., a
+      // two-electron integral matrix.
+      template <typename T>
+      PivotedCholesky<T> pivoted_cholesky(const MatrixBase<T> &a,
+                                          T tolerance = T(-1)) {
+        kernel::check_square(a);
+        const size_t n = a.get_num_rows();
+        const MatrixVector<T> dense(a);
+        if (tolerance < T(0)) {
+          T largest = 0;
+          for (size_t i = 0; i < n; ++i) {
+            largest = std::max(largest, dense(i, i));
+          }
+          tolerance = n * std::numeric_limits<T>::epsilon() * largest;
+        }
+        std::vector<size_t> permutation(n);
+        std::vector<T> l(n * n);
+        const size_t rank = kernel::factorize::cholesky_pivoted(
+            n, dense.data(), n, 1, permutation.data(), l.data(), n, tolerance);
+        std::unique_ptr<MatrixBase<T>> factor(new MatrixVector<T>(n, rank));
+        T *f = factor->data();
+        for (size_t i = 0; i < n; ++i) {
+          std::copy(l.begin() + i * n, l.begin() + i * n + rank,
+                    f + i * rank);
+        }
+        return {Matrix<T>(std::move(factor)), std::move(permutation), rank};
+      }
+
+      // P A = L U with L unit lower and U upper triangular, packed into
+      // factors; row i was swapped with row pivots[i], in order of i.
+      template <typename T> struct LUDecomposition {
+        Matrix<T> factors;
+        std::vector<size_t> pivots;
+      };
+
+      // Throws std::domain_error if a is singular.
+      template <typename T> LUDecomposition<T> lu(const MatrixBase<T> &a) {
+        kernel::check_square(a);
+        const size_t n = a.get_num_rows();
+        std::unique_ptr<MatrixBase<T>> factors(new MatrixVector<T>(a));
+        std::vector<size_t> pivots(n);
+        if (!kernel::factorize::lu(n, factors->data(), n, pivots.data())) {
+          throw std::domain_error("matrix is singular");
+        }
+        return {Matrix<T>(std::move(factors)), std::move(pivots)};
+      }
+
+      // B = A^-1 B in place for the triangular a; b needs strided storage,
+      // e.g. a MatrixVector or a view. Pass transpose(a) to solve with A^T.
+      template <typename T>
+      void solve_triangular(const MatrixBase<T> &a, Triangle triangle,
+                            MatrixBase<T> &b, bool unit_diagonal = false) {
+        kernel::check_square(a);
+        kernel::check_strided(b);
+        if (a.get_num_rows() != b.get_num_rows()) {
+          throw std::invalid_argument("matrix shapes do not match");
+        }
+        std::unique_ptr<MatrixBase<T>> temp;
+        const MatrixBase<T> *src = &a;
+        if (!kernel::is_strided(a)) {
+          temp = kernel::to_strided(a);
+          src = temp.get();
+        }
+        const auto solve = triangle == Triangle::lower
+                               ? kernel::factorize::solve_lower<T>
+                               : kernel::factorize::solve_upper<T>;
+        solve(b.get_num_rows(), b.get_num_columns(), src->data(),
+              src->get_row_stride(), src->get_column_stride(), unit_diagonal,
+              b.data(), b.get_row_stride(), b.get_column_stride());
+      }
+
+      // A^-1 B from the LU factors of A.
+      template <typename T>
+      Matrix<T> solve(const LUDecomposition<T> &lu, const MatrixBase<T> &b) {
+        const size_t n = lu.factors.get_num_rows();
+        if (b.get_num_rows() != n) {
+          throw std::invalid_argument("matrix shapes do not match");
+        }
+        std::unique_ptr<MatrixBase<T>> x(new MatrixVector<T>(b));
+        const size_t m = b.get_num_columns();
+        kernel::factorize::lu_solve(n, lu.factors.data(), n, lu.pivots.data(),
+                                    m, x->data(), m, 1);
+        return Matrix<T>(std::move(x));
+      }
+
+      // A^-1 B for a general square A, through LU.
+      template <typename T>
+      Matrix<T> solve(const MatrixBase<T> &a, const MatrixBase<T> &b) {
+        return solve(lu(a), b);
+      }
+
+      // A^-1 B from the Cholesky factor l of A.
+      template <typename T>
+      Matrix<T> cholesky_solve(const MatrixBase<T> &l,
+                               const MatrixBase<T> &b) {
+        std::unique_ptr<MatrixBase<T>> x(new MatrixVector<T>(b));
+        solve_triangular(l, Triangle::lower, *x);
+        solve_triangular(transpose(l), Triangle::upper, *x);
+        return Matrix<T>(std::move(x));
+      }
+
+      // Fixed-size versions: the same algorithms, unblocked, with
+      // compile-time bounds and no heap allocation.
+      template <typename T, size_t n, Layout layout>
+      MatrixArray<T, n, n, layout>
+      cholesky(const MatrixArray<T, n, n, layout> &a) {
+        MatrixArray<T, n, n, layout> l;
+        for (size_t j = 0; j < n; ++j) {
+          T pivot = a(j, j);
+          for (size_t k = 0; k < j; ++k) {
+            pivot -= l(j, k) * l(j, k);
+          }
+          if (!(pivot > T(0))) {
+            throw std::domain_error("matrix is not positive definite");
+          }
+          l(j, j) = std::sqrt(pivot);
+          for (size_t i = 0; i < j; ++i) {
+            l(i, j) = T(0);
+          }
+          for (size_t i = j + 1; i < n; ++i) {
+            T sum = a(i, j);
+            for (size_t k = 0; k < j; ++k) {
+              sum -= l(i, k) * l(j, k);
+            }
+            l(i, j) = sum / l(j, j);
+          }
+        }
+        return l;
+      }
+
+      // A^-1 B by Gaussian elimination with partial pivoting; throws
+      // std::domain_error if a is singular.
+      template <typename T, size_t n, size_t m, Layout la, Layout lb>
+      MatrixArray<T, n, m, lb> solve(const MatrixArray<T, n, n, la> &a,
+                                     const MatrixArray<T, n, m, lb> &b) {
+        MatrixArray<T, n, n, la> u = a;
+        MatrixArray<T, n, m, lb> x = b;
+        for (size_t j = 0; j < n; ++j) {
+          size_t p = j;
+          for (size_t r = j + 1; r < n; ++r) {
+            if (std::abs(u(r, j)) > std::abs(u(p, j))) {
+              p = r;
+            }
+          }
+          if (u(p, j) == T(0)) {
+            throw std::domain_error("matrix is singular");
+          }
+          if (p != j) {
+            for (size_t k = 0; k < n; ++k) {
+              std::swap(u(j, k), u(p, k));
+            }
+            for (size_t k = 0; k < m; ++k) {
+              std::swap(x(j, k), x(p, k));
+            }
+          }
+          for (size_t r = j + 1; r < n; ++r) {
+            const T factor = u(r, j) / u(j, j);
+            for (size_t k = j + 1; k < n; ++k) {
+              u(r, k) -= factor * u(j, k);
+            }
+            for (size_t k = 0; k < m; ++k) {
+              x(r, k) -= factor * x(j, k);
+            }
+          }
+        }
+        for (size_t j = n; j-- > 0;) {
+          for (size_t k = 0; k < m; ++k) {
+            T sum = x(j, k);
+            for (size_t l = j + 1; l < n; ++l) {
+              sum -= u(j, l) * x(l, k);
+            }
+            x(j, k) = sum / u(j, j);
+          }
+        }
+        return x;
+      }
+    }
+  }
+}
@@ -0,0 +1,309 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <stdexcept>
+
+namespace ketcpp {
+  namespace wrapper {
+    namespace matrix {
+      // Kernels on row-major arrays whose shape is fixed at compile time.
+      // Loop bounds are template arguments, so compilers unroll them
+      // completely for small shapes, and every kernel is constexpr: called
+      // on a local FixedMatrix inside a constant expression they are
+      // evaluated at compile time.
+      namespace kernel {
+        namespace fixed {
+          template <typename T> constexpr T abs(T x) {
+            return x < T(0) ? -x : x;
+          }
+
+          // c = a * b, a is m x k and b is k x n; c must not alias a or b.
+          template <typename T, size_t m, size_t k, size_t n>
+          constexpr void multiply(const T *a, const T *b, T *c) {
+            for (size_t i = 0; i < m; ++i) {
+              for (size_t j = 0; j < n; ++j) {
+                T sum = T(0);
+                for (size_t p = 0; p < k; ++p) {
+                  sum += a[i * k + p] * b[p * n + j];
+                }
+                c[i * n + j] = sum;
+              }
+            }
+          }
+
+          // b = a^T, a is m x n.
+          template <typename T, size_t m, size_t n>
+          constexpr void transpose(const T *a, T *b) {
+            for (size_t i = 0; i < m; ++i) {
+              for (size_t j = 0; j < n; ++j) {
+                b[j * m + i] = a[i * n + j];
+              }
+            }
+          }
+
+          template <typename T> constexpr T det2(T a, T b, T c, T d) {
+            return a * d - b * c;
+          }
+
+          // Closed forms up to 3 x 3; larger orders use Gaussian elimination
+          // with partial pivoting.
+          template <typename T, size_t n> struct Determinant {
+            static constexpr T get(const T *a) {
+              T lu[n * n] = {};
+              for (size_t i = 0; i < n * n; ++i) {
+                lu[i] = a[i];
+              }
+              T det = T(1);
+              for (size_t k = 0; k < n; ++k) {
+                size_t pivot = k;
+                for (size_t i = k + 1; i < n; ++i) {
+                  if (abs(lu[i * n + k]) > abs(lu[pivot * n + k])) {
+                    pivot = i;
+                  }
+                }
+                if (lu[pivot * n + k] == T(0)) {
+                  return T(0);
+                }
+                if (pivot != k) {
+                  for (size_t j = 0; j < n; ++j) {
+                    const T t = lu[k * n + j];
+                    lu[k * n + j] = lu[pivot * n + j];
+                    lu[pivot * n + j] = t;
+                  }
+                  det = -det;
+                }
+                det *= lu[k * n + k];
+                for (size_t i = k + 1; i < n; ++i) {
+                  const T f = lu[i * n + k] / lu[k * n + k];
+                  for (size_t j = k + 1; j < n; ++j) {
+                    lu[i * n + j] -= f * lu[k * n + j];
+                  }
+                }
+              }
+              return det;
+            }
+          };
+          template <typename T> struct Determinant<T, 1> {
+            static constexpr T get(const T *a) { return a[0]; }
+          };
+          template <typename T> struct Determinant<T, 2> {
+            static constexpr T get(const T *a) {
+              return det2(a[0], a[1], a[2], a[3]);
+            }
+          };
+          template <typename T> struct Determinant<T, 3> {
+            static constexpr T get(const T *a) {
+              return a[0] * det2(a[4], a[5], a[7], a[8]) -
+                     a[1] * det2(a[3], a[5], a[6], a[8]) +
+                     a[2] * det2(a[3], a[4], a[6], a[7]);
+            }
+          };
+
+          template <typename T, size_t n> constexpr T determinant(const T *a) {
+            return Determinant<T, n>::get(a);
+          }
+
+          // Adjugate over determinant up to 3 x 3; Gauss-Jordan elimination
+          // with partial pivoting above. Throws std::domain_error for
+          // singular matrices.
+          template <typename T, size_t n> struct Inverse {
+            static constexpr void get(const T *a, T *b) {
+              T lu[n * n] = {};
+              for (size_t i = 0; i < n * n; ++i) {
+                lu[i] = a[i];
+                b[i] = T(0);
+              }
+              for (size_t i = 0; i < n; ++i) {
+                b[i * n + i] = T(1);
+              }
+              for (size_t k = 0; k < n; ++k) {
+                size_t pivot = k;
+                for (size_t i = k + 1; i < n; ++i) {
+                  if (abs(lu[i * n + k]) > abs(lu[pivot * n + k])) {
+                    pivot = i;
+                  }
+                }
+                if (lu[pivot * n + k] == T(0)) {
+                  throw std::domain_error("matrix is singular");
+                }
+                for (size_t j = 0; j < n; ++j) {
+                  T t = lu[k * n + j];
+                  lu[k * n + j] = lu[pivot * n + j];
+                  lu[pivot * n + j] = t;
+                  t = b[k * n + j];
+                  b[k * n + j] = b[pivot * n + j];
+                  b[pivot * n + j] = t;
+                }
+                const T r = T(1) / lu[k * n + k];
+                for (size_t j = 0; j < n; ++j) {
+                  lu[k * n + j] *= r;
+                  b[k * n + j] *= r;
+                }
+                for (size_t i = 0; i < n; ++i) {
+                  if (i == k) {
+                    continue;
+                  }
+                  const T f = lu[i * n + k];
+                  for (size_t j = 0; j < n; ++j) {
+                    lu[i * n + j] -= f * lu[k * n + j];
+                    b[i * n + j] -= f * b[k * n + j];
+                  }
+                }
+              }
+            }
+          };
+          template <typename T> struct Inverse<T, 1> {
+            static constexpr void get(const T *a, T *b) {
+              if (a[0] == T(0)) {
+                throw std::domain_error("matrix is singular");
+              }
+              b[0] = T(1) / a[0];
+            }
+          };
+          template <typename T> struct Inverse<T, 2> {
+            static constexpr void get(const T *a, T *b) {
+              const T det = Determinant<T, 2>::get(a);
+              if (det == T(0)) {
+                throw std::domain_error("matrix is singular");
+              }
+              const T r = T(1) / det;
+              b[0] = a[3] * r;
+              b[1] = -a[1] * r;
+              b[2] = -a[2] * r;
+              b[3] = a[0] * r;
+            }
+          };
+          template <typename T> struct Inverse<T, 3> {
+            static constexpr void get(const T *a, T *b) {
+              const T c00 = det2(a[4], a[5], a[7], a[8]);
+              const T c01 = -det2(a[3], a[5], a[6], a[8]);
+              const T c02 = det2(a[3], a[4], a[6], a[7]);
+              const T det = a[0] * c00 + a[1] * c01 + a[2] * c02;
+              if (det == T(0)) {
+                throw std::domain_error("matrix is singular");
+              }
+              const T r = T(1) / det;
+              b[0] = c00 * r;
+              b[1] = -det2(a[1], a[2], a[7], a[8]) * r;
+              b[2] = det2(a[1], a[2], a[4], a[5]) * r;
+              b[3] = c01 * r;
+              b[4] = det2(a[0], a[2], a[6], a[8]) * r;
+              b[5] = -det2(a[0], a[2], a[3], a[5]) * r;
+              b[6] = c02 * r;
+              b[7] = -det2(a[0], a[1], a[6], a[7]) * r;
+              b[8] = det2(a[0], a[1], a[3], a[4]) * r;
+            }
+          };
+
+          template <typename T, size_t n>
+          constexpr void inverse(const T *a, T *b) {
+            Inverse<T, n>::get(a, b);
+          }
+
+          // c = a x b for 3-vectors; c must not alias a or b.
+          template <typename T>
+          constexpr void cross(const T *a, const T *b, T *c) {
+            c[0] = a[1] * b[2] - a[2] * b[1];
+            c[1] = a[2] * b[0] - a[0] * b[2];
+            c[2] = a[0] * b[1] - a[1] * b[0];
+          }
+        }
+      }
+
+      // Literal m x n matrix for geometry in constant expressions, e.g.
+      //   constexpr FixedMatrix<double, 3> r = {{0, -1, 0, 1, 0, 0, 0, 0, 1}};
+      //   static_assert(determinant(r) == 1, "");
+      // MatrixArray offers the same operations at run time.
+      template <typename T, size_t m, size_t n = m> struct FixedMatrix {
+        T elements[m * n];
+
+        constexpr static size_t num_rows = m;
+        constexpr static size_t num_columns = n;
+
+        constexpr T &operator()(size_t i, size_t j) {
+          return elements[i * n + j];
+        }
+        constexpr const T &operator()(size_t i, size_t j) const {
+          return elements[i * n + j];
+        }
+        constexpr T *data() { return elements; }
+        constexpr const T *data() const { return elements; }
+
+        constexpr bool operator==(const FixedMatrix &rhs) const {
+          for (size_t i = 0; i < m * n; ++i) {
+            if (!(elements[i] == rhs.elements[i])) {
+              return false;
+            }
+          }
+          return true;
+        }
+        constexpr bool operator!=(const FixedMatrix &rhs) const {
+          return !(*this == rhs);
+        }
+      };
+
+      template <typename T, size_t m, size_t n>
+      constexpr size_t FixedMatrix<T, m, n>::num_rows;
+      template <typename T, size_t m, size_t n>
+      constexpr size_t FixedMatrix<T, m, n>::num_columns;
+
+      template <typename T, size_t m, size_t k, size_t n>
+      constexpr FixedMatrix<T, m, n> operator*(const FixedMatrix<T, m, k> &a,
+                                               const FixedMatrix<T, k, n> &b) {
+        FixedMatrix<T, m, n> c = {};
+        kernel::fixed::multiply<T, m, k, n>(a.elements, b.elements,
+                                            c.elements);
+        return c;
+      }
+
+      template <typename T, size_t m, size_t n>
+      constexpr FixedMatrix<T, n, m> transpose(const FixedMatrix<T, m, n> &a) {
+        FixedMatrix<T, n, m> b = {};
+        kernel::fixed::transpose<T, m, n>(a.elements, b.elements);
+        return b;
+      }
+
+      template <typename T, size_t n>
+      constexpr T determinant(const FixedMatrix<T, n, n> &a) {
+        return kernel::fixed::determinant<T, n>(a.elements);
+      }
+
+      template <typename T, size_t n>
+      constexpr FixedMatrix<T, n, n> inverse(const FixedMatrix<T, n, n> &a) {
+        FixedMatrix<T, n, n> b = {};
+        kernel::fixed::inverse<T, n>(a.elements, b.elements);
+        return b;
+      }
+
+      // Cross product of column (3 x 1) or row (1 x 3) vectors.
+      template <typename T, size_t m, size_t n>
+      constexpr FixedMatrix<T, m, n> cross(const FixedMatrix<T, m, n> &a,
+                                           const FixedMatrix<T, m, n> &b) {
+        static_assert(m * n == 3 && (m == 1 || n == 1),
+                      "cross product needs 3-vectors");
+        FixedMatrix<T, m, n> c = {};
+        kernel::fixed::cross(a.elements, b.elements, c.elements);
+        return c;
+      }
+    }
+  }
+}
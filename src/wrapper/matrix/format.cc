@@ -0,0 +1,70 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+
+#include "wrapper/matrix/format.h"
+
+namespace ketcpp {
+  namespace wrapper {
+    namespace matrix {
+      namespace kernel {
+        namespace {
+          double parse(const char *buf, double) {
+            return std::strtod(buf, nullptr);
+          }
+          float parse(const char *buf, float) {
+            return std::strtof(buf, nullptr);
+          }
+
+          // Without a precision, the digits are increased from digits10
+          // until the text parses back to value; max_digits10 always does.
+          template <typename T>
+          char *format_floating(T value, int precision, char *buf) {
+            using limits = std::numeric_limits<T>;
+            if (precision > 0) {
+              precision = std::min(precision, limits::max_digits10);
+              return buf + std::snprintf(buf, 32, "%.*g", precision,
+                                         double(value));
+            }
+            int length = 0;
+            for (int digits = limits::digits10; digits <= limits::max_digits10;
+                 ++digits) {
+              length = std::snprintf(buf, 32, "%.*g", digits, double(value));
+              if (!(value == value) || parse(buf, value) == value) {
+                break;
+              }
+            }
+            return buf + length;
+          }
+        }
+
+        char *format_number(double value, int precision, char *buf) {
+          return format_floating(value, precision, buf);
+        }
+        char *format_number(float value, int precision, char *buf) {
+          return format_floating(value, precision, buf);
+        }
+      }
+    }
+  }
+}
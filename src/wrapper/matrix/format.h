@@ -0,0 +1,164 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <complex>
+#include <cstddef>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "wrapper/matrix/base.h"
+#include "wrapper/matrix/dispatch.h"
+#include "wrapper/thread/pool.h"
+
+namespace ketcpp {
+  namespace wrapper {
+    namespace matrix {
+      // Delimiters and precision for format(). A matrix is written as
+      // matrix_begin, the rows joined by row_separator, and matrix_end;
+      // each row as row_begin, its elements joined by element_separator,
+      // and row_end.
+      struct FormatStyle {
+        std::string matrix_begin, row_begin, element_separator, row_end,
+            row_separator, matrix_end;
+        // Significant digits; zero selects the shortest text that reads
+        // back to the same value.
+        int precision;
+
+        // {{a, b}, {c, d}}, as operator<< writes it.
+        static FormatStyle braces(int precision = 0) {
+          return {"{{", "", ", ", "", "}, {", "}}", precision};
+        }
+        static FormatStyle csv(int precision = 0) {
+          return {"", "", ",", "", "\n", "\n", precision};
+        }
+        static FormatStyle whitespace(int precision = 0) {
+          return {"", "", " ", "", "\n", "\n", precision};
+        }
+      };
+
+      namespace kernel {
+        // Writes value to buf, which must hold at least 32 characters, and
+        // returns the end of the text.
+        char *format_number(double value, int precision, char *buf);
+        char *format_number(float value, int precision, char *buf);
+
+        inline void append_number(std::string &out, double value,
+                                  int precision) {
+          char buf[32];
+          out.append(buf, format_number(value, precision, buf));
+        }
+        inline void append_number(std::string &out, float value,
+                                  int precision) {
+          char buf[32];
+          out.append(buf, format_number(value, precision, buf));
+        }
+        // Other element types go through iostreams.
+        template <typename T>
+        void append_number(std::string &out, const T &value, int precision) {
+          std::ostringstream ss;
+          if (precision > 0) {
+            ss.precision(precision);
+          }
+          ss << value;
+          out += ss.str();
+        }
+        template <typename T>
+        void append_number(std::string &out, const std::complex<T> &value,
+                           int precision) {
+          out += '(';
+          append_number(out, value.real(), precision);
+          out += ',';
+          append_number(out, value.imag(), precision);
+          out += ')';
+        }
+
+        template <typename T>
+        void format_rows(std::string &out, const MatrixBase<T> &matrix,
+                         size_t first, size_t last, const FormatStyle &style) {
+          const size_t n = matrix.get_num_columns();
+          const std::ptrdiff_t rs = matrix.get_row_stride();
+          const std::ptrdiff_t cs = matrix.get_column_stride();
+          for (size_t i = first; i < last; ++i) {
+            if (i != 0) {
+              out += style.row_separator;
+            }
+            out += style.row_begin;
+            const T *row = matrix.data() + i * rs;
+            for (size_t j = 0; j < n; ++j) {
+              if (j != 0) {
+                out += style.element_separator;
+              }
+              append_number(out, row[j * cs], style.precision);
+            }
+            out += style.row_end;
+          }
+        }
+      }
+
+      // Writes matrix to out as text. Rows are formatted in blocks on the
+      // thread pool into buffers that are reused from one wave of blocks to
+      // the next, and each buffer reaches out with a single write.
+      template <typename T>
+      void format(std::ostream &out, const MatrixBase<T> &matrix,
+                  const FormatStyle &style = FormatStyle::braces()) {
+        std::unique_ptr<MatrixBase<T>> temp;
+        if (!kernel::is_strided(matrix)) {
+          temp = kernel::to_strided(matrix);
+        }
+        const MatrixBase<T> &a = temp ? *temp : matrix;
+        const size_t m = a.get_num_rows(), n = a.get_num_columns();
+        constexpr size_t block_elements = 1 << 14;
+        const size_t block_rows = std::max<size_t>(block_elements / (n + 1), 1);
+        const size_t num_blocks = (m + block_rows - 1) / block_rows;
+        std::vector<std::string> buffers(
+            std::min(num_blocks, 4 * thread::get_num_threads()));
+        out << style.matrix_begin;
+        for (size_t wave = 0; wave < num_blocks; wave += buffers.size()) {
+          const size_t count = std::min(buffers.size(), num_blocks - wave);
+          thread::parallel_for(0, count, 1, [&](size_t first, size_t last) {
+            for (size_t b = first; b < last; ++b) {
+              const size_t row = (wave + b) * block_rows;
+              buffers[b].clear();
+              kernel::format_rows(buffers[b], a, row,
+                                  std::min(row + block_rows, m), style);
+            }
+          });
+          for (size_t b = 0; b < count; ++b) {
+            out.write(buffers[b].data(), buffers[b].size());
+          }
+        }
+        out << style.matrix_end;
+      }
+
+      template <typename T>
+      std::string to_string(const MatrixBase<T> &matrix,
+                            const FormatStyle &style = FormatStyle::braces()) {
+        std::ostringstream ss;
+        format(ss, matrix, style);
+        return ss.str();
+      }
+    }
+  }
+}
@@ -0,0 +1,627 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "wrapper/matrix/base.h"
+#include "wrapper/matrix/dispatch.h"
+#include "wrapper/matrix/eigensolver.h"
+#include "wrapper/matrix/expression.h"
+#include "wrapper/matrix/factorize.h"
+#include "wrapper/matrix/gemm.h"
+#include "wrapper/matrix/matrix.h"
+#include "wrapper/matrix/vector.h"
+#include "wrapper/thread/pool.h"
+
+namespace ketcpp {
+  namespace wrapper {
+    namespace matrix {
+      // How a function of a matrix is evaluated. spectral applies the
+      // function to the eigenvalues of a dense eigendecomposition;
+      // iterative runs a Newton-Schulz or Taylor scheme made only of
+      // products and sums, so it parallelizes like GEMM and keeps the
+      // backend of its operand, block-sparse included. automatic picks the
+      // cheaper of the two.
+      enum class FunctionMethod { automatic, spectral, iterative };
+
+      namespace kernel {
+        namespace function {
+          template <typename T> using Pointer = std::unique_ptr<MatrixBase<T>>;
+
+          constexpr size_t max_iterations = 100;
+          // Below this size the eigendecomposition is always used.
+          constexpr size_t min_iterative_size = 32;
+          // The Taylor series for exp is summed on A / 2^s with
+          // |A / 2^s| <= taylor_radius, where the degree 15 remainder is
+          // below the rounding error.
+          constexpr double taylor_radius = 0.5;
+          constexpr size_t taylor_degree = 15;
+
+          template <typename T> constexpr T epsilon() {
+            return std::numeric_limits<T>::epsilon();
+          }
+
+          // Cost of the dense eigendecomposition and back transformation,
+          // in GEMMs of the same size. On one thread it is about 4 + 256 / n;
+          // the reduction to tridiagonal form is half matrix-vector work,
+          // which gains less from more threads than GEMM does.
+          inline double get_spectral_cost(size_t n) {
+            return (4 + 256. / n) *
+                   std::sqrt(static_cast<double>(thread::get_num_threads()));
+          }
+
+          // Whether an iteration of about num_gemms products beats the
+          // eigendecomposition of a. Operands without strided storage are
+          // never diagonalized.
+          template <typename T>
+          bool prefer_iterative(const MatrixBase<T> &a, double num_gemms) {
+            if (!is_strided(a)) {
+              return true;
+            }
+            const size_t n = a.get_num_rows();
+            return n >= min_iterative_size && num_gemms < get_spectral_cost(n);
+          }
+
+          // Gershgorin bounds for a strided square matrix: every eigenvalue
+          // lies in [lower, upper] and at least gap away from zero.
+          template <typename T> struct Disks {
+            T lower, upper, gap;
+          };
+          template <typename T> Disks<T> gershgorin(const MatrixBase<T> &a) {
+            const size_t n = a.get_num_rows();
+            const T *data = a.data();
+            const std::ptrdiff_t rs = a.get_row_stride();
+            const std::ptrdiff_t cs = a.get_column_stride();
+            Disks<T> disks{std::numeric_limits<T>::max(),
+                           std::numeric_limits<T>::lowest(),
+                           std::numeric_limits<T>::max()};
+            for (size_t i = 0; i < n; ++i) {
+              const T center = data[i * rs + i * cs];
+              T radius = 0;
+              for (size_t j = 0; j < n; ++j) {
+                radius += j == i ? T(0) : std::abs(data[i * rs + j * cs]);
+              }
+              disks.lower = std::min(disks.lower, center - radius);
+              disks.upper = std::max(disks.upper, center + radius);
+              disks.gap = std::min(disks.gap,
+                                   std::max(std::abs(center) - radius, T(0)));
+            }
+            return disks;
+          }
+
+          // Newton-Schulz steps needed to bring eigenvalues spread over
+          // [lower, upper] to convergence, when the small ones grow by
+          // growth per step before the quadratic phase sets in.
+          template <typename T>
+          double estimate_iterations(T lower, T upper, double growth) {
+            if (!(lower > T(0))) {
+              return std::numeric_limits<double>::infinity();
+            }
+            return std::ceil(std::log(std::max(upper / lower, T(1))) /
+                             std::log(growth)) +
+                   5;
+          }
+
+          template <typename T> bool is_symmetric(const MatrixBase<T> &a) {
+            Pointer<T> temp;
+            const MatrixBase<T> *src = &a;
+            if (!is_strided(a)) {
+              temp = to_strided(a);
+              src = temp.get();
+            }
+            const size_t n = a.get_num_rows();
+            const T *data = src->data();
+            const std::ptrdiff_t rs = src->get_row_stride();
+            const std::ptrdiff_t cs = src->get_column_stride();
+            for (size_t i = 0; i < n; ++i) {
+              for (size_t j = 0; j < i; ++j) {
+                const T x = data[i * rs + j * cs], y = data[j * rs + i * cs];
+                if (std::abs(x - y) >
+                    16 * epsilon<T>() * (std::abs(x) + std::abs(y))) {
+                  return false;
+                }
+              }
+            }
+            return true;
+          }
+
+          template <typename T>
+          Pointer<T> multiply(const MatrixBase<T> &a, const MatrixBase<T> &b) {
+            return Dispatcher<T>::multiply(a, b);
+          }
+
+          // y += alpha x, keeping the backend of y.
+          template <typename T>
+          void axpy(MatrixBase<T> &y, T alpha, const MatrixBase<T> &x) {
+            if (is_strided(y) && is_strided(x)) {
+              add_assign(y, alpha * lazy(x));
+              return;
+            }
+            Pointer<T> temp = x.copy();
+            *temp *= alpha;
+            y += *temp;
+          }
+
+          // Frobenius norm of I - p.
+          template <typename T>
+          T distance_from_identity(const MatrixBase<T> &p) {
+            Pointer<T> temp = p.copy();
+            *temp *= T(-1);
+            temp->add_to_diagonal(T(1));
+            return temp->get_frobenius_norm();
+          }
+
+          // Tracks the residual of a quadratically convergent iteration.
+          // Returns true once it is below the rounding level or has stopped
+          // decreasing inside the region of convergence; a residual that
+          // stops decreasing outside it means the function is not defined
+          // for the operand, reported by throwing domain_error(what).
+          template <typename T> class Convergence {
+            T tolerance;
+            T previous = std::numeric_limits<T>::infinity();
+            size_t iteration = 0;
+            const char *what;
+
+          public:
+            Convergence(size_t n, const char *what)
+                : tolerance(16 * epsilon<T>() * std::sqrt(T(n))), what(what) {}
+            bool done(T residual) {
+              if (residual <= tolerance) {
+                return true;
+              }
+              if (!(residual < previous)) {
+                if (residual < T(1)) {
+                  return true;
+                }
+                throw std::domain_error(what);
+              }
+              if (++iteration == max_iterations) {
+                throw std::runtime_error(
+                    "Newton-Schulz iteration did not converge");
+              }
+              previous = residual;
+              return false;
+            }
+          };
+
+          // Coupled Newton-Schulz iteration
+          //   Y <- Y (3 I - Z Y) / 2,  Z <- (3 I - Z Y) Z / 2
+          // from Y = a / scale and Z = I, which converges to
+          // Y = (a / scale)^1/2 and Z = (a / scale)^-1/2 for every scale
+          // above the largest eigenvalue. Three products per step.
+          //
+          // Zero eigenvalues stay zero in Y while Z grows without bound
+          // along them, so I - Z Y stalls at one or more. With semidefinite
+          // set, Y is then taken as converged once Y (I - Z Y) is at the
+          // rounding level; Z is meaningless in that case.
+          template <typename T>
+          std::pair<Pointer<T>, Pointer<T>>
+          newton_schulz_root(const MatrixBase<T> &a, T scale,
+                             bool semidefinite) {
+            const size_t n = a.get_num_rows();
+            const T stationary = 16 * epsilon<T>() * T(n);
+            Pointer<T> y = a.copy();
+            *y *= T(1) / scale;
+            // The first step, with Z = I, needs a single product.
+            Pointer<T> z = y->copy();
+            Pointer<T> square = multiply(*y, *y);
+            *y *= T(1.5);
+            axpy(*y, T(-0.5), *square);
+            *z *= T(-0.5);
+            z->add_to_diagonal(T(1.5));
+            Convergence<T> convergence(
+                n, semidefinite ? "matrix is not positive semidefinite"
+                                : "matrix is not positive definite");
+            for (;;) {
+              Pointer<T> p = multiply(*z, *y);
+              Pointer<T> yp;
+              const T residual = distance_from_identity(*p);
+              if (semidefinite && residual >= T(1)) {
+                yp = multiply(*y, *p);
+                Pointer<T> step = y->copy();
+                axpy(*step, T(-1), *yp);
+                if (step->get_frobenius_norm() <=
+                    stationary * y->get_frobenius_norm()) {
+                  break;
+                }
+              }
+              if (convergence.done(residual)) {
+                break;
+              }
+              if (!yp) {
+                yp = multiply(*y, *p);
+              }
+              Pointer<T> pz = multiply(*p, *z);
+              *y *= T(1.5);
+              axpy(*y, T(-0.5), *yp);
+              *z *= T(1.5);
+              axpy(*z, T(-0.5), *pz);
+            }
+            return std::make_pair(std::move(y), std::move(z));
+          }
+
+          // X <- X (3 I - X^2) / 2 from X = a / scale, for scale above the
+          // largest absolute eigenvalue. Two products per step.
+          template <typename T>
+          Pointer<T> newton_schulz_sign(const MatrixBase<T> &a, T scale) {
+            Pointer<T> x = a.copy();
+            *x *= T(1) / scale;
+            Convergence<T> convergence(a.get_num_rows(), "matrix is singular");
+            for (;;) {
+              Pointer<T> square = multiply(*x, *x);
+              if (convergence.done(distance_from_identity(*square))) {
+                break;
+              }
+              Pointer<T> cube = multiply(*x, *square);
+              *x *= T(1.5);
+              axpy(*x, T(-0.5), *cube);
+            }
+            return x;
+          }
+
+          // Halvings that bring a norm within the Taylor radius.
+          template <typename T> size_t count_squarings(T norm) {
+            return norm > T(taylor_radius)
+                       ? static_cast<size_t>(
+                             std::ceil(std::log2(norm / T(taylor_radius))))
+                       : 0;
+          }
+
+          // exp(a) by scaling and squaring. The degree 15 Taylor polynomial
+          // in B = a / 2^s is summed Paterson-Stockmeyer style, as a cubic
+          // in B with B^4 as the Horner variable: six products, followed by
+          // s squarings.
+          template <typename T>
+          Pointer<T> taylor_exponential(const MatrixBase<T> &a) {
+            const size_t s = count_squarings(a.get_frobenius_norm());
+            Pointer<T> b = a.copy();
+            *b *= std::ldexp(T(1), -static_cast<int>(s));
+            Pointer<T> b2 = multiply(*b, *b);
+            Pointer<T> b3 = multiply(*b2, *b), b4 = multiply(*b2, *b2);
+            T c[taylor_degree + 1] = {T(1)};
+            for (size_t k = 1; k <= taylor_degree; ++k) {
+              c[k] = c[k - 1] / T(k);
+            }
+            auto chunk = [&](size_t j) {
+              Pointer<T> p = b->copy();
+              *p *= c[4 * j + 1];
+              axpy(*p, c[4 * j + 2], *b2);
+              axpy(*p, c[4 * j + 3], *b3);
+              p->add_to_diagonal(c[4 * j]);
+              return p;
+            };
+            Pointer<T> result = chunk(3);
+            for (size_t j = 3; j-- > 0;) {
+              Pointer<T> next = multiply(*result, *b4);
+              axpy(*next, T(1), *chunk(j));
+              result = std::move(next);
+            }
+            for (size_t i = 0; i < s; ++i) {
+              result = multiply(*result, *result);
+            }
+            return result;
+          }
+
+          template <typename T>
+          Pointer<T> identity_like(const MatrixBase<T> &a) {
+            Pointer<T> result = a.copy();
+            *result *= T(0);
+            result->add_to_diagonal(T(1));
+            return result;
+          }
+
+          // a^p by binary powering.
+          template <typename T>
+          Pointer<T> integer_power(const MatrixBase<T> &a, size_t p) {
+            Pointer<T> result, square;
+            const MatrixBase<T> *base = &a;
+            for (; p > 0; p >>= 1) {
+              if (p & 1) {
+                result = result ? multiply(*result, *base) : base->copy();
+              }
+              if (p > 1) {
+                square = multiply(*base, *base);
+                base = square.get();
+              }
+            }
+            return result ? std::move(result) : identity_like(a);
+          }
+
+          inline double count_power_products(size_t p) {
+            double count = 0;
+            for (; p > 1; p >>= 1) {
+              count += (p & 1) ? 2 : 1;
+            }
+            return count;
+          }
+
+          // V f(L) V^T from an eigensystem of all pairs.
+          template <typename T, typename F>
+          Matrix<T> reconstruct(const Eigensystem<T> &e, F f) {
+            const size_t n = e.values.size();
+            const MatrixBase<T> &v = e.vectors.get_base();
+            const std::ptrdiff_t rsv = v.get_row_stride();
+            const std::ptrdiff_t csv = v.get_column_stride();
+            std::vector<T> fv(n);
+            for (size_t j = 0; j < n; ++j) {
+              fv[j] = f(e.values[j]);
+            }
+            MatrixVector<T> w(n, n);
+            for (size_t i = 0; i < n; ++i) {
+              for (size_t j = 0; j < n; ++j) {
+                w(i, j) = v.data()[i * rsv + j * csv] * fv[j];
+              }
+            }
+            Pointer<T> result(new MatrixVector<T>(n, n));
+            gemm<T>(n, n, n, T(1), w.data(), w.get_row_stride(), 1, v.data(),
+                    csv, rsv, T(0), result->data(), result->get_row_stride(),
+                    1);
+            return Matrix<T>(std::move(result));
+          }
+
+          // Eigenvalues within this distance of zero are treated as zero.
+          template <typename T> T get_zero_level(const Eigensystem<T> &e) {
+            T largest = 0;
+            for (T x : e.values) {
+              largest = std::max(largest, std::abs(x));
+            }
+            return T(e.values.size()) * epsilon<T>() * largest;
+          }
+
+          template <typename T>
+          FunctionMethod resolve(FunctionMethod method,
+                                 const MatrixBase<T> &a, double num_gemms) {
+            if (method != FunctionMethod::automatic) {
+              return method;
+            }
+            return prefer_iterative(a, num_gemms) ? FunctionMethod::iterative
+                                                  : FunctionMethod::spectral;
+          }
+
+          // Products a square root iteration on a is expected to take.
+          template <typename T>
+          double count_root_products(const MatrixBase<T> &a) {
+            if (!is_strided(a)) {
+              return 0;
+            }
+            const auto disks = gershgorin(a);
+            return 3 * estimate_iterations(disks.lower, disks.upper, 2.25) - 2;
+          }
+
+          // Scale for the Newton-Schulz iterations: an upper bound on the
+          // absolute eigenvalues, the tighter of the Frobenius norm and the
+          // Gershgorin bound when that is available.
+          template <typename T> T get_scale(const MatrixBase<T> &a) {
+            T scale = a.get_frobenius_norm();
+            if (is_strided(a)) {
+              const auto disks = gershgorin(a);
+              scale = std::min(scale, std::max(std::abs(disks.lower),
+                                               std::abs(disks.upper)));
+            }
+            return scale;
+          }
+        }
+      }
+
+      // f(a) = V f(L) V^T for the symmetric a = V L V^T; only the lower
+      // triangle of a is read.
+      template <typename T, typename F>
+      Matrix<T> apply_function(const MatrixBase<T> &a, F f) {
+        return kernel::function::reconstruct(diagonalize(a), f);
+      }
+      template <typename T, typename F>
+      Matrix<T> apply_function(const Matrix<T> &a, F f) {
+        return apply_function(a.get_base(), f);
+      }
+
+      // Principal square root of a symmetric positive semidefinite matrix.
+      // Eigenvalues below zero by no more than the rounding level stall the
+      // iteration like truly negative ones, so when it stalls the
+      // eigendecomposition decides, and the result is then dense.
+      template <typename T>
+      Matrix<T> square_root(const MatrixBase<T> &a,
+                            FunctionMethod method = FunctionMethod::automatic) {
+        namespace function = kernel::function;
+        kernel::check_square(a);
+        method = function::resolve(method, a, function::count_root_products(a));
+        if (method == FunctionMethod::spectral) {
+          const auto e = diagonalize(a);
+          const T zero = function::get_zero_level(e);
+          return function::reconstruct(e, [zero](T x) {
+            if (x < -zero) {
+              throw std::domain_error("matrix is not positive semidefinite");
+            }
+            return std::sqrt(std::max(x, T(0)));
+          });
+        }
+        const T scale = function::get_scale(a);
+        if (scale == T(0)) {
+          return Matrix<T>(a.copy());
+        }
+        try {
+          auto roots = function::newton_schulz_root(a, scale, true);
+          *roots.first *= std::sqrt(scale);
+          return Matrix<T>(std::move(roots.first));
+        } catch (const std::domain_error &) {
+          return square_root(a, FunctionMethod::spectral);
+        }
+      }
+      template <typename T>
+      Matrix<T> square_root(const Matrix<T> &a,
+                            FunctionMethod method = FunctionMethod::automatic) {
+        return square_root(a.get_base(), method);
+      }
+
+      // a^-1/2 of a symmetric positive definite matrix, e.g. the symmetric
+      // orthogonalizer S^-1/2 of an overlap matrix.
+      template <typename T>
+      Matrix<T>
+      inverse_square_root(const MatrixBase<T> &a,
+                          FunctionMethod method = FunctionMethod::automatic) {
+        namespace function = kernel::function;
+        kernel::check_square(a);
+        method = function::resolve(method, a, function::count_root_products(a));
+        if (method == FunctionMethod::spectral) {
+          const auto e = diagonalize(a);
+          const T zero = function::get_zero_level(e);
+          return function::reconstruct(e, [zero](T x) {
+            if (x <= zero) {
+              throw std::domain_error("matrix is not positive definite");
+            }
+            return T(1) / std::sqrt(x);
+          });
+        }
+        const T scale = function::get_scale(a);
+        if (scale == T(0)) {
+          throw std::domain_error("matrix is not positive definite");
+        }
+        auto roots = function::newton_schulz_root(a, scale, false);
+        *roots.second *= T(1) / std::sqrt(scale);
+        return Matrix<T>(std::move(roots.second));
+      }
+      template <typename T>
+      Matrix<T>
+      inverse_square_root(const Matrix<T> &a,
+                          FunctionMethod method = FunctionMethod::automatic) {
+        return inverse_square_root(a.get_base(), method);
+      }
+
+      // Matrix sign function of a symmetric nonsingular matrix: the
+      // eigenvalues are replaced by their signs, as in density matrix
+      // purification, where P = (I - sign(H - mu I)) / 2.
+      template <typename T>
+      Matrix<T> sign(const MatrixBase<T> &a,
+                     FunctionMethod method = FunctionMethod::automatic) {
+        namespace function = kernel::function;
+        kernel::check_square(a);
+        double num_gemms = 0;
+        if (kernel::is_strided(a)) {
+          const auto disks = function::gershgorin(a);
+          num_gemms = 2 * function::estimate_iterations(
+                              disks.gap, function::get_scale(a), 1.5);
+        }
+        method = function::resolve(method, a, num_gemms);
+        if (method == FunctionMethod::spectral) {
+          const auto e = diagonalize(a);
+          const T zero = function::get_zero_level(e);
+          return function::reconstruct(e, [zero](T x) {
+            if (std::abs(x) <= zero) {
+              throw std::domain_error("matrix is singular");
+            }
+            return x > T(0) ? T(1) : T(-1);
+          });
+        }
+        const T scale = function::get_scale(a);
+        if (scale == T(0)) {
+          throw std::domain_error("matrix is singular");
+        }
+        return Matrix<T>(function::newton_schulz_sign(a, scale));
+      }
+      template <typename T>
+      Matrix<T> sign(const Matrix<T> &a,
+                     FunctionMethod method = FunctionMethod::automatic) {
+        return sign(a.get_base(), method);
+      }
+
+      // Matrix exponential. The iterative form takes any square matrix, e.g.
+      // the antisymmetric generator of an orbital rotation; the spectral one
+      // needs a symmetric matrix.
+      template <typename T>
+      Matrix<T> exponential(const MatrixBase<T> &a,
+                            FunctionMethod method = FunctionMethod::automatic) {
+        namespace function = kernel::function;
+        kernel::check_square(a);
+        const bool may_diagonalize =
+            method == FunctionMethod::spectral ||
+            (method == FunctionMethod::automatic && kernel::is_strided(a));
+        if (may_diagonalize && !function::is_symmetric(a)) {
+          if (method == FunctionMethod::spectral) {
+            throw std::invalid_argument("matrix is not symmetric");
+          }
+          method = FunctionMethod::iterative;
+        }
+        method = function::resolve(
+            method, a,
+            6 + function::count_squarings(a.get_frobenius_norm()));
+        if (method == FunctionMethod::spectral) {
+          return apply_function(a, [](T x) { return std::exp(x); });
+        }
+        return Matrix<T>(function::taylor_exponential(a));
+      }
+      template <typename T>
+      Matrix<T> exponential(const Matrix<T> &a,
+                            FunctionMethod method = FunctionMethod::automatic) {
+        return exponential(a.get_base(), method);
+      }
+
+      // a^p of a symmetric matrix. Exponents of +-1/2 go through the square
+      // root iterations and non-negative integers through repeated
+      // squaring; any other exponent needs the eigendecomposition and a
+      // positive semidefinite a unless it is an integer.
+      template <typename T>
+      Matrix<T> power(const MatrixBase<T> &a, T p,
+                      FunctionMethod method = FunctionMethod::automatic) {
+        namespace function = kernel::function;
+        kernel::check_square(a);
+        if (p == T(0.5)) {
+          return square_root(a, method);
+        }
+        if (p == T(-0.5)) {
+          return inverse_square_root(a, method);
+        }
+        const bool integral = std::floor(p) == p;
+        if (integral && p >= T(0)) {
+          const size_t q = static_cast<size_t>(p);
+          method =
+              function::resolve(method, a, function::count_power_products(q));
+          if (method == FunctionMethod::iterative) {
+            return Matrix<T>(function::integer_power(a, q));
+          }
+        } else if (method == FunctionMethod::iterative) {
+          throw std::invalid_argument("exponent has no iterative form");
+        }
+        const auto e = diagonalize(a);
+        const T zero = function::get_zero_level(e);
+        return function::reconstruct(e, [=](T x) {
+          if (!integral && x < -zero) {
+            throw std::domain_error("matrix is not positive semidefinite");
+          }
+          if (p < T(0) && std::abs(x) <= zero) {
+            throw std::domain_error("matrix is singular");
+          }
+          return std::pow(integral ? x : std::max(x, T(0)), p);
+        });
+      }
+      template <typename T>
+      Matrix<T> power(const Matrix<T> &a, T p,
+                      FunctionMethod method = FunctionMethod::automatic) {
+        return power(a.get_base(), p, method);
+      }
+    }
+  }
+}
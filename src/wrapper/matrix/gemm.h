@@ -0,0 +1,268 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+#include "wrapper/matrix/base.h"
+#include "wrapper/thread/pool.h"
+
+namespace ketcpp {
+  namespace wrapper {
+    namespace matrix {
+      namespace kernel {
+        // Register tile (mr x nr) and cache block (mc x kc of A in L2,
+        // kc x nr sliver of B in L1) sizes.
+        template <typename T> struct GemmBlocking {
+          constexpr static size_t mr = 4;
+          constexpr static size_t nr = sizeof(T) >= 8 ? 8 : 16;
+          constexpr static size_t kc = 256;
+          constexpr static size_t mc = sizeof(T) >= 8 ? 96 : 192;
+          constexpr static size_t nc = 2048;
+          // Below this many multiply-adds packing costs more than it saves.
+          constexpr static size_t small = 32 * 32 * 32;
+          // Below this many multiply-adds the product stays on one thread.
+          constexpr static size_t parallel = 96 * 96 * 96;
+          // Smallest slice of C handed to a thread; each slice packs its own
+          // copy of B (or A), so slices must be tall (or wide) enough to
+          // amortize it.
+          constexpr static size_t slice_rows = 8 * mr;
+          constexpr static size_t slice_columns = 8 * nr;
+        };
+
+        template <typename T, size_t mr>
+        void pack_a(size_t mc, size_t kc, const T *a, std::ptrdiff_t rsa,
+                    std::ptrdiff_t csa, T *buf) {
+          for (size_t ir = 0; ir < mc; ir += mr) {
+            const size_t rows = std::min(mr, mc - ir);
+            for (size_t p = 0; p < kc; ++p) {
+              const T *src = a + ir * rsa + p * csa;
+              for (size_t i = 0; i < rows; ++i) {
+                *buf++ = src[i * rsa];
+              }
+              for (size_t i = rows; i < mr; ++i) {
+                *buf++ = T(0);
+              }
+            }
+          }
+        }
+
+        template <typename T, size_t nr>
+        void pack_b(size_t kc, size_t nc, const T *b, std::ptrdiff_t rsb,
+                    std::ptrdiff_t csb, T *buf) {
+          for (size_t jr = 0; jr < nc; jr += nr) {
+            const size_t columns = std::min(nr, nc - jr);
+            for (size_t p = 0; p < kc; ++p) {
+              const T *src = b + p * rsb + jr * csb;
+              for (size_t j = 0; j < columns; ++j) {
+                *buf++ = src[j * csb];
+              }
+              for (size_t j = columns; j < nr; ++j) {
+                *buf++ = T(0);
+              }
+            }
+          }
+        }
+
+        // C(m x n) = beta * C + alpha * A_panel * B_panel on one register
+        // tile; m and n are smaller than mr and nr on the fringe.
+        template <typename T, size_t mr, size_t nr>
+        void micro_kernel(size_t kc, T alpha, const T *a, const T *b, T beta,
+                          T *c, std::ptrdiff_t rsc, std::ptrdiff_t csc,
+                          size_t m, size_t n) {
+          T ab[mr * nr] = {};
+          for (size_t p = 0; p < kc; ++p, a += mr, b += nr) {
+            for (size_t i = 0; i < mr; ++i) {
+              const T ai = a[i];
+              for (size_t j = 0; j < nr; ++j) {
+                ab[i * nr + j] += ai * b[j];
+              }
+            }
+          }
+          for (size_t i = 0; i < m; ++i) {
+            for (size_t j = 0; j < n; ++j) {
+              T &cij = c[i * rsc + j * csc];
+              cij = (beta == T(0) ? T(0) : beta * cij) + alpha * ab[i * nr + j];
+            }
+          }
+        }
+
+        template <typename T>
+        void scale(size_t m, size_t n, T beta, T *c, std::ptrdiff_t rsc,
+                   std::ptrdiff_t csc) {
+          for (size_t i = 0; i < m; ++i) {
+            for (size_t j = 0; j < n; ++j) {
+              T &cij = c[i * rsc + j * csc];
+              cij = beta == T(0) ? T(0) : beta * cij;
+            }
+          }
+        }
+
+        template <typename T>
+        void gemm_small(size_t m, size_t n, size_t k, T alpha, const T *a,
+                        std::ptrdiff_t rsa, std::ptrdiff_t csa, const T *b,
+                        std::ptrdiff_t rsb, std::ptrdiff_t csb, T beta, T *c,
+                        std::ptrdiff_t rsc, std::ptrdiff_t csc) {
+          if (csa == 1 && rsb == 1 && csb != 1) {
+            // B is transposed: rows of A and columns of B are both
+            // contiguous, so each element of C is one unit-stride dot
+            // product.
+            for (size_t i = 0; i < m; ++i) {
+              for (size_t j = 0; j < n; ++j) {
+                const T *ai = a + i * rsa, *bj = b + j * csb;
+                T sum = T(0);
+                for (size_t p = 0; p < k; ++p) {
+                  sum += ai[p] * bj[p];
+                }
+                T &cij = c[i * rsc + j * csc];
+                cij = (beta == T(0) ? T(0) : beta * cij) + alpha * sum;
+              }
+            }
+            return;
+          }
+          scale(m, n, beta, c, rsc, csc);
+          for (size_t i = 0; i < m; ++i) {
+            for (size_t p = 0; p < k; ++p) {
+              const T aip = alpha * a[i * rsa + p * csa];
+              for (size_t j = 0; j < n; ++j) {
+                c[i * rsc + j * csc] += aip * b[p * rsb + j * csb];
+              }
+            }
+          }
+        }
+
+        template <typename T>
+        void gemm_blocked(size_t m, size_t n, size_t k, T alpha, const T *a,
+                          std::ptrdiff_t rsa, std::ptrdiff_t csa, const T *b,
+                          std::ptrdiff_t rsb, std::ptrdiff_t csb, T beta, T *c,
+                          std::ptrdiff_t rsc, std::ptrdiff_t csc) {
+          using blocking = kernel::GemmBlocking<T>;
+          constexpr size_t mr = blocking::mr, nr = blocking::nr;
+          constexpr size_t mc = blocking::mc, kc = blocking::kc;
+          constexpr size_t nc = blocking::nc;
+          std::vector<T> a_buf(mc * kc);
+          std::vector<T> b_buf(kc * ((std::min(nc, n) + nr - 1) / nr * nr));
+          for (size_t jc = 0; jc < n; jc += nc) {
+            const size_t nb = std::min(nc, n - jc);
+            for (size_t pc = 0; pc < k; pc += kc) {
+              const size_t kb = std::min(kc, k - pc);
+              const T beta_block = pc == 0 ? beta : T(1);
+              kernel::pack_b<T, nr>(kb, nb, b + pc * rsb + jc * csb, rsb, csb,
+                                    b_buf.data());
+              for (size_t ic = 0; ic < m; ic += mc) {
+                const size_t mb = std::min(mc, m - ic);
+                kernel::pack_a<T, mr>(mb, kb, a + ic * rsa + pc * csa, rsa, csa,
+                                      a_buf.data());
+                for (size_t jr = 0; jr < nb; jr += nr) {
+                  for (size_t ir = 0; ir < mb; ir += mr) {
+                    kernel::micro_kernel<T, mr, nr>(
+                        kb, alpha, a_buf.data() + ir * kb,
+                        b_buf.data() + jr * kb, beta_block,
+                        c + (ic + ir) * rsc + (jc + jr) * csc, rsc, csc,
+                        std::min(mr, mb - ir), std::min(nr, nb - jr));
+                  }
+                }
+              }
+            }
+          }
+        }
+      }
+
+      // General strided GEMM: C = alpha * A * B + beta * C, where A is m x k,
+      // B is k x n and C is m x n. Each operand is addressed as
+      // ptr[i * row_stride + j * column_stride], so transposed and
+      // column-major operands are handled by swapping strides. When beta is
+      // zero C is not read. Large products are split into row (or column)
+      // slices of C computed on the thread pool.
+      template <typename T>
+      void gemm(size_t m, size_t n, size_t k, T alpha, const T *a,
+                std::ptrdiff_t rsa, std::ptrdiff_t csa, const T *b,
+                std::ptrdiff_t rsb, std::ptrdiff_t csb, T beta, T *c,
+                std::ptrdiff_t rsc, std::ptrdiff_t csc) {
+        using blocking = kernel::GemmBlocking<T>;
+        if (m == 0 || n == 0) {
+          return;
+        }
+        if (k == 0 || alpha == T(0)) {
+          kernel::scale(m, n, beta, c, rsc, csc);
+          return;
+        }
+        if (rsc == 1 && csc != 1) {
+          // C is stored by columns (e.g. a transposed view): compute
+          // C^T = B^T * A^T instead, so that the kernels below write along
+          // contiguous rows.
+          gemm<T>(n, m, k, alpha, b, csb, rsb, a, csa, rsa, beta, c, csc, rsc);
+          return;
+        }
+        if (m * n * k <= blocking::small) {
+          kernel::gemm_small(m, n, k, alpha, a, rsa, csa, b, rsb, csb, beta, c,
+                             rsc, csc);
+          return;
+        }
+        if (m * n * k <= blocking::parallel) {
+          kernel::gemm_blocked(m, n, k, alpha, a, rsa, csa, b, rsb, csb, beta,
+                               c, rsc, csc);
+          return;
+        }
+        if (m >= n) {
+          thread::parallel_for(
+              0, m, blocking::slice_rows, [=](size_t first, size_t last) {
+                kernel::gemm_blocked(last - first, n, k, alpha, a + first * rsa,
+                                     rsa, csa, b, rsb, csb, beta,
+                                     c + first * rsc, rsc, csc);
+              });
+        } else {
+          thread::parallel_for(
+              0, n, blocking::slice_columns, [=](size_t first, size_t last) {
+                kernel::gemm_blocked(m, last - first, k, alpha, a, rsa, csa,
+                                     b + first * csb, rsb, csb, beta,
+                                     c + first * csc, rsc, csc);
+              });
+        }
+      }
+
+      // Row-major convenience form with leading dimensions.
+      template <typename T>
+      void gemm(size_t m, size_t n, size_t k, T alpha, const T *a, size_t lda,
+                const T *b, size_t ldb, T beta, T *c, size_t ldc) {
+        gemm<T>(m, n, k, alpha, a, lda, 1, b, ldb, 1, beta, c, ldc, 1);
+      }
+
+      // C = alpha * A * B + beta * C on backends exposing strided storage
+      // through MatrixBase::data().
+      template <typename T>
+      void gemm(T alpha, const MatrixBase<T> &a, const MatrixBase<T> &b, T beta,
+                MatrixBase<T> &c) {
+        if (a.get_num_columns() != b.get_num_rows() ||
+            a.get_num_rows() != c.get_num_rows() ||
+            b.get_num_columns() != c.get_num_columns()) {
+          throw std::invalid_argument("matrix shapes do not match");
+        }
+        gemm<T>(a.get_num_rows(), b.get_num_columns(), a.get_num_columns(),
+                alpha, a.data(), a.get_row_stride(), a.get_column_stride(),
+                b.data(), b.get_row_stride(), b.get_column_stride(), beta,
+                c.data(), c.get_row_stride(), c.get_column_stride());
+      }
+    }
+  }
+}
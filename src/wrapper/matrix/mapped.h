@@ -0,0 +1,363 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <typeinfo>
+
+#include "wrapper/matrix/base.h"
+#include "wrapper/matrix/dispatch.h"
+#include "wrapper/matrix/gemm.h"
+#include "wrapper/matrix/parallel.h"
+#include "wrapper/matrix/range.h"
+#include "wrapper/matrix/vector.h"
+#include "wrapper/memory/mapped.h"
+
+namespace ketcpp {
+  namespace wrapper {
+    namespace matrix {
+      // Row-major matrix kept in a memory-mapped file, for intermediates too
+      // large to stay resident. Pages are read in on first touch and may be
+      // evicted by the kernel; advise() and advise_tile() tell it which
+      // parts are about to be used or are done with.
+      template <typename T>
+      class MatrixMapped : public MatrixBase<T>,
+                           public StridedMatrix<MatrixMapped<T>, T> {
+      private:
+        size_t num_rows;
+        size_t num_columns;
+        memory::MappedFile file;
+        // Bytes before element (0, 0) in the file.
+        size_t offset;
+
+      public:
+        // Working set of one operand panel in gemm_streamed.
+        constexpr static size_t default_tile_bytes = size_t(64) << 20;
+
+        size_t get_num_rows() const { return num_rows; }
+        size_t get_num_columns() const { return num_columns; }
+        size_t get_row_size() const { return num_columns; }
+        size_t get_column_size() const { return num_rows; }
+        T *data() {
+          return reinterpret_cast<T *>(static_cast<char *>(file.data()) +
+                                       offset);
+        }
+        const T *data() const {
+          return reinterpret_cast<const T *>(
+              static_cast<const char *>(file.data()) + offset);
+        }
+        std::ptrdiff_t get_row_stride() const { return num_columns; }
+
+        // Hints for rows [first, last).
+        void advise_rows(size_t first, size_t last,
+                         memory::Advice advice) const {
+          const size_t row_bytes = num_columns * sizeof(T);
+          file.advise(offset + first * row_bytes, (last - first) * row_bytes,
+                      advice);
+        }
+        // Hints for the m x n tile at (i, j). Rows shorter than a few pages
+        // are hinted as a whole.
+        void advise_tile(size_t i, size_t j, size_t m, size_t n,
+                         memory::Advice advice) const {
+          const size_t row_bytes = num_columns * sizeof(T);
+          if (n == num_columns || row_bytes < 4 * 4096) {
+            advise_rows(i, i + m, advice);
+            return;
+          }
+          for (size_t r = i; r < i + m; ++r) {
+            file.advise(offset + (r * num_columns + j) * sizeof(T),
+                        n * sizeof(T), advice);
+          }
+        }
+        void advise(memory::Advice advice) const {
+          advise_rows(0, num_rows, advice);
+        }
+        void sync() const { file.sync(); }
+
+      private:
+        using Base = MatrixBase<T>;
+        typedef typename Base::RowVectorIterator RowVectorIterator;
+        typedef typename Base::RowElementIterator RowElementIterator;
+        typedef typename Base::ColumnVectorIterator ColumnVectorIterator;
+        typedef typename Base::ColumnElementIterator ColumnElementIterator;
+        typedef typename Base::RowVectorConstIterator RowVectorConstIterator;
+        typedef typename Base::RowElementConstIterator RowElementConstIterator;
+        typedef
+            typename Base::ColumnVectorConstIterator ColumnVectorConstIterator;
+        typedef typename Base::ColumnElementConstIterator
+            ColumnElementConstIterator;
+
+        template <bool is_const>
+        class GenericIterator
+            : public Base::template BaseGenericIterator<is_const> {
+          using BaseIterator =
+              typename Base::template BaseGenericIterator<is_const>;
+          using unique_ptr = std::unique_ptr<BaseIterator>;
+          typename std::conditional<is_const, const T *, T *>::type iterator;
+          const size_t num_rows;
+          const size_t num_columns;
+
+          unique_ptr make(decltype(iterator) p) const {
+            return std::make_unique<GenericIterator>(p, num_rows, num_columns);
+          }
+
+        protected:
+          void advance_in_column() { this->iterator += num_columns; }
+          void advance_in_row() { this->iterator++; }
+          unique_ptr row_begin() { return make(iterator); }
+          unique_ptr row_end() { return make(iterator + num_columns); }
+          unique_ptr column_begin() { return make(iterator); }
+          unique_ptr column_end() {
+            return make(iterator + num_rows * num_columns);
+          }
+          unique_ptr copy() { return make(iterator); }
+          bool operator==(BaseIterator &rhs) const throw(std::bad_cast &) {
+            auto &rhs_cast = dynamic_cast<decltype(*this)>(rhs);
+            return this->iterator == rhs_cast.iterator;
+          }
+          bool operator!=(BaseIterator &rhs) const throw(std::bad_cast &) {
+            auto &rhs_cast = dynamic_cast<decltype(*this)>(rhs);
+            return this->iterator != rhs_cast.iterator;
+          }
+          typename BaseIterator::difference_type
+          operator-(const BaseIterator &rhs) const throw(std::bad_cast &) {
+            auto &rhs_cast = dynamic_cast<decltype(*this)>(rhs);
+            return this->iterator - rhs_cast.iterator;
+          }
+          typename std::conditional<is_const, const T &, T &>::type
+          operator*() {
+            return *iterator;
+          }
+
+        public:
+          GenericIterator(decltype(iterator) src, size_t num_rows,
+                          size_t num_columns)
+              : iterator(src), num_rows(num_rows), num_columns(num_columns) {}
+        };
+        using Iterator = GenericIterator<false>;
+        using ConstIterator = GenericIterator<true>;
+
+      protected:
+        RowVectorConstIterator row_cbegin() const {
+          return RowVectorConstIterator(
+              std::make_unique<ConstIterator>(data(), num_rows, num_columns));
+        }
+        RowVectorConstIterator row_cend() const {
+          return RowVectorConstIterator(std::make_unique<ConstIterator>(
+              data() + num_rows * num_columns, num_rows, num_columns));
+        }
+        ColumnVectorConstIterator column_cbegin() const {
+          return ColumnVectorConstIterator(
+              std::make_unique<ConstIterator>(data(), num_rows, num_columns));
+        }
+        ColumnVectorConstIterator column_cend() const {
+          return ColumnVectorConstIterator(std::make_unique<ConstIterator>(
+              data() + num_columns, num_rows, num_columns));
+        }
+        RowVectorIterator row_begin() {
+          return RowVectorIterator(
+              std::make_unique<Iterator>(data(), num_rows, num_columns));
+        }
+        RowVectorIterator row_end() {
+          return RowVectorIterator(std::make_unique<Iterator>(
+              data() + num_rows * num_columns, num_rows, num_columns));
+        }
+        ColumnVectorIterator column_begin() {
+          return ColumnVectorIterator(
+              std::make_unique<Iterator>(data(), num_rows, num_columns));
+        }
+        ColumnVectorIterator column_end() {
+          return ColumnVectorIterator(std::make_unique<Iterator>(
+              data() + num_columns, num_rows, num_columns));
+        }
+
+      private:
+        static void hint(const Base &matrix, size_t first, size_t last,
+                         memory::Advice advice) {
+          if (typeid(matrix) == typeid(MatrixMapped)) {
+            static_cast<const MatrixMapped &>(matrix).advise_rows(first, last,
+                                                                  advice);
+          }
+        }
+
+        // Products involving a mapped operand are written to a new mapped
+        // matrix, since they are usually as large as the operands.
+        static std::unique_ptr<Base> multiply_streamed(const Base &lhs,
+                                                       const Base &rhs) {
+          std::unique_ptr<Base> c(
+              new MatrixMapped(lhs.get_num_rows(), rhs.get_num_columns()));
+          gemm_streamed(T(1), lhs, rhs, T(0), *c);
+          return c;
+        }
+        static bool register_kernels() {
+          auto &dispatcher = Dispatcher<T>::get_instance();
+          using Dense = MatrixVector<T>;
+          dispatcher.template define<Operation::multiply, MatrixMapped,
+                                     MatrixMapped>(multiply_streamed);
+          dispatcher.template define<Operation::multiply, MatrixMapped,
+                                     Dense>(multiply_streamed);
+          dispatcher.template define<Operation::multiply, Dense,
+                                     MatrixMapped>(multiply_streamed);
+          return true;
+        }
+        static void ensure_registered() {
+          static const bool registered = register_kernels();
+          (void)registered;
+        }
+
+      public:
+        // A zero-filled m x n matrix in a new scratch file.
+        MatrixMapped(size_t m, size_t n)
+            : num_rows(m), num_columns(n), file(m * n * sizeof(T)),
+              offset(0) {
+          ensure_registered();
+        }
+        // An m x n matrix backed by path, starting offset bytes into the
+        // file. The file is created or grown as needed and keeps the
+        // elements after the matrix is destroyed; with
+        // Sharing::private_copy it is only read, as for MappedFile. offset
+        // must be a multiple of alignof(T).
+        MatrixMapped(const std::string &path, size_t m, size_t n,
+                     size_t offset = 0,
+                     memory::Sharing sharing = memory::Sharing::shared)
+            : num_rows(m), num_columns(n),
+              file(path, offset + m * n * sizeof(T), sharing), offset(offset) {
+          ensure_registered();
+        }
+        MatrixMapped(const std::initializer_list<std::initializer_list<T>> list)
+            : MatrixMapped(list.size(),
+                           std::max_element(list.begin(), list.end(),
+                                            [](const auto &a, const auto &b) {
+                                              return a.size() < b.size();
+                                            })
+                               ->size()) {
+          T *dest = data();
+          for (auto i : list) {
+            std::copy(i.begin(), i.end(), dest);
+            dest += num_columns;
+          }
+        }
+        // Copies go to a new scratch file.
+        MatrixMapped(const MatrixMapped &src)
+            : MatrixMapped(src.num_rows, src.num_columns) {
+          std::memcpy(data(), src.data(), num_rows * num_columns * sizeof(T));
+        }
+        MatrixMapped(MatrixMapped &&src) = default;
+        MatrixMapped() = delete;
+
+        bool operator==(const MatrixMapped &rhs) const {
+          return parallel::equal(num_rows * num_columns, data(), rhs.data());
+        }
+        bool operator==(const Base &rhs) const {
+          return Dispatcher<T>::compare(*this, rhs);
+        }
+        Base &operator+=(const Base &rhs) {
+          Dispatcher<T>::add(*this, rhs);
+          return *this;
+        }
+        Base &operator*=(T rhs) {
+          KETCPP_PROFILE_UNARY(scale, *this, num_rows * num_columns,
+                               2. * num_rows * num_columns * sizeof(T), 0);
+          parallel::scale(num_rows * num_columns, rhs, data(), data());
+          return *this;
+        }
+
+        std::unique_ptr<MatrixBase<T>> copy() const {
+          KETCPP_PROFILE_UNARY(copy, *this, 0,
+                               2. * num_rows * num_columns * sizeof(T), 1);
+          std::unique_ptr<MatrixBase<T>> copy;
+          copy.reset(new MatrixMapped(*this));
+          return std::move(copy);
+        }
+
+        // C = alpha * A * B + beta * C with strided C, one panel at a
+        // time: rows of A and C are visited in tiles, and within a tile the
+        // inner dimension is split so that a panel of B stays within
+        // tile_bytes. Mapped operands are told to read ahead the panel in use
+        // and to drop what is finished, so the resident set stays near a few
+        // tiles however large the operands are.
+        static void gemm_streamed(T alpha, const Base &a, const Base &b,
+                                  T beta, Base &c,
+                                  size_t tile_bytes = default_tile_bytes) {
+          if (a.get_num_columns() != b.get_num_rows() ||
+              a.get_num_rows() != c.get_num_rows() ||
+              b.get_num_columns() != c.get_num_columns()) {
+            throw std::invalid_argument("matrix shapes do not match");
+          }
+          if (!kernel::is_strided(c)) {
+            throw std::invalid_argument("destination must be strided");
+          }
+          std::unique_ptr<Base> a_temp, b_temp;
+          if (!kernel::is_strided(a)) {
+            a_temp = kernel::to_strided(a);
+          }
+          if (!kernel::is_strided(b)) {
+            b_temp = kernel::to_strided(b);
+          }
+          const Base &a_s = a_temp ? *a_temp : a;
+          const Base &b_s = b_temp ? *b_temp : b;
+          const size_t m = c.get_num_rows(), n = c.get_num_columns();
+          const size_t k = a.get_num_columns();
+          const size_t tile = std::max<size_t>(tile_bytes / sizeof(T), 1);
+          const size_t mt = std::max<size_t>(tile / std::max<size_t>(k, 1), 1);
+          const size_t kt = std::max<size_t>(tile / std::max<size_t>(n, 1), 1);
+          // B is read once per row tile; keep it only if it fits.
+          const bool drop_b = kt < k;
+          for (size_t i0 = 0; i0 < m; i0 += mt) {
+            const size_t mb = std::min(mt, m - i0);
+            hint(a_s, i0, i0 + mb, memory::Advice::will_need);
+            hint(a_s, i0 + mb, std::min(i0 + 2 * mb, m),
+                 memory::Advice::will_need);
+            if (k == 0) {
+              kernel::scale(mb, n, beta, c.data() + i0 * c.get_row_stride(),
+                            c.get_row_stride(), c.get_column_stride());
+            }
+            for (size_t p0 = 0; p0 < k; p0 += kt) {
+              const size_t kb = std::min(kt, k - p0);
+              hint(b_s, p0, p0 + kb, memory::Advice::will_need);
+              gemm<T>(mb, n, kb, alpha,
+                      a_s.data() + i0 * a_s.get_row_stride() +
+                          p0 * a_s.get_column_stride(),
+                      a_s.get_row_stride(), a_s.get_column_stride(),
+                      b_s.data() + p0 * b_s.get_row_stride(),
+                      b_s.get_row_stride(), b_s.get_column_stride(),
+                      p0 == 0 ? beta : T(1), c.data() + i0 * c.get_row_stride(),
+                      c.get_row_stride(), c.get_column_stride());
+              if (drop_b) {
+                hint(b_s, p0, p0 + kb, memory::Advice::dont_need);
+              }
+            }
+            hint(a_s, i0, i0 + mb, memory::Advice::dont_need);
+            hint(c, i0, i0 + mb, memory::Advice::dont_need);
+          }
+        }
+
+        ~MatrixMapped() {}
+      };
+
+      template <typename T>
+      constexpr size_t MatrixMapped<T>::default_tile_bytes;
+    }
+  }
+}
@@ -22,26 +22,69 @@
 #include <memory>
 
 #include "wrapper/matrix/base.h"
+#include "wrapper/matrix/expression.h"
 
 namespace ketcpp {
   namespace wrapper {
     namespace matrix {
-      template <typename T> class Matrix {
+      template <typename T> class Matrix : public Expression<Matrix<T>> {
       private:
         using Base = MatrixBase<T>;
         using unique_ptr = std::unique_ptr<Base>;
         unique_ptr base;
 
+        bool has_shape_of(size_t m, size_t n) const {
+          return base->get_num_rows() == m && base->get_num_columns() == n;
+        }
+
       public:
+        using value_type = T;
+        using stored_type = const Matrix &;
+        constexpr static size_t num_terms = 1;
+        constexpr static size_t num_products = 0;
+
         Matrix(const Matrix &src) : base(std::move(src.base->copy())) {}
         Matrix(const Base &src) : base(std::move(src.copy())) {}
         Matrix(Matrix &&src) : base(std::move(src.base)) {}
         Matrix(std::unique_ptr<Base> &&src) : base(std::move(src)) {}
+        template <typename E>
+        Matrix(const Expression<E> &src) : base(evaluate(src)) {}
+
+        Matrix &operator=(const Matrix &rhs) {
+          return *this = static_cast<const Expression<Matrix> &>(rhs);
+        }
+        Matrix &operator=(Matrix &&rhs) {
+          base = std::move(rhs.base);
+          return *this;
+        }
+        template <typename E> Matrix &operator=(const Expression<E> &rhs) {
+          const auto &e = rhs.derived();
+          if (base && base->data() != nullptr &&
+              has_shape_of(e.get_num_rows(), e.get_num_columns())) {
+            assign(*base, e);
+          } else {
+            base = evaluate(e);
+          }
+          return *this;
+        }
 
         size_t get_num_rows() const { return base->get_num_rows(); }
         size_t get_num_columns() const { return base->get_num_columns(); }
         size_t get_row_size() const { return base->get_row_size(); }
         size_t get_column_size() const { return base->get_column_size(); }
+        T *data() { return base->data(); }
+        const T *data() const { return base->data(); }
+        // The backend holding the elements.
+        Base &get_base() { return *base; }
+        const Base &get_base() const { return *base; }
+
+        const Base *get_leaf(T &coeff) const {
+          coeff = T(1);
+          return base.get();
+        }
+        template <typename F> void for_each_term(T coeff, F &f) const {
+          f.term(coeff, *base);
+        }
 
         auto rows() { return base->rows(); }
         auto rows() const { return base->rows(); }
@@ -50,28 +93,21 @@ namespace ketcpp {
 
         bool operator==(const Matrix &rhs) const { return *base == *rhs.base; }
 
-        Matrix operator+(const Matrix &rhs) const {
-          return *this; // FIXME
-        }
-
-        Matrix &operator+=(const Matrix &rhs) {
-          *this->base += rhs.base;
+        template <typename E> Matrix &operator+=(const Expression<E> &rhs) {
+          add_assign(*base, rhs);
           return *this;
         }
 
-        Matrix operator*(T rhs) {
-          return std::move(Matrix(std::move(*this->base * rhs)));
+        template <typename E> Matrix &operator-=(const Expression<E> &rhs) {
+          add_assign(*base, -rhs);
+          return *this;
         }
 
-        Matrix operator*=(T rhs) {
+        Matrix &operator*=(T rhs) {
           *this->base *= rhs;
           return *this;
         }
 
-        Matrix operator*(const Matrix &rhs) const {
-          return std::move(Matrix(std::move(*this->base * (*rhs.base))));
-        }
-
         friend std::ostream &operator<<(std::ostream &out,
                                         const Matrix &matrix) {
           return out << *matrix.base;
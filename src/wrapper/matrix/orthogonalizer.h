@@ -0,0 +1,226 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "wrapper/matrix/base.h"
+#include "wrapper/matrix/dispatch.h"
+#include "wrapper/matrix/eigensolver.h"
+#include "wrapper/matrix/factorize.h"
+#include "wrapper/matrix/gemm.h"
+#include "wrapper/matrix/matrix.h"
+#include "wrapper/matrix/vector.h"
+
+namespace ketcpp {
+  namespace wrapper {
+    namespace matrix {
+      // How an Orthogonalizer builds X with X^T S X = I:
+      // symmetric: X = S^-1/2 (Loewdin), the orthonormal basis closest to
+      //   the original one;
+      // canonical: X = U s^-1/2 from the eigenpairs (s, U) of S;
+      // cholesky: X = L^-T from S = L L^T, the cheapest to build.
+      enum class Orthogonalization { symmetric, canonical, cholesky };
+
+      // Orthogonalizer for the generalized symmetric eigenproblem
+      // F C = S C e, e.g. the Roothaan-Hall equations. X is built once from
+      // the overlap S, so that every later solve is two GEMMs to form
+      // X^T F X, a standard eigenproblem, and one GEMM for C = X C'. Keep
+      // one per geometry and call reset() when S may have changed.
+      //
+      // Basis functions are nearly linearly dependent when S has
+      // eigenvalues at or below threshold times its largest one; their
+      // combinations are dropped, so that X, and C, have fewer columns than
+      // S. symmetric then falls back to canonical, as S^-1/2 does not
+      // exist; cholesky falls back to canonical when a pivot gets that
+      // small.
+      template <typename T> class Orthogonalizer {
+      public:
+        constexpr static T default_threshold = T(1e-7);
+
+        explicit Orthogonalizer(
+            const MatrixBase<T> &s,
+            Orthogonalization method = Orthogonalization::symmetric,
+            T threshold = default_threshold)
+            : method(method), threshold(threshold), order(s.get_num_rows()),
+              overlap(kernel::symmetric_copy(s)),
+              transform(std::make_unique<MatrixVector<T>>(0, 0)) {
+          build();
+        }
+
+        // Rebuilds X if s differs from the overlap it was built from;
+        // returns whether it did.
+        bool reset(const MatrixBase<T> &s) {
+          std::vector<T> copy = kernel::symmetric_copy(s);
+          if (copy == overlap) {
+            return false;
+          }
+          order = s.get_num_rows();
+          overlap = std::move(copy);
+          build();
+          return true;
+        }
+
+        size_t get_num_functions() const { return transform.get_num_rows(); }
+        // Columns of X: the functions left after dropping dependencies.
+        size_t get_num_independent() const {
+          return transform.get_num_columns();
+        }
+        size_t get_num_dropped() const {
+          return get_num_functions() - get_num_independent();
+        }
+        // The method actually used, after any fallback to canonical.
+        Orthogonalization get_method() const { return used; }
+        const Matrix<T> &get_transform() const { return transform; }
+
+        // X^T F X.
+        Matrix<T> project(const MatrixBase<T> &f) const {
+          const size_t n = get_num_functions(), m = get_num_independent();
+          if (f.get_num_rows() != n || f.get_num_columns() != n) {
+            throw std::invalid_argument("matrix shapes do not match");
+          }
+          std::unique_ptr<MatrixBase<T>> temp;
+          const MatrixBase<T> *src = &f;
+          if (!kernel::is_strided(f)) {
+            temp = kernel::to_strided(f);
+            src = temp.get();
+          }
+          const T *x = transform.data();
+          std::vector<T> fx(n * m);
+          gemm<T>(n, m, n, T(1), src->data(), src->get_row_stride(),
+                  src->get_column_stride(), x, m, 1, T(0), fx.data(), m, 1);
+          std::unique_ptr<MatrixBase<T>> result(new MatrixVector<T>(m, m));
+          gemm<T>(m, m, n, T(1), x, 1, m, fx.data(), m, 1, T(0),
+                  result->data(), m, 1);
+          return Matrix<T>(std::move(result));
+        }
+
+        // Lowest num_pairs solutions of F C = S C e, with C^T S C = I.
+        Eigensystem<T> solve(const MatrixBase<T> &f,
+                             size_t num_pairs = all_pairs) const {
+          const size_t n = get_num_functions(), m = get_num_independent();
+          const auto reduced = diagonalize(project(f), num_pairs);
+          const size_t k = reduced.values.size();
+          std::unique_ptr<MatrixBase<T>> c(new MatrixVector<T>(n, k));
+          gemm<T>(n, k, m, T(1), transform.data(), m,
+                  reduced.vectors.data(), k, T(0), c->data(), k);
+          return {reduced.values, Matrix<T>(std::move(c))};
+        }
+        Eigensystem<T> solve(const Matrix<T> &f,
+                             size_t num_pairs = all_pairs) const {
+          return solve(f.get_base(), num_pairs);
+        }
+
+      private:
+        Orthogonalization method, used;
+        T threshold;
+        size_t order;
+        // Copy of S, to tell in reset() whether it changed.
+        std::vector<T> overlap;
+        Matrix<T> transform;
+
+        void build() {
+          if (method == Orthogonalization::cholesky && build_cholesky()) {
+            used = method;
+            return;
+          }
+          const size_t n = order;
+          std::vector<T> work(overlap), s(n), u(n * n);
+          kernel::eigensolver::solve(n, work.data(), n, n, s.data(), u.data(),
+                                     n);
+          build_from_eigenpairs(n, s, u);
+        }
+
+        // X = U_kept s^-1/2, and X (U_kept)^T for symmetric.
+        void build_from_eigenpairs(size_t n, const std::vector<T> &s,
+                                   const std::vector<T> &u) {
+          const T largest = n > 0 ? s[n - 1] : T(0);
+          size_t first = 0;
+          while (first < n && !(s[first] > threshold * largest)) {
+            ++first;
+          }
+          const size_t m = n - first;
+          std::vector<T> x(n * m);
+          for (size_t i = 0; i < n; ++i) {
+            for (size_t j = 0; j < m; ++j) {
+              x[i * m + j] = u[i * n + first + j] / std::sqrt(s[first + j]);
+            }
+          }
+          if (method == Orthogonalization::symmetric && first == 0) {
+            used = Orthogonalization::symmetric;
+            std::unique_ptr<MatrixBase<T>> result(new MatrixVector<T>(n, n));
+            gemm<T>(n, n, n, T(1), x.data(), n, 1, u.data(), 1, n, T(0),
+                    result->data(), n, 1);
+            transform = Matrix<T>(std::move(result));
+            return;
+          }
+          used = Orthogonalization::canonical;
+          std::unique_ptr<MatrixBase<T>> result(new MatrixVector<T>(n, m));
+          std::copy(x.begin(), x.end(), result->data());
+          transform = Matrix<T>(std::move(result));
+        }
+
+        // X = L^-T, from L^-1 solved against the identity.
+        bool build_cholesky() {
+          const size_t n = order;
+          std::vector<T> l(overlap);
+          if (!kernel::factorize::cholesky(n, l.data(), n)) {
+            return false;
+          }
+          T largest = 0, smallest = std::numeric_limits<T>::max();
+          for (size_t i = 0; i < n; ++i) {
+            largest = std::max(largest, overlap[i * n + i]);
+            smallest = std::min(smallest, l[i * n + i] * l[i * n + i]);
+          }
+          if (n > 0 && !(smallest > threshold * largest)) {
+            return false;
+          }
+          std::unique_ptr<MatrixBase<T>> result(new MatrixVector<T>(n, n));
+          T *x = result->data();
+          for (size_t i = 0; i < n; ++i) {
+            x[i * n + i] = T(1);
+          }
+          // Solving into the transposed storage leaves L^-T in x.
+          kernel::factorize::solve_lower<T>(n, n, l.data(), n, 1, false, x, 1,
+                                            n);
+          transform = Matrix<T>(std::move(result));
+          return true;
+        }
+      };
+
+      template <typename T>
+      constexpr T Orthogonalizer<T>::default_threshold;
+
+      // Lowest num_pairs solutions of F C = S C e. Solving repeatedly with
+      // the same S is cheaper through an Orthogonalizer kept around.
+      template <typename T>
+      Eigensystem<T> diagonalize(const MatrixBase<T> &f, const MatrixBase<T> &s,
+                                 size_t num_pairs = all_pairs) {
+        return Orthogonalizer<T>(s).solve(f, num_pairs);
+      }
+    }
+  }
+}
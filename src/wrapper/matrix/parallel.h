@@ -0,0 +1,83 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+
+#include "wrapper/matrix/simd.h"
+#include "wrapper/thread/pool.h"
+
+namespace ketcpp {
+  namespace wrapper {
+    namespace matrix {
+      // Element-wise operations and reductions on contiguous storage, split
+      // over the thread pool. Arrays shorter than grain elements are handled
+      // serially by the SIMD kernels.
+      namespace parallel {
+        constexpr size_t grain = 1 << 15;
+
+        template <typename T>
+        void add(size_t n, const T *x, const T *y, T *z) {
+          thread::parallel_for(0, n, grain, [=](size_t first, size_t last) {
+            simd::add(last - first, x + first, y + first, z + first);
+          });
+        }
+
+        template <typename T> void scale(size_t n, T a, const T *x, T *y) {
+          thread::parallel_for(0, n, grain, [=](size_t first, size_t last) {
+            simd::scale(last - first, a, x + first, y + first);
+          });
+        }
+
+        template <typename T> void axpy(size_t n, T a, const T *x, T *y) {
+          thread::parallel_for(0, n, grain, [=](size_t first, size_t last) {
+            simd::axpy(last - first, a, x + first, y + first);
+          });
+        }
+
+        template <typename T> bool equal(size_t n, const T *x, const T *y) {
+          return thread::parallel_reduce(
+              0, n, grain, true,
+              [=](size_t first, size_t last) {
+                return simd::equal(last - first, x + first, y + first);
+              },
+              [](bool l, bool r) { return l && r; });
+        }
+
+        template <typename T> T dot(size_t n, const T *x, const T *y) {
+          return thread::parallel_reduce(
+              0, n, grain, T(0),
+              [=](size_t first, size_t last) {
+                return simd::dot(last - first, x + first, y + first);
+              },
+              [](T l, T r) { return l + r; });
+        }
+
+        template <typename T> T norm(size_t n, const T *x) {
+          if (n <= grain) {
+            return simd::norm(n, x);
+          }
+          return std::sqrt(dot(n, x, x));
+        }
+      }
+    }
+  }
+}
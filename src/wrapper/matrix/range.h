@@ -0,0 +1,233 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+
+#include "wrapper/matrix/base.h"
+
+namespace ketcpp {
+  namespace wrapper {
+    namespace matrix {
+      template <typename T>
+      class StrideIterator
+          : public std::iterator<std::random_access_iterator_tag, T> {
+        T *ptr;
+        std::ptrdiff_t stride;
+
+      public:
+        using difference_type = std::ptrdiff_t;
+
+        StrideIterator(T *ptr, std::ptrdiff_t stride)
+            : ptr(ptr), stride(stride) {}
+        T &operator*() const { return *ptr; }
+        T &operator[](difference_type n) const { return ptr[n * stride]; }
+        StrideIterator &operator++() {
+          ptr += stride;
+          return *this;
+        }
+        StrideIterator &operator--() {
+          ptr -= stride;
+          return *this;
+        }
+        StrideIterator operator++(int) {
+          auto old = *this;
+          ptr += stride;
+          return old;
+        }
+        StrideIterator &operator+=(difference_type n) {
+          ptr += n * stride;
+          return *this;
+        }
+        StrideIterator operator+(difference_type n) const {
+          return StrideIterator(ptr + n * stride, stride);
+        }
+        difference_type operator-(const StrideIterator &rhs) const {
+          return (ptr - rhs.ptr) / stride;
+        }
+        bool operator==(const StrideIterator &rhs) const {
+          return ptr == rhs.ptr;
+        }
+        bool operator!=(const StrideIterator &rhs) const {
+          return ptr != rhs.ptr;
+        }
+        bool operator<(const StrideIterator &rhs) const {
+          return stride > 0 ? ptr < rhs.ptr : ptr > rhs.ptr;
+        }
+      };
+
+      template <typename Iterator> class Range {
+        Iterator first, last;
+
+      public:
+        Range(Iterator first, Iterator last) : first(first), last(last) {}
+        Iterator begin() const { return first; }
+        Iterator end() const { return last; }
+        size_t size() const { return last - first; }
+        decltype(auto) operator[](size_t n) const { return first[n]; }
+      };
+
+      namespace kernel {
+        template <typename Element> struct ElementFactory {
+          template <typename U> static Element make(U *ptr, std::ptrdiff_t n) {
+            return Element(ptr, n);
+          }
+        };
+        template <typename U> struct ElementFactory<U *> {
+          static U *make(U *ptr, std::ptrdiff_t) { return ptr; }
+        };
+      }
+
+      // Iterates over the rows or the columns of a strided matrix, yielding
+      // each one as a Range of Element iterators.
+      template <typename T, typename Element> class LineIterator {
+        T *ptr;
+        std::ptrdiff_t line_stride, element_stride;
+        size_t length;
+
+        Element make_element(T *p) const {
+          return kernel::ElementFactory<Element>::make(p, element_stride);
+        }
+
+      public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = Range<Element>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = value_type;
+
+        LineIterator(T *ptr, std::ptrdiff_t line_stride,
+                     std::ptrdiff_t element_stride, size_t length)
+            : ptr(ptr), line_stride(line_stride),
+              element_stride(element_stride), length(length) {}
+        Range<Element> operator*() const {
+          return Range<Element>(make_element(ptr),
+                                make_element(ptr + length * element_stride));
+        }
+        Range<Element> operator[](difference_type n) const {
+          return *(*this + n);
+        }
+        LineIterator &operator++() {
+          ptr += line_stride;
+          return *this;
+        }
+        LineIterator operator+(difference_type n) const {
+          auto it = *this;
+          it.ptr += n * line_stride;
+          return it;
+        }
+        difference_type operator-(const LineIterator &rhs) const {
+          return (ptr - rhs.ptr) / line_stride;
+        }
+        bool operator==(const LineIterator &rhs) const {
+          return ptr == rhs.ptr;
+        }
+        bool operator!=(const LineIterator &rhs) const {
+          return ptr != rhs.ptr;
+        }
+      };
+
+      namespace kernel {
+        // Line iterators over the rows and the columns of dense storage:
+        // lines that are contiguous in layout yield plain pointers, the
+        // others StrideIterators.
+        template <Layout layout, typename U> struct Lines {
+          using Rows = LineIterator<U, U *>;
+          using Columns = LineIterator<U, StrideIterator<U>>;
+        };
+        template <typename U> struct Lines<Layout::column_major, U> {
+          using Rows = LineIterator<U, StrideIterator<U>>;
+          using Columns = LineIterator<U, U *>;
+        };
+      }
+
+      // Allocation-free, non-virtual iteration for backends that keep their
+      // elements in dense storage of the given layout. Derived must provide
+      // data(), get_num_rows(), get_num_columns() and get_row_stride(), and
+      // get_column_stride() for column-major storage; they are called with
+      // qualified names so that no virtual dispatch happens.
+      template <typename Derived, typename T,
+                Layout layout = Layout::row_major>
+      class StridedMatrix {
+        Derived &derived() { return static_cast<Derived &>(*this); }
+        const Derived &derived() const {
+          return static_cast<const Derived &>(*this);
+        }
+        // Stride between consecutive rows or columns, whichever are
+        // contiguous.
+        std::ptrdiff_t get_leading_stride() const {
+          const auto &d = derived();
+          return layout == Layout::row_major ? d.Derived::get_row_stride()
+                                             : d.Derived::get_column_stride();
+        }
+        template <typename U> auto make_rows(U *ptr) const {
+          const auto &d = derived();
+          using Lines = typename kernel::Lines<layout, U>::Rows;
+          const std::ptrdiff_t ld = get_leading_stride();
+          const std::ptrdiff_t rs = layout == Layout::row_major ? ld : 1;
+          const std::ptrdiff_t cs = layout == Layout::row_major ? 1 : ld;
+          const size_t m = d.Derived::get_num_rows();
+          const size_t n = d.Derived::get_num_columns();
+          return Range<Lines>(Lines(ptr, rs, cs, n),
+                              Lines(ptr + m * rs, rs, cs, n));
+        }
+        template <typename U> auto make_columns(U *ptr) const {
+          const auto &d = derived();
+          using Lines = typename kernel::Lines<layout, U>::Columns;
+          const std::ptrdiff_t ld = get_leading_stride();
+          const std::ptrdiff_t rs = layout == Layout::row_major ? ld : 1;
+          const std::ptrdiff_t cs = layout == Layout::row_major ? 1 : ld;
+          const size_t m = d.Derived::get_num_rows();
+          const size_t n = d.Derived::get_num_columns();
+          return Range<Lines>(Lines(ptr, cs, rs, m),
+                              Lines(ptr + n * cs, cs, rs, m));
+        }
+        std::ptrdiff_t get_offset(size_t i, size_t j) const {
+          return layout == Layout::row_major ? i * get_leading_stride() + j
+                                             : i + j * get_leading_stride();
+        }
+
+      public:
+        auto fast_rows() { return make_rows(derived().Derived::data()); }
+        auto fast_rows() const {
+          return make_rows(derived().Derived::data());
+        }
+        auto fast_columns() {
+          return make_columns(derived().Derived::data());
+        }
+        auto fast_columns() const {
+          return make_columns(derived().Derived::data());
+        }
+        auto fast_row(size_t i) { return fast_rows()[i]; }
+        auto fast_row(size_t i) const { return fast_rows()[i]; }
+        auto fast_column(size_t j) { return fast_columns()[j]; }
+        auto fast_column(size_t j) const { return fast_columns()[j]; }
+
+        T &operator()(size_t i, size_t j) {
+          return derived().Derived::data()[get_offset(i, j)];
+        }
+        const T &operator()(size_t i, size_t j) const {
+          return derived().Derived::data()[get_offset(i, j)];
+        }
+      };
+    }
+  }
+}
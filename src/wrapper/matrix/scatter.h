@@ -0,0 +1,178 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "wrapper/matrix/base.h"
+#include "wrapper/matrix/dispatch.h"
+#include "wrapper/thread/pool.h"
+
+namespace ketcpp {
+  namespace wrapper {
+    namespace matrix {
+      // Accumulates many small dense blocks into a large matrix, as in Fock
+      // and density builds over shell pairs. Blocks are queued with add()
+      // and summed into the destination by apply(), which splits the
+      // destination into bands of rows owned by one thread each, so no two
+      // threads write the same element and no locking is needed. The
+      // result does not depend on the number of threads: within a band,
+      // blocks are added in the order they were queued.
+      //
+      // Strided blocks are referenced, not copied, and must stay alive
+      // until apply(); other backends and temporaries are copied when
+      // queued.
+      template <typename T> class BlockScatter {
+      public:
+        struct Block {
+          size_t row, column;
+          size_t num_rows, num_columns;
+          const T *data;
+          std::ptrdiff_t row_stride, column_stride;
+          T coefficient;
+        };
+
+      private:
+        std::vector<Block> blocks;
+        std::vector<std::unique_ptr<MatrixBase<T>>> temporaries;
+        size_t max_row = 0, max_column = 0;
+
+        const MatrixBase<T> &get_strided(const MatrixBase<T> &block) {
+          if (kernel::is_strided(block)) {
+            return block;
+          }
+          return own(block);
+        }
+        const MatrixBase<T> &own(const MatrixBase<T> &block) {
+          temporaries.push_back(kernel::to_strided(block));
+          return *temporaries.back();
+        }
+
+        void push(const Block &b) {
+          blocks.push_back(b);
+          max_row = std::max(max_row, b.row + b.num_rows);
+          max_column = std::max(max_column, b.column + b.num_columns);
+        }
+
+        void add_strided(size_t row, size_t column, const MatrixBase<T> &b,
+                         T coefficient) {
+          add(row, column, b.get_num_rows(), b.get_num_columns(), b.data(),
+              b.get_row_stride(), b.get_column_stride(), coefficient);
+        }
+        void add_symmetric_strided(size_t row, size_t column,
+                                   const MatrixBase<T> &b, T coefficient) {
+          add_strided(row, column, b, coefficient);
+          if (row != column) {
+            add(column, row, b.get_num_columns(), b.get_num_rows(), b.data(),
+                b.get_column_stride(), b.get_row_stride(), coefficient);
+          }
+        }
+
+      public:
+        // Rows per band in apply(); bands are the unit of parallel work.
+        constexpr static size_t band_rows = 64;
+
+        size_t size() const { return blocks.size(); }
+        void clear() {
+          blocks.clear();
+          temporaries.clear();
+          max_row = max_column = 0;
+        }
+
+        // dest(row + i, column + j) += coefficient * data[i * row_stride +
+        // j * column_stride] at apply().
+        void add(size_t row, size_t column, size_t num_rows,
+                 size_t num_columns, const T *data, std::ptrdiff_t row_stride,
+                 std::ptrdiff_t column_stride = 1, T coefficient = T(1)) {
+          push(Block{row, column, num_rows, num_columns, data, row_stride,
+                     column_stride, coefficient});
+        }
+        void add(size_t row, size_t column, const MatrixBase<T> &block,
+                 T coefficient = T(1)) {
+          add_strided(row, column, get_strided(block), coefficient);
+        }
+        void add(size_t row, size_t column, MatrixBase<T> &&block,
+                 T coefficient = T(1)) {
+          add_strided(row, column, own(block), coefficient);
+        }
+        // Adds block at (row, column) and its transpose at (column, row),
+        // for symmetric destinations built from unique pairs. Diagonal
+        // blocks (row == column) are added once.
+        void add_symmetric(size_t row, size_t column,
+                           const MatrixBase<T> &block, T coefficient = T(1)) {
+          add_symmetric_strided(row, column, get_strided(block), coefficient);
+        }
+        void add_symmetric(size_t row, size_t column, MatrixBase<T> &&block,
+                           T coefficient = T(1)) {
+          add_symmetric_strided(row, column, own(block), coefficient);
+        }
+
+        // dest += sum of the queued blocks. The queue is kept, so the same
+        // blocks can be applied again.
+        void apply(MatrixBase<T> &dest) const {
+          if (!kernel::is_strided(dest)) {
+            throw std::invalid_argument("destination must be strided");
+          }
+          if (max_row > dest.get_num_rows() ||
+              max_column > dest.get_num_columns()) {
+            throw std::out_of_range("block out of range");
+          }
+          const size_t num_bands = (max_row + band_rows - 1) / band_rows;
+          // Blocks overlapping each band, in queue order.
+          std::vector<std::vector<const Block *>> bands(num_bands);
+          for (const Block &b : blocks) {
+            if (b.num_rows == 0) {
+              continue;
+            }
+            const size_t last = (b.row + b.num_rows - 1) / band_rows;
+            for (size_t band = b.row / band_rows; band <= last; ++band) {
+              bands[band].push_back(&b);
+            }
+          }
+          T *d = dest.data();
+          const std::ptrdiff_t rsd = dest.get_row_stride();
+          const std::ptrdiff_t csd = dest.get_column_stride();
+          thread::parallel_for(0, num_bands, 1, [&](size_t first,
+                                                    size_t last) {
+            for (size_t band = first; band < last; ++band) {
+              const size_t r0 = band * band_rows, r1 = r0 + band_rows;
+              for (const Block *b : bands[band]) {
+                const size_t i0 = std::max(b->row, r0);
+                const size_t i1 = std::min(b->row + b->num_rows, r1);
+                for (size_t i = i0; i < i1; ++i) {
+                  kernel::strided_axpy(
+                      b->num_columns, b->coefficient,
+                      b->data + (i - b->row) * b->row_stride, b->column_stride,
+                      d + i * rsd + b->column * csd, csd);
+                }
+              }
+            }
+          });
+        }
+      };
+
+      template <typename T> constexpr size_t BlockScatter<T>::band_rows;
+    }
+  }
+}
@@ -0,0 +1,158 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "wrapper/matrix/simd.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define KETCPP_SIMD_X86
+#endif
+
+namespace ketcpp {
+  namespace wrapper {
+    namespace matrix {
+      namespace simd {
+        namespace scalar {
+          template <typename T> const Kernels<T> &get_table() {
+            static const Kernels<T> table = {
+                simd::add<T>,   simd::scale<T>, simd::axpy<T>,
+                simd::equal<T>, simd::dot<T>,   simd::norm<T>};
+            return table;
+          }
+        }
+
+#ifdef KETCPP_SIMD_X86
+#pragma GCC push_options
+#pragma GCC target("sse2")
+        namespace sse2 {
+          constexpr size_t vector_bytes = 16;
+#include "wrapper/matrix/simd_impl.h"
+        }
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+        namespace avx2 {
+          constexpr size_t vector_bytes = 32;
+#include "wrapper/matrix/simd_impl.h"
+        }
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+        namespace avx512 {
+          constexpr size_t vector_bytes = 64;
+#include "wrapper/matrix/simd_impl.h"
+        }
+#pragma GCC pop_options
+#endif
+
+        namespace {
+          Isa detect_isa() {
+#ifdef KETCPP_SIMD_X86
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f")) {
+              return Isa::avx512;
+            }
+            if (__builtin_cpu_supports("avx2") &&
+                __builtin_cpu_supports("fma")) {
+              return Isa::avx2;
+            }
+            if (__builtin_cpu_supports("sse2")) {
+              return Isa::sse2;
+            }
+#endif
+            return Isa::scalar;
+          }
+
+          Isa initial_isa() {
+            Isa isa = get_detected_isa();
+            if (const char *env = std::getenv("KETCPP_SIMD")) {
+              for (Isa i : {Isa::scalar, Isa::sse2, Isa::avx2, Isa::avx512}) {
+                if (get_isa_name(i) == std::string(env)) {
+                  isa = std::min(isa, i);
+                }
+              }
+            }
+            return isa;
+          }
+
+          std::atomic<Isa> &active_isa() {
+            static std::atomic<Isa> isa(initial_isa());
+            return isa;
+          }
+
+          template <typename T> const Kernels<T> &select(Isa isa) {
+            switch (isa) {
+#ifdef KETCPP_SIMD_X86
+            case Isa::avx512:
+              return avx512::get_table<T>();
+            case Isa::avx2:
+              return avx2::get_table<T>();
+            case Isa::sse2:
+              return sse2::get_table<T>();
+#endif
+            default:
+              return scalar::get_table<T>();
+            }
+          }
+        }
+
+        Isa get_detected_isa() {
+          static const Isa isa = detect_isa();
+          return isa;
+        }
+
+        Isa get_isa() { return active_isa().load(std::memory_order_relaxed); }
+
+        Isa set_isa(Isa isa) {
+          isa = std::min(isa, get_detected_isa());
+          active_isa().store(isa, std::memory_order_relaxed);
+          return isa;
+        }
+
+        const char *get_isa_name(Isa isa) {
+          switch (isa) {
+          case Isa::sse2:
+            return "sse2";
+          case Isa::avx2:
+            return "avx2";
+          case Isa::avx512:
+            return "avx512";
+          default:
+            return "scalar";
+          }
+        }
+
+        template <> const Kernels<float> &get_kernels<float>(Isa isa) {
+          return select<float>(std::min(isa, get_detected_isa()));
+        }
+
+        template <> const Kernels<double> &get_kernels<double>(Isa isa) {
+          return select<double>(std::min(isa, get_detected_isa()));
+        }
+      }
+    }
+  }
+}
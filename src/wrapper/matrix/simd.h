@@ -0,0 +1,128 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <numeric>
+
+namespace ketcpp {
+  namespace wrapper {
+    namespace matrix {
+      namespace simd {
+        // Instruction sets in increasing order of width. The widest one
+        // supported by the running CPU is selected on first use; the
+        // KETCPP_SIMD environment variable (scalar, sse2, avx2 or avx512)
+        // can lower it.
+        enum class Isa { scalar, sse2, avx2, avx512 };
+
+        template <typename T> struct Kernels {
+          void (*add)(size_t n, const T *x, const T *y, T *z);
+          void (*scale)(size_t n, T a, const T *x, T *y);
+          void (*axpy)(size_t n, T a, const T *x, T *y);
+          bool (*equal)(size_t n, const T *x, const T *y);
+          T (*dot)(size_t n, const T *x, const T *y);
+          T (*norm)(size_t n, const T *x);
+        };
+
+        Isa get_detected_isa();
+        Isa get_isa();
+        // Clamps to the detected instruction set and returns the one in use.
+        Isa set_isa(Isa isa);
+        const char *get_isa_name(Isa isa);
+
+        template <typename T> const Kernels<T> &get_kernels(Isa isa);
+        template <> const Kernels<float> &get_kernels<float>(Isa isa);
+        template <> const Kernels<double> &get_kernels<double>(Isa isa);
+        template <typename T> const Kernels<T> &get_kernels() {
+          return get_kernels<T>(get_isa());
+        }
+
+        // z = x + y
+        template <typename T>
+        void add(size_t n, const T *x, const T *y, T *z) {
+          std::transform(x, x + n, y, z, [](T l, T r) -> T { return l + r; });
+        }
+        inline void add(size_t n, const float *x, const float *y, float *z) {
+          get_kernels<float>().add(n, x, y, z);
+        }
+        inline void add(size_t n, const double *x, const double *y,
+                        double *z) {
+          get_kernels<double>().add(n, x, y, z);
+        }
+
+        // y = a * x
+        template <typename T> void scale(size_t n, T a, const T *x, T *y) {
+          std::transform(x, x + n, y, [a](T l) -> T { return l * a; });
+        }
+        inline void scale(size_t n, float a, const float *x, float *y) {
+          get_kernels<float>().scale(n, a, x, y);
+        }
+        inline void scale(size_t n, double a, const double *x, double *y) {
+          get_kernels<double>().scale(n, a, x, y);
+        }
+
+        // y += a * x
+        template <typename T> void axpy(size_t n, T a, const T *x, T *y) {
+          std::transform(x, x + n, y, y,
+                         [a](T l, T r) -> T { return r + a * l; });
+        }
+        inline void axpy(size_t n, float a, const float *x, float *y) {
+          get_kernels<float>().axpy(n, a, x, y);
+        }
+        inline void axpy(size_t n, double a, const double *x, double *y) {
+          get_kernels<double>().axpy(n, a, x, y);
+        }
+
+        template <typename T> bool equal(size_t n, const T *x, const T *y) {
+          return std::equal(x, x + n, y);
+        }
+        inline bool equal(size_t n, const float *x, const float *y) {
+          return get_kernels<float>().equal(n, x, y);
+        }
+        inline bool equal(size_t n, const double *x, const double *y) {
+          return get_kernels<double>().equal(n, x, y);
+        }
+
+        template <typename T> T dot(size_t n, const T *x, const T *y) {
+          return std::inner_product(x, x + n, y, T(0));
+        }
+        inline float dot(size_t n, const float *x, const float *y) {
+          return get_kernels<float>().dot(n, x, y);
+        }
+        inline double dot(size_t n, const double *x, const double *y) {
+          return get_kernels<double>().dot(n, x, y);
+        }
+
+        // Euclidean norm
+        template <typename T> T norm(size_t n, const T *x) {
+          return std::sqrt(dot<T>(n, x, x));
+        }
+        inline float norm(size_t n, const float *x) {
+          return get_kernels<float>().norm(n, x);
+        }
+        inline double norm(size_t n, const double *x) {
+          return get_kernels<double>().norm(n, x);
+        }
+      }
+    }
+  }
+}
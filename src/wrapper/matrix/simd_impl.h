@@ -0,0 +1,123 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Kernel bodies written once against GCC vector extensions. simd.cc includes
+// this file (deliberately without an include guard) inside one namespace per
+// instruction set, after defining vector_bytes and selecting the target with
+// #pragma GCC target.
+
+template <typename T> struct Vector {
+  typedef T type __attribute__((vector_size(vector_bytes)));
+  constexpr static size_t width = vector_bytes / sizeof(T);
+  static type load(const T *p) {
+    type v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+  }
+  static void store(T *p, const type &v) { std::memcpy(p, &v, sizeof(v)); }
+  static T sum(const type &v) {
+    T s = 0;
+    for (size_t i = 0; i < width; ++i) {
+      s += v[i];
+    }
+    return s;
+  }
+};
+
+template <typename T> void add(size_t n, const T *x, const T *y, T *z) {
+  using V = Vector<T>;
+  size_t i = 0;
+  for (; i + V::width <= n; i += V::width) {
+    V::store(z + i, V::load(x + i) + V::load(y + i));
+  }
+  for (; i < n; ++i) {
+    z[i] = x[i] + y[i];
+  }
+}
+
+template <typename T> void scale(size_t n, T a, const T *x, T *y) {
+  using V = Vector<T>;
+  size_t i = 0;
+  for (; i + V::width <= n; i += V::width) {
+    V::store(y + i, a * V::load(x + i));
+  }
+  for (; i < n; ++i) {
+    y[i] = a * x[i];
+  }
+}
+
+template <typename T> void axpy(size_t n, T a, const T *x, T *y) {
+  using V = Vector<T>;
+  size_t i = 0;
+  for (; i + V::width <= n; i += V::width) {
+    V::store(y + i, V::load(y + i) + a * V::load(x + i));
+  }
+  for (; i < n; ++i) {
+    y[i] += a * x[i];
+  }
+}
+
+template <typename T> bool equal(size_t n, const T *x, const T *y) {
+  using V = Vector<T>;
+  size_t i = 0;
+  for (; i + V::width <= n; i += V::width) {
+    auto differ = V::load(x + i) != V::load(y + i);
+    for (size_t j = 0; j < V::width; ++j) {
+      if (differ[j]) {
+        return false;
+      }
+    }
+  }
+  for (; i < n; ++i) {
+    if (!(x[i] == y[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Four independent accumulators hide the latency of the adds.
+template <typename T> T dot(size_t n, const T *x, const T *y) {
+  using V = Vector<T>;
+  typename V::type acc[4] = {};
+  size_t i = 0;
+  for (; i + 4 * V::width <= n; i += 4 * V::width) {
+    for (size_t j = 0; j < 4; ++j) {
+      acc[j] += V::load(x + i + j * V::width) * V::load(y + i + j * V::width);
+    }
+  }
+  for (; i + V::width <= n; i += V::width) {
+    acc[0] += V::load(x + i) * V::load(y + i);
+  }
+  T sum = V::sum((acc[0] + acc[1]) + (acc[2] + acc[3]));
+  for (; i < n; ++i) {
+    sum += x[i] * y[i];
+  }
+  return sum;
+}
+
+template <typename T> T norm(size_t n, const T *x) {
+  return std::sqrt(dot(n, x, x));
+}
+
+template <typename T> const Kernels<T> &get_table() {
+  static const Kernels<T> table = {add<T>,   scale<T>, axpy<T>,
+                                   equal<T>, dot<T>,   norm<T>};
+  return table;
+}
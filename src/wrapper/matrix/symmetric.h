@@ -0,0 +1,414 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "wrapper/matrix/base.h"
+#include "wrapper/matrix/dispatch.h"
+#include "wrapper/matrix/parallel.h"
+#include "wrapper/matrix/simd.h"
+#include "wrapper/matrix/vector.h"
+#include "wrapper/thread/pool.h"
+
+namespace ketcpp {
+  namespace wrapper {
+    namespace matrix {
+      namespace kernel {
+        // Offset of row i in a row-packed upper triangle of order n.
+        inline size_t packed_row(size_t n, size_t i) {
+          return i * (2 * n - i + 1) / 2;
+        }
+        // Index of element (i, j), i <= j, in a row-packed upper triangle.
+        inline size_t packed_index(size_t n, size_t i, size_t j) {
+          return packed_row(n, i) + j - i;
+        }
+
+        // C = alpha * S * B + beta * C, where S is a packed symmetric n x n
+        // matrix and B, C are n x m. Rows of C are computed independently.
+        // When beta is zero C is not read.
+        template <typename T>
+        void symm(size_t n, size_t m, T alpha, const T *s, const T *b,
+                  std::ptrdiff_t rsb, std::ptrdiff_t csb, T beta, T *c,
+                  std::ptrdiff_t rsc, std::ptrdiff_t csc) {
+          const size_t grain =
+              std::max<size_t>(parallel::grain / (n * m + 1), 1);
+          thread::parallel_for(0, n, grain, [=](size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i) {
+              T *ci = c + i * rsc;
+              scale(1, m, beta, ci, rsc, csc);
+              for (size_t k = 0; k < n; ++k) {
+                const T sik = k < i ? s[packed_index(n, k, i)]
+                                    : s[packed_index(n, i, k)];
+                strided_axpy(m, alpha * sik, b + k * rsb, csb, ci, csc);
+              }
+            }
+          });
+        }
+
+        // C = alpha * A * A^T + beta * C, where A is n x k and C is a packed
+        // symmetric n x n matrix. When beta is zero C is not read.
+        template <typename T>
+        void syrk(size_t n, size_t k, T alpha, const T *a, std::ptrdiff_t rsa,
+                  std::ptrdiff_t csa, T beta, T *c) {
+          const size_t grain =
+              std::max<size_t>(parallel::grain / (n * k + 1), 1);
+          thread::parallel_for(0, n, grain, [=](size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i) {
+              const T *ai = a + i * rsa;
+              T *ci = c + packed_row(n, i);
+              for (size_t j = i; j < n; ++j) {
+                const T *aj = a + j * rsa;
+                T sum;
+                if (csa == 1) {
+                  sum = simd::dot(k, ai, aj);
+                } else {
+                  sum = T(0);
+                  for (size_t p = 0; p < k; ++p) {
+                    sum += ai[p * csa] * aj[p * csa];
+                  }
+                }
+                T &cij = ci[j - i];
+                cij = (beta == T(0) ? T(0) : beta * cij) + alpha * sum;
+              }
+            }
+          });
+        }
+      }
+
+      // Symmetric n x n matrix storing only its upper triangle, packed row
+      // by row. operator() mirrors the lower triangle, so writing element
+      // (i, j) also writes (j, i). Iterators read the mirror too, but
+      // mutable iterators discard writes to the lower triangle, so that a
+      // sweep over the full matrix updates each stored element once.
+      template <typename T> class MatrixSymmetric : public MatrixBase<T> {
+      private:
+        size_t order;
+        std::vector<T> storage;
+
+      public:
+        size_t get_num_rows() const { return order; }
+        size_t get_num_columns() const { return order; }
+        size_t get_row_size() const { return order; }
+        size_t get_column_size() const { return order; }
+        size_t get_packed_size() const { return storage.size(); }
+        T *packed_data() { return storage.data(); }
+        const T *packed_data() const { return storage.data(); }
+
+        T &operator()(size_t i, size_t j) {
+          return i <= j ? storage[kernel::packed_index(order, i, j)]
+                        : storage[kernel::packed_index(order, j, i)];
+        }
+        const T &operator()(size_t i, size_t j) const {
+          return i <= j ? storage[kernel::packed_index(order, i, j)]
+                        : storage[kernel::packed_index(order, j, i)];
+        }
+
+      private:
+        using Base = MatrixBase<T>;
+        typedef typename Base::RowVectorIterator RowVectorIterator;
+        typedef typename Base::RowElementIterator RowElementIterator;
+        typedef typename Base::ColumnVectorIterator ColumnVectorIterator;
+        typedef typename Base::ColumnElementIterator ColumnElementIterator;
+        typedef typename Base::RowVectorConstIterator RowVectorConstIterator;
+        typedef typename Base::RowElementConstIterator RowElementConstIterator;
+        typedef
+            typename Base::ColumnVectorConstIterator ColumnVectorConstIterator;
+        typedef typename Base::ColumnElementConstIterator
+            ColumnElementConstIterator;
+
+        // Walks the full n x n matrix by linear position i * n + j. Lower
+        // elements of a mutable iterator are copies in scratch.
+        template <bool is_const>
+        class GenericIterator
+            : public Base::template BaseGenericIterator<is_const> {
+          using BaseIterator =
+              typename Base::template BaseGenericIterator<is_const>;
+          using unique_ptr = std::unique_ptr<BaseIterator>;
+          typename std::conditional<is_const, const T *, T *>::type storage;
+          const size_t order;
+          size_t position;
+          T scratch;
+
+          unique_ptr make(size_t p) const {
+            return std::make_unique<GenericIterator>(storage, order, p);
+          }
+
+        protected:
+          void advance_in_column() { this->position += order; }
+          void advance_in_row() { this->position++; }
+          unique_ptr row_begin() { return make(position); }
+          unique_ptr row_end() { return make(position + order); }
+          unique_ptr column_begin() { return make(position); }
+          unique_ptr column_end() { return make(position + order * order); }
+          unique_ptr copy() { return make(position); }
+          bool operator==(BaseIterator &rhs) const throw(std::bad_cast &) {
+            auto &rhs_cast = dynamic_cast<decltype(*this)>(rhs);
+            return this->position == rhs_cast.position;
+          }
+          bool operator!=(BaseIterator &rhs) const throw(std::bad_cast &) {
+            auto &rhs_cast = dynamic_cast<decltype(*this)>(rhs);
+            return this->position != rhs_cast.position;
+          }
+          typename BaseIterator::difference_type
+          operator-(const BaseIterator &rhs) const throw(std::bad_cast &) {
+            auto &rhs_cast = dynamic_cast<decltype(*this)>(rhs);
+            return this->position - rhs_cast.position;
+          }
+          typename std::conditional<is_const, const T &, T &>::type
+          operator*() {
+            const size_t i = position / order, j = position % order;
+            if (i <= j) {
+              return storage[kernel::packed_index(order, i, j)];
+            }
+            scratch = storage[kernel::packed_index(order, j, i)];
+            return scratch;
+          }
+
+        public:
+          GenericIterator(decltype(storage) storage, size_t order,
+                          size_t position)
+              : storage(storage), order(order), position(position) {}
+        };
+        using Iterator = GenericIterator<false>;
+        using ConstIterator = GenericIterator<true>;
+
+      protected:
+        RowVectorConstIterator row_cbegin() const {
+          return RowVectorConstIterator(
+              std::make_unique<ConstIterator>(storage.data(), order, 0));
+        }
+        RowVectorConstIterator row_cend() const {
+          return RowVectorConstIterator(std::make_unique<ConstIterator>(
+              storage.data(), order, order * order));
+        }
+        ColumnVectorConstIterator column_cbegin() const {
+          return ColumnVectorConstIterator(
+              std::make_unique<ConstIterator>(storage.data(), order, 0));
+        }
+        ColumnVectorConstIterator column_cend() const {
+          return ColumnVectorConstIterator(
+              std::make_unique<ConstIterator>(storage.data(), order, order));
+        }
+        RowVectorIterator row_begin() {
+          return RowVectorIterator(
+              std::make_unique<Iterator>(storage.data(), order, 0));
+        }
+        RowVectorIterator row_end() {
+          return RowVectorIterator(
+              std::make_unique<Iterator>(storage.data(), order, order * order));
+        }
+        ColumnVectorIterator column_begin() {
+          return ColumnVectorIterator(
+              std::make_unique<Iterator>(storage.data(), order, 0));
+        }
+        ColumnVectorIterator column_end() {
+          return ColumnVectorIterator(
+              std::make_unique<Iterator>(storage.data(), order, order));
+        }
+
+      private:
+        static const MatrixSymmetric &cast(const Base &matrix) {
+          return static_cast<const MatrixSymmetric &>(matrix);
+        }
+
+        // Packed kernels registered in the dispatch table on first
+        // construction.
+        static void add_packed(Base &lhs, const Base &rhs) {
+          auto &l = static_cast<MatrixSymmetric &>(lhs);
+          parallel::add(l.storage.size(), l.storage.data(),
+                        cast(rhs).storage.data(), l.storage.data());
+        }
+        static bool compare_packed(const Base &lhs, const Base &rhs) {
+          return cast(lhs) == cast(rhs);
+        }
+        static std::unique_ptr<Base> multiply_dense(const Base &lhs,
+                                                    const Base &rhs) {
+          const auto &s = cast(lhs);
+          const size_t m = rhs.get_num_columns();
+          std::unique_ptr<Base> c(new MatrixVector<T>(s.order, m));
+          kernel::symm(s.order, m, T(1), s.storage.data(), rhs.data(),
+                       rhs.get_row_stride(), rhs.get_column_stride(), T(0),
+                       c->data(), c->get_row_stride(), c->get_column_stride());
+          return c;
+        }
+        // A * S = (S * A^T)^T, computed by swapping the strides of A and C.
+        static std::unique_ptr<Base> multiply_dense_left(const Base &lhs,
+                                                         const Base &rhs) {
+          const auto &s = cast(rhs);
+          const size_t m = lhs.get_num_rows();
+          std::unique_ptr<Base> c(new MatrixVector<T>(m, s.order));
+          kernel::symm(s.order, m, T(1), s.storage.data(), lhs.data(),
+                       lhs.get_column_stride(), lhs.get_row_stride(), T(0),
+                       c->data(), c->get_column_stride(), c->get_row_stride());
+          return c;
+        }
+        static std::unique_ptr<Base> multiply_packed(const Base &lhs,
+                                                     const Base &rhs) {
+          MatrixVector<T> dense(cast(rhs).order, cast(rhs).order);
+          cast(rhs).unpack(dense.data(), dense.get_row_stride(), 1);
+          return multiply_dense(lhs, dense);
+        }
+        static void convert_to_dense(Base &dest, const Base &src) {
+          cast(src).unpack(dest.data(), dest.get_row_stride(),
+                           dest.get_column_stride());
+        }
+        // Dense operands are read through their upper triangle only.
+        template <typename Store>
+        static void update_from_dense(Base &dest, const Base &src,
+                                      Store store) {
+          auto &s = static_cast<MatrixSymmetric &>(dest);
+          const T *data = src.data();
+          const std::ptrdiff_t rs = src.get_row_stride();
+          const std::ptrdiff_t cs = src.get_column_stride();
+          for (size_t i = 0; i < s.order; ++i) {
+            T *row = s.storage.data() + kernel::packed_row(s.order, i);
+            for (size_t j = i; j < s.order; ++j) {
+              store(row[j - i], data[i * rs + j * cs]);
+            }
+          }
+        }
+        static void add_dense(Base &lhs, const Base &rhs) {
+          update_from_dense(lhs, rhs, [](T &x, T y) { x += y; });
+        }
+        static void convert_from_dense(Base &dest, const Base &src) {
+          update_from_dense(dest, src, [](T &x, T y) { x = y; });
+        }
+        static bool register_kernels() {
+          auto &dispatcher = Dispatcher<T>::get_instance();
+          using Dense = Strided;
+          dispatcher.template define<Operation::add, MatrixSymmetric,
+                                     MatrixSymmetric>(add_packed);
+          dispatcher.template define<Operation::compare, MatrixSymmetric,
+                                     MatrixSymmetric>(compare_packed);
+          dispatcher.template define<Operation::multiply, MatrixSymmetric,
+                                     MatrixSymmetric>(multiply_packed);
+          dispatcher.template define<Operation::multiply, MatrixSymmetric,
+                                     Dense>(multiply_dense);
+          dispatcher.template define<Operation::multiply, Dense,
+                                     MatrixSymmetric>(multiply_dense_left);
+          dispatcher.template define<Operation::convert, Dense,
+                                     MatrixSymmetric>(convert_to_dense);
+          dispatcher.template define<Operation::add, MatrixSymmetric,
+                                     Dense>(add_dense);
+          dispatcher.template define<Operation::convert, MatrixSymmetric,
+                                     Dense>(convert_from_dense);
+          return true;
+        }
+        static void ensure_registered() {
+          static const bool registered = register_kernels();
+          (void)registered;
+        }
+
+      public:
+        // The list gives the full matrix, which must be square and
+        // symmetric.
+        MatrixSymmetric(
+            const std::initializer_list<std::initializer_list<T>> &list)
+            : order(list.size()), storage(order * (order + 1) / 2) {
+          ensure_registered();
+          size_t i = 0;
+          for (const auto &row : list) {
+            if (row.size() != order) {
+              throw std::invalid_argument("matrix is not square");
+            }
+            std::copy(row.begin() + i, row.end(),
+                      storage.begin() + kernel::packed_row(order, i));
+            ++i;
+          }
+          i = 0;
+          for (const auto &row : list) {
+            for (size_t j = 0; j < i; ++j) {
+              if (!(row.begin()[j] == (*this)(j, i))) {
+                throw std::invalid_argument("matrix is not symmetric");
+              }
+            }
+            ++i;
+          }
+        }
+        explicit MatrixSymmetric(size_t n)
+            : order(n), storage(n * (n + 1) / 2) {
+          ensure_registered();
+        }
+        MatrixSymmetric() = delete;
+
+        // Writes the full matrix to dest[i * rs + j * cs].
+        void unpack(T *dest, std::ptrdiff_t rs, std::ptrdiff_t cs) const {
+          for (size_t i = 0; i < order; ++i) {
+            const T *row = storage.data() + kernel::packed_row(order, i);
+            for (size_t j = i; j < order; ++j) {
+              dest[i * rs + j * cs] = dest[j * rs + i * cs] = row[j - i];
+            }
+          }
+        }
+
+        bool operator==(const MatrixSymmetric &rhs) const {
+          return order == rhs.order &&
+                 parallel::equal(storage.size(), storage.data(),
+                                 rhs.storage.data());
+        }
+        bool operator==(const Base &rhs) const {
+          return Dispatcher<T>::compare(*this, rhs);
+        }
+        Base &operator+=(const Base &rhs) {
+          Dispatcher<T>::add(*this, rhs);
+          return *this;
+        }
+        Base &operator*=(T rhs) {
+          KETCPP_PROFILE_UNARY(scale, *this, storage.size(),
+                               2. * storage.size() * sizeof(T), 0);
+          parallel::scale(storage.size(), rhs, storage.data(), storage.data());
+          return *this;
+        }
+
+        std::unique_ptr<MatrixBase<T>> copy() const {
+          KETCPP_PROFILE_UNARY(copy, *this, 0,
+                               2. * storage.size() * sizeof(T), 1);
+          std::unique_ptr<MatrixBase<T>> copy;
+          copy.reset(new MatrixSymmetric(*this));
+          return std::move(copy);
+        }
+
+        ~MatrixSymmetric() {}
+      };
+
+      // C = alpha * A * A^T + beta * C
+      template <typename T>
+      void syrk(T alpha, const MatrixBase<T> &a, T beta,
+                MatrixSymmetric<T> &c) {
+        if (a.get_num_rows() != c.get_num_rows()) {
+          throw std::invalid_argument("matrix shapes do not match");
+        }
+        std::unique_ptr<MatrixBase<T>> temp;
+        if (!kernel::is_strided(a)) {
+          temp = kernel::to_strided(a);
+        }
+        const MatrixBase<T> &s = temp ? *temp : a;
+        kernel::syrk(s.get_num_rows(), s.get_num_columns(), alpha, s.data(),
+                     s.get_row_stride(), s.get_column_stride(), beta,
+                     c.packed_data());
+      }
+    }
+  }
+}
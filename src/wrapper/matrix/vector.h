@@ -25,25 +25,100 @@
 #include <vector>
 
 #include "wrapper/matrix/base.h"
+#include "wrapper/matrix/dispatch.h"
+#include "wrapper/matrix/gemm.h"
+#include "wrapper/matrix/parallel.h"
+#include "wrapper/matrix/range.h"
+#include "wrapper/matrix/simd.h"
+#include "wrapper/memory/placement.h"
+#include "wrapper/memory/pool.h"
+#include "wrapper/thread/pool.h"
 
 namespace ketcpp {
   namespace wrapper {
     namespace matrix {
-      template <typename T> class MatrixVector : public MatrixBase<T> {
+      // How a MatrixVector lays out and places its storage. padded rounds
+      // the leading dimension up to whole cache lines, and off multiples of
+      // the page size, so that every line starts on a cache line and
+      // walking across lines does not map onto the same cache sets (4K
+      // aliasing). Padded matrices are not contiguous, so routines that need
+      // contiguous storage make a packed copy first.
+      struct StorageOptions {
+        bool padded;
+        memory::Placement placement;
+
+        StorageOptions(
+            bool padded = false,
+            memory::Placement placement = memory::get_default_placement())
+            : padded(padded), placement(placement) {}
+        StorageOptions(memory::Placement placement)
+            : StorageOptions(false, placement) {}
+      };
+
+      namespace kernel {
+        // Padded leading dimension for lines of n elements.
+        template <typename T> size_t get_padded_dimension(size_t n) {
+          constexpr size_t alignment = memory::BufferPool::alignment;
+          constexpr size_t line =
+              sizeof(T) < alignment ? alignment / sizeof(T) : 1;
+          size_t dimension = (n + line - 1) / line * line;
+          if (dimension != 0 &&
+              dimension * sizeof(T) % memory::BufferPool::page_size == 0) {
+            dimension += line;
+          }
+          return dimension;
+        }
+      }
+
+      // Allocator defaults to memory::PoolAllocator<T> and layout to
+      // Layout::row_major (declared in dispatch.h), so that buffers of freed
+      // matrices are recycled.
+      template <typename T, typename Allocator, Layout layout>
+      class MatrixVector
+          : public MatrixBase<T>,
+            public StridedMatrix<MatrixVector<T, Allocator, layout>, T,
+                                 layout> {
       private:
         const size_t num_rows;
         const size_t num_columns;
-        const size_t &row_size = num_columns;
-        const size_t &column_size = num_rows;
+        const size_t row_size = num_columns;
+        const size_t column_size = num_rows;
+        // Distance between consecutive rows (row-major) or columns
+        // (column-major); larger than the line when padded.
+        const size_t leading_dimension;
+        const memory::Placement placement;
+
+        static size_t get_line_size(size_t m, size_t n) {
+          return layout == Layout::row_major ? n : m;
+        }
+        static size_t get_num_lines(size_t m, size_t n) {
+          return layout == Layout::row_major ? m : n;
+        }
 
       public:
         size_t get_num_rows() const { return num_rows; }
         size_t get_num_columns() const { return num_columns; }
         size_t get_row_size() const { return row_size; }
         size_t get_column_size() const { return column_size; }
+        T *data() { return storage.data(); }
+        const T *data() const { return storage.data(); }
+        std::ptrdiff_t get_row_stride() const {
+          return layout == Layout::row_major ? leading_dimension : 1;
+        }
+        std::ptrdiff_t get_column_stride() const {
+          return layout == Layout::row_major ? 1 : leading_dimension;
+        }
+        size_t get_leading_dimension() const { return leading_dimension; }
+        memory::Placement get_placement() const { return placement; }
+        // True unless padded; packed storage holds exactly m * n elements.
+        bool is_packed() const {
+          return leading_dimension == get_line_size(num_rows, num_columns);
+        }
+        constexpr static Layout storage_layout = layout;
 
       private:
-        using vector = std::vector<T>;
+        using vector =
+            std::vector<T, memory::DefaultInitAllocator<Allocator>>;
         vector storage;
         using Base = MatrixBase<T>;
         typedef typename Base::RowVectorIterator RowVectorIterator;
@@ -66,34 +141,33 @@ namespace ketcpp {
           typename std::conditional<
               is_const, typename MatrixVector::vector::const_iterator,
               typename MatrixVector::vector::iterator>::type iterator;
-          const size_t num_rows;
-          const size_t num_columns;
+          const MatrixVector &matrix;
+          // Stride between consecutive positions of this iterator, used to
+          // turn storage distances into element distances.
+          const std::ptrdiff_t step;
 
-        protected:
-          void advance_in_column() { this->iterator += num_columns; }
-          void advance_in_row() { this->iterator++; }
-          unique_ptr row_begin() {
-            return std::move(std::make_unique<GenericIterator>(
-                this->iterator, this->num_rows, this->num_columns));
+          std::ptrdiff_t row_stride() const { return matrix.get_row_stride(); }
+          std::ptrdiff_t column_stride() const {
+            return matrix.get_column_stride();
           }
-          unique_ptr row_end() {
-            return std::move(std::make_unique<GenericIterator>(
-                this->iterator + this->num_columns, this->num_rows,
-                this->num_columns));
+          unique_ptr make(decltype(iterator) it, std::ptrdiff_t s) const {
+            return std::make_unique<GenericIterator>(it, matrix, s);
           }
-          unique_ptr column_begin() {
-            return std::move(std::make_unique<GenericIterator>(
-                this->iterator, this->num_rows, this->num_columns));
+
+        protected:
+          void advance_in_column() { this->iterator += row_stride(); }
+          void advance_in_row() { this->iterator += column_stride(); }
+          unique_ptr row_begin() { return make(iterator, column_stride()); }
+          unique_ptr row_end() {
+            return make(iterator + matrix.num_columns * column_stride(),
+                        column_stride());
           }
+          unique_ptr column_begin() { return make(iterator, row_stride()); }
           unique_ptr column_end() {
-            return std::move(std::make_unique<GenericIterator>(
-                this->iterator + this->num_rows * this->num_columns,
-                this->num_rows, this->num_columns));
-          }
-          unique_ptr copy() {
-            return std::move(std::make_unique<GenericIterator>(
-                this->iterator, this->num_rows, this->num_columns));
+            return make(iterator + matrix.num_rows * row_stride(),
+                        row_stride());
           }
+          unique_ptr copy() { return make(iterator, step); }
           bool operator==(BaseIterator &rhs) const throw(std::bad_cast &) {
             auto &rhs_cast = dynamic_cast<decltype(*this)>(rhs);
             return this->iterator == rhs_cast.iterator;
@@ -105,7 +179,7 @@ namespace ketcpp {
           typename BaseIterator::difference_type
           operator-(const BaseIterator &rhs) const throw(std::bad_cast &) {
             auto &rhs_cast = dynamic_cast<decltype(*this)>(rhs);
-            return this->iterator - rhs_cast.iterator;
+            return (this->iterator - rhs_cast.iterator) / step;
           }
           typename std::conditional<is_const, const T &, T &>::type
           operator*() {
@@ -113,48 +187,54 @@ namespace ketcpp {
           }
 
         public:
-          GenericIterator(decltype(iterator) src, size_t num_rows,
-                          size_t num_columns)
-              : iterator(src), num_rows(num_rows), num_columns(num_columns) {}
+          GenericIterator(decltype(iterator) src, const MatrixVector &matrix,
+                          std::ptrdiff_t step)
+              : iterator(src), matrix(matrix), step(step != 0 ? step : 1) {}
         };
         using Iterator = GenericIterator<false>;
         using ConstIterator = GenericIterator<true>;
 
+        template <typename It, typename Source>
+        std::unique_ptr<It> make_iterator(Source it, size_t offset,
+                                          std::ptrdiff_t step) const {
+          return std::make_unique<It>(it + offset, *this, step);
+        }
+
       protected:
         RowVectorConstIterator row_cbegin() const {
-          return RowVectorConstIterator(std::make_unique<ConstIterator>(
-              storage.cbegin(), num_rows, num_columns));
+          return RowVectorConstIterator(make_iterator<ConstIterator>(
+              storage.cbegin(), 0, get_row_stride()));
         }
         RowVectorConstIterator row_cend() const {
-          return RowVectorConstIterator(
-              std::move(std::make_unique<ConstIterator>(
-                  storage.cend(), num_rows, num_columns)));
+          return RowVectorConstIterator(make_iterator<ConstIterator>(
+              storage.cbegin(), num_rows * get_row_stride(),
+              get_row_stride()));
         }
         ColumnVectorConstIterator column_cbegin() const {
-          return ColumnVectorConstIterator(
-              std::move(std::make_unique<ConstIterator>(
-                  storage.cbegin(), num_rows, num_columns)));
+          return ColumnVectorConstIterator(make_iterator<ConstIterator>(
+              storage.cbegin(), 0, get_column_stride()));
         }
         ColumnVectorConstIterator column_cend() const {
-          return ColumnVectorConstIterator(
-              std::move(std::make_unique<ConstIterator>(
-                  storage.cbegin() + row_size, num_rows, num_columns)));
+          return ColumnVectorConstIterator(make_iterator<ConstIterator>(
+              storage.cbegin(), num_columns * get_column_stride(),
+              get_column_stride()));
         }
         RowVectorIterator row_begin() {
-          return RowVectorIterator(std::make_unique<Iterator>(
-              storage.begin(), num_rows, num_columns));
+          return RowVectorIterator(
+              make_iterator<Iterator>(storage.begin(), 0, get_row_stride()));
         }
         RowVectorIterator row_end() {
-          return RowVectorIterator(std::move(std::make_unique<Iterator>(
-              storage.end(), num_rows, num_columns)));
+          return RowVectorIterator(make_iterator<Iterator>(
+              storage.begin(), num_rows * get_row_stride(), get_row_stride()));
         }
         ColumnVectorIterator column_begin() {
-          return ColumnVectorIterator(std::move(std::make_unique<Iterator>(
-              storage.begin(), num_rows, num_columns)));
+          return ColumnVectorIterator(make_iterator<Iterator>(
+              storage.begin(), 0, get_column_stride()));
         }
         ColumnVectorIterator column_end() {
-          return ColumnVectorIterator(std::move(std::make_unique<Iterator>(
-              storage.begin() + row_size, num_rows, num_columns)));
+          return ColumnVectorIterator(make_iterator<Iterator>(
+              storage.begin(), num_columns * get_column_stride(),
+              get_column_stride()));
         }
 
       private:
@@ -168,61 +248,164 @@ namespace ketcpp {
           return max_size_element->size();
         }
 
+        // Writes the storage for the first time, either with src or with
+        // zeros, on the threads chosen by the placement.
+        void initialize(const T *src) {
+          T *dest = storage.data();
+          const size_t size = storage.size();
+          auto fill = [=](size_t first, size_t last) {
+            if (src != nullptr) {
+              std::copy(src + first, src + last, dest + first);
+            } else {
+              std::fill(dest + first, dest + last, T(0));
+            }
+          };
+          if (placement == memory::Placement::local) {
+            fill(0, size);
+            return;
+          }
+          if (placement == memory::Placement::interleaved) {
+            memory::interleave(dest, size * sizeof(T));
+          }
+          thread::parallel_for(0, size, parallel::grain, fill);
+        }
+
+        // Calls f(first, last) for ranges of whole lines, split over the
+        // thread pool.
+        template <typename F> void for_lines(F &&f) const {
+          const size_t lines = get_num_lines(num_rows, num_columns);
+          const size_t grain =
+              std::max<size_t>(parallel::grain / (leading_dimension + 1), 1);
+          thread::parallel_for(0, lines, grain, std::forward<F>(f));
+        }
+
       public:
         MatrixVector(const std::initializer_list<std::initializer_list<T>> list)
-            : num_rows(list.size()), num_columns(max_size(list)),
-              storage(num_rows * num_columns) {
-          auto dest = storage.begin();
-          for (auto i : list) {
-            std::copy(i.begin(), i.end(), dest);
-            dest += num_columns;
+            : MatrixVector(list.size(), max_size(list)) {
+          size_t i = 0;
+          for (const auto &row : list) {
+            size_t j = 0;
+            for (const T &x : row) {
+              (*this)(i, j++) = x;
+            }
+            ++i;
           }
         }
-        MatrixVector(size_t m, size_t n) : num_rows(m), num_columns(n) {}
+        // Zero-filled m x n matrix.
+        MatrixVector(size_t m, size_t n,
+                     StorageOptions options = StorageOptions())
+            : num_rows(m), num_columns(n),
+              leading_dimension(
+                  options.padded
+                      ? kernel::get_padded_dimension<T>(get_line_size(m, n))
+                      : get_line_size(m, n)),
+              placement(options.placement),
+              storage(get_num_lines(m, n) * leading_dimension) {
+          initialize(nullptr);
+        }
+        // Copies keep the padding and placement of src.
+        MatrixVector(const MatrixVector &src)
+            : num_rows(src.num_rows), num_columns(src.num_columns),
+              leading_dimension(src.leading_dimension),
+              placement(src.placement), storage(src.storage.size()) {
+          initialize(src.storage.data());
+        }
+        MatrixVector(MatrixVector &&src) = default;
+        // Copies src, which may be any backend or layout; converting between
+        // layouts this way is a cache-blocked transpose.
+        explicit MatrixVector(const Base &src)
+            : MatrixVector(src.get_num_rows(), src.get_num_columns()) {
+          Dispatcher<T>::convert(*this, src);
+        }
         MatrixVector() = delete;
 
+        // Padding is never written, so matrices with the same leading
+        // dimension compare as flat arrays.
         bool operator==(const MatrixVector &rhs) const {
-          return std::equal(this->storage.cbegin(), this->storage.cend(),
-                            rhs.storage.cbegin());
-        }
-        Base &operator+=(const Base &rhsbase) {
-          try {
-            auto &rhs = dynamic_cast<const MatrixVector &>(rhsbase);
-            std::transform(this->storage.cbegin(), this->storage.cend(),
-                           rhs.storage.cbegin(), this->storage.begin(),
-                           [](T l, T r) -> T { return l + r; });
-            return *this;
-          } catch (std::bad_cast &ex) {
-            return Base::operator+=(rhsbase);
+          if (leading_dimension != rhs.leading_dimension ||
+              storage.size() != rhs.storage.size()) {
+            return Dispatcher<T>::compare(*this, rhs);
           }
+          return parallel::equal(this->storage.size(), this->storage.data(),
+                                 rhs.storage.data());
+        }
+        bool operator==(const Base &rhs) const {
+          return Dispatcher<T>::compare(*this, rhs);
+        }
+        Base &operator+=(const Base &rhs) {
+          Dispatcher<T>::add(*this, rhs);
+          return *this;
         }
 
         Base &operator*=(T rhs) {
-          std::transform(this->storage.cbegin(), this->storage.cend(),
-                         this->storage.begin(),
-                         [rhs](T l) -> T { return l * rhs; });
+          KETCPP_PROFILE_UNARY(scale, *this, storage.size(),
+                               2. * storage.size() * sizeof(T), 0);
+          if (is_packed()) {
+            parallel::scale(this->storage.size(), rhs, this->storage.data(),
+                            this->storage.data());
+            return *this;
+          }
+          const size_t line = get_line_size(num_rows, num_columns);
+          T *const base = storage.data();
+          const size_t ld = leading_dimension;
+          for_lines([=](size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i) {
+              simd::scale(line, rhs, base + i * ld, base + i * ld);
+            }
+          });
           return *this;
         }
+        // Sum of element-wise products
+        T dot(const MatrixVector &rhs) const {
+          if (leading_dimension == rhs.leading_dimension) {
+            return parallel::dot(this->storage.size(), this->storage.data(),
+                                 rhs.storage.data());
+          }
+          const size_t line = get_line_size(num_rows, num_columns);
+          const T *const x = storage.data();
+          const T *const y = rhs.storage.data();
+          const size_t ldx = leading_dimension, ldy = rhs.leading_dimension;
+          return thread::parallel_reduce(
+              0, get_num_lines(num_rows, num_columns),
+              std::max<size_t>(parallel::grain / (line + 1), 1), T(0),
+              [=](size_t first, size_t last) {
+                T sum = 0;
+                for (size_t i = first; i < last; ++i) {
+                  sum += simd::dot(line, x + i * ldx, y + i * ldy);
+                }
+                return sum;
+              },
+              [](T l, T r) { return l + r; });
+        }
+        // Frobenius norm
+        T norm() const {
+          return parallel::norm(this->storage.size(), this->storage.data());
+        }
         std::unique_ptr<MatrixBase<T>> operator*(T rhs) {
           auto new_ptr = std::move(this->copy());
           auto &new_matrix = dynamic_cast<decltype(*this) &>(*new_ptr);
           new_matrix *= rhs;
           return std::move(new_ptr);
         }
-        MatrixVector<T> operator*(const MatrixVector<T> &rhs) const {
-          MatrixVector<T> buf(this->num_rows, rhs.num_columns);
-          auto lr = this->rows().begin();
-          for (auto br = buf.rows().begin(); br != buf.rows().end();
-               ++br, ++lr) {
-            auto rc = rhs.columns().begin();
-            for (auto b = br.begin(); b != br.end(); ++b, ++rc) {
-              *b = std::inner_product(lr.begin(), lr.end(), rc.begin(), 0);
-            }
-          }
+        MatrixVector operator*(const MatrixVector &rhs) const {
+          KETCPP_PROFILE_BINARY(multiply, *this, rhs,
+                                2. * num_rows * num_columns * rhs.num_columns,
+                                (storage.size() + rhs.storage.size() +
+                                 double(num_rows) * rhs.num_columns) *
+                                    sizeof(T),
+                                1);
+          MatrixVector buf(this->num_rows, rhs.num_columns);
+          gemm<T>(this->num_rows, rhs.num_columns, this->num_columns, T(1),
+                  this->storage.data(), get_row_stride(), get_column_stride(),
+                  rhs.storage.data(), rhs.get_row_stride(),
+                  rhs.get_column_stride(), T(0), buf.storage.data(),
+                  buf.get_row_stride(), buf.get_column_stride());
           return std::move(buf);
         }
 
         std::unique_ptr<MatrixBase<T>> copy() const {
+          KETCPP_PROFILE_UNARY(copy, *this, 0,
+                               2. * storage.size() * sizeof(T), 1);
           std::unique_ptr<MatrixBase<T>> copy;
           copy.reset(new MatrixVector(*this));
           return std::move(copy);
@@ -230,6 +413,15 @@ namespace ketcpp {
 
         ~MatrixVector() {}
       };
+
+      template <typename T, typename Allocator, Layout layout>
+      constexpr Layout MatrixVector<T, Allocator, layout>::storage_layout;
+
+      // Dense column-major matrix, e.g. for LAPACK-style routines that
+      // expect Fortran order.
+      template <typename T>
+      using MatrixVectorColumnMajor =
+          MatrixVector<T, memory::PoolAllocator<T>, Layout::column_major>;
     }
   }
 }
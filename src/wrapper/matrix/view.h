@@ -0,0 +1,412 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "wrapper/matrix/base.h"
+#include "wrapper/matrix/dispatch.h"
+#include "wrapper/matrix/range.h"
+
+namespace ketcpp {
+  namespace wrapper {
+    namespace matrix {
+      // Non-owning view of elements of a strided matrix: element (i, j) is
+      // data()[i * get_row_stride() + j * get_column_stride()], so
+      // transposes, blocks, every k-th row or column and diagonals are
+      // all described by a pointer and two strides without copying. Views
+      // are strided operands, so the Dispatcher and gemm read them in
+      // place; writes go through to the viewed matrix, which must outlive
+      // the view. copy() materializes a MatrixVector.
+      //
+      // MatrixView<const T> is a read-only view, still a MatrixBase<T>: its
+      // elements are only handed out as const references, and assignment,
+      // += and *= throw logic_error. Elements reached through its mutable
+      // generic iterators are copies, as for the lower triangle of
+      // MatrixSymmetric, so writes to them are dropped.
+      template <typename U>
+      class MatrixView : public MatrixBase<std::remove_const_t<U>> {
+      private:
+        using T = std::remove_const_t<U>;
+        constexpr static bool is_read_only = std::is_const<U>::value;
+        U *pointer;
+
+        static T *writable(T *p) { return p; }
+        static T *writable(const T *) {
+          throw std::logic_error("view is read-only");
+        }
+        size_t num_rows;
+        size_t num_columns;
+        std::ptrdiff_t row_stride;
+        std::ptrdiff_t column_stride;
+
+      public:
+        size_t get_num_rows() const { return num_rows; }
+        size_t get_num_columns() const { return num_columns; }
+        size_t get_row_size() const { return num_columns; }
+        size_t get_column_size() const { return num_rows; }
+        T *data() { return writable(pointer); }
+        const T *data() const { return pointer; }
+        std::ptrdiff_t get_row_stride() const { return row_stride; }
+        std::ptrdiff_t get_column_stride() const { return column_stride; }
+
+        U &operator()(size_t i, size_t j) {
+          return pointer[i * row_stride + j * column_stride];
+        }
+        const T &operator()(size_t i, size_t j) const {
+          return pointer[i * row_stride + j * column_stride];
+        }
+
+      private:
+        template <typename V> static auto make_lines(V *ptr, size_t count,
+                                                     std::ptrdiff_t line_stride,
+                                                     std::ptrdiff_t stride,
+                                                     size_t length) {
+          using Lines = LineIterator<V, StrideIterator<V>>;
+          return Range<Lines>(Lines(ptr, line_stride, stride, length),
+                              Lines(ptr + count * line_stride, line_stride,
+                                    stride, length));
+        }
+
+      public:
+        // Allocation-free iteration like StridedMatrix::fast_rows, with
+        // strided elements along rows as well.
+        auto fast_rows() {
+          return make_lines(pointer, num_rows, row_stride, column_stride,
+                            num_columns);
+        }
+        auto fast_rows() const {
+          return make_lines<const T>(pointer, num_rows, row_stride,
+                                     column_stride, num_columns);
+        }
+        auto fast_columns() {
+          return make_lines(pointer, num_columns, column_stride, row_stride,
+                            num_rows);
+        }
+        auto fast_columns() const {
+          return make_lines<const T>(pointer, num_columns, column_stride,
+                                     row_stride, num_rows);
+        }
+        auto fast_row(size_t i) { return fast_rows()[i]; }
+        auto fast_row(size_t i) const { return fast_rows()[i]; }
+        auto fast_column(size_t j) { return fast_columns()[j]; }
+        auto fast_column(size_t j) const { return fast_columns()[j]; }
+
+      private:
+        using Base = MatrixBase<T>;
+        typedef typename Base::RowVectorIterator RowVectorIterator;
+        typedef typename Base::ColumnVectorIterator ColumnVectorIterator;
+        typedef typename Base::RowVectorConstIterator RowVectorConstIterator;
+        typedef
+            typename Base::ColumnVectorConstIterator ColumnVectorConstIterator;
+
+        // Iterators carry the shape and strides of the view, so they stay
+        // valid after a temporary view is gone. step is the stride between
+        // consecutive positions of this iterator, used to turn pointer
+        // differences into distances.
+        struct Shape {
+          size_t num_rows, num_columns;
+          std::ptrdiff_t row_stride, column_stride;
+        };
+        Shape get_shape() const {
+          return Shape{num_rows, num_columns, row_stride, column_stride};
+        }
+
+        template <bool is_const>
+        class GenericIterator
+            : public Base::template BaseGenericIterator<is_const> {
+          using BaseIterator =
+              typename Base::template BaseGenericIterator<is_const>;
+          using unique_ptr = std::unique_ptr<BaseIterator>;
+          typename std::conditional<is_const, const T *, U *>::type iterator;
+          const Shape shape;
+          const std::ptrdiff_t step;
+          T scratch;
+          using Reference =
+              typename std::conditional<is_const, const T &, T &>::type;
+
+          Reference element(std::false_type) { return *iterator; }
+          Reference element(std::true_type) {
+            scratch = *iterator;
+            return scratch;
+          }
+
+          unique_ptr make(decltype(iterator) p, std::ptrdiff_t s) const {
+            return std::make_unique<GenericIterator>(p, shape, s);
+          }
+
+        protected:
+          void advance_in_column() { this->iterator += shape.row_stride; }
+          void advance_in_row() { this->iterator += shape.column_stride; }
+          unique_ptr row_begin() { return make(iterator, shape.column_stride); }
+          unique_ptr row_end() {
+            return make(iterator + shape.num_columns * shape.column_stride,
+                        shape.column_stride);
+          }
+          unique_ptr column_begin() {
+            return make(iterator, shape.row_stride);
+          }
+          unique_ptr column_end() {
+            return make(iterator + shape.num_rows * shape.row_stride,
+                        shape.row_stride);
+          }
+          unique_ptr copy() { return make(iterator, step); }
+          bool operator==(BaseIterator &rhs) const throw(std::bad_cast &) {
+            auto &rhs_cast = dynamic_cast<decltype(*this)>(rhs);
+            return this->iterator == rhs_cast.iterator;
+          }
+          bool operator!=(BaseIterator &rhs) const throw(std::bad_cast &) {
+            auto &rhs_cast = dynamic_cast<decltype(*this)>(rhs);
+            return this->iterator != rhs_cast.iterator;
+          }
+          typename BaseIterator::difference_type
+          operator-(const BaseIterator &rhs) const throw(std::bad_cast &) {
+            auto &rhs_cast = dynamic_cast<decltype(*this)>(rhs);
+            return (this->iterator - rhs_cast.iterator) / step;
+          }
+          Reference operator*() {
+            return element(std::integral_constant<bool, !is_const &&
+                                                            is_read_only>());
+          }
+
+        public:
+          GenericIterator(decltype(iterator) src, const Shape &shape,
+                          std::ptrdiff_t step)
+              : iterator(src), shape(shape), step(step != 0 ? step : 1) {}
+        };
+        using Iterator = GenericIterator<false>;
+        using ConstIterator = GenericIterator<true>;
+
+        template <typename It, typename V>
+        std::unique_ptr<It> make_iterator(V *p, std::ptrdiff_t step) const {
+          return std::make_unique<It>(p, get_shape(), step);
+        }
+
+      protected:
+        RowVectorConstIterator row_cbegin() const {
+          return RowVectorConstIterator(
+              make_iterator<ConstIterator>(pointer, row_stride));
+        }
+        RowVectorConstIterator row_cend() const {
+          return RowVectorConstIterator(make_iterator<ConstIterator>(
+              pointer + num_rows * row_stride, row_stride));
+        }
+        ColumnVectorConstIterator column_cbegin() const {
+          return ColumnVectorConstIterator(
+              make_iterator<ConstIterator>(pointer, column_stride));
+        }
+        ColumnVectorConstIterator column_cend() const {
+          return ColumnVectorConstIterator(make_iterator<ConstIterator>(
+              pointer + num_columns * column_stride, column_stride));
+        }
+        RowVectorIterator row_begin() {
+          return RowVectorIterator(
+              make_iterator<Iterator>(pointer, row_stride));
+        }
+        RowVectorIterator row_end() {
+          return RowVectorIterator(make_iterator<Iterator>(
+              pointer + num_rows * row_stride, row_stride));
+        }
+        ColumnVectorIterator column_begin() {
+          return ColumnVectorIterator(
+              make_iterator<Iterator>(pointer, column_stride));
+        }
+        ColumnVectorIterator column_end() {
+          return ColumnVectorIterator(make_iterator<Iterator>(
+              pointer + num_columns * column_stride, column_stride));
+        }
+
+      public:
+        MatrixView(U *data, size_t m, size_t n, std::ptrdiff_t row_stride,
+                   std::ptrdiff_t column_stride)
+            : pointer(data), num_rows(m), num_columns(n),
+              row_stride(row_stride), column_stride(column_stride) {}
+        MatrixView(const MatrixView &) = default;
+        // Assignment writes elements through, as for other backends, rather
+        // than rebinding the view.
+        MatrixView &operator=(const MatrixView &rhs) {
+          Dispatcher<T>::convert(*this, rhs);
+          return *this;
+        }
+        MatrixView &operator=(const Base &rhs) {
+          Dispatcher<T>::convert(*this, rhs);
+          return *this;
+        }
+
+        bool operator==(const Base &rhs) const {
+          return Dispatcher<T>::compare(*this, rhs);
+        }
+        Base &operator+=(const Base &rhs) {
+          Dispatcher<T>::add(*this, rhs);
+          return *this;
+        }
+        Base &operator*=(T rhs) {
+          T *p = data();
+          KETCPP_PROFILE_UNARY(scale, *this, kernel::size_of(*this),
+                               2. * kernel::size_of(*this) * sizeof(T), 0);
+          if (kernel::is_contiguous(*this)) {
+            parallel::scale(num_rows * num_columns, rhs, p, p);
+            return *this;
+          }
+          for (size_t i = 0; i < num_rows; ++i) {
+            kernel::strided_scale(num_columns, rhs, p + i * row_stride,
+                                  column_stride, p + i * row_stride,
+                                  column_stride);
+          }
+          return *this;
+        }
+
+        std::unique_ptr<MatrixBase<T>> copy() const {
+          KETCPP_PROFILE_UNARY(copy, *this, 0,
+                               2. * kernel::size_of(*this) * sizeof(T), 1);
+          std::unique_ptr<MatrixBase<T>> copy(
+              new MatrixVector<T>(num_rows, num_columns));
+          Dispatcher<T>::convert(*copy, *this);
+          return copy;
+        }
+      };
+
+      namespace kernel {
+        template <typename T> void check_strided(const MatrixBase<T> &a) {
+          if (!is_strided(a)) {
+            throw std::invalid_argument("matrix has no strided storage");
+          }
+        }
+
+        // Shared bodies of the view functions below. B is MatrixBase<T> or
+        // const MatrixBase<T>; the view is over the element type that the
+        // data() of B hands out, so views of const matrices are read-only.
+        template <typename B>
+        using ViewOf = MatrixView<
+            std::remove_pointer_t<decltype(std::declval<B &>().data())>>;
+
+        template <typename B> ViewOf<B> make_transpose(B &a) {
+          check_strided(a);
+          return ViewOf<B>(a.data(), a.get_num_columns(), a.get_num_rows(),
+                           a.get_column_stride(), a.get_row_stride());
+        }
+        template <typename B>
+        ViewOf<B> make_row_view(B &a, size_t first, size_t count,
+                                size_t step) {
+          check_strided(a);
+          if (step == 0 || (count > 0 && first + (count - 1) * step >=
+                                             a.get_num_rows())) {
+            throw std::out_of_range("rows out of range");
+          }
+          return ViewOf<B>(a.data() + first * a.get_row_stride(), count,
+                           a.get_num_columns(), step * a.get_row_stride(),
+                           a.get_column_stride());
+        }
+        template <typename B>
+        ViewOf<B> make_column_view(B &a, size_t first, size_t count,
+                                   size_t step) {
+          check_strided(a);
+          if (step == 0 || (count > 0 && first + (count - 1) * step >=
+                                             a.get_num_columns())) {
+            throw std::out_of_range("columns out of range");
+          }
+          return ViewOf<B>(a.data() + first * a.get_column_stride(),
+                           a.get_num_rows(), count, a.get_row_stride(),
+                           step * a.get_column_stride());
+        }
+        template <typename B>
+        ViewOf<B> make_block(B &a, size_t row, size_t column,
+                             size_t num_rows, size_t num_columns) {
+          check_strided(a);
+          if (row + num_rows > a.get_num_rows() ||
+              column + num_columns > a.get_num_columns()) {
+            throw std::out_of_range("block out of range");
+          }
+          return ViewOf<B>(a.data() + row * a.get_row_stride() +
+                               column * a.get_column_stride(),
+                           num_rows, num_columns, a.get_row_stride(),
+                           a.get_column_stride());
+        }
+        template <typename B> ViewOf<B> make_diagonal(B &a) {
+          check_strided(a);
+          return ViewOf<B>(a.data(),
+                           std::min(a.get_num_rows(), a.get_num_columns()), 1,
+                           a.get_row_stride() + a.get_column_stride(), 1);
+        }
+      }
+
+      template <typename T> MatrixView<T> transpose(MatrixBase<T> &a) {
+        return kernel::make_transpose(a);
+      }
+      template <typename T>
+      MatrixView<const T> transpose(const MatrixBase<T> &a) {
+        return kernel::make_transpose(a);
+      }
+
+      // count rows of a starting at row first, step rows apart.
+      template <typename T>
+      MatrixView<T> row_view(MatrixBase<T> &a, size_t first, size_t count,
+                             size_t step = 1) {
+        return kernel::make_row_view(a, first, count, step);
+      }
+      template <typename T>
+      MatrixView<const T> row_view(const MatrixBase<T> &a, size_t first,
+                                   size_t count, size_t step = 1) {
+        return kernel::make_row_view(a, first, count, step);
+      }
+
+      // count columns of a starting at column first, step columns apart.
+      template <typename T>
+      MatrixView<T> column_view(MatrixBase<T> &a, size_t first, size_t count,
+                                size_t step = 1) {
+        return kernel::make_column_view(a, first, count, step);
+      }
+      template <typename T>
+      MatrixView<const T> column_view(const MatrixBase<T> &a, size_t first,
+                                      size_t count, size_t step = 1) {
+        return kernel::make_column_view(a, first, count, step);
+      }
+
+      // The num_rows x num_columns block of a whose top-left element is
+      // (row, column). +=, *= and gemm into the block update that region
+      // of a in place.
+      template <typename T>
+      MatrixView<T> block(MatrixBase<T> &a, size_t row, size_t column,
+                          size_t num_rows, size_t num_columns) {
+        return kernel::make_block(a, row, column, num_rows, num_columns);
+      }
+      template <typename T>
+      MatrixView<const T> block(const MatrixBase<T> &a, size_t row,
+                                size_t column, size_t num_rows,
+                                size_t num_columns) {
+        return kernel::make_block(a, row, column, num_rows, num_columns);
+      }
+
+      // The main diagonal of a as a column vector.
+      template <typename T> MatrixView<T> diagonal(MatrixBase<T> &a) {
+        return kernel::make_diagonal(a);
+      }
+      template <typename T>
+      MatrixView<const T> diagonal(const MatrixBase<T> &a) {
+        return kernel::make_diagonal(a);
+      }
+    }
+  }
+}
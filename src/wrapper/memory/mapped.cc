@@ -0,0 +1,192 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <mutex>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "wrapper/memory/mapped.h"
+
+namespace ketcpp {
+  namespace wrapper {
+    namespace memory {
+      namespace {
+        std::mutex scratch_mutex;
+
+        std::string &scratch_directory() {
+          static std::string directory = [] {
+            for (const char *name : {"KETCPP_SCRATCH_DIR", "TMPDIR"}) {
+              const char *value = std::getenv(name);
+              if (value != nullptr && *value != '\0') {
+                return std::string(value);
+              }
+            }
+            return std::string("/tmp");
+          }();
+          return directory;
+        }
+
+        [[noreturn]] void throw_errno(const char *what) {
+          throw std::system_error(errno, std::generic_category(), what);
+        }
+
+        int to_madvise(Advice advice) {
+          switch (advice) {
+          case Advice::sequential:
+            return MADV_SEQUENTIAL;
+          case Advice::random:
+            return MADV_RANDOM;
+          case Advice::will_need:
+            return MADV_WILLNEED;
+          case Advice::dont_need:
+            return MADV_DONTNEED;
+          default:
+            return MADV_NORMAL;
+          }
+        }
+
+        // Closes the descriptor once the mapping holds the file.
+        struct FileDescriptor {
+          int fd;
+          ~FileDescriptor() { ::close(fd); }
+        };
+      }
+
+      MappedFile::MappedFile(size_t bytes)
+          : address(nullptr), length(0), sharing(Sharing::shared) {
+        std::string path = get_scratch_directory() + "/ketcpp-XXXXXX";
+        std::vector<char> name(path.begin(), path.end());
+        name.push_back('\0');
+        const int fd = ::mkstemp(name.data());
+        if (fd < 0) {
+          throw_errno("mkstemp");
+        }
+        FileDescriptor file{fd};
+        ::unlink(name.data());
+        map(fd, bytes);
+      }
+
+      MappedFile::MappedFile(const std::string &path, size_t bytes,
+                             Sharing sharing)
+          : address(nullptr), length(0), sharing(sharing) {
+        const int fd = sharing == Sharing::shared
+                           ? ::open(path.c_str(), O_RDWR | O_CREAT, 0644)
+                           : ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+          throw_errno("open");
+        }
+        FileDescriptor file{fd};
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+          throw_errno("fstat");
+        }
+        if (sharing == Sharing::private_copy && size_t(st.st_size) < bytes) {
+          throw std::runtime_error("file is shorter than the mapping");
+        }
+        map(fd, std::max(bytes, size_t(st.st_size)));
+      }
+
+      MappedFile::MappedFile(MappedFile &&src)
+          : address(src.address), length(src.length), sharing(src.sharing) {
+        src.address = nullptr;
+        src.length = 0;
+      }
+
+      MappedFile::~MappedFile() {
+        if (address != nullptr) {
+          ::munmap(address, length);
+        }
+      }
+
+      // Zero-sized files are mapped as one byte, since mmap rejects empty
+      // mappings. Private mappings are writable even when fd is read-only.
+      void MappedFile::map(int fd, size_t bytes) {
+        bytes = std::max<size_t>(bytes, 1);
+        if (sharing == Sharing::shared) {
+          struct stat st;
+          if (::fstat(fd, &st) != 0) {
+            throw_errno("fstat");
+          }
+          if (size_t(st.st_size) < bytes && ::ftruncate(fd, bytes) != 0) {
+            throw_errno("ftruncate");
+          }
+        }
+        const int flags = sharing == Sharing::shared ? MAP_SHARED : MAP_PRIVATE;
+        void *ptr =
+            ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, flags, fd, 0);
+        if (ptr == MAP_FAILED) {
+          throw_errno("mmap");
+        }
+        address = ptr;
+        length = bytes;
+      }
+
+      void MappedFile::advise(size_t offset, size_t bytes,
+                              Advice advice) const {
+        if (address == nullptr || offset >= length || bytes == 0) {
+          return;
+        }
+        static const size_t page = ::sysconf(_SC_PAGESIZE);
+        size_t first = offset / page * page;
+        size_t last = std::min(offset + bytes, length);
+        if (advice == Advice::dont_need) {
+          if (sharing == Sharing::private_copy) {
+            return;
+          }
+          // Inward, so that pages shared with data outside the range stay.
+          // The partial page at the end of the mapping holds nothing else.
+          first = (offset + page - 1) / page * page;
+          if (last < length) {
+            last = last / page * page;
+          }
+          if (first >= last) {
+            return;
+          }
+        }
+        ::madvise(static_cast<char *>(address) + first, last - first,
+                  to_madvise(advice));
+      }
+
+      void MappedFile::sync() const {
+        if (address != nullptr && ::msync(address, length, MS_SYNC) != 0) {
+          throw_errno("msync");
+        }
+      }
+
+      std::string MappedFile::get_scratch_directory() {
+        std::lock_guard<std::mutex> lock(scratch_mutex);
+        return scratch_directory();
+      }
+
+      void MappedFile::set_scratch_directory(const std::string &path) {
+        std::lock_guard<std::mutex> lock(scratch_mutex);
+        scratch_directory() = path;
+      }
+    }
+  }
+}
@@ -0,0 +1,83 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace ketcpp {
+  namespace wrapper {
+    namespace memory {
+      // Access pattern hints passed on to madvise.
+      enum class Advice { normal, sequential, random, will_need, dont_need };
+
+      // How a named file is mapped. shared writes through to the file.
+      // private_copy opens the file read-only and maps it copy-on-write:
+      // writes stay in this process, and the file is never grown.
+      enum class Sharing { shared, private_copy };
+
+      // A file mapped writable into memory. Scratch files are created in
+      // the scratch directory and unlinked right away, so that the kernel
+      // reclaims them when the mapping goes away; named files persist.
+      class MappedFile {
+      public:
+        // Maps a new scratch file of the given size.
+        explicit MappedFile(size_t bytes);
+        // Maps path, creating it or growing it to at least bytes. With
+        // bytes zero an existing file is mapped at its current size. With
+        // Sharing::private_copy the file must exist and hold at least
+        // bytes, or runtime_error is thrown.
+        MappedFile(const std::string &path, size_t bytes,
+                   Sharing sharing = Sharing::shared);
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+        MappedFile(MappedFile &&src);
+        ~MappedFile();
+
+        void *data() { return address; }
+        const void *data() const { return address; }
+        size_t size() const { return length; }
+
+        // Applies advice to the pages overlapping [offset, offset + bytes).
+        // dont_need drops the pages from this process only, so it covers
+        // only the pages lying wholly inside the range; their contents stay
+        // in the file. It is ignored for Sharing::private_copy, where
+        // dropping a page would discard the writes made to it.
+        void advise(size_t offset, size_t bytes, Advice advice) const;
+        void advise(Advice advice) const { advise(0, length, advice); }
+        // Writes dirty pages back to the file; does nothing for
+        // Sharing::private_copy.
+        void sync() const;
+
+        // Directory for scratch files; read from KETCPP_SCRATCH_DIR on
+        // first use, falling back to TMPDIR and then /tmp.
+        static std::string get_scratch_directory();
+        static void set_scratch_directory(const std::string &path);
+
+      private:
+        void *address;
+        size_t length;
+        Sharing sharing;
+
+        void map(int fd, size_t bytes);
+      };
+    }
+  }
+}
@@ -0,0 +1,136 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "wrapper/memory/placement.h"
+#include "wrapper/memory/pool.h"
+
+namespace ketcpp {
+  namespace wrapper {
+    namespace memory {
+      namespace {
+        // From linux/mempolicy.h, which is not always installed.
+        constexpr int mpol_interleave = 3;
+
+        Placement parse_placement(const char *value) {
+          if (value != nullptr) {
+            if (std::strcmp(value, "first_touch") == 0) {
+              return Placement::first_touch;
+            }
+            if (std::strcmp(value, "interleaved") == 0) {
+              return Placement::interleaved;
+            }
+          }
+          return Placement::local;
+        }
+
+        std::atomic<Placement> &default_placement() {
+          static std::atomic<Placement> placement(
+              parse_placement(std::getenv("KETCPP_PLACEMENT")));
+          return placement;
+        }
+
+        // Parses a node list such as "0-1,4" from sysfs.
+        std::vector<size_t> read_nodes() {
+          std::vector<size_t> nodes;
+          std::ifstream file("/sys/devices/system/node/online");
+          std::string list;
+          if (!std::getline(file, list)) {
+            return nodes;
+          }
+          const char *p = list.c_str();
+          while (*p != '\0') {
+            char *end;
+            const size_t first = std::strtoul(p, &end, 10);
+            if (end == p) {
+              break;
+            }
+            size_t last = first;
+            p = end;
+            if (*p == '-') {
+              last = std::strtoul(p + 1, &end, 10);
+              p = end;
+            }
+            for (size_t node = first; node <= last; ++node) {
+              nodes.push_back(node);
+            }
+            if (*p == ',') {
+              ++p;
+            }
+          }
+          return nodes;
+        }
+
+        const std::vector<size_t> &get_nodes() {
+          static const std::vector<size_t> nodes = read_nodes();
+          return nodes;
+        }
+      }
+
+      Placement get_default_placement() { return default_placement(); }
+
+      void set_default_placement(Placement placement) {
+        default_placement() = placement;
+      }
+
+      size_t get_num_nodes() {
+        return std::max<size_t>(get_nodes().size(), 1);
+      }
+
+      bool interleave(void *ptr, size_t bytes) {
+#if defined(__linux__) && defined(SYS_mbind)
+        const auto &nodes = get_nodes();
+        if (nodes.size() < 2) {
+          return false;
+        }
+        // mbind only takes whole pages; a partial page at the front stays
+        // with the first toucher.
+        const size_t page = BufferPool::page_size;
+        const auto address = reinterpret_cast<std::uintptr_t>(ptr);
+        const std::uintptr_t first = (address + page - 1) / page * page;
+        if (first >= address + bytes) {
+          return false;
+        }
+        constexpr size_t bits = sizeof(unsigned long) * CHAR_BIT;
+        std::vector<unsigned long> mask(nodes.back() / bits + 1, 0);
+        for (size_t node : nodes) {
+          mask[node / bits] |= 1ul << (node % bits);
+        }
+        return ::syscall(SYS_mbind, first, address + bytes - first,
+                         mpol_interleave, mask.data(),
+                         mask.size() * bits + 1, 0) == 0;
+#else
+        return false;
+#endif
+      }
+    }
+  }
+}
@@ -0,0 +1,95 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+
+namespace ketcpp {
+  namespace wrapper {
+    namespace memory {
+      // Where the pages of a new matrix end up on a NUMA machine. Linux puts
+      // a page on the node of the thread that first writes it, so local
+      // keeps the whole matrix next to the constructing thread. first_touch
+      // initializes the storage on the thread pool, split the same way as
+      // the element-wise kernels, so that each part lands next to the
+      // threads that work on it. interleaved spreads the pages round-robin
+      // over all nodes, for matrices used by every thread alike; it falls
+      // back to first_touch where the kernel refuses. Buffers recycled by
+      // the BufferPool keep the pages they already have.
+      enum class Placement { local, first_touch, interleaved };
+
+      // Placement of matrices that do not ask for one; read from
+      // KETCPP_PLACEMENT (local, first_touch or interleaved) on first use,
+      // falling back to local.
+      Placement get_default_placement();
+      void set_default_placement(Placement placement);
+
+      // Number of online NUMA nodes; 1 where the topology is unknown.
+      size_t get_num_nodes();
+
+      // Asks the kernel to interleave the pages of [ptr, ptr + bytes) that
+      // have not been touched yet over all online nodes. Returns false if
+      // the policy was not applied, e.g. on a single node or without mbind.
+      bool interleave(void *ptr, size_t bytes);
+
+      // Allocator adaptor that default-initializes elements instead of
+      // value-initializing them, so that std::vector<T>(n) leaves trivial
+      // elements untouched and their pages unplaced until the owner writes
+      // them.
+      template <typename Allocator>
+      class DefaultInitAllocator : public Allocator {
+        using Traits = std::allocator_traits<Allocator>;
+
+      public:
+        template <typename U> struct rebind {
+          using other = DefaultInitAllocator<
+              typename Traits::template rebind_alloc<U>>;
+        };
+
+        using Allocator::Allocator;
+        DefaultInitAllocator() = default;
+        DefaultInitAllocator(const Allocator &allocator)
+            : Allocator(allocator) {}
+
+        template <typename U> void construct(U *ptr) {
+          ::new (static_cast<void *>(ptr)) U;
+        }
+        template <typename U, typename... Args>
+        void construct(U *ptr, Args &&... args) {
+          Allocator &allocator = *this;
+          Traits::construct(allocator, ptr, std::forward<Args>(args)...);
+        }
+      };
+      template <typename A, typename B>
+      bool operator==(const DefaultInitAllocator<A> &lhs,
+                      const DefaultInitAllocator<B> &rhs) {
+        return static_cast<const A &>(lhs) == static_cast<const B &>(rhs);
+      }
+      template <typename A, typename B>
+      bool operator!=(const DefaultInitAllocator<A> &lhs,
+                      const DefaultInitAllocator<B> &rhs) {
+        return !(lhs == rhs);
+      }
+    }
+  }
+}
@@ -0,0 +1,186 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#include "wrapper/memory/pool.h"
+
+namespace ketcpp {
+  namespace wrapper {
+    namespace memory {
+      namespace {
+        void *system_allocate(size_t bytes, size_t alignment) {
+          void *ptr = nullptr;
+          if (::posix_memalign(&ptr, alignment, bytes) != 0) {
+            throw std::bad_alloc();
+          }
+          return ptr;
+        }
+      }
+
+      // Per-thread free lists, handed back to the shared pool when the
+      // thread exits.
+      class BufferPool::ThreadCache {
+        BufferPool &pool;
+        FreeLists free_lists;
+        static thread_local bool destroyed;
+
+      public:
+        ThreadCache(BufferPool &pool) : pool(pool) {}
+        ~ThreadCache() {
+          destroyed = true;
+          for (auto &list : free_lists) {
+            for (void *ptr : list.second) {
+              pool.put(ptr, list.first);
+            }
+          }
+        }
+        void *take(size_t size) {
+          auto it = free_lists.find(size);
+          if (it == free_lists.end() || it->second.empty()) {
+            return nullptr;
+          }
+          void *ptr = it->second.back();
+          it->second.pop_back();
+          return ptr;
+        }
+        bool put(void *ptr, size_t size) {
+          auto &list = free_lists[size];
+          if (list.size() >= thread_cache_size) {
+            return false;
+          }
+          list.push_back(ptr);
+          return true;
+        }
+
+        // Returns nullptr once the cache of this thread has been destroyed,
+        // e.g. when a static matrix is freed at program exit.
+        static ThreadCache *get(BufferPool &pool) {
+          if (destroyed) {
+            return nullptr;
+          }
+          thread_local ThreadCache cache(pool);
+          return &cache;
+        }
+      };
+      thread_local bool BufferPool::ThreadCache::destroyed = false;
+
+      constexpr size_t BufferPool::min_bytes;
+      constexpr size_t BufferPool::thread_cache_size;
+      constexpr size_t BufferPool::alignment;
+      constexpr size_t BufferPool::page_size;
+
+      BufferPool::BufferPool()
+          : hits(0), misses(0), cached_bytes(0), limit(size_t(1) << 30) {}
+
+      BufferPool &BufferPool::get_instance() {
+        // Never destroyed, so that thread caches can flush into it at any
+        // point of program exit.
+        static BufferPool *pool = new BufferPool;
+        return *pool;
+      }
+
+      size_t BufferPool::round_size(size_t bytes) {
+        if (bytes <= min_bytes) {
+          return min_bytes;
+        }
+        size_t power = 1;
+        while (power < bytes) {
+          power <<= 1;
+        }
+        const size_t step = power / 8;
+        return (bytes + step - 1) / step * step;
+      }
+
+      void *BufferPool::allocate(size_t bytes) {
+        if (bytes < min_bytes) {
+          return system_allocate(bytes, alignment);
+        }
+        const size_t size = round_size(bytes);
+        ThreadCache *cache = ThreadCache::get(*this);
+        void *ptr = cache ? cache->take(size) : nullptr;
+        if (ptr == nullptr) {
+          ptr = take(size);
+        }
+        if (ptr != nullptr) {
+          ++hits;
+          return ptr;
+        }
+        ++misses;
+        return system_allocate(size, page_size);
+      }
+
+      void BufferPool::deallocate(void *ptr, size_t bytes) {
+        if (bytes < min_bytes) {
+          std::free(ptr);
+          return;
+        }
+        const size_t size = round_size(bytes);
+        ThreadCache *cache = ThreadCache::get(*this);
+        if (cache == nullptr || !cache->put(ptr, size)) {
+          put(ptr, size);
+        }
+      }
+
+      void *BufferPool::take(size_t size) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = free_lists.find(size);
+        if (it == free_lists.end() || it->second.empty()) {
+          return nullptr;
+        }
+        void *ptr = it->second.back();
+        it->second.pop_back();
+        cached_bytes -= size;
+        return ptr;
+      }
+
+      void BufferPool::put(void *ptr, size_t size) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (cached_bytes + size > limit) {
+          std::free(ptr);
+          return;
+        }
+        free_lists[size].push_back(ptr);
+        cached_bytes += size;
+      }
+
+      BufferPool::Statistics BufferPool::get_statistics() const {
+        return {hits, misses, cached_bytes};
+      }
+
+      void BufferPool::reset_statistics() {
+        hits = 0;
+        misses = 0;
+      }
+
+      void BufferPool::release() {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto &list : free_lists) {
+          for (void *ptr : list.second) {
+            std::free(ptr);
+          }
+          cached_bytes -= list.first * list.second.size();
+        }
+        free_lists.clear();
+      }
+    }
+  }
+}
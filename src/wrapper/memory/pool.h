@@ -0,0 +1,114 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <vector>
+
+namespace ketcpp {
+  namespace wrapper {
+    namespace memory {
+      // Recycles freed buffers by size class so that matrices of the same
+      // shape, allocated and freed over and over, stop reaching the system
+      // allocator. Each thread keeps a few buffers per size class without
+      // locking; the rest is shared. Buffers smaller than min_bytes are not
+      // pooled. Every buffer starts on a cache line, and pooled buffers on a
+      // page, so that they can be bound to NUMA nodes (see placement.h).
+      class BufferPool {
+      public:
+        struct Statistics {
+          size_t hits;   // allocations served from the pool
+          size_t misses; // allocations that went to the system
+          size_t cached_bytes; // held by the shared lists
+        };
+
+        constexpr static size_t min_bytes = 4096;
+        constexpr static size_t thread_cache_size = 4;
+        // A cache line, which is also the width of an AVX-512 register.
+        constexpr static size_t alignment = 64;
+        constexpr static size_t page_size = 4096;
+
+        static BufferPool &get_instance();
+
+        // Buffers passed to deallocate must come from allocate.
+        void *allocate(size_t bytes);
+        void deallocate(void *ptr, size_t bytes);
+
+        Statistics get_statistics() const;
+        void reset_statistics();
+        // Returns the shared cached buffers to the system; buffers cached by
+        // other threads stay there.
+        void release();
+        // Upper bound on the shared cached bytes; freed buffers beyond it go
+        // back to the system.
+        void set_limit(size_t bytes) { limit = bytes; }
+        size_t get_limit() const { return limit; }
+
+        // Rounds bytes up to its size class; there are four classes per
+        // power of two.
+        static size_t round_size(size_t bytes);
+
+      private:
+        using FreeLists = std::unordered_map<size_t, std::vector<void *>>;
+        class ThreadCache;
+        friend ThreadCache;
+
+        mutable std::mutex mutex;
+        FreeLists free_lists;
+        std::atomic<size_t> hits, misses, cached_bytes;
+        std::atomic<size_t> limit;
+
+        BufferPool();
+        void *take(size_t size);
+        void put(void *ptr, size_t size);
+      };
+
+      // Standard allocator drawing from the BufferPool.
+      template <typename T> class PoolAllocator {
+      public:
+        using value_type = T;
+        template <typename U> struct rebind { using other = PoolAllocator<U>; };
+
+        PoolAllocator() = default;
+        template <typename U> PoolAllocator(const PoolAllocator<U> &) {}
+
+        T *allocate(size_t n) {
+          return static_cast<T *>(
+              BufferPool::get_instance().allocate(n * sizeof(T)));
+        }
+        void deallocate(T *ptr, size_t n) {
+          BufferPool::get_instance().deallocate(ptr, n * sizeof(T));
+        }
+      };
+      template <typename T, typename U>
+      bool operator==(const PoolAllocator<T> &, const PoolAllocator<U> &) {
+        return true;
+      }
+      template <typename T, typename U>
+      bool operator!=(const PoolAllocator<T> &, const PoolAllocator<U> &) {
+        return false;
+      }
+    }
+  }
+}
@@ -0,0 +1,195 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <cxxabi.h>
+
+#include "wrapper/profile/counters.h"
+
+namespace ketcpp {
+  namespace wrapper {
+    namespace profile {
+      namespace detail {
+        std::atomic<bool> enabled([] {
+          const char *env = std::getenv("KETCPP_PROFILE");
+          return env != nullptr && std::strtol(env, nullptr, 10) != 0;
+        }());
+      }
+
+      namespace {
+        struct Hash {
+          size_t operator()(const Key &key) const {
+            const size_t h = key.lhs.hash_code() * 31 + key.rhs.hash_code();
+            return (h * 8 + static_cast<size_t>(key.operation)) * 64 +
+                   key.bucket;
+          }
+        };
+        using Table = std::unordered_map<Key, Counters, Hash>;
+
+        void accumulate(Counters &total, const Counters &c) {
+          total.calls += c.calls;
+          total.nanoseconds += c.nanoseconds;
+          total.flops += c.flops;
+          total.bytes += c.bytes;
+          total.allocations += c.allocations;
+        }
+
+        // Each thread records into its own table; the lock is only
+        // contended while counters are read or reset.
+        struct ThreadTable {
+          std::mutex mutex;
+          Table table;
+        };
+
+        std::mutex tables_mutex;
+        std::vector<std::shared_ptr<ThreadTable>> &get_tables() {
+          static auto tables =
+              new std::vector<std::shared_ptr<ThreadTable>>();
+          return *tables;
+        }
+
+        ThreadTable &get_thread_table() {
+          thread_local std::shared_ptr<ThreadTable> table = [] {
+            auto t = std::make_shared<ThreadTable>();
+            std::lock_guard<std::mutex> lock(tables_mutex);
+            get_tables().push_back(t);
+            return t;
+          }();
+          return *table;
+        }
+
+        std::string get_name(const std::type_index &type) {
+          int status;
+          char *demangled =
+              abi::__cxa_demangle(type.name(), nullptr, nullptr, &status);
+          std::string name = status == 0 ? demangled : type.name();
+          std::free(demangled);
+          const std::string prefix = "ketcpp::wrapper::matrix::";
+          for (size_t p; (p = name.find(prefix)) != std::string::npos;) {
+            name.erase(p, prefix.size());
+          }
+          return name;
+        }
+
+        const char *get_name(Operation operation) {
+          switch (operation) {
+          case Operation::add:
+            return "add";
+          case Operation::scale:
+            return "scale";
+          case Operation::multiply:
+            return "multiply";
+          case Operation::compare:
+            return "compare";
+          default:
+            return "copy";
+          }
+        }
+      }
+
+      void set_enabled(bool enabled) { detail::enabled = enabled; }
+
+      unsigned get_bucket(size_t num_rows, size_t num_columns) {
+        const size_t n = std::max(num_rows, num_columns);
+        unsigned b = 0;
+        while ((size_t(1) << b) < n) {
+          ++b;
+        }
+        return b;
+      }
+
+      void record(const Key &key, const Counters &counters) {
+        auto &t = get_thread_table();
+        std::lock_guard<std::mutex> lock(t.mutex);
+        auto it = t.table.find(key);
+        if (it == t.table.end()) {
+          t.table.emplace(key, counters);
+        } else {
+          accumulate(it->second, counters);
+        }
+      }
+
+      std::vector<std::pair<Key, Counters>> get_counters() {
+        Table total;
+        {
+          std::lock_guard<std::mutex> lock(tables_mutex);
+          for (auto &t : get_tables()) {
+            std::lock_guard<std::mutex> table_lock(t->mutex);
+            for (const auto &entry : t->table) {
+              auto it = total.find(entry.first);
+              if (it == total.end()) {
+                total.emplace(entry.first, entry.second);
+              } else {
+                accumulate(it->second, entry.second);
+              }
+            }
+          }
+        }
+        std::vector<std::pair<Key, Counters>> result(total.begin(),
+                                                     total.end());
+        std::sort(result.begin(), result.end(),
+                  [](const auto &a, const auto &b) {
+                    return a.second.nanoseconds > b.second.nanoseconds;
+                  });
+        return result;
+      }
+
+      void reset() {
+        std::lock_guard<std::mutex> lock(tables_mutex);
+        for (auto &t : get_tables()) {
+          std::lock_guard<std::mutex> table_lock(t->mutex);
+          t->table.clear();
+        }
+      }
+
+      void report(std::ostream &out) {
+        char line[256];
+        std::snprintf(line, sizeof(line),
+                      "%-9s %-40s %7s %10s %12s %9s %9s %8s\n", "operation",
+                      "operands", "n <=", "calls", "time [s]", "GFlop/s",
+                      "GB/s", "allocs");
+        out << line;
+        for (const auto &entry : get_counters()) {
+          const Key &key = entry.first;
+          const Counters &c = entry.second;
+          std::string operands = get_name(key.lhs);
+          if (key.rhs != typeid(void)) {
+            operands += ", " + get_name(key.rhs);
+          }
+          const double seconds = c.nanoseconds * 1e-9;
+          const double rate = seconds > 0 ? 1e-9 / seconds : 0;
+          std::snprintf(line, sizeof(line),
+                        "%-9s %-40s %7zu %10llu %12.6f %9.3f %9.3f %8llu\n",
+                        get_name(key.operation), operands.c_str(),
+                        size_t(1) << key.bucket, (unsigned long long)c.calls,
+                        seconds, c.flops * rate, c.bytes * rate,
+                        (unsigned long long)c.allocations);
+          out << line;
+        }
+      }
+    }
+  }
+}
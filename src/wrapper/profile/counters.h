@@ -0,0 +1,152 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <typeindex>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+namespace ketcpp {
+  namespace wrapper {
+    namespace profile {
+      enum class Operation { add, scale, multiply, compare, copy };
+
+      // Operations are keyed by the dynamic types of their operands (rhs is
+      // typeid(void) for unary operations) and a shape bucket: the smallest
+      // b with max(rows, columns) <= 2^b.
+      struct Key {
+        Operation operation;
+        std::type_index lhs, rhs;
+        unsigned bucket;
+        bool operator==(const Key &other) const {
+          return operation == other.operation && lhs == other.lhs &&
+                 rhs == other.rhs && bucket == other.bucket;
+        }
+      };
+
+      struct Counters {
+        uint64_t calls;
+        uint64_t nanoseconds;
+        double flops;
+        double bytes;
+        uint64_t allocations; // matrices allocated by the operation
+      };
+
+      // Recording is off unless KETCPP_PROFILE is set to a nonzero value in
+      // the environment or set_enabled(true) is called. Building with
+      // KETCPP_NO_PROFILE compiles the probes out entirely.
+      namespace detail {
+        extern std::atomic<bool> enabled;
+      }
+      inline bool is_enabled() {
+        return detail::enabled.load(std::memory_order_relaxed);
+      }
+      void set_enabled(bool enabled);
+
+      unsigned get_bucket(size_t num_rows, size_t num_columns);
+      void record(const Key &key, const Counters &counters);
+      // Totals over all threads, largest time first.
+      std::vector<std::pair<Key, Counters>> get_counters();
+      void reset();
+      // Writes a table of get_counters() with rates per row.
+      void report(std::ostream &out);
+
+      // The work of a profiled operation.
+      struct Probe {
+        Operation operation;
+        const std::type_info &lhs, &rhs;
+        size_t num_rows, num_columns;
+        double flops, bytes;
+        uint64_t allocations;
+      };
+
+      // Times its own lifetime and records it with the work returned by
+      // describe(), which is only called when recording is enabled.
+      class Scope {
+        bool active;
+        Key key;
+        Counters counters;
+        std::chrono::steady_clock::time_point start;
+
+      public:
+        template <typename F>
+        explicit Scope(F describe)
+            : active(is_enabled()),
+              key{Operation::add, typeid(void), typeid(void), 0},
+              counters{0, 0, 0, 0, 0} {
+          if (active) {
+            const Probe probe = describe();
+            key = Key{probe.operation, probe.lhs, probe.rhs,
+                      get_bucket(probe.num_rows, probe.num_columns)};
+            counters = Counters{1, 0, probe.flops, probe.bytes,
+                                probe.allocations};
+            start = std::chrono::steady_clock::now();
+          }
+        }
+        Scope(const Scope &) = delete;
+        ~Scope() {
+          if (active) {
+            counters.nanoseconds =
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+            record(key, counters);
+          }
+        }
+      };
+    }
+  }
+}
+
+#define KETCPP_PROFILE_CONCAT_(a, b) a##b
+#define KETCPP_PROFILE_CONCAT(a, b) KETCPP_PROFILE_CONCAT_(a, b)
+
+#ifdef KETCPP_NO_PROFILE
+#define KETCPP_PROFILE_BINARY(operation, lhs, rhs, flops, bytes, allocations)
+#define KETCPP_PROFILE_UNARY(operation, matrix, flops, bytes, allocations)
+#else
+// Profiles the rest of the enclosing block as an operation on MatrixBase
+// operands; the shape bucket is taken from lhs. The arguments are only
+// evaluated when recording is enabled.
+#define KETCPP_PROFILE_BINARY(operation, lhs, rhs, flops, bytes, allocations) \
+  ::ketcpp::wrapper::profile::Scope KETCPP_PROFILE_CONCAT(profile_scope_,    \
+                                                          __LINE__)([&] {    \
+    return ::ketcpp::wrapper::profile::Probe{                                \
+        ::ketcpp::wrapper::profile::Operation::operation, typeid(lhs),       \
+        typeid(rhs), (lhs).get_num_rows(), (lhs).get_num_columns(),          \
+        static_cast<double>(flops), static_cast<double>(bytes),              \
+        static_cast<uint64_t>(allocations)};                                 \
+  })
+#define KETCPP_PROFILE_UNARY(operation, matrix, flops, bytes, allocations)    \
+  ::ketcpp::wrapper::profile::Scope KETCPP_PROFILE_CONCAT(profile_scope_,    \
+                                                          __LINE__)([&] {    \
+    return ::ketcpp::wrapper::profile::Probe{                                \
+        ::ketcpp::wrapper::profile::Operation::operation, typeid(matrix),    \
+        typeid(void), (matrix).get_num_rows(), (matrix).get_num_columns(),   \
+        static_cast<double>(flops), static_cast<double>(bytes),              \
+        static_cast<uint64_t>(allocations)};                                 \
+  })
+#endif
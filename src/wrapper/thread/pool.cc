@@ -0,0 +1,172 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdlib>
+#include <string>
+
+#include "wrapper/thread/pool.h"
+
+namespace ketcpp {
+  namespace wrapper {
+    namespace thread {
+      namespace {
+        // Index of the queue owned by the current thread, 0 outside the pool.
+        thread_local const ThreadPool *current_pool = nullptr;
+        thread_local size_t current_queue = 0;
+
+        size_t initial_num_threads() {
+          if (const char *env = std::getenv("KETCPP_NUM_THREADS")) {
+            const long n = std::strtol(env, nullptr, 10);
+            if (n > 0) {
+              return n;
+            }
+          }
+          return std::max(std::thread::hardware_concurrency(), 1u);
+        }
+
+        std::mutex global_mutex;
+        std::unique_ptr<ThreadPool> &global_pool() {
+          static std::unique_ptr<ThreadPool> pool;
+          return pool;
+        }
+        std::atomic<size_t> &global_num_threads() {
+          static std::atomic<size_t> n(initial_num_threads());
+          return n;
+        }
+      }
+
+      ThreadPool::ThreadPool(size_t num_threads)
+          : num_pending(0), next_queue(0), stopping(false) {
+        num_threads = std::max<size_t>(num_threads, 1);
+        for (size_t i = 0; i < num_threads; ++i) {
+          queues.emplace_back(new Queue);
+        }
+        for (size_t i = 1; i < num_threads; ++i) {
+          workers.emplace_back([this, i] { work(i); });
+        }
+      }
+
+      ThreadPool::~ThreadPool() {
+        {
+          std::lock_guard<std::mutex> lock(sleep_mutex);
+          stopping = true;
+        }
+        wake.notify_all();
+        for (auto &worker : workers) {
+          worker.join();
+        }
+      }
+
+      size_t ThreadPool::get_own_queue() const {
+        return current_pool == this ? current_queue : 0;
+      }
+
+      void ThreadPool::submit(Task task) {
+        size_t own = get_own_queue();
+        if (own == 0 && queues.size() > 1) {
+          // Spread work submitted from outside over the workers.
+          own = 1 + next_queue++ % (queues.size() - 1);
+        }
+        {
+          std::lock_guard<std::mutex> lock(queues[own]->mutex);
+          queues[own]->tasks.push_back(std::move(task));
+        }
+        {
+          std::lock_guard<std::mutex> lock(sleep_mutex);
+          ++num_pending;
+        }
+        wake.notify_one();
+      }
+
+      bool ThreadPool::take(size_t own, Task &task) {
+        if (num_pending == 0) {
+          return false;
+        }
+        {
+          auto &queue = *queues[own];
+          std::lock_guard<std::mutex> lock(queue.mutex);
+          if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+            --num_pending;
+            return true;
+          }
+        }
+        for (size_t i = 1; i <= queues.size(); ++i) {
+          auto &victim = *queues[(own + i) % queues.size()];
+          std::lock_guard<std::mutex> lock(victim.mutex);
+          if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            --num_pending;
+            return true;
+          }
+        }
+        return false;
+      }
+
+      bool ThreadPool::run_one() {
+        Task task;
+        if (!take(get_own_queue(), task)) {
+          return false;
+        }
+        task();
+        return true;
+      }
+
+      void ThreadPool::work(size_t index) {
+        current_pool = this;
+        current_queue = index;
+        Task task;
+        while (true) {
+          if (take(index, task)) {
+            task();
+            task = nullptr;
+            continue;
+          }
+          std::unique_lock<std::mutex> lock(sleep_mutex);
+          wake.wait(lock, [this] { return stopping || num_pending > 0; });
+          if (stopping && num_pending == 0) {
+            return;
+          }
+        }
+      }
+
+      size_t get_num_threads() { return global_num_threads(); }
+
+      void set_num_threads(size_t num_threads) {
+        num_threads = std::max<size_t>(num_threads, 1);
+        std::lock_guard<std::mutex> lock(global_mutex);
+        if (global_pool() && global_pool()->get_num_threads() != num_threads) {
+          global_pool().reset();
+        }
+        global_num_threads() = num_threads;
+      }
+
+      ThreadPool &get_pool() {
+        std::lock_guard<std::mutex> lock(global_mutex);
+        auto &pool = global_pool();
+        if (!pool) {
+          pool.reset(new ThreadPool(global_num_threads()));
+        }
+        return *pool;
+      }
+    }
+  }
+}
@@ -0,0 +1,198 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ketcpp {
+  namespace wrapper {
+    namespace thread {
+      // Pool of worker threads, each owning a deque of tasks. A worker runs
+      // its own tasks last-in first-out and steals the oldest task of
+      // another queue when it runs dry. Threads waiting for a TaskGroup
+      // execute pending tasks instead of blocking.
+      class ThreadPool {
+      public:
+        using Task = std::function<void()>;
+
+        // num_threads counts the calling thread, so num_threads - 1 workers
+        // are started.
+        explicit ThreadPool(size_t num_threads);
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+        ~ThreadPool();
+
+        size_t get_num_threads() const { return workers.size() + 1; }
+        void submit(Task task);
+        // Runs one pending task, if any, on the calling thread.
+        bool run_one();
+
+      private:
+        struct Queue {
+          std::mutex mutex;
+          std::deque<Task> tasks;
+        };
+        // queues[0] receives tasks submitted from outside the pool.
+        std::vector<std::unique_ptr<Queue>> queues;
+        std::vector<std::thread> workers;
+        std::atomic<size_t> num_pending;
+        std::atomic<size_t> next_queue;
+        bool stopping;
+        std::mutex sleep_mutex;
+        std::condition_variable wake;
+
+        size_t get_own_queue() const;
+        bool take(size_t own, Task &task);
+        void work(size_t index);
+      };
+
+      // The number of threads is read from KETCPP_NUM_THREADS on first use
+      // and defaults to the number of hardware threads.
+      size_t get_num_threads();
+      // Replaces the global pool; must not be called while parallel work
+      // is in flight.
+      void set_num_threads(size_t num_threads);
+      ThreadPool &get_pool();
+
+      // Tasks that are waited for together. The first exception thrown by a
+      // task is rethrown from wait().
+      class TaskGroup {
+        ThreadPool &pool;
+        std::atomic<size_t> num_running;
+        std::exception_ptr error;
+        std::mutex error_mutex;
+
+      public:
+        explicit TaskGroup(ThreadPool &pool = get_pool())
+            : pool(pool), num_running(0) {}
+        TaskGroup(const TaskGroup &) = delete;
+        ~TaskGroup() {
+          while (num_running > 0) {
+            if (!pool.run_one()) {
+              std::this_thread::yield();
+            }
+          }
+        }
+
+        template <typename F> void run(F &&f) {
+          ++num_running;
+          pool.submit([this, f]() mutable {
+            try {
+              f();
+            } catch (...) {
+              std::lock_guard<std::mutex> lock(error_mutex);
+              if (!error) {
+                error = std::current_exception();
+              }
+            }
+            --num_running;
+          });
+        }
+
+        void wait() {
+          while (num_running > 0) {
+            if (!pool.run_one()) {
+              std::this_thread::yield();
+            }
+          }
+          if (error) {
+            std::rethrow_exception(error);
+          }
+        }
+      };
+
+      // Calls f(first, last) on disjoint subranges covering [begin, end).
+      // Ranges of at most grain elements, and any range when only one thread
+      // is configured, run serially on the calling thread.
+      template <typename F>
+      void parallel_for(size_t begin, size_t end, size_t grain, F &&f) {
+        const size_t n = end > begin ? end - begin : 0;
+        const size_t num_threads = get_num_threads();
+        grain = std::max<size_t>(grain, 1);
+        if (num_threads <= 1 || n <= grain) {
+          if (n > 0) {
+            f(begin, end);
+          }
+          return;
+        }
+        // A few chunks per thread let stealing even out the load.
+        const size_t num_chunks =
+            std::min((n + grain - 1) / grain, 4 * num_threads);
+        const size_t chunk = (n + num_chunks - 1) / num_chunks;
+        TaskGroup group;
+        for (size_t first = begin + chunk; first < end; first += chunk) {
+          const size_t last = std::min(first + chunk, end);
+          group.run([&f, first, last] { f(first, last); });
+        }
+        try {
+          f(begin, std::min(begin + chunk, end));
+        } catch (...) {
+          group.wait();
+          throw;
+        }
+        group.wait();
+      }
+
+      // Reduces map(first, last) over disjoint subranges of [begin, end)
+      // with reduce, starting from init. Partial results are combined in
+      // range order so that the result does not depend on scheduling.
+      template <typename T, typename Map, typename Reduce>
+      T parallel_reduce(size_t begin, size_t end, size_t grain, T init,
+                        Map &&map, Reduce &&reduce) {
+        const size_t n = end > begin ? end - begin : 0;
+        const size_t num_threads = get_num_threads();
+        grain = std::max<size_t>(grain, 1);
+        if (num_threads <= 1 || n <= grain) {
+          return n > 0 ? reduce(init, map(begin, end)) : init;
+        }
+        const size_t num_chunks =
+            std::min((n + grain - 1) / grain, 4 * num_threads);
+        const size_t chunk = (n + num_chunks - 1) / num_chunks;
+        // Wrapped so that std::vector<bool> does not pack the slots that
+        // the workers write concurrently into one word.
+        struct Partial {
+          T value;
+        };
+        std::vector<Partial> partial((n + chunk - 1) / chunk, Partial{init});
+        parallel_for(0, partial.size(), 1,
+                     [&](size_t first, size_t last) {
+                       for (size_t c = first; c < last; ++c) {
+                         const size_t b = begin + c * chunk;
+                         partial[c].value = map(b, std::min(b + chunk, end));
+                       }
+                     });
+        for (const Partial &p : partial) {
+          init = reduce(init, p.value);
+        }
+        return init;
+      }
+    }
+  }
+}
@@ -279,6 +279,41 @@ go_bandit([] {
       });
     });
 
+    describe(".fast_rows", [&array] {
+      it("should yield all row vectors", [&array] {
+        float v[3][2] = {{1.f, 2.f}, {3.f, 4.f}, {5.f, 6.f}};
+        size_t k = 0;
+        for (auto i : array.fast_rows()) {
+          std::equal(i.begin(), i.end(), &v[k++][0]) must be_truthy;
+        }
+        k must equal(3);
+      });
+
+      it("should allow writing through the ranges", [&array] {
+        auto array2 = array;
+        for (auto row : array2.fast_rows()) {
+          for (auto &x : row) {
+            x *= 2;
+          }
+        }
+        array2(2, 1) must equal(12.f);
+        array2.fast_row(1)[0] must equal(6.f);
+      });
+    });
+
+    describe(".fast_columns const", [&array] {
+      const auto &carray = array;
+      it("should yield all column vectors", [&carray] {
+        float v[2][3] = {{1.f, 3.f, 5.f}, {2.f, 4.f, 6.f}};
+        size_t k = 0;
+        for (auto i : carray.fast_columns()) {
+          std::equal(i.begin(), i.end(), &v[k++][0]) must be_truthy;
+        }
+        k must equal(2);
+        carray.fast_column(1).size() must equal(3);
+      });
+    });
+
     describe("::operator==", [&array, &array2] {
       it("should return true for same matrix", [&array] {
         auto array2 = array;
@@ -340,4 +375,45 @@ go_bandit([] {
       });
     });
   });
+
+  describe("MatrixArray (column-major)", [] {
+    using ColumnMajor = MatrixArray<double, 2, 3, Layout::column_major>;
+    const ColumnMajor a = {{1, 2, 3}, {4, 5, 6}};
+
+    it("should store columns contiguously", [&] {
+      a.data()[1] must equal(4);
+      a(1, 2) must equal(6);
+      (a == ColumnMajor({1, 2, 3, 4, 5, 6})) must be_truthy;
+      (a == MatrixArray<double, 2, 3>({1, 2, 3, 4, 5, 6})) must be_truthy;
+    });
+
+    it("should multiply and transpose in its own layout", [&] {
+      const MatrixArray<double, 3, 2, Layout::column_major> b = {
+          {1, 0}, {0, 1}, {1, 1}};
+      const auto c = a * b;
+      (c == MatrixArray<double, 2, 2>({{4, 5}, {10, 11}})) must be_truthy;
+      (a.transpose() == MatrixArray<double, 3, 2>({{1, 4}, {2, 5}, {3, 6}}))
+          must be_truthy;
+      MatrixArray<double, 12, 12, Layout::column_major> big, id;
+      for (size_t i = 0; i < 12; ++i) {
+        for (size_t j = 0; j < 12; ++j) {
+          big(i, j) = i * 12. + j;
+          id(i, j) = i == j;
+        }
+      }
+      (big * id == big) must be_truthy;
+    });
+
+    it("should keep determinant and inverse", [] {
+      const MatrixArray<double, 3, 3, Layout::column_major> a = {
+          {2, 0, 1}, {1, 3, 2}, {1, 1, 2}};
+      a.determinant() must equal(6);
+      const auto product = a * a.inverse();
+      for (size_t i = 0; i < 3; ++i) {
+        for (size_t j = 0; j < 3; ++j) {
+          product(i, j) must be_close_to(i == j ? 1. : 0.).within(1e-12);
+        }
+      }
+    });
+  });
 });
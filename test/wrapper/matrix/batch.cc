@@ -0,0 +1,120 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <bandit/bandit.h>
+#include <stdexcept>
+#include <vector>
+#include "wrapper/matrix/batch.h"
+using namespace bandit;
+using namespace bandit::Matchers;
+using namespace ketcpp::wrapper::matrix;
+
+namespace {
+  template <size_t m, size_t n>
+  std::vector<MatrixArray<double, m, n>> make_arrays(size_t count,
+                                                     double seed) {
+    std::vector<MatrixArray<double, m, n>> arrays(count);
+    for (size_t k = 0; k < count; ++k) {
+      for (size_t i = 0; i < m; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+          arrays[k](i, j) =
+              (i == j ? m + 1. : 0.) + seed * (k % 7 + 1) / (i + 2 * j + 1);
+        }
+      }
+    }
+    return arrays;
+  }
+}
+
+go_bandit([] {
+  describe("MatrixBatch", [] {
+    // More lanes than one block, and not a multiple of the block size.
+    const size_t count = 3 * MatrixBatch<double, 3>::block_size + 17;
+    const auto a = make_arrays<3, 3>(count, 0.5);
+    const auto b = make_arrays<3, 2>(count, -1.5);
+
+    it("should round-trip arrays of MatrixArray", [&] {
+      MatrixBatch<double, 3> batch(a);
+      batch.get_batch_size() must equal(count);
+      batch(5, 1, 2) must equal(a[5](1, 2));
+      const auto arrays = batch.to_arrays();
+      for (size_t k = 0; k < count; ++k) {
+        (arrays[k] == a[k]) must be_truthy;
+      }
+    });
+
+    it("should multiply matrix by matrix", [&] {
+      const auto c = MatrixBatch<double, 3>(a) * MatrixBatch<double, 3, 2>(b);
+      for (size_t k = 0; k < count; k += 97) {
+        const auto expected = a[k] * b[k];
+        for (size_t i = 0; i < 3; ++i) {
+          for (size_t j = 0; j < 2; ++j) {
+            c(k, i, j) must be_close_to(expected(i, j)).within(1e-12);
+          }
+        }
+      }
+    });
+
+    it("should add and scale", [&] {
+      MatrixBatch<double, 3> c(a);
+      c += MatrixBatch<double, 3>(a);
+      c *= 0.5;
+      (c == MatrixBatch<double, 3>(a)) must be_truthy;
+    });
+
+    it("should reject mismatched batch sizes", [&] {
+      [&] {
+        MatrixBatch<double, 3> c(a);
+        c += MatrixBatch<double, 3>(count - 1);
+      } must throw_exception;
+    });
+
+    it("should solve linear systems", [&] {
+      const MatrixBatch<double, 3> batch(a);
+      const auto x = batch.solve(MatrixBatch<double, 3, 2>(b));
+      const auto residual = batch * x;
+      for (size_t k = 0; k < count; ++k) {
+        for (size_t i = 0; i < 3; ++i) {
+          for (size_t j = 0; j < 2; ++j) {
+            residual(k, i, j) must be_close_to(b[k](i, j)).within(1e-12);
+          }
+        }
+      }
+    });
+
+    it("should pivot lane by lane", [] {
+      std::vector<MatrixArray<double, 2>> a = {{{0, 1}, {1, 0}},
+                                               {{2, 0}, {0, 4}}};
+      std::vector<MatrixArray<double, 2, 1>> b = {{3., 5.}, {2., 8.}};
+      const auto x = MatrixBatch<double, 2>(a).solve(
+          MatrixBatch<double, 2, 1>(b));
+      x(0, 0, 0) must equal(5);
+      x(0, 1, 0) must equal(3);
+      x(1, 0, 0) must equal(1);
+      x(1, 1, 0) must equal(2);
+    });
+
+    it("should throw for singular systems", [] {
+      std::vector<MatrixArray<double, 2>> a = {{{1, 0}, {0, 1}},
+                                               {{1, 2}, {2, 4}}};
+      const MatrixBatch<double, 2> batch(a);
+      [&] { batch.solve(MatrixBatch<double, 2, 1>(2)); } must throw_exception;
+    });
+  });
+});
@@ -0,0 +1,178 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <bandit/bandit.h>
+#include "wrapper/matrix/block_sparse.h"
+#include "wrapper/matrix/default.h"
+using namespace bandit;
+using namespace bandit::Matchers;
+using namespace ketcpp::wrapper::matrix;
+
+go_bandit([] {
+  describe("MatrixBlockSparse", [] {
+    it("should not be abstract class", [] {
+      std::is_abstract<MatrixBlockSparse<double>>::value must_not be_truthy;
+    });
+
+    MatrixVector<double> dense = {{1, 2, 0, 0, 0},
+                                  {3, 4, 0, 0, 0},
+                                  {0, 0, 0, 0, 5},
+                                  {0, 0, 0, 0, 0},
+                                  {0, 0, 6, 0, 7}};
+
+    it("should keep only blocks above the tolerance", [&dense] {
+      MatrixBlockSparse<double> s(dense, 2);
+      s.get_num_block_rows() must equal(3u);
+      s.get_num_block_columns() must equal(3u);
+      s.get_num_blocks() must equal(4u);
+      MatrixBlockSparse<double> t(dense, 2, 5.5);
+      t.get_num_blocks() must equal(2u);
+    });
+
+    it("should convert back to MatrixVector", [&dense] {
+      MatrixBlockSparse<double> s(dense, 2);
+      *s.to_dense() must equal(dense);
+      MatrixVector<double> d(5, 5);
+      Dispatcher<double>::convert(d, s);
+      d must equal(dense);
+    });
+
+    it("should read zeros outside stored blocks", [&dense] {
+      const MatrixBlockSparse<double> s(dense, 2);
+      s(0, 4) must equal(0);
+      s(4, 2) must equal(6);
+      (static_cast<const MatrixBase<double> &>(s) == dense) must be_truthy;
+    });
+
+    it("should insert a block when writing outside stored blocks",
+       [&dense] {
+         MatrixBlockSparse<double> s(dense, 2);
+         s(3, 1) = 8;
+         s.get_num_blocks() must equal(5u);
+         s(3, 1) must equal(8);
+         s(2, 4) must equal(5);
+       });
+
+    it("should drop blocks that became negligible", [&dense] {
+      MatrixBlockSparse<double> s(dense, 2, 1e-12);
+      s(2, 4) = 0;
+      s.prune();
+      s.get_num_blocks() must equal(3u);
+      s(4, 4) must equal(7);
+    });
+
+    it("should not insert blocks through mutable iterators", [] {
+      MatrixVector<double> diagonal(64, 64);
+      for (size_t i = 0; i < 64; ++i) {
+        diagonal(i, i) = 1;
+      }
+      MatrixBlockSparse<double> s(diagonal, 8);
+      MatrixBase<double> &base = s;
+      double sum = 0;
+      for (auto row = base.rows().begin(); row != base.rows().end(); ++row) {
+        for (auto e = row.begin(); e != row.end(); ++e) {
+          sum += *e;
+        }
+      }
+      sum must equal(64.);
+      s.get_num_blocks() must equal(8u);
+      MatrixBlockSparse<double> t(64, 64, 8);
+      auto row = t.MatrixBase<double>::rows().begin();
+      *row.begin() = 0;
+      *++row.begin() = 3;
+      t.get_num_blocks() must equal(1u);
+      t(0, 1) must equal(3);
+    });
+
+    describe("::operator+=", [&dense] {
+      it("should merge block structures", [&dense] {
+        MatrixBlockSparse<double> s(dense, 2);
+        MatrixBlockSparse<double> t({{0, 0, 0, 0, 0},
+                                     {0, 0, 0, 1, 0},
+                                     {0, 0, 0, 0, 0},
+                                     {0, 0, 0, 0, 0},
+                                     {0, 0, 0, 0, 1}},
+                                    2);
+        s += t;
+        s.get_num_blocks() must equal(5u);
+        s(1, 3) must equal(1);
+        s(4, 4) must equal(8);
+      });
+      it("should add only the nonzero elements of other operands",
+         [&dense] {
+           MatrixBlockSparse<double> s(dense, 2);
+           MatrixBlockSparse<double> u(5, 5, 3);
+           u(1, 2) = 1;
+           s += u;
+           s += MatrixVector<double>(
+               {{0, 0, 0, 0, 0}, {0, 0, 0, 0, 0}, {0, 0, 0, 0, 1},
+                {0, 0, 0, 0, 0}, {0, 0, 0, 0, 0}});
+           s.get_num_blocks() must equal(5u);
+           s(1, 2) must equal(1);
+           s(2, 4) must equal(6);
+         });
+      it("should not fill in from dense operands of any layout", [] {
+        MatrixVector<double> diagonal(64, 64);
+        for (size_t i = 0; i < 64; ++i) {
+          for (size_t j = i / 8 * 8; j < i / 8 * 8 + 8; ++j) {
+            diagonal(i, j) = 1. + i + j;
+          }
+        }
+        MatrixBlockSparse<double> s(64, 64, 8);
+        s += MatrixVectorColumnMajor<double>(diagonal);
+        s.get_num_blocks() must equal(8u);
+        s += diagonal;
+        s.get_num_blocks() must equal(8u);
+        auto twice = diagonal;
+        twice *= 2.;
+        (s == twice) must be_truthy;
+      });
+      it("should add into a dense matrix", [&dense] {
+        MatrixVector<double> d = dense;
+        d += MatrixBlockSparse<double>(dense, 2);
+        auto twice = dense;
+        twice *= 2.;
+        d must equal(twice);
+      });
+    });
+
+    describe("multiply", [&dense] {
+      it("should multiply by a dense matrix on either side", [&dense] {
+        MatrixBlockSparse<double> s(dense, 2);
+        *Dispatcher<double>::multiply(s, dense) must equal(dense * dense);
+        *Dispatcher<double>::multiply(dense, s) must equal(dense * dense);
+      });
+      it("should multiply two block-sparse matrices", [&dense] {
+        MatrixBlockSparse<double> s(dense, 2);
+        auto c = Dispatcher<double>::multiply(s, s);
+        dynamic_cast<MatrixBlockSparse<double> &>(*c).get_num_blocks()
+            must equal(5u);
+        *dynamic_cast<MatrixBlockSparse<double> &>(*c).to_dense()
+            must equal(dense * dense);
+      });
+      it("should work through Matrix", [&dense] {
+        Matrix<double> s = make_matrix<MatrixBlockSparse>(
+            {{1., 2.}, {0., 3.}});
+        Matrix<double> d = make_matrix<double>({{1, 2}, {0, 3}});
+        Matrix<double> c = s * s + d;
+        c must equal(make_matrix<double>({{2, 10}, {0, 12}}));
+      });
+    });
+  });
+});
@@ -0,0 +1,160 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <bandit/bandit.h>
+#include <complex>
+#include <cstdio>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "wrapper/matrix/checkpoint.h"
+#include "wrapper/matrix/default.h"
+#include "wrapper/memory/mapped.h"
+using namespace bandit;
+using namespace bandit::Matchers;
+using namespace ketcpp::wrapper::matrix;
+using ketcpp::wrapper::memory::MappedFile;
+
+go_bandit([] {
+  describe("checkpoint", [] {
+    const std::string path =
+        MappedFile::get_scratch_directory() + "/ketcpp-checkpoint-test";
+    after_each([path] { std::remove(path.c_str()); });
+
+    MatrixVector<double> dense = {{1, 2, 3}, {4, 5, 6}};
+
+    it("should round-trip dense matrices exactly", [&] {
+      MatrixVector<double> a = {{0.1, 1. / 3}, {1e-300, -2.5e300}};
+      write_checkpoint(path, a);
+      auto b = read_checkpoint<double>(path);
+      (dynamic_cast<MatrixVector<double> *>(b.get()) != nullptr)
+          must be_truthy;
+      (*b == a) must be_truthy;
+    });
+
+    it("should align the payload to 64 bytes", [&] {
+      write_checkpoint(path, dense);
+      std::FILE *fp = std::fopen(path.c_str(), "rb");
+      std::fseek(fp, 0, SEEK_END);
+      const long size = std::ftell(fp);
+      std::fclose(fp);
+      size must equal(long(64 + 6 * sizeof(double)));
+    });
+
+    it("should keep symmetric matrices packed", [&] {
+      MatrixSymmetric<double> s = {{1, 2}, {2, 3}};
+      write_checkpoint(path, s);
+      auto t = read_checkpoint<double>(path);
+      (dynamic_cast<MatrixSymmetric<double> *>(t.get()) != nullptr)
+          must be_truthy;
+      (*t == s) must be_truthy;
+    });
+
+    it("should read dense checkpoints into symmetric matrices", [&] {
+      MatrixVector<double> a = {{1, 2}, {2, 3}};
+      write_checkpoint(path, a);
+      MatrixSymmetric<double> s(2);
+      read_checkpoint(path, s);
+      s must equal(MatrixSymmetric<double>({{1, 2}, {2, 3}}));
+    });
+
+    it("should write and read other backends", [&] {
+      MatrixArray<double, 2, 3> a = {{1, 2, 3}, {4, 5, 6}};
+      write_checkpoint(path, a);
+      MatrixBlockSparse<double> b(2, 3, 1);
+      read_checkpoint(path, b);
+      (b == dense) must be_truthy;
+      MatrixVector<double> c(2, 3);
+      read_checkpoint(path, c);
+      (c == dense) must be_truthy;
+    });
+
+    it("should keep column-major storage as it is", [&] {
+      const MatrixVectorColumnMajor<double> a(dense);
+      write_checkpoint(path, a);
+      auto b = read_checkpoint<double>(path);
+      (dynamic_cast<MatrixVectorColumnMajor<double> *>(b.get()) != nullptr)
+          must be_truthy;
+      (*b == dense) must be_truthy;
+      MatrixVector<double> c(2, 3);
+      read_checkpoint(path, c);
+      (c == dense) must be_truthy;
+    });
+
+    it("should store complex elements", [&] {
+      using Z = std::complex<double>;
+      MatrixVector<Z> z = {{Z(1, 2), Z(3, -4)}};
+      write_checkpoint(path, z);
+      (*read_checkpoint<Z>(path) == z) must be_truthy;
+    });
+
+    it("should reject mismatched types and shapes", [&] {
+      write_checkpoint(path, dense);
+      [&] { read_checkpoint<float>(path); } must throw_exception;
+      [&] {
+        MatrixVector<double> wrong(3, 2);
+        read_checkpoint(path, wrong);
+      } must throw_exception;
+      std::FILE *fp = std::fopen(path.c_str(), "wb");
+      std::fputs("not a matrix", fp);
+      std::fclose(fp);
+      [&] { read_checkpoint<double>(path); } must throw_exception;
+    });
+
+    it("should map dense files in place", [&] {
+      write_checkpoint(path, dense);
+      {
+        auto mapped = map_checkpoint<double>(path);
+        (dynamic_cast<MatrixMapped<double> *>(mapped.get()) != nullptr)
+            must be_truthy;
+        (*mapped == dense) must be_truthy;
+        mapped->data()[0] = 7;
+        mapped->data()[0] must equal(7);
+      }
+      (*read_checkpoint<double>(path) == dense) must be_truthy;
+    });
+
+    it("should keep writes to mapped files through products", [&] {
+      write_checkpoint(path, dense);
+      auto mapped = map_checkpoint<double>(path);
+      mapped->data()[0] = 100;
+      const MatrixVector<double> identity = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+      Dispatcher<double>::multiply(*mapped, identity);
+      mapped->data()[0] must equal(100);
+    });
+
+    it("should map read-only files", [&] {
+      write_checkpoint(path, dense);
+      ::chmod(path.c_str(), 0444);
+      auto mapped = map_checkpoint<double>(path);
+      (*mapped == dense) must be_truthy;
+    });
+
+    it("should reject truncated files when mapping", [&] {
+      write_checkpoint(path, dense);
+      struct stat st;
+      ::stat(path.c_str(), &st);
+      const off_t size = st.st_size - sizeof(double);
+      ::truncate(path.c_str(), size);
+      [&] { map_checkpoint<double>(path); } must throw_exception;
+      ::stat(path.c_str(), &st);
+      st.st_size must equal(size);
+    });
+  });
+});
@@ -0,0 +1,115 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <bandit/bandit.h>
+#include "wrapper/matrix/default.h"
+#include "wrapper/matrix/dispatch.h"
+using namespace bandit;
+using namespace bandit::Matchers;
+using namespace ketcpp::wrapper::matrix;
+
+namespace {
+  size_t num_custom_calls = 0;
+}
+
+go_bandit([] {
+  describe("Dispatcher", [] {
+    MatrixArray<double, 2, 2> a = {{1, 2}, {3, 4}};
+    MatrixVector<double> v = {{4, 8}, {12, 16}};
+    MatrixEigen<double> e = {{8, 4}, {4, 8}};
+
+    it("should add mixed backends", [&a, &v, &e] {
+      MatrixArray<double, 2, 2> b = a;
+      b += v;
+      b must equal(MatrixArray<double, 2, 2>({{5, 10}, {15, 20}}));
+      MatrixVector<double> w = v;
+      w += e;
+      w must equal(MatrixVector<double>({{12, 12}, {16, 24}}));
+      MatrixEigen<double> f = e;
+      f += a;
+      f must equal(MatrixEigen<double>({{9, 6}, {7, 12}}));
+    });
+
+    it("should compare mixed backends", [&a] {
+      const MatrixBase<double> &v = MatrixVector<double>({{1, 2}, {3, 4}});
+      const MatrixBase<double> &e = MatrixEigen<double>({{1, 2}, {3, 5}});
+      Dispatcher<double>::compare(a, v) must be_truthy;
+      Dispatcher<double>::compare(a, e) must_not be_truthy;
+      Dispatcher<double>::compare(a, MatrixVector<double>(3, 2))
+          must_not be_truthy;
+    });
+
+    it("should multiply mixed backends", [&a, &e] {
+      auto c = Dispatcher<double>::multiply(a, e);
+      *c must equal(MatrixVector<double>({{16, 20}, {40, 44}}));
+      auto d = Dispatcher<double>::multiply(e, e);
+      *d must equal(MatrixEigen<double>({{80, 64}, {64, 80}}));
+      [&a] {
+        Dispatcher<double>::multiply(MatrixVector<double>(2, 3), a);
+      } must throw_exception;
+    });
+
+    it("should convert between backends", [&a] {
+      MatrixEigen<double> f(2, 2);
+      Dispatcher<double>::convert(f, a);
+      f must equal(MatrixEigen<double>({{1, 2}, {3, 4}}));
+    });
+
+    it("should use kernels defined for a pair", [] {
+      using Small = MatrixArray<double, 1, 1>;
+      Dispatcher<double>::get_instance()
+          .define<Operation::add, Small, Small>(
+              [](MatrixBase<double> &lhs, const MatrixBase<double> &rhs) {
+                ++num_custom_calls;
+                *lhs.data() += *rhs.data();
+              });
+      Small x = {1.}, y = {2.};
+      x += y;
+      num_custom_calls must equal(1u);
+      x must equal(Small({3.}));
+    });
+
+    it("should use kernels defined against any strided operand", [] {
+      using Small = MatrixArray<double, 1, 2>;
+      Dispatcher<double>::get_instance()
+          .define<Operation::add, Small, Strided>(
+              [](MatrixBase<double> &lhs, const MatrixBase<double> &rhs) {
+                ++num_custom_calls;
+                for (size_t j = 0; j < 2; ++j) {
+                  lhs.data()[j] += rhs.data()[j * rhs.get_column_stride()];
+                }
+              });
+      num_custom_calls = 0;
+      Small x = {{1., 2.}};
+      x += MatrixVector<double>({{1., 1.}});
+      x += MatrixVectorColumnMajor<double>({{1., 1.}});
+      x += MatrixArray<double, 1, 2>({{1., 1.}});
+      num_custom_calls must equal(3u);
+      x must equal(Small({{4., 5.}}));
+    });
+
+    it("should choose the kernel for each call", [] {
+      MatrixVector<double> empty(0, 0);
+      empty += MatrixVector<double>(0, 0);
+      MatrixVector<double> b = {{1, 2}, {3, 4}};
+      b += MatrixVector<double>({{1, 1}, {1, 1}});
+      b must equal(MatrixVector<double>({{2, 3}, {4, 5}}));
+    });
+  });
+});
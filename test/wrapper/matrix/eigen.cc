@@ -0,0 +1,147 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <bandit/bandit.h>
+#include "wrapper/matrix/eigen.h"
+#include "wrapper/matrix/vector.h"
+using namespace bandit;
+using namespace bandit::Matchers;
+using namespace ketcpp::wrapper::matrix;
+
+go_bandit([] {
+  describe("MatrixEigen", [] {
+    it("should not be abstract class",
+       [] { std::is_abstract<MatrixEigen<float>>::value must_not be_truthy; });
+
+    it("should be initialized with list", [] {
+      [] {
+        MatrixEigen<float> eigen = {{1.f, 2.f}, {3.f, 4.f}};
+      } must_not throw_exception;
+    });
+
+    it("should be correctly initialized with nested list", [] {
+      MatrixEigen<float> eigen = {{1.f}, {3.f, 4.f}};
+      MatrixEigen<float> eigen2 = {{1.f, 0.f}, {3.f, 4.f}};
+      eigen must equal(eigen2);
+    });
+
+    it("should be initialized with zeros by size", [] {
+      MatrixEigen<float> eigen(2, 3);
+      MatrixEigen<float> eigen2 = {{0.f, 0.f, 0.f}, {0.f, 0.f, 0.f}};
+      eigen must equal(eigen2);
+    });
+
+    MatrixEigen<float> eigen = {{1.f, 2.f}, {3.f, 4.f}, {5.f, 6.f}};
+    auto eigen2 = eigen;
+    eigen2 *= 2;
+    auto eigen3 = eigen;
+    eigen3 *= 3;
+
+    describe(".get_num_rows", [&eigen] {
+      it("should return the correct number of rows",
+         [&eigen] { eigen.get_num_rows() must equal(3); });
+    });
+    describe(".get_num_columns", [&eigen] {
+      it("should return the correct number of columns",
+         [&eigen] { eigen.get_num_columns() must equal(2); });
+    });
+
+    describe(".rows", [&eigen] {
+      it("should iterate as many times as number of rows", [&eigen] {
+        size_t n = 0;
+        for (auto i : eigen.rows()) {
+          ++n must be_lte(3);
+        }
+        n must equal(3);
+      });
+
+      it("should all row vectors", [&eigen] {
+        float v[3][2] = {{1.f, 2.f}, {3.f, 4.f}, {5.f, 6.f}};
+        size_t k = 0;
+        for (auto i : eigen.rows()) {
+          std::equal(i.begin(), i.end(), &v[k++][0]) must be_truthy;
+        }
+      });
+    });
+
+    describe(".columns const", [&eigen2] {
+      const auto &eigen = eigen2;
+      it("should iterate as many times as number of columns", [&eigen] {
+        size_t n = 0;
+        for (auto i : eigen.columns()) {
+          ++n must be_lte(2);
+        }
+        n must equal(2);
+      });
+
+      it("should all column vectors", [&eigen] {
+        float v[2][3] = {{2.f, 6.f, 10.f}, {4.f, 8.f, 12.f}};
+        size_t k = 0;
+        for (auto i : eigen.columns()) {
+          std::equal(i.begin(), i.end(), &v[k++][0]) must be_truthy;
+        }
+      });
+    });
+
+    describe("::operator==", [&eigen, &eigen2] {
+      it("should return true for same matrix", [&eigen] {
+        auto eigen2 = eigen;
+        (eigen == eigen2) must be_truthy;
+      });
+
+      it("should false true for different matrix",
+         [&eigen, &eigen2] { (eigen == eigen2) must be_falsy; });
+    });
+
+    describe("::operator+=", [&eigen, &eigen2, &eigen3] {
+      it("should change elements", [&eigen, &eigen2, &eigen3] {
+        auto eigen4 = eigen;
+
+        eigen must equal(eigen4);
+        eigen4 += eigen2;
+        eigen4 must equal(eigen3);
+      });
+
+      it("should accept other backends", [&eigen, &eigen3] {
+        auto eigen4 = eigen;
+        MatrixVector<float> vector = {{2.f, 4.f}, {6.f, 8.f}, {10.f, 12.f}};
+
+        eigen4 += vector;
+        eigen4 must equal(eigen3);
+      });
+    });
+
+    describe("::operator*", [&eigen, &eigen2] {
+      describe("(float)", [&eigen, &eigen2] {
+        it("should return a multiplied matrix", [&eigen, &eigen2] {
+          auto eigen3 = eigen * 2.f;
+          *eigen3 must equal(eigen2);
+        });
+      });
+      describe("(MatrixEigen)", [] {
+        it("should return a multiplied matrix", [] {
+          MatrixEigen<float> eigen1 = {{1, 2}, {3, 4}, {5, 6}};
+          MatrixEigen<float> eigen2 = {{6, 5, 4}, {3, 2, 1}};
+          MatrixEigen<float> eigen3 = {{12, 9, 6}, {30, 23, 16}, {48, 37, 26}};
+          eigen1 *eigen2 must equal(eigen3);
+        });
+      });
+    });
+  });
+});
@@ -0,0 +1,194 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <bandit/bandit.h>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+#include <Eigen/Eigenvalues>
+#include "wrapper/matrix/eigensolver.h"
+using namespace bandit;
+using namespace bandit::Matchers;
+using namespace ketcpp::wrapper::matrix;
+
+namespace {
+  MatrixVector<double> make_symmetric(size_t n, unsigned seed) {
+    MatrixVector<double> a(n, n);
+    for (size_t i = 0; i < n; ++i) {
+      for (size_t j = 0; j <= i; ++j) {
+        a(i, j) = a(j, i) = std::sin(seed + 1.7 * i + 0.31 * j * j);
+      }
+    }
+    return a;
+  }
+
+  // Largest entry of A V - V diag(values) and of V^T V - I.
+  void check(const MatrixVector<double> &a, const Eigensystem<double> &e,
+             double tolerance) {
+    const size_t n = a.get_num_rows(), k = e.values.size();
+    const double *v = e.vectors.data();
+    e.vectors.get_num_rows() must equal(n);
+    e.vectors.get_num_columns() must equal(k);
+    double residual = 0, orthogonality = 0;
+    for (size_t j = 0; j < k; ++j) {
+      if (j > 0) {
+        e.values[j] must be_gte(e.values[j - 1]);
+      }
+      for (size_t i = 0; i < n; ++i) {
+        double sum = -e.values[j] * v[i * k + j];
+        for (size_t l = 0; l < n; ++l) {
+          sum += a(i, l) * v[l * k + j];
+        }
+        residual = std::max(residual, std::abs(sum));
+      }
+      for (size_t l = 0; l < k; ++l) {
+        double sum = l == j ? -1 : 0;
+        for (size_t i = 0; i < n; ++i) {
+          sum += v[i * k + j] * v[i * k + l];
+        }
+        orthogonality = std::max(orthogonality, std::abs(sum));
+      }
+    }
+    residual must be_lte(tolerance);
+    orthogonality must be_lte(tolerance);
+  }
+
+  std::vector<double> reference_values(const MatrixVector<double> &a) {
+    const size_t n = a.get_num_rows();
+    Eigen::MatrixXd m(n, n);
+    for (size_t i = 0; i < n; ++i) {
+      for (size_t j = 0; j < n; ++j) {
+        m(i, j) = a(i, j);
+      }
+    }
+    Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> solver(m);
+    const auto &values = solver.eigenvalues();
+    return std::vector<double>(values.data(), values.data() + n);
+  }
+}
+
+go_bandit([] {
+  describe("diagonalize", [] {
+    it("should diagonalize a small matrix", [] {
+      const MatrixVector<double> a = {{2, 1}, {1, 2}};
+      const auto e = diagonalize(a);
+      e.values[0] must be_close_to(1).within(1e-14);
+      e.values[1] must be_close_to(3).within(1e-14);
+      check(a, e, 1e-14);
+    });
+
+    it("should agree with a reference on the whole spectrum", [] {
+      for (size_t n : {1, 5, 33, 100, 300}) {
+        const auto a = make_symmetric(n, n);
+        const auto e = diagonalize(a);
+        check(a, e, 1e-11 * n);
+        const auto reference = reference_values(a);
+        for (size_t j = 0; j < n; ++j) {
+          e.values[j] must be_close_to(reference[j]).within(1e-11 * n);
+        }
+      }
+    });
+
+    it("should compute only the lowest pairs", [] {
+      const auto a = make_symmetric(120, 3);
+      const auto e = diagonalize(a, 10);
+      e.values.size() must equal(10u);
+      check(a, e, 1e-10);
+      const auto reference = reference_values(a);
+      for (size_t j = 0; j < 10; ++j) {
+        e.values[j] must be_close_to(reference[j]).within(1e-10);
+      }
+    });
+
+    it("should handle degenerate eigenvalues", [] {
+      const size_t n = 80;
+      MatrixVector<double> a(n, n);
+      for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+          a(i, j) = (i == j) + 0.1 * std::cos(i) * std::cos(j);
+        }
+      }
+      const auto all = diagonalize(a);
+      check(a, all, 1e-12);
+      all.values[0] must be_close_to(1).within(1e-12);
+      all.values[n - 2] must be_close_to(1).within(1e-12);
+      const auto lowest = diagonalize(a, 6);
+      check(a, lowest, 1e-12);
+    });
+
+    it("should converge on graded matrices", [] {
+      for (double ratio : {1e-3, 1e-2}) {
+        for (size_t n : {31, 64}) {
+          MatrixVector<double> a(n, n);
+          for (size_t i = 0; i < n; ++i) {
+            for (size_t j = 0; j < n; ++j) {
+              a(i, j) = std::pow(ratio, double(i + j));
+            }
+          }
+          const auto e = diagonalize(a);
+          check(a, e, 1e-12);
+          e.values[n - 1] must be_close_to(1 / (1 - ratio * ratio))
+              .within(1e-12);
+        }
+      }
+    });
+
+    it("should keep tiny matrices orthogonal", [] {
+      const size_t n = 100;
+      const auto a = make_symmetric(n, 5);
+      MatrixVector<double> tiny(n, n);
+      for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+          tiny(i, j) = 1e-150 * a(i, j);
+        }
+      }
+      const auto e = diagonalize(tiny);
+      check(tiny, e, 1e-11 * n);
+      const auto reference = reference_values(a);
+      for (size_t j = 0; j < n; ++j) {
+        (1e150 * e.values[j]) must be_close_to(reference[j]).within(1e-11 * n);
+      }
+    });
+
+    it("should only read the lower triangle", [] {
+      const MatrixVector<double> a = {{2, 100}, {1, 2}};
+      diagonalize(a).values[1] must be_close_to(3).within(1e-14);
+    });
+
+    it("should use Jacobi rotations on small arrays", [] {
+      MatrixArray<double, 3> a = {{4, 1, 0}, {1, 3, 1}, {0, 1, 2}};
+      const auto e = diagonalize(a);
+      check(MatrixVector<double>(a), e, 1e-14);
+      const auto reference = reference_values(MatrixVector<double>(a));
+      for (size_t j = 0; j < 3; ++j) {
+        e.values[j] must be_close_to(reference[j]).within(1e-13);
+      }
+      diagonalize(a, 1).values.size() must equal(1u);
+    });
+
+    it("should accept a Matrix", [] {
+      const Matrix<double> a(MatrixVector<double>({{0, 1}, {1, 0}}));
+      diagonalize(a).values[0] must be_close_to(-1).within(1e-14);
+    });
+
+    it("should reject non-square matrices", [] {
+      [] { diagonalize(MatrixVector<double>(2, 3)); } must throw_exception;
+    });
+  });
+});
@@ -0,0 +1,100 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <bandit/bandit.h>
+#include "wrapper/matrix/default.h"
+#include "wrapper/matrix/expression.h"
+using namespace bandit;
+using namespace bandit::Matchers;
+using namespace ketcpp::wrapper::matrix;
+
+go_bandit([] {
+  describe("Expression", [] {
+    Matrix<double> h = make_matrix<double>({{1, 2}, {3, 4}});
+    Matrix<double> g = make_matrix<double, 2, 2>({{4, 8}, {12, 16}});
+    Matrix<double> k = make_matrix<MatrixEigen>({{8., 4.}, {4., 8.}});
+
+    it("should evaluate a linear combination of mixed backends",
+       [&h, &g, &k] {
+         Matrix<double> f = h + g * 0.5 + k * (-0.25);
+         f must equal(make_matrix<double>({{1, 5}, {8, 10}}));
+       });
+
+    it("should assign into existing storage without reallocating",
+       [&h, &g, &k] {
+         Matrix<double> f = make_matrix<double>({{0, 0}, {0, 0}});
+         const double *storage = f.data();
+         f = h + g * 0.5 + k * (-0.25);
+         f.data() must equal(storage);
+         f must equal(make_matrix<double>({{1, 5}, {8, 10}}));
+       });
+
+    it("should accumulate products in place", [&h, &g] {
+      Matrix<double> f = h;
+      const double *storage = f.data();
+      f += h * g;
+      f.data() must equal(storage);
+      f must equal(make_matrix<double>({{29, 42}, {63, 92}}));
+    });
+
+    it("should subtract, negate and divide", [&h, &g] {
+      Matrix<double> f = g / 4. - h;
+      f must equal(make_matrix<double>({{0, 0}, {0, 0}}));
+      Matrix<double> f2 = -h;
+      f2 must equal(h * -1.);
+      f2 -= h;
+      f2 must equal(h * -2.);
+    });
+
+    it("should handle the destination appearing on the right", [&h, &g] {
+      Matrix<double> f = h;
+      f = f * 2. + f;
+      f must equal(h * 3.);
+      f = f * g;
+      f must equal(make_matrix<double>({{84, 120}, {180, 264}}));
+    });
+
+    it("should evaluate products of expressions", [&h, &g] {
+      Matrix<double> f = (h + h) * (g * 0.25);
+      f must equal(make_matrix<double>({{14, 20}, {30, 44}}));
+    });
+
+    it("should compare unevaluated expressions", [&h, &g] {
+      (h * 4. == g) must be_truthy;
+      (h * 3. != g) must be_truthy;
+    });
+
+    it("should reject mismatched shapes", [&h] {
+      Matrix<double> m = make_matrix<double>({{1, 2, 3}});
+      [&h, &m] { Matrix<double> f = h + m; } must throw_exception;
+      [&h, &m] { Matrix<double> f = h * m; } must throw_exception;
+    });
+
+    describe("lazy", [] {
+      it("should assign into backends directly", [] {
+        MatrixArray<double, 2, 2> a = {1, 2, 3, 4}, b = {4, 3, 2, 1};
+        MatrixArray<double, 2, 2> c;
+        assign(c, lazy(a) * 2. + lazy(b));
+        c must equal(MatrixArray<double, 2, 2>({6, 7, 8, 9}));
+        add_assign(c, lazy(a) * lazy(b));
+        c must equal(MatrixArray<double, 2, 2>({14, 12, 28, 22}));
+      });
+    });
+  });
+});
@@ -0,0 +1,146 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <bandit/bandit.h>
+#include <cmath>
+#include <stdexcept>
+#include "wrapper/matrix/factorize.h"
+#include "helpers.h"
+using namespace bandit;
+using namespace bandit::Matchers;
+using namespace ketcpp::wrapper::matrix;
+using namespace test_helpers;
+
+namespace {
+  MatrixVector<double> make_general(size_t m, size_t n, unsigned seed) {
+    MatrixVector<double> a(m, n);
+    for (size_t i = 0; i < m; ++i) {
+      for (size_t j = 0; j < n; ++j) {
+        a(i, j) = std::sin(seed + 0.37 * (i + 1) * (j + 1) + 0.1 * j * j);
+      }
+    }
+    return a;
+  }
+  MatrixVector<double> make_spd(size_t n) {
+    auto a = make_general(n, n, 1);
+    MatrixVector<double> s(n, n);
+    for (size_t i = 0; i < n; ++i) {
+      for (size_t j = 0; j < n; ++j) {
+        for (size_t k = 0; k < n; ++k) {
+          s(i, j) += a(i, k) * a(j, k);
+        }
+      }
+      s(i, i) += n;
+    }
+    return s;
+  }
+}
+
+go_bandit([] {
+  describe("factorize", [] {
+    const size_t n = 150;
+    const auto spd = make_spd(n);
+    const auto general = make_general(n, n, 2);
+    const auto rhs = make_general(n, 7, 3);
+
+    it("should compute a blocked Cholesky factor", [&] {
+      const auto l = dense(cholesky(spd));
+      max_difference(product(l, transpose(l)), spd) must be_lte(1e-9);
+      for (size_t i = 0; i < n; ++i) {
+        for (size_t j = i + 1; j < n; ++j) {
+          l(i, j) must equal(0);
+        }
+      }
+      const auto x = dense(cholesky_solve(l, rhs));
+      max_difference(product(spd, x), rhs) must be_lte(1e-9);
+    });
+
+    it("should reject matrices that are not positive definite", [] {
+      const MatrixVector<double> a = {{1, 2}, {2, 1}};
+      [&] { cholesky(a); } must throw_exception;
+    });
+
+    it("should find the rank with pivoted Cholesky", [] {
+      const size_t rank = 5, m = 40;
+      const auto b = make_general(m, rank, 4);
+      const auto a = product(b, transpose(b));
+      const auto p = pivoted_cholesky(a);
+      p.rank must equal(rank);
+      p.factor.get_num_columns() must equal(rank);
+      const auto l = dense(p.factor);
+      const auto llt = product(l, transpose(l));
+      double d = 0;
+      for (size_t i = 0; i < m; ++i) {
+        for (size_t j = 0; j < m; ++j) {
+          d = std::max(d, std::abs(llt(i, j) - a(p.permutation[i],
+                                                   p.permutation[j])));
+        }
+      }
+      d must be_lte(1e-10);
+    });
+
+    it("should solve through LU with partial pivoting", [&] {
+      const auto factors = lu(general);
+      factors.pivots.size() must equal(n);
+      const auto x = dense(solve(factors, rhs));
+      max_difference(product(general, x), rhs) must be_lte(1e-9);
+      max_difference(dense(solve(general, rhs)), x) must equal(0);
+      const MatrixVector<double> singular = {{1, 2}, {2, 4}};
+      [&] { lu(singular); } must throw_exception;
+    });
+
+    it("should solve triangular systems with many right-hand sides", [&] {
+      MatrixVector<double> u(n, n);
+      for (size_t i = 0; i < n; ++i) {
+        for (size_t j = i; j < n; ++j) {
+          u(i, j) = i == j ? 2 + general(i, j) : general(i, j) / n;
+        }
+      }
+      MatrixVector<double> x = rhs;
+      solve_triangular(u, Triangle::upper, x);
+      max_difference(product(u, x), rhs) must be_lte(1e-10);
+      MatrixVector<double> y = rhs;
+      solve_triangular(transpose(u), Triangle::lower, y);
+      max_difference(product(transpose(u), y), rhs) must be_lte(1e-10);
+      MatrixVector<double> z = rhs;
+      solve_triangular(transpose(u), Triangle::lower, z, true);
+      MatrixVector<double> unit = u;
+      for (size_t i = 0; i < n; ++i) {
+        unit(i, i) = 1;
+      }
+      max_difference(product(transpose(unit), z), rhs) must be_lte(1e-10);
+    });
+
+    it("should factor and solve fixed-size arrays", [] {
+      const MatrixArray<double, 3> a = {{4, 2, 0}, {2, 5, 1}, {0, 1, 3}};
+      const auto l = cholesky(a);
+      l(0, 1) must equal(0);
+      max_difference(l * l.transpose(), a) must be_lte(1e-14);
+      const MatrixArray<double, 3, 2> b = {{1, 0}, {0, 1}, {2, 3}};
+      const auto x = solve(a, b);
+      max_difference(a * x, b) must be_lte(1e-14);
+      const MatrixArray<double, 2, 2, Layout::column_major> c = {{0, 1},
+                                                                 {2, 0}};
+      const MatrixArray<double, 2, 1> d = {4., 6.};
+      const auto e = solve(c, d);
+      e(0, 0) must equal(3);
+      e(1, 0) must equal(4);
+    });
+  });
+});
@@ -0,0 +1,165 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <bandit/bandit.h>
+#include <stdexcept>
+#include "wrapper/matrix/array.h"
+#include "wrapper/matrix/fixed.h"
+using namespace bandit;
+using namespace bandit::Matchers;
+using namespace ketcpp::wrapper::matrix;
+
+namespace {
+  constexpr FixedMatrix<double, 3> rotation = {{0, -1, 0, 1, 0, 0, 0, 0, 1}};
+  constexpr FixedMatrix<double, 3, 1> x = {{1, 0, 0}}, y = {{0, 1, 0}};
+  // Needs a row swap during elimination.
+  constexpr FixedMatrix<double, 4> a4 = {
+      {0, 2, 0, 0, 1, 0, 0, 0, 0, 0, 4, 0, 0, 0, 1, 0.5}};
+
+  static_assert(rotation * x == y, "constexpr multiply");
+  static_assert(transpose(rotation) * rotation ==
+                    FixedMatrix<double, 3>{{1, 0, 0, 0, 1, 0, 0, 0, 1}},
+                "constexpr transpose");
+  static_assert(determinant(rotation) == 1, "constexpr 3x3 determinant");
+  static_assert(determinant(a4) == -4, "constexpr 4x4 determinant");
+  static_assert(inverse(rotation) == transpose(rotation), "constexpr inverse");
+  static_assert(cross(x, y) == FixedMatrix<double, 3, 1>{{0, 0, 1}},
+                "constexpr cross product");
+
+  template <size_t n> MatrixArray<double, n> make_spd() {
+    MatrixArray<double, n> a;
+    for (size_t i = 0; i < n; ++i) {
+      for (size_t j = 0; j < n; ++j) {
+        a(i, j) = i == j ? n + 1. : 1. / (i + j + 1);
+      }
+    }
+    return a;
+  }
+
+  template <size_t n> void check_inverse() {
+    const auto a = make_spd<n>();
+    const auto product = a * a.inverse();
+    for (size_t i = 0; i < n; ++i) {
+      for (size_t j = 0; j < n; ++j) {
+        product(i, j) must be_close_to(i == j ? 1. : 0.).within(1e-12);
+      }
+    }
+  }
+}
+
+go_bandit([] {
+  describe("FixedMatrix", [] {
+    it("should be a literal type", [] {
+      std::is_literal_type<FixedMatrix<float, 2, 3>>::value must be_truthy;
+    });
+
+    it("should invert 2x2 matrices", [] {
+      const FixedMatrix<double, 2> a = {{4, 7, 2, 6}};
+      const auto b = inverse(a);
+      b(0, 0) must be_close_to(0.6).within(1e-15);
+      b(0, 1) must be_close_to(-0.7).within(1e-15);
+      b(1, 0) must be_close_to(-0.2).within(1e-15);
+      b(1, 1) must be_close_to(0.4).within(1e-15);
+    });
+
+    it("should throw for singular matrices", [] {
+      [] { inverse(FixedMatrix<double, 2>{{1, 2, 2, 4}}); }
+      must throw_exception;
+      [] {
+        inverse(FixedMatrix<double, 5>{
+            {1, 2, 3, 4, 5, 2, 4, 6, 8, 10, 0, 0, 1, 0, 0,
+             0, 0, 0, 1, 0, 0, 0, 0, 0, 1}});
+      } must throw_exception;
+    });
+  });
+
+  describe("MatrixArray", [] {
+    describe("::operator*", [] {
+      it("should match gemm for small shapes", [] {
+        MatrixArray<double, 3, 4> a;
+        MatrixArray<double, 4, 2> b;
+        for (size_t i = 0; i < 12; ++i) {
+          a.data()[i] = i + 1.;
+        }
+        for (size_t i = 0; i < 8; ++i) {
+          b.data()[i] = 0.5 * i - 1.;
+        }
+        const auto c = a * b;
+        for (size_t i = 0; i < 3; ++i) {
+          for (size_t j = 0; j < 2; ++j) {
+            double sum = 0;
+            for (size_t k = 0; k < 4; ++k) {
+              sum += a(i, k) * b(k, j);
+            }
+            c(i, j) must equal(sum);
+          }
+        }
+      });
+    });
+
+    describe("::transpose", [] {
+      it("should swap rows and columns", [] {
+        MatrixArray<float, 2, 3> a = {{1, 2, 3}, {4, 5, 6}};
+        MatrixArray<float, 3, 2> b = {{1, 4}, {2, 5}, {3, 6}};
+        (a.transpose() == b) must be_truthy;
+      });
+    });
+
+    describe("::determinant", [] {
+      it("should handle every order up to eight", [] {
+        MatrixArray<double, 2> a2 = {{3, 1}, {4, 2}};
+        a2.determinant() must equal(2);
+        MatrixArray<double, 3> a3 = {{2, 0, 1}, {1, 3, 2}, {1, 1, 2}};
+        a3.determinant() must equal(6);
+        MatrixArray<double, 8> a8 = {0.};
+        for (size_t i = 0; i < 8; ++i) {
+          a8(i, 7 - i) = i + 1.;
+        }
+        // Reversing eight rows takes four swaps.
+        a8.determinant() must be_close_to(40320).within(1e-9);
+      });
+
+      it("should be zero for singular matrices", [] {
+        MatrixArray<double, 4> a = {
+            {1, 2, 3, 4}, {2, 4, 6, 8}, {0, 1, 0, 1}, {1, 0, 1, 0}};
+        a.determinant() must equal(0);
+      });
+    });
+
+    describe("::inverse", [] {
+      it("should give the identity when multiplied back", [] {
+        check_inverse<2>();
+        check_inverse<3>();
+        check_inverse<4>();
+        check_inverse<6>();
+        check_inverse<8>();
+      });
+    });
+
+    describe("::cross", [] {
+      it("should follow the right-hand rule", [] {
+        MatrixArray<double, 3, 1> a = {1, 2, 3}, b = {4, 5, 6};
+        MatrixArray<double, 3, 1> c = {-3, 6, -3};
+        (a.cross(b) == c) must be_truthy;
+        MatrixArray<double, 1, 3> d = {0, 0, 1}, e = {1, 0, 0};
+        (d.cross(e) == MatrixArray<double, 1, 3>{0, 1, 0}) must be_truthy;
+      });
+    });
+  });
+});
@@ -0,0 +1,86 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <bandit/bandit.h>
+#include <complex>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include "wrapper/matrix/default.h"
+#include "wrapper/matrix/format.h"
+using namespace bandit;
+using namespace bandit::Matchers;
+using namespace ketcpp::wrapper::matrix;
+
+go_bandit([] {
+  describe("format", [] {
+    MatrixVector<double> a = {{1, 2.5}, {-3, 0.1}};
+
+    it("should match operator<< in the default style", [&a] {
+      std::stringstream ss;
+      ss << static_cast<const MatrixBase<double> &>(a);
+      to_string(a) must equal(ss.str());
+    });
+
+    it("should write CSV and whitespace-separated text", [&a] {
+      to_string(a, FormatStyle::csv()) must equal("1,2.5\n-3,0.1\n");
+      to_string(a, FormatStyle::whitespace()) must equal("1 2.5\n-3 0.1\n");
+    });
+
+    it("should write the shortest round-trip text", [] {
+      MatrixVector<double> b = {{1. / 3, 1e-300, 0.1 + 0.2}};
+      const std::string text = to_string(b, FormatStyle::whitespace());
+      text must equal("0.3333333333333333 1e-300 0.30000000000000004\n");
+      MatrixVector<float> f = {{0.1f, 1.f / 3}};
+      to_string(f, FormatStyle::csv()) must equal("0.1,0.33333334\n");
+    });
+
+    it("should honour a fixed precision", [] {
+      MatrixVector<double> b = {{1. / 3, 2. / 3}};
+      to_string(b, FormatStyle::csv(3)) must equal("0.333,0.667\n");
+    });
+
+    it("should write complex elements", [] {
+      using Z = std::complex<double>;
+      MatrixVector<Z> z = {{Z(1, -2)}};
+      to_string(z) must equal("{{(1,-2)}}");
+    });
+
+    it("should format non-strided backends", [] {
+      MatrixSymmetric<double> s = {{1, 2}, {2, 3}};
+      to_string(s) must equal("{{1, 2}, {2, 3}}");
+    });
+
+    it("should keep row order for large matrices", [] {
+      const size_t m = 3000, n = 7;
+      MatrixVector<double> b(m, n);
+      for (size_t i = 0; i < m * n; ++i) {
+        b.data()[i] = i * 0.37;
+      }
+      std::istringstream in(to_string(b, FormatStyle::whitespace()));
+      bool exact = true;
+      for (size_t i = 0; i < m * n; ++i) {
+        std::string word;
+        in >> word;
+        exact = exact && std::strtod(word.c_str(), nullptr) == b.data()[i];
+      }
+      exact must be_truthy;
+    });
+  });
+});
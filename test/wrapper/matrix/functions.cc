@@ -0,0 +1,217 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <bandit/bandit.h>
+#include <cmath>
+#include "wrapper/matrix/block_sparse.h"
+#include "wrapper/matrix/functions.h"
+#include "wrapper/matrix/view.h"
+#include "helpers.h"
+using namespace bandit;
+using namespace bandit::Matchers;
+using namespace ketcpp::wrapper::matrix;
+using namespace test_helpers;
+
+namespace {
+  // Symmetric with eigenvalues on both sides of zero, none near it.
+  MatrixVector<double> make_hamiltonian(size_t n) {
+    MatrixVector<double> h(n, n);
+    for (size_t i = 0; i < n; ++i) {
+      for (size_t j = 0; j <= i; ++j) {
+        h(i, j) = h(j, i) = 0.1 * std::cos(0.3 * i * j) / (1. + i - j);
+      }
+      h(i, i) = double(i) - 0.5 * n + 0.5;
+    }
+    return h;
+  }
+  // r r^T for an n x rank r, positive semidefinite and singular.
+  MatrixVector<double> make_low_rank(size_t n, size_t rank) {
+    MatrixVector<double> r(n, rank), a(n, n);
+    for (size_t i = 0; i < n; ++i) {
+      for (size_t k = 0; k < rank; ++k) {
+        r(i, k) = std::sin(1. + i + 3. * k);
+      }
+    }
+    gemm(1., r, transpose(r), 0., a);
+    return a;
+  }
+  MatrixVector<double> make_antisymmetric(size_t n) {
+    MatrixVector<double> k(n, n);
+    for (size_t i = 0; i < n; ++i) {
+      for (size_t j = 0; j < i; ++j) {
+        k(i, j) = 0.3 * std::sin(1. + i + 2. * j);
+        k(j, i) = -k(i, j);
+      }
+    }
+    return k;
+  }
+  double distance_from_identity(const MatrixVector<double> &a) {
+    double d = 0;
+    for (size_t i = 0; i < a.get_num_rows(); ++i) {
+      for (size_t j = 0; j < a.get_num_columns(); ++j) {
+        d = std::max(d, std::abs(a(i, j) - (i == j)));
+      }
+    }
+    return d;
+  }
+}
+
+go_bandit([] {
+  describe("matrix functions", [] {
+    const size_t n = 48;
+    const auto s = make_overlap(n);
+    const auto h = make_hamiltonian(n);
+    const auto spectral = FunctionMethod::spectral;
+    const auto iterative = FunctionMethod::iterative;
+
+    it("should compute square roots both ways", [&] {
+      const auto x = dense(square_root(s, spectral));
+      const auto y = dense(square_root(s, iterative));
+      max_difference(x, y) must be_lte(1e-12);
+      max_difference(product(x, x), s) must be_lte(1e-12);
+      max_difference(dense(square_root(s)), x) must be_lte(1e-12);
+    });
+
+    it("should compute square roots of singular matrices", [&] {
+      const auto a = make_low_rank(40, 10);
+      const auto x = dense(square_root(a, spectral));
+      const auto y = dense(square_root(a, iterative));
+      max_difference(x, y) must be_lte(1e-6);
+      max_difference(product(y, y), a) must be_lte(1e-10);
+      [&] { inverse_square_root(a, iterative); } must throw_exception;
+    });
+
+    it("should accept eigenvalues at the rounding level below zero", [&] {
+      const auto a = make_overlap(40, 0.02);
+      const auto x = dense(square_root(a, spectral));
+      const auto y = dense(square_root(a, iterative));
+      max_difference(x, y) must be_lte(1e-6);
+      max_difference(product(y, y), a) must be_lte(1e-10);
+    });
+
+    it("should compute inverse square roots both ways", [&] {
+      const auto x = dense(inverse_square_root(s, spectral));
+      const auto y = dense(inverse_square_root(s, iterative));
+      max_difference(x, y) must be_lte(1e-10);
+      distance_from_identity(product(product(x, s), x)) must be_lte(1e-10);
+      distance_from_identity(product(product(y, s), y)) must be_lte(1e-10);
+    });
+
+    it("should reject matrices that are not positive definite", [&] {
+      [&] { square_root(h, spectral); } must throw_exception;
+      [&] { square_root(h, iterative); } must throw_exception;
+      [&] { inverse_square_root(h, iterative); } must throw_exception;
+      const MatrixVector<double> rectangular(2, 3);
+      [&] { square_root(rectangular); } must throw_exception;
+    });
+
+    it("should compute the sign function both ways", [&] {
+      const auto x = dense(sign(h, spectral));
+      const auto y = dense(sign(h, iterative));
+      max_difference(x, y) must be_lte(1e-10);
+      distance_from_identity(product(y, y)) must be_lte(1e-10);
+      const MatrixVector<double> singular = {{1, 1}, {1, 1}};
+      [&] { sign(singular, spectral); } must throw_exception;
+    });
+
+    it("should compute exponentials of symmetric matrices", [&] {
+      const MatrixVector<double> a = {{2, 0}, {0, -1}};
+      const auto x = dense(exponential(a, iterative));
+      x(0, 0) must be_close_to(std::exp(2.)).within(1e-14);
+      x(1, 1) must be_close_to(std::exp(-1.)).within(1e-15);
+      x(0, 1) must equal(0.);
+      const auto y = dense(exponential(h, spectral));
+      const auto z = dense(exponential(h, iterative));
+      max_difference(y, z) must be_lte(1e-12 * std::exp(0.5 * n));
+    });
+
+    it("should compute rotations from antisymmetric generators", [&] {
+      const double t = 0.7;
+      const MatrixVector<double> k = {{0, -t}, {t, 0}};
+      const auto r = dense(exponential(k));
+      max_difference(r, MatrixVector<double>{{std::cos(t), -std::sin(t)},
+                                             {std::sin(t), std::cos(t)}})
+          must be_lte(1e-15);
+      const auto kappa = make_antisymmetric(n);
+      const auto u = dense(exponential(kappa));
+      MatrixVector<double> ut(n, n);
+      for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+          ut(i, j) = u(j, i);
+        }
+      }
+      distance_from_identity(product(ut, u)) must be_lte(1e-12);
+      [&] { exponential(kappa, spectral); } must throw_exception;
+    });
+
+    it("should compute powers", [&] {
+      const auto cube = product(product(s, s), s);
+      max_difference(dense(power(s, 3., iterative)), cube) must be_lte(1e-11);
+      max_difference(dense(power(s, 3., spectral)), cube) must be_lte(1e-11);
+      const auto inverse = dense(power(s, -1.));
+      distance_from_identity(product(inverse, s)) must be_lte(1e-10);
+      const auto x = dense(power(s, 1.5));
+      max_difference(x, product(dense(square_root(s)), s))
+          must be_lte(1e-12);
+      [&] { power(s, 1.5, iterative); } must throw_exception;
+      distance_from_identity(dense(power(h, 0., iterative))) must equal(0.);
+    });
+
+    it("should apply arbitrary functions to the eigenvalues", [&] {
+      const auto x = dense(apply_function(s, [](double x) { return x * x; }));
+      max_difference(x, product(s, s)) must be_lte(1e-12);
+    });
+
+    it("should keep block-sparse operands block-sparse", [&] {
+      // Block diagonal, so that the iterations do not fill in.
+      MatrixVector<double> blocked(n, n);
+      for (size_t i = 0; i < n; ++i) {
+        for (size_t j = i / 8 * 8; j < i / 8 * 8 + 8; ++j) {
+          blocked(i, j) = s(i, j);
+        }
+      }
+      const MatrixBlockSparse<double> sparse(blocked, 8);
+      const auto x = inverse_square_root(sparse);
+      (x.data() == nullptr) must be_truthy;
+      max_difference(dense(x), dense(inverse_square_root(blocked, spectral)))
+          must be_lte(1e-10);
+      const auto y = sign(sparse, iterative);
+      (y.data() == nullptr) must be_truthy;
+      distance_from_identity(dense(y)) must be_lte(1e-12);
+    });
+
+    it("should compute square roots of singular block-sparse matrices", [&] {
+      MatrixVector<double> blocked(n, n);
+      for (size_t b = 0; b < n; b += 8) {
+        const auto a = make_low_rank(8, 3);
+        for (size_t i = 0; i < 8; ++i) {
+          for (size_t j = 0; j < 8; ++j) {
+            blocked(b + i, b + j) = a(i, j);
+          }
+        }
+      }
+      const MatrixBlockSparse<double> sparse(blocked, 8);
+      const auto x = square_root(sparse);
+      (x.data() == nullptr) must be_truthy;
+      max_difference(dense(x), dense(square_root(blocked, spectral)))
+          must be_lte(1e-6);
+      max_difference(product(dense(x), dense(x)), blocked) must be_lte(1e-10);
+    });
+  });
+});
@@ -0,0 +1,126 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <bandit/bandit.h>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+#include "wrapper/matrix/gemm.h"
+#include "wrapper/thread/pool.h"
+using namespace bandit;
+using namespace bandit::Matchers;
+using namespace ketcpp::wrapper::matrix;
+
+namespace {
+  template <typename T> std::vector<T> random_vector(size_t size) {
+    std::mt19937 engine(size);
+    std::uniform_real_distribution<T> distribution(-1, 1);
+    std::vector<T> v(size);
+    for (auto &x : v) {
+      x = distribution(engine);
+    }
+    return v;
+  }
+
+  template <typename T>
+  std::vector<T> naive(size_t m, size_t n, size_t k, T alpha,
+                       const std::vector<T> &a, std::ptrdiff_t rsa,
+                       std::ptrdiff_t csa, const std::vector<T> &b,
+                       std::ptrdiff_t rsb, std::ptrdiff_t csb, T beta,
+                       std::vector<T> c) {
+    for (size_t i = 0; i < m; ++i) {
+      for (size_t j = 0; j < n; ++j) {
+        T sum = 0;
+        for (size_t p = 0; p < k; ++p) {
+          sum += a[i * rsa + p * csa] * b[p * rsb + j * csb];
+        }
+        c[i * n + j] = beta * c[i * n + j] + alpha * sum;
+      }
+    }
+    return c;
+  }
+
+  template <typename T>
+  T max_difference(const std::vector<T> &a, const std::vector<T> &b) {
+    T max = 0;
+    for (size_t i = 0; i < a.size(); ++i) {
+      max = std::max(max, std::abs(a[i] - b[i]));
+    }
+    return max;
+  }
+
+  template <typename T>
+  T compare(size_t m, size_t n, size_t k, T alpha, T beta, bool ta, bool tb) {
+    auto a = random_vector<T>(m * k), b = random_vector<T>(k * n),
+         c = random_vector<T>(m * n);
+    std::ptrdiff_t rsa = ta ? 1 : k, csa = ta ? m : 1;
+    std::ptrdiff_t rsb = tb ? 1 : n, csb = tb ? k : 1;
+    auto expected = naive(m, n, k, alpha, a, rsa, csa, b, rsb, csb, beta, c);
+    gemm<T>(m, n, k, alpha, a.data(), rsa, csa, b.data(), rsb, csb, beta,
+            c.data(), n, 1);
+    return max_difference(c, expected);
+  }
+}
+
+go_bandit([] {
+  describe("gemm", [] {
+    it("should match the naive product for small shapes", [] {
+      compare<double>(3, 2, 4, 1, 0, false, false) must be_lte(1e-12);
+      compare<float>(1, 7, 5, 1, 0, false, false) must be_lte(1e-5f);
+    });
+
+    it("should match the naive product across block boundaries", [] {
+      compare<double>(131, 67, 300, 1, 0, false, false) must be_lte(1e-10);
+      compare<float>(201, 33, 97, 1, 0, false, false) must be_lte(1e-4f);
+    });
+
+    it("should honour alpha and beta", [] {
+      compare<double>(45, 51, 260, -0.5, 2, false, false) must be_lte(1e-10);
+      compare<double>(2, 3, 4, 2, 0.25, false, false) must be_lte(1e-12);
+    });
+
+    it("should accept transposed operands through strides", [] {
+      compare<double>(70, 40, 90, 1, 1, true, false) must be_lte(1e-10);
+      compare<double>(70, 40, 90, 1, 1, false, true) must be_lte(1e-10);
+      compare<double>(70, 40, 90, 1, 1, true, true) must be_lte(1e-10);
+    });
+
+    it("should match the naive product on several threads", [] {
+      const size_t num_threads = ketcpp::wrapper::thread::get_num_threads();
+      ketcpp::wrapper::thread::set_num_threads(4);
+      compare<double>(300, 130, 120, 1, 0.5, false, false) must be_lte(1e-10);
+      compare<double>(70, 260, 110, 1, 0, true, true) must be_lte(1e-10);
+      ketcpp::wrapper::thread::set_num_threads(num_threads);
+    });
+
+    it("should only scale C when k is zero", [] {
+      std::vector<double> c = {1, 2, 3, 4};
+      gemm<double>(2, 2, 0, 1, nullptr, 0, nullptr, 0, 3, c.data(), 2);
+      c must equal(std::vector<double>({3, 6, 9, 12}));
+    });
+
+    it("should not read C when beta is zero", [] {
+      std::vector<double> a = {1, 2}, b = {3, 4};
+      std::vector<double> c = {std::numeric_limits<double>::quiet_NaN()};
+      gemm<double>(1, 1, 2, 1, a.data(), 2, b.data(), 1, 0, c.data(), 1);
+      c[0] must equal(11);
+    });
+  });
+});
@@ -0,0 +1,70 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#include "wrapper/matrix/default.h"
+#include "wrapper/matrix/gemm.h"
+#include "wrapper/matrix/matrix.h"
+
+// Helpers shared by the tests of the dense solvers and matrix functions.
+namespace test_helpers {
+  using ketcpp::wrapper::matrix::Matrix;
+  using ketcpp::wrapper::matrix::MatrixBase;
+  using ketcpp::wrapper::matrix::MatrixVector;
+
+  // Overlap of Gaussians exp(-width (i - j)^2) on a line, positive
+  // definite.
+  inline MatrixVector<double> make_overlap(size_t n, double width = 0.5) {
+    MatrixVector<double> s(n, n);
+    for (size_t i = 0; i < n; ++i) {
+      for (size_t j = 0; j < n; ++j) {
+        const double d = double(i) - double(j);
+        s(i, j) = std::exp(-width * d * d);
+      }
+    }
+    return s;
+  }
+
+  inline MatrixVector<double> dense(const Matrix<double> &a) {
+    return MatrixVector<double>(a.get_base());
+  }
+
+  inline MatrixVector<double> product(const MatrixBase<double> &a,
+                                      const MatrixBase<double> &b) {
+    MatrixVector<double> c(a.get_num_rows(), b.get_num_columns());
+    ketcpp::wrapper::matrix::gemm(1., a, b, 0., c);
+    return c;
+  }
+
+  template <typename A, typename B>
+  double max_difference(const A &a, const B &b) {
+    double d = 0;
+    for (size_t i = 0; i < a.get_num_rows(); ++i) {
+      for (size_t j = 0; j < a.get_num_columns(); ++j) {
+        d = std::max(d, std::abs(a(i, j) - b(i, j)));
+      }
+    }
+    return d;
+  }
+}
@@ -0,0 +1,158 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <bandit/bandit.h>
+#include <cstdio>
+#include <string>
+#include "wrapper/matrix/default.h"
+#include "wrapper/matrix/mapped.h"
+using namespace bandit;
+using namespace bandit::Matchers;
+using namespace ketcpp::wrapper::matrix;
+using ketcpp::wrapper::memory::Advice;
+using ketcpp::wrapper::memory::MappedFile;
+using ketcpp::wrapper::memory::Sharing;
+
+namespace {
+  template <typename M> void fill(M &a, double seed) {
+    for (size_t i = 0; i < a.get_num_rows(); ++i) {
+      for (size_t j = 0; j < a.get_num_columns(); ++j) {
+        a(i, j) = seed * (i + 1) - double(j) / (i + j + 1);
+      }
+    }
+  }
+}
+
+go_bandit([] {
+  describe("MatrixMapped", [] {
+    it("should not be abstract class", [] {
+      std::is_abstract<MatrixMapped<double>>::value must_not be_truthy;
+    });
+
+    it("should start zero-filled", [] {
+      MatrixMapped<double> a(3, 4);
+      (a == MatrixVector<double>(3, 4)) must be_truthy;
+    });
+
+    it("should be constructible from lists", [] {
+      MatrixMapped<double> a = {{1, 2}, {3, 4}};
+      a(1, 0) must equal(3);
+      const MatrixBase<double> &base = a;
+      (base == MatrixVector<double>({{1, 2}, {3, 4}})) must be_truthy;
+    });
+
+    it("should copy into a separate file", [] {
+      MatrixMapped<double> a = {{1, 2}, {3, 4}};
+      MatrixMapped<double> b = a;
+      b(0, 0) = 5;
+      a(0, 0) must equal(1);
+    });
+
+    it("should keep named files", [] {
+      const std::string path =
+          MappedFile::get_scratch_directory() + "/ketcpp-mapped-test";
+      {
+        MatrixMapped<double> a(path, 2, 3);
+        a(1, 2) = 7;
+      }
+      {
+        MatrixMapped<double> a(path, 2, 3);
+        a(1, 2) must equal(7);
+      }
+      std::remove(path.c_str());
+    });
+
+    it("should create scratch files in the scratch directory", [] {
+      const std::string old = MappedFile::get_scratch_directory();
+      MappedFile::set_scratch_directory("/nonexistent-ketcpp");
+      [] { MatrixMapped<double> a(2, 2); } must throw_exception;
+      MappedFile::set_scratch_directory(old);
+      [] { MatrixMapped<double> a(2, 2); } must_not throw_exception;
+    });
+
+    it("should accept access hints", [] {
+      MatrixMapped<double> a(100, 3000);
+      fill(a, 1);
+      a.advise(Advice::sequential);
+      a.advise_tile(10, 100, 20, 200, Advice::will_need);
+      a.advise_rows(0, 50, Advice::dont_need);
+      a(20, 2999) must equal(1. * 21 - 2999. / 3020);
+    });
+
+    describe("::gemm_streamed", [] {
+      MatrixVector<double> a(37, 23), b(23, 19);
+      fill(a, 1);
+      fill(b, -2);
+      const MatrixVector<double> expected = a * b;
+
+      it("should match the in-core product over small tiles", [&] {
+        MatrixMapped<double> am(37, 23), bm(23, 19), c(37, 19);
+        Dispatcher<double>::convert(am, a);
+        Dispatcher<double>::convert(bm, b);
+        MatrixMapped<double>::gemm_streamed(1., am, bm, 0., c, 200);
+        for (size_t i = 0; i < 37; ++i) {
+          for (size_t j = 0; j < 19; ++j) {
+            c(i, j) must be_close_to(expected(i, j)).within(1e-10);
+          }
+        }
+      });
+
+      it("should accumulate with beta", [&] {
+        MatrixVector<double> c = expected;
+        MatrixMapped<double>::gemm_streamed(2., a, b, -1., c, 300);
+        for (size_t i = 0; i < 37; ++i) {
+          for (size_t j = 0; j < 19; ++j) {
+            c(i, j) must be_close_to(expected(i, j)).within(1e-10);
+          }
+        }
+      });
+
+      it("should keep products in private mappings", [] {
+        const std::string path =
+            MappedFile::get_scratch_directory() + "/ketcpp-mapped-test";
+        { MatrixMapped<double> file(path, 2, 2); }
+        {
+          MatrixMapped<double> c(path, 2, 2, 0, Sharing::private_copy);
+          const MatrixVector<double> a = {{1, 2}, {3, 4}};
+          const MatrixVector<double> identity = {{1, 0}, {0, 1}};
+          MatrixMapped<double>::gemm_streamed(1., a, identity, 0., c);
+          (c == a) must be_truthy;
+          c.advise(Advice::dont_need);
+          (c == a) must be_truthy;
+        }
+        std::remove(path.c_str());
+      });
+
+      it("should be dispatched for mapped operands", [&] {
+        std::unique_ptr<MatrixBase<double>> am(
+            new MatrixMapped<double>(37, 23));
+        Dispatcher<double>::convert(*am, a);
+        auto c = Dispatcher<double>::multiply(*am, b);
+        (dynamic_cast<MatrixMapped<double> *>(c.get()) != nullptr)
+            must be_truthy;
+        for (size_t i = 0; i < 37; ++i) {
+          for (size_t j = 0; j < 19; ++j) {
+            c->data()[i * 19 + j] must be_close_to(expected(i, j))
+                .within(1e-10);
+          }
+        }
+      });
+    });
+  });
+});
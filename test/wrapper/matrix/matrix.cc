@@ -335,5 +335,13 @@ go_bandit([] {
         });
       });
     });
+
+    describe("make_matrix<MatrixEigen>", [&matrix] {
+      it("should build a matrix backed by Eigen", [&matrix] {
+        Matrix<float> eigen =
+            make_matrix<MatrixEigen>({{1.f, 2.f}, {3.f, 4.f}, {5.f, 6.f}});
+        eigen must equal(matrix);
+      });
+    });
   });
 });
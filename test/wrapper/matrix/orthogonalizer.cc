@@ -0,0 +1,157 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <bandit/bandit.h>
+#include <cmath>
+#include "wrapper/matrix/orthogonalizer.h"
+#include "helpers.h"
+using namespace bandit;
+using namespace bandit::Matchers;
+using namespace ketcpp::wrapper::matrix;
+using namespace test_helpers;
+
+namespace {
+  // A Fock-like matrix in the basis of make_overlap.
+  MatrixVector<double> make_fock(size_t n) {
+    MatrixVector<double> f(n, n);
+    for (size_t i = 0; i < n; ++i) {
+      for (size_t j = 0; j <= i; ++j) {
+        f(i, j) = f(j, i) = std::cos(0.3 * i * j) - (i == j) * 0.1 * i;
+      }
+    }
+    return f;
+  }
+
+  // Largest entries of F C - S C e and of C^T S C - I.
+  void check(const MatrixVector<double> &f, const MatrixVector<double> &s,
+             const Eigensystem<double> &e, double tolerance) {
+    const size_t n = f.get_num_rows(), k = e.values.size();
+    const double *c = e.vectors.data();
+    double residual = 0, orthonormality = 0;
+    for (size_t j = 0; j < k; ++j) {
+      for (size_t i = 0; i < n; ++i) {
+        double sum = 0;
+        for (size_t l = 0; l < n; ++l) {
+          sum += (f(i, l) - e.values[j] * s(i, l)) * c[l * k + j];
+        }
+        residual = std::max(residual, std::abs(sum));
+      }
+      for (size_t l = 0; l < k; ++l) {
+        double sum = l == j ? -1 : 0;
+        for (size_t a = 0; a < n; ++a) {
+          for (size_t b = 0; b < n; ++b) {
+            sum += c[a * k + j] * s(a, b) * c[b * k + l];
+          }
+        }
+        orthonormality = std::max(orthonormality, std::abs(sum));
+      }
+    }
+    residual must be_lte(tolerance);
+    orthonormality must be_lte(tolerance);
+  }
+}
+
+go_bandit([] {
+  describe("Orthogonalizer", [] {
+    const size_t n = 40;
+    const auto s = make_overlap(n);
+    const auto f = make_fock(n);
+
+    it("should solve the generalized problem with every method", [&] {
+      std::vector<double> reference;
+      for (auto method :
+           {Orthogonalization::symmetric, Orthogonalization::canonical,
+            Orthogonalization::cholesky}) {
+        const Orthogonalizer<double> x(s, method);
+        x.get_method() must equal(method);
+        x.get_num_dropped() must equal(0u);
+        const auto e = x.solve(f);
+        check(f, s, e, 1e-10);
+        if (reference.empty()) {
+          reference = e.values;
+        }
+        for (size_t j = 0; j < n; ++j) {
+          e.values[j] must be_close_to(reference[j]).within(1e-10);
+        }
+      }
+    });
+
+    it("should orthonormalize the overlap", [&] {
+      const Orthogonalizer<double> x(s);
+      const Matrix<double> identity = x.project(s);
+      const double *p = identity.data();
+      const double *t = x.get_transform().data();
+      for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+          p[i * n + j] must be_close_to(i == j).within(1e-10);
+          t[i * n + j] must be_close_to(t[j * n + i]).within(1e-12);
+        }
+      }
+    });
+
+    it("should compute only the lowest pairs", [&] {
+      const auto e = Orthogonalizer<double>(s).solve(f, 5);
+      e.values.size() must equal(5u);
+      check(f, s, e, 1e-10);
+      diagonalize(f, s).values[4] must be_close_to(e.values[4])
+          .within(1e-10);
+    });
+
+    it("should drop linearly dependent functions", [] {
+      // The last function is the sum of the first two.
+      const size_t m = 6;
+      MatrixVector<double> b(10, m);
+      for (size_t i = 0; i < 10; ++i) {
+        for (size_t j = 0; j + 1 < m; ++j) {
+          const double d = double(i) - 2. * j;
+          b(i, j) = std::exp(-0.3 * d * d);
+        }
+        b(i, m - 1) = b(i, 0) + b(i, 1);
+      }
+      MatrixVector<double> dependent(m, m), fock(m, m);
+      for (size_t i = 0; i < m; ++i) {
+        for (size_t j = 0; j < m; ++j) {
+          for (size_t l = 0; l < 10; ++l) {
+            dependent(i, j) += b(l, i) * b(l, j);
+            fock(i, j) += b(l, i) * b(l, j) * (l % 3 - 1.);
+          }
+        }
+      }
+      for (auto method :
+           {Orthogonalization::symmetric, Orthogonalization::cholesky}) {
+        const Orthogonalizer<double> x(dependent, method);
+        x.get_method() must equal(Orthogonalization::canonical);
+        x.get_num_functions() must equal(m);
+        x.get_num_dropped() must equal(1u);
+        const auto e = x.solve(fock);
+        e.values.size() must equal(m - 1);
+        check(fock, dependent, e, 1e-9);
+      }
+    });
+
+    it("should rebuild only when the overlap changes", [&] {
+      Orthogonalizer<double> x(s);
+      x.reset(s) must be_falsy;
+      MatrixVector<double> moved = s;
+      moved(1, 0) = moved(0, 1) = 0.5;
+      x.reset(moved) must be_truthy;
+      check(f, moved, x.solve(f), 1e-10);
+    });
+  });
+});
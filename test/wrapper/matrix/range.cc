@@ -0,0 +1,47 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <bandit/bandit.h>
+#include <vector>
+#include "wrapper/matrix/range.h"
+using namespace bandit;
+using namespace bandit::Matchers;
+using namespace ketcpp::wrapper::matrix;
+
+go_bandit([] {
+  describe("StrideIterator", [] {
+    std::vector<int> v = {0, 1, 2, 3, 4, 5, 6, 7, 8};
+
+    it("should advance by its stride", [&v] {
+      StrideIterator<int> it(v.data() + 1, 3);
+      *it must equal(1);
+      *++it must equal(4);
+      it[1] must equal(7);
+    });
+
+    it("should measure distances in strides", [&v] {
+      StrideIterator<int> first(v.data(), 3), last(v.data() + 9, 3);
+      (last - first) must equal(3);
+      Range<StrideIterator<int>> range(first, last);
+      range.size() must equal(3);
+      std::vector<int>(range.begin(), range.end()) must
+          equal(std::vector<int>({0, 3, 6}));
+    });
+  });
+});
@@ -0,0 +1,116 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <bandit/bandit.h>
+#include <stdexcept>
+#include <vector>
+#include "wrapper/matrix/default.h"
+#include "wrapper/matrix/scatter.h"
+using namespace bandit;
+using namespace bandit::Matchers;
+using namespace ketcpp::wrapper::matrix;
+
+go_bandit([] {
+  describe("BlockScatter", [] {
+    it("should accumulate overlapping blocks", [] {
+      MatrixVector<double> dest(4, 4);
+      const MatrixVector<double> a = {{1, 2}, {3, 4}};
+      BlockScatter<double> scatter;
+      scatter.add(0, 0, a);
+      scatter.add(1, 1, a, 2.);
+      scatter.size() must equal(2);
+      scatter.apply(dest);
+      (dest == MatrixVector<double>(
+                   {{1, 2, 0, 0}, {3, 6, 4, 0}, {0, 6, 8, 0}, {0, 0, 0, 0}}))
+          must be_truthy;
+    });
+
+    it("should mirror off-diagonal blocks", [] {
+      MatrixVector<double> dest(3, 3);
+      const MatrixVector<double> a = {{1, 2}};
+      const MatrixVector<double> d = {{5}};
+      BlockScatter<double> scatter;
+      scatter.add_symmetric(0, 1, a);
+      scatter.add_symmetric(2, 2, d);
+      scatter.apply(dest);
+      (dest == MatrixVector<double>({{0, 1, 2}, {1, 0, 0}, {2, 0, 5}}))
+          must be_truthy;
+    });
+
+    it("should convert blocks without strided storage", [] {
+      MatrixVector<double> dest(3, 3);
+      MatrixSymmetric<double> s(2);
+      s(0, 1) = 3;
+      BlockScatter<double> scatter;
+      scatter.add(1, 1, s);
+      scatter.apply(dest);
+      dest(1, 2) must equal(3);
+      dest(2, 1) must equal(3);
+    });
+
+    it("should match serial accumulation across many bands", [] {
+      const size_t n = 5 * BlockScatter<double>::band_rows + 7, bs = 13;
+      MatrixVector<double> dest(n, n), expected(n, n);
+      std::vector<MatrixVector<double>> blocks;
+      std::vector<std::pair<size_t, size_t>> offsets;
+      for (size_t k = 0; k < 400; ++k) {
+        const size_t r = (k * 37) % (n - bs), c = (k * 91) % (n - bs);
+        MatrixVector<double> b(bs, bs);
+        for (size_t i = 0; i < bs; ++i) {
+          for (size_t j = 0; j < bs; ++j) {
+            b(i, j) = double(k + 1) / (i + 2 * j + 1);
+            expected(r + i, c + j) += b(i, j);
+          }
+        }
+        blocks.push_back(std::move(b));
+        offsets.emplace_back(r, c);
+      }
+      BlockScatter<double> scatter;
+      for (size_t k = 0; k < blocks.size(); ++k) {
+        scatter.add(offsets[k].first, offsets[k].second, blocks[k]);
+      }
+      scatter.apply(dest);
+      for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+          dest(i, j) must be_close_to(expected(i, j)).within(1e-9);
+        }
+      }
+    });
+
+    it("should keep temporary blocks until applied", [] {
+      MatrixVector<double> dest(3, 3);
+      BlockScatter<double> scatter;
+      scatter.add(0, 1, MatrixVector<double>({{1, 2}, {3, 4}}));
+      scatter.add_symmetric(0, 1, MatrixVector<double>({{5}, {6}}), 2.);
+      scatter.apply(dest);
+      (dest == MatrixVector<double>({{0, 11, 2}, {10, 27, 4}, {0, 0, 0}}))
+          must be_truthy;
+    });
+
+    it("should check the destination", [] {
+      MatrixVector<double> dest(2, 2);
+      BlockScatter<double> scatter;
+      scatter.add(1, 1, MatrixVector<double>({{1, 2}}));
+      [&] { scatter.apply(dest); } must throw_exception;
+      scatter.clear();
+      scatter.size() must equal(0);
+      [&] { scatter.apply(dest); } must_not throw_exception;
+    });
+  });
+});
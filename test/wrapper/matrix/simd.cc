@@ -0,0 +1,106 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <bandit/bandit.h>
+#include <random>
+#include <vector>
+#include "wrapper/matrix/simd.h"
+using namespace bandit;
+using namespace bandit::Matchers;
+using namespace ketcpp::wrapper::matrix;
+
+namespace {
+  template <typename T> std::vector<T> random_vector(size_t size, int seed) {
+    std::mt19937 engine(seed);
+    std::uniform_real_distribution<T> distribution(-1, 1);
+    std::vector<T> v(size);
+    for (auto &x : v) {
+      x = distribution(engine);
+    }
+    return v;
+  }
+
+  template <typename T> void check_kernels(simd::Isa isa, T tolerance) {
+    const auto &reference = simd::get_kernels<T>(simd::Isa::scalar);
+    const auto &kernels = simd::get_kernels<T>(isa);
+    for (size_t n : {0, 1, 7, 33, 1001}) {
+      auto x = random_vector<T>(n, 1), y = random_vector<T>(n, 2);
+      auto z = y, z_ref = y;
+
+      kernels.add(n, x.data(), y.data(), z.data());
+      reference.add(n, x.data(), y.data(), z_ref.data());
+      z must equal(z_ref);
+
+      kernels.scale(n, T(0.5), x.data(), z.data());
+      reference.scale(n, T(0.5), x.data(), z_ref.data());
+      z must equal(z_ref);
+
+      kernels.axpy(n, T(-3), x.data(), z.data());
+      reference.axpy(n, T(-3), x.data(), z_ref.data());
+      for (size_t i = 0; i < n; ++i) {
+        z[i] must be_close_to(z_ref[i]).within(tolerance);
+      }
+
+      kernels.equal(n, x.data(), x.data()) must be_truthy;
+      if (n > 0) {
+        z = x;
+        z[n - 1] += 1;
+        kernels.equal(n, x.data(), z.data()) must be_falsy;
+      }
+
+      kernels.dot(n, x.data(), y.data()) must
+          be_close_to(reference.dot(n, x.data(), y.data()))
+              .within(tolerance * (n + 1));
+      kernels.norm(n, x.data()) must
+          be_close_to(reference.norm(n, x.data())).within(tolerance * (n + 1));
+    }
+  }
+}
+
+go_bandit([] {
+  describe("simd", [] {
+    it("should detect an instruction set no wider than it selects", [] {
+      (simd::get_isa() <= simd::get_detected_isa()) must be_truthy;
+    });
+
+    it("should clamp requests to the detected instruction set", [] {
+      auto isa = simd::get_isa();
+      simd::set_isa(simd::Isa::avx512) must equal(simd::get_detected_isa());
+      simd::set_isa(simd::Isa::scalar) must equal(simd::Isa::scalar);
+      simd::set_isa(isa);
+    });
+
+    for (auto isa : {simd::Isa::scalar, simd::Isa::sse2, simd::Isa::avx2,
+                     simd::Isa::avx512}) {
+      describe(simd::get_isa_name(isa), [isa] {
+        it("should agree with the scalar kernels for float",
+           [isa] { check_kernels<float>(isa, 1e-5f); });
+        it("should agree with the scalar kernels for double",
+           [isa] { check_kernels<double>(isa, 1e-13); });
+      });
+    }
+
+    it("should fall back to the standard library for other types", [] {
+      std::vector<int> x = {1, 2, 3}, y = {4, 5, 6}, z(3);
+      simd::add(3, x.data(), y.data(), z.data());
+      z must equal(std::vector<int>({5, 7, 9}));
+      simd::dot(3, x.data(), y.data()) must equal(32);
+    });
+  });
+});
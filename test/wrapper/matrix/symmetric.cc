@@ -0,0 +1,153 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <bandit/bandit.h>
+#include "wrapper/matrix/default.h"
+#include "wrapper/matrix/symmetric.h"
+using namespace bandit;
+using namespace bandit::Matchers;
+using namespace ketcpp::wrapper::matrix;
+
+go_bandit([] {
+  describe("MatrixSymmetric", [] {
+    it("should not be abstract class", [] {
+      std::is_abstract<MatrixSymmetric<double>>::value must_not be_truthy;
+    });
+
+    it("should store only the upper triangle", [] {
+      MatrixSymmetric<double> s = {{1, 2, 3}, {2, 4, 5}, {3, 5, 6}};
+      s.get_packed_size() must equal(6u);
+      std::vector<double>(s.packed_data(), s.packed_data() + 6)
+          must equal(std::vector<double>({1, 2, 3, 4, 5, 6}));
+    });
+
+    it("should reject asymmetric or ragged lists", [] {
+      [] { MatrixSymmetric<double> s = {{1, 2}, {3, 4}}; } must throw_exception;
+      [] { MatrixSymmetric<double> s = {{1, 2}, {2}}; } must throw_exception;
+    });
+
+    MatrixSymmetric<double> s = {{1, 2, 3}, {2, 4, 5}, {3, 5, 6}};
+    MatrixVector<double> full = {{1, 2, 3}, {2, 4, 5}, {3, 5, 6}};
+
+    describe(".rows", [&s, &full] {
+      it("should mirror the lower triangle", [&s, &full] {
+        const MatrixBase<double> &base = s;
+        (base == full) must be_truthy;
+      });
+    });
+
+    describe(".columns", [&s] {
+      it("should yield all column vectors", [&s] {
+        std::vector<double> elements;
+        for (auto column : s.columns()) {
+          for (auto element : column) {
+            elements.push_back(element);
+          }
+        }
+        elements must equal(std::vector<double>({1, 2, 3, 2, 4, 5, 3, 5, 6}));
+      });
+    });
+
+    describe("::operator()", [&s] {
+      it("should write both mirrored elements", [&s] {
+        auto t = s;
+        t(2, 0) = 7;
+        t(0, 2) must equal(7);
+      });
+    });
+
+    describe("::operator+=", [&s, &full] {
+      it("should add packed storage", [&s] {
+        auto t = s;
+        t += s;
+        t must equal(MatrixSymmetric<double>(
+                         {{2, 4, 6}, {4, 8, 10}, {6, 10, 12}}));
+      });
+      it("should add a dense matrix", [&s, &full] {
+        auto t = full;
+        t += s;
+        t must equal(
+            MatrixVector<double>({{2, 4, 6}, {4, 8, 10}, {6, 10, 12}}));
+      });
+      it("should add each dense element once", [&full] {
+        MatrixSymmetric<double> t(3);
+        MatrixBase<double> &b = t;
+        b += full;
+        b += MatrixVectorColumnMajor<double>(full);
+        t must equal(MatrixSymmetric<double>(
+                         {{2, 4, 6}, {4, 8, 10}, {6, 10, 12}}));
+      });
+      it("should add through the iterators once", [&s] {
+        MatrixSymmetric<double> t(3);
+        t.MatrixBase<double>::operator+=(s);
+        t must equal(s);
+      });
+    });
+
+    describe("convert", [&s, &full] {
+      it("should read dense matrices of any layout", [&s, &full] {
+        MatrixSymmetric<double> t(3), u(3);
+        Dispatcher<double>::convert(t, full);
+        t must equal(s);
+        Dispatcher<double>::convert(u, MatrixVectorColumnMajor<double>(full));
+        u must equal(s);
+      });
+    });
+
+    describe("::operator*=", [&s] {
+      it("should scale packed storage", [&s] {
+        auto t = s;
+        t *= 0.5;
+        t(1, 2) must equal(2.5);
+      });
+    });
+
+    describe("multiply", [&s, &full] {
+      MatrixVector<double> b = {{1, 0}, {0, 1}, {1, 1}};
+      it("should multiply by a dense matrix on either side",
+         [&s, &full, &b] {
+           auto c = Dispatcher<double>::multiply(s, b);
+           *c must equal(full * b);
+           MatrixVector<double> bt = {{1, 0, 1}, {0, 1, 1}};
+           auto d = Dispatcher<double>::multiply(bt, s);
+           *d must equal(bt * full);
+         });
+      it("should multiply two symmetric matrices", [&s, &full] {
+        auto c = Dispatcher<double>::multiply(s, s);
+        *c must equal(full * full);
+      });
+      it("should work through Matrix", [&s, &full] {
+        Matrix<double> m(s);
+        Matrix<double> c = m * m + m;
+        c must equal(Matrix<double>(full * full) + Matrix<double>(full));
+      });
+    });
+
+    describe("syrk", [] {
+      it("should accumulate A * A^T", [] {
+        MatrixVector<double> a = {{1, 2}, {3, 4}, {5, 6}};
+        MatrixSymmetric<double> c(3);
+        c(0, 0) = 1;
+        syrk(1., a, 2., c);
+        c must equal(MatrixSymmetric<double>(
+                         {{7, 11, 17}, {11, 25, 39}, {17, 39, 61}}));
+      });
+    });
+  });
+});
@@ -18,6 +18,8 @@
  */
 
 #include <bandit/bandit.h>
+#include <cstdint>
+#include <sstream>
 #include "wrapper/matrix/vector.h"
 using namespace bandit;
 using namespace bandit::Matchers;
@@ -259,6 +261,41 @@ go_bandit([] {
       });
     });
 
+    describe(".fast_rows", [&vector] {
+      it("should yield all row vectors", [&vector] {
+        float v[3][2] = {{1.f, 2.f}, {3.f, 4.f}, {5.f, 6.f}};
+        size_t k = 0;
+        for (auto i : vector.fast_rows()) {
+          std::equal(i.begin(), i.end(), &v[k++][0]) must be_truthy;
+        }
+        k must equal(3);
+      });
+
+      it("should allow writing through the ranges", [&vector] {
+        auto vector2 = vector;
+        for (auto row : vector2.fast_rows()) {
+          for (auto &x : row) {
+            x *= 2;
+          }
+        }
+        vector2(2, 1) must equal(12.f);
+        vector2.fast_row(1)[0] must equal(6.f);
+      });
+    });
+
+    describe(".fast_columns const", [&vector] {
+      const auto &cvector = vector;
+      it("should yield all column vectors", [&cvector] {
+        float v[2][3] = {{1.f, 3.f, 5.f}, {2.f, 4.f, 6.f}};
+        size_t k = 0;
+        for (auto i : cvector.fast_columns()) {
+          std::equal(i.begin(), i.end(), &v[k++][0]) must be_truthy;
+        }
+        k must equal(2);
+        cvector.fast_column(1).size() must equal(3);
+      });
+    });
+
     describe("::operator==", [&vector, &vector2] {
       it("should return true for same matrix", [&vector] {
         auto vector2 = vector;
@@ -267,6 +304,20 @@ go_bandit([] {
 
       it("should false true for different matrix",
          [&vector, &vector2] { (vector == vector2) must be_falsy; });
+
+      it("should find a single difference on several threads", [] {
+        namespace thread = ketcpp::wrapper::thread;
+        const size_t num_threads = thread::get_num_threads();
+        thread::set_num_threads(8);
+        MatrixVector<double> a(640, 640), b(640, 640);
+        (a == b) must be_truthy;
+        for (size_t i = 0; i < 640; i += 71) {
+          b(i, 3) = 1;
+          (a == b) must be_falsy;
+          b(i, 3) = 0;
+        }
+        thread::set_num_threads(num_threads);
+      });
     });
 
     describe("::operator+=", [&vector, &vector2, &vector3] {
@@ -320,5 +371,134 @@ go_bandit([] {
         });
       });
     });
+    describe("::dot", [&vector] {
+      it("should sum element-wise products", [&vector] {
+        vector.dot(vector) must equal(91.f);
+      });
+    });
+    describe("::norm", [] {
+      it("should return the Frobenius norm", [] {
+        MatrixVector<double> v = {{3, 0}, {0, 4}};
+        v.norm() must be_close_to(5).within(1e-12);
+      });
+    });
+  });
+
+  describe("MatrixVectorColumnMajor", [] {
+    using ColumnMajor = MatrixVectorColumnMajor<double>;
+    const ColumnMajor a = {{1, 2, 3}, {4, 5, 6}};
+
+    it("should store columns contiguously", [&] {
+      a.data()[1] must equal(4);
+      a.get_row_stride() must equal(1);
+      a.get_column_stride() must equal(2);
+      a(1, 2) must equal(6);
+      a.fast_column(1)[1] must equal(5);
+      a.fast_row(0)[2] must equal(3);
+    });
+
+    it("should iterate in logical order", [&] {
+      std::stringstream ss;
+      ss << static_cast<const MatrixBase<double> &>(a);
+      ss.str() must equal("{{1, 2, 3}, {4, 5, 6}}");
+      size_t n = 0;
+      for (auto row : a.rows()) {
+        n += std::distance(row.begin(), row.end());
+      }
+      n must equal(6);
+    });
+
+    it("should compare, add and multiply across layouts", [&] {
+      const MatrixVector<double> r = {{1, 2, 3}, {4, 5, 6}};
+      (a == r) must be_truthy;
+      (r == a) must be_truthy;
+      ColumnMajor b = a;
+      b += r;
+      b(1, 0) must equal(8);
+      const ColumnMajor c = {{1, 0}, {0, 1}, {1, 1}};
+      (a * c == MatrixVector<double>({{4, 5}, {10, 11}})) must be_truthy;
+    });
+
+    it("should convert layouts through the constructor", [] {
+      MatrixVector<double> r(70, 45);
+      for (size_t i = 0; i < 70; ++i) {
+        for (size_t j = 0; j < 45; ++j) {
+          r(i, j) = i * 100. + j;
+        }
+      }
+      const ColumnMajor c(r);
+      c(69, 44) must equal(6944);
+      c.data()[1] must equal(100);
+      (MatrixVector<double>(c) == r) must be_truthy;
+    });
+  });
+
+  describe("MatrixVector storage", [] {
+    using ketcpp::wrapper::memory::Placement;
+    auto address = [](const double *ptr) {
+      return reinterpret_cast<std::uintptr_t>(ptr);
+    };
+    auto fill = [](auto &a) {
+      for (size_t i = 0; i < a.get_num_rows(); ++i) {
+        for (size_t j = 0; j < a.get_num_columns(); ++j) {
+          a(i, j) = i * 7. - j;
+        }
+      }
+    };
+
+    it("should align storage to cache lines", [&] {
+      MatrixVector<double> small(3, 5), large(100, 100);
+      address(small.data()) % 64 must equal(0u);
+      address(large.data()) % 4096 must equal(0u);
+    });
+
+    it("should pad the leading dimension", [&] {
+      MatrixVector<double> a(3, 5, StorageOptions(true));
+      a.get_leading_dimension() must equal(8u);
+      a.get_row_stride() must equal(8);
+      a.is_packed() must be_falsy;
+      address(&a(2, 0)) % 64 must equal(0u);
+      MatrixVector<double> b(2, 512, StorageOptions(true));
+      b.get_leading_dimension() must equal(520u);
+      MatrixVectorColumnMajor<double> c(3, 5, StorageOptions(true));
+      c.get_column_stride() must equal(8);
+      kernel::get_padded_dimension<float>(17) must equal(32u);
+    });
+
+    it("should compute on padded matrices like on packed ones", [&] {
+      MatrixVector<double> packed(9, 13);
+      MatrixVector<double> padded(9, 13, StorageOptions(true));
+      fill(packed);
+      fill(padded);
+      (padded == packed) must be_truthy;
+      (packed == padded) must be_truthy;
+      padded.dot(packed) must equal(packed.dot(packed));
+      padded.norm() must equal(packed.norm());
+      padded *= 2.;
+      packed *= 2.;
+      (padded == packed) must be_truthy;
+      const MatrixVector<double> copy = padded;
+      copy.get_leading_dimension() must equal(16u);
+      (copy == padded) must be_truthy;
+      MatrixVector<double> square(13, 13, StorageOptions(true));
+      fill(square);
+      (padded * square == packed * MatrixVector<double>(square))
+          must be_truthy;
+      padded += packed;
+      padded(8, 12) must equal(4 * (8 * 7. - 12));
+    });
+
+    it("should zero-fill with every placement", [&] {
+      for (auto placement : {Placement::local, Placement::first_touch,
+                             Placement::interleaved}) {
+        MatrixVector<double> a(300, 300, placement);
+        a.get_placement() must equal(placement);
+        a.norm() must equal(0);
+        fill(a);
+        const MatrixVector<double> b = a;
+        b.get_placement() must equal(placement);
+        (b == a) must be_truthy;
+      }
+    });
   });
 });
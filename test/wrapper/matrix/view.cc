@@ -0,0 +1,277 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <bandit/bandit.h>
+#include <sstream>
+#include <stdexcept>
+#include <type_traits>
+#include "wrapper/matrix/default.h"
+#include "wrapper/matrix/view.h"
+using namespace bandit;
+using namespace bandit::Matchers;
+using namespace ketcpp::wrapper::matrix;
+
+namespace {
+  MatrixVector<double> make(size_t m, size_t n, double seed) {
+    MatrixVector<double> a(m, n);
+    for (size_t i = 0; i < m; ++i) {
+      for (size_t j = 0; j < n; ++j) {
+        a(i, j) = seed * (i + 1) - double(j) / (i + j + 1);
+      }
+    }
+    return a;
+  }
+
+  MatrixVector<double> transposed(const MatrixVector<double> &a) {
+    MatrixVector<double> b(a.get_num_columns(), a.get_num_rows());
+    for (size_t i = 0; i < a.get_num_rows(); ++i) {
+      for (size_t j = 0; j < a.get_num_columns(); ++j) {
+        b(j, i) = a(i, j);
+      }
+    }
+    return b;
+  }
+
+  template <typename M>
+  void check_close(const M &a, const MatrixVector<double> &b) {
+    a.get_num_rows() must equal(b.get_num_rows());
+    a.get_num_columns() must equal(b.get_num_columns());
+    for (size_t i = 0; i < b.get_num_rows(); ++i) {
+      for (size_t j = 0; j < b.get_num_columns(); ++j) {
+        a(i, j) must be_close_to(b(i, j)).within(1e-9);
+      }
+    }
+  }
+}
+
+go_bandit([] {
+  describe("MatrixView", [] {
+    it("should not be abstract class", [] {
+      std::is_abstract<MatrixView<double>>::value must_not be_truthy;
+    });
+
+    describe("transpose", [] {
+      it("should share storage with the matrix", [] {
+        MatrixVector<double> a = {{1, 2, 3}, {4, 5, 6}};
+        auto t = transpose(a);
+        t.get_num_rows() must equal(3);
+        t.get_num_columns() must equal(2);
+        t(2, 1) must equal(6);
+        t(0, 1) = 7;
+        a(1, 0) must equal(7);
+        t *= 2;
+        a(0, 2) must equal(6);
+      });
+
+      it("should iterate through MatrixBase", [] {
+        const MatrixVector<double> a = {{1, 2, 3}, {4, 5, 6}};
+        const auto t = transpose(a);
+        const MatrixBase<double> &base = t;
+        (base == MatrixVector<double>({{1, 4}, {2, 5}, {3, 6}}))
+            must be_truthy;
+        std::stringstream ss;
+        ss << base;
+        ss.str() must equal("{{1, 4}, {2, 5}, {3, 6}}");
+        size_t n = 0;
+        for (auto column : base.columns()) {
+          n += std::distance(column.begin(), column.end());
+        }
+        n must equal(6);
+        t.fast_column(1)[2] must equal(6);
+        t.fast_row(2)[1] must equal(6);
+      });
+
+      it("should be an operand of the Dispatcher", [] {
+        MatrixVector<double> a = make(3, 4, 1);
+        const MatrixVector<double> b = make(4, 3, 2);
+        auto t = transpose(a);
+        t += b;
+        MatrixVector<double> expected = transposed(make(3, 4, 1));
+        expected += b;
+        check_close(t, expected);
+        (transpose(t) == a) must be_truthy;
+        (dynamic_cast<MatrixVector<double> *>(t.copy().get()) != nullptr)
+            must be_truthy;
+      });
+
+      it("should be multiplied in place by gemm", [] {
+        // Sizes take the small, blocked and threaded paths of gemm.
+        for (size_t n : {5, 40, 130}) {
+          const MatrixVector<double> a = make(n + 3, n, 1);
+          const MatrixVector<double> b = make(n + 1, n, -1);
+          const auto abt = a * transposed(b);
+          check_close(dynamic_cast<MatrixVector<double> &>(
+                          *Dispatcher<double>::multiply(a, transpose(b))),
+                      abt);
+          const MatrixVector<double> at = transposed(a);
+          check_close(dynamic_cast<MatrixVector<double> &>(
+                          *Dispatcher<double>::multiply(transpose(at),
+                                                        transpose(b))),
+                      abt);
+          // A transposed destination receives (A B^T)^T.
+          MatrixVector<double> c(n + 1, n + 3);
+          auto ct = transpose(c);
+          gemm(1., a, transpose(b), 0., ct);
+          check_close(c, transposed(abt));
+        }
+      });
+
+      it("should be read-only for const matrices", [] {
+        MatrixVector<double> a = make(3, 4, 1);
+        const MatrixBase<double> &ca = a;
+        auto t = transpose(ca);
+        std::is_same<decltype(t), MatrixView<const double>>::value must
+            be_truthy;
+        std::is_const<std::remove_reference_t<decltype(t(0, 1))>>::value must
+            be_truthy;
+        t(0, 1) must equal(a(1, 0));
+        MatrixBase<double> &base = t;
+        [&] { base *= 2.; } must throw_exception;
+        [&] { base += MatrixVector<double>(4, 3); } must throw_exception;
+        [&] { t = MatrixVector<double>(4, 3); } must throw_exception;
+        for (auto row : base.rows()) {
+          for (auto &x : row) {
+            x = 0;
+          }
+        }
+        check_close(a, make(3, 4, 1));
+        check_close(t, transposed(a));
+        (*t.copy() == transposed(a)) must be_truthy;
+      });
+
+      it("should iterate through views of const matrices", [] {
+        const MatrixVector<double> a = {{1, 2, 3}, {4, 5, 6}};
+        auto t = transpose(a);
+        double sum = 0;
+        size_t count = 0;
+        for (auto row : t.rows()) {
+          for (auto x : row) {
+            sum += x;
+          }
+        }
+        for (auto column : t.columns()) {
+          count += std::distance(column.begin(), column.end());
+        }
+        sum must equal(21);
+        count must equal(6);
+        auto b = block(a, 0, 1, 2, 2);
+        (b == MatrixVector<double>({{2, 3}, {5, 6}})) must be_truthy;
+      });
+    });
+
+    describe("row_view", [] {
+      it("should select every step-th row", [] {
+        MatrixVector<double> a = make(7, 3, 1);
+        auto v = row_view(a, 1, 3, 2);
+        v.get_num_rows() must equal(3);
+        v(2, 1) must equal(a(5, 1));
+        v *= 0;
+        a(3, 2) must equal(0);
+        a(2, 2) must_not equal(0);
+      });
+
+      it("should check its range", [] {
+        MatrixVector<double> a(4, 4);
+        [&] { row_view(a, 1, 2, 3); } must throw_exception;
+        [&] { row_view(a, 1, 2, 2); } must_not throw_exception;
+      });
+    });
+
+    describe("column_view", [] {
+      it("should select every step-th column", [] {
+        const MatrixVector<double> a = make(3, 6, 1);
+        const auto v = column_view(a, 0, 3, 2);
+        v.get_num_columns() must equal(3);
+        v(1, 2) must equal(a(1, 4));
+        MatrixVector<double> b(3, 3);
+        Dispatcher<double>::convert(b, v);
+        b(2, 1) must equal(a(2, 2));
+      });
+    });
+
+    describe("block", [] {
+      it("should update a region of the parent in place", [] {
+        MatrixVector<double> a(5, 6);
+        auto b = block(a, 1, 2, 2, 3);
+        b += MatrixVector<double>({{1, 2, 3}, {4, 5, 6}});
+        b *= 2;
+        a(1, 2) must equal(2);
+        a(2, 4) must equal(12);
+        a(0, 2) must equal(0);
+        a(1, 5) must equal(0);
+      });
+
+      it("should be a gemm destination", [] {
+        MatrixVector<double> c = make(6, 7, 3);
+        const MatrixVector<double> x = make(3, 4, 1), y = make(4, 2, 2);
+        const auto xy = x * y;
+        auto b = block(c, 2, 4, 3, 2);
+        gemm(1., x, y, 1., b);
+        const MatrixVector<double> original = make(6, 7, 3);
+        for (size_t i = 0; i < 6; ++i) {
+          for (size_t j = 0; j < 7; ++j) {
+            const bool inside = i >= 2 && i < 5 && j >= 4 && j < 6;
+            c(i, j) must be_close_to(original(i, j) +
+                                     (inside ? xy(i - 2, j - 4) : 0.))
+                .within(1e-12);
+          }
+        }
+      });
+
+      it("should nest with other views", [] {
+        MatrixVector<double> a = make(6, 6, 1);
+        const auto b = block(transpose(a), 1, 2, 3, 2);
+        b(2, 1) must equal(a(3, 3));
+        [&] { block(a, 4, 0, 3, 1); } must throw_exception;
+      });
+
+      it("should be read-only for const matrices", [] {
+        MatrixVector<double> a = make(4, 4, 1);
+        const MatrixVector<double> &ca = a;
+        auto b = block(ca, 1, 1, 2, 2);
+        std::is_same<decltype(b), MatrixView<const double>>::value must
+            be_truthy;
+        b(1, 0) must equal(a(2, 1));
+        [&] { b *= 0.; } must throw_exception;
+        [&] { block(transpose(a), 0, 0, 2, 2) *= 0.; } must throw_exception;
+        check_close(a, make(4, 4, 1));
+        auto t = transpose(a);
+        block(t, 0, 1, 2, 2) *= 0.;
+        a(1, 0) must equal(0);
+      });
+    });
+
+    describe("diagonal", [] {
+      it("should view the diagonal as a column", [] {
+        MatrixVector<double> a = make(3, 5, 1);
+        auto d = diagonal(a);
+        d.get_num_rows() must equal(3);
+        d.get_num_columns() must equal(1);
+        d(2, 0) must equal(a(2, 2));
+        d = MatrixVector<double>({{1}, {1}, {1}});
+        a(1, 1) must equal(1);
+      });
+
+      it("should need strided storage", [] {
+        MatrixSymmetric<double> s(3);
+        [&] { diagonal(s); } must throw_exception;
+      });
+    });
+  });
+});
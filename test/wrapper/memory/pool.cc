@@ -0,0 +1,137 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <bandit/bandit.h>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "wrapper/matrix/vector.h"
+#include "wrapper/memory/placement.h"
+#include "wrapper/memory/pool.h"
+using namespace bandit;
+using namespace bandit::Matchers;
+using namespace ketcpp::wrapper::memory;
+using ketcpp::wrapper::matrix::MatrixVector;
+
+go_bandit([] {
+  describe("BufferPool", [] {
+    auto &pool = BufferPool::get_instance();
+
+    it("should round sizes to four classes per power of two", [] {
+      BufferPool::round_size(1) must equal(BufferPool::min_bytes);
+      BufferPool::round_size(8193) must equal(10240u);
+      BufferPool::round_size(10240) must equal(10240u);
+      BufferPool::round_size(15000) must equal(16384u);
+    });
+
+    it("should reuse a freed buffer of the same size class", [&pool] {
+      pool.reset_statistics();
+      void *first = pool.allocate(100000);
+      pool.deallocate(first, 100000);
+      void *second = pool.allocate(99000);
+      second must equal(first);
+      pool.deallocate(second, 99000);
+      pool.get_statistics().hits must equal(1u);
+      pool.get_statistics().misses must equal(1u);
+    });
+
+    it("should share buffers freed by exited threads", [&pool] {
+      std::thread([&pool] {
+        std::vector<void *> buffers;
+        for (int i = 0; i < 8; ++i) {
+          buffers.push_back(pool.allocate(1 << 20));
+        }
+        for (void *ptr : buffers) {
+          pool.deallocate(ptr, 1 << 20);
+        }
+      }).join();
+      pool.get_statistics().cached_bytes must be_gte(size_t(8) << 20);
+      pool.reset_statistics();
+      void *ptr = pool.allocate(1 << 20);
+      pool.get_statistics().hits must equal(1u);
+      pool.deallocate(ptr, 1 << 20);
+      pool.release();
+      pool.get_statistics().cached_bytes must equal(0u);
+    });
+
+    it("should align buffers", [&pool] {
+      for (size_t bytes : {size_t(24), size_t(5000), size_t(1) << 20}) {
+        void *ptr = pool.allocate(bytes);
+        const auto address = reinterpret_cast<std::uintptr_t>(ptr);
+        address % BufferPool::alignment must equal(0u);
+        if (bytes >= BufferPool::min_bytes) {
+          address % BufferPool::page_size must equal(0u);
+        }
+        pool.deallocate(ptr, bytes);
+      }
+    });
+
+    it("should not pool small buffers", [&pool] {
+      pool.reset_statistics();
+      pool.deallocate(pool.allocate(16), 16);
+      pool.get_statistics().hits must equal(0u);
+      pool.get_statistics().misses must equal(0u);
+    });
+  });
+
+  describe("PoolAllocator", [] {
+    it("should recycle MatrixVector storage", [] {
+      auto &pool = BufferPool::get_instance();
+      { MatrixVector<double> warmup(64, 64); }
+      pool.reset_statistics();
+      for (int i = 0; i < 10; ++i) {
+        MatrixVector<double> a(64, 64);
+      }
+      pool.get_statistics().hits must equal(10u);
+      pool.get_statistics().misses must equal(0u);
+    });
+
+    it("should leave other allocators usable", [] {
+      MatrixVector<double, std::allocator<double>> a = {{1, 2}, {3, 4}};
+      a *= 2.;
+      a(1, 1) must equal(8);
+    });
+  });
+
+  describe("Placement", [] {
+    it("should find at least one node", [] {
+      get_num_nodes() must be_gte(1u);
+    });
+
+    it("should leave interleaved buffers usable", [] {
+      auto &pool = BufferPool::get_instance();
+      const size_t bytes = size_t(1) << 22;
+      void *ptr = pool.allocate(bytes);
+      interleave(ptr, bytes);
+      std::memset(ptr, 1, bytes);
+      static_cast<unsigned char *>(ptr)[bytes - 1] must equal(1);
+      pool.deallocate(ptr, bytes);
+    });
+
+    it("should switch the default placement", [] {
+      const Placement saved = get_default_placement();
+      set_default_placement(Placement::first_touch);
+      MatrixVector<double>(4, 4).get_placement()
+          must equal(Placement::first_touch);
+      set_default_placement(saved);
+    });
+  });
+});
@@ -0,0 +1,124 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <bandit/bandit.h>
+#include <sstream>
+#include <string>
+#include "wrapper/matrix/default.h"
+#include "wrapper/profile/counters.h"
+using namespace bandit;
+using namespace bandit::Matchers;
+using namespace ketcpp::wrapper;
+using namespace ketcpp::wrapper::matrix;
+
+#ifndef KETCPP_NO_PROFILE
+namespace {
+  const profile::Counters *find(
+      const std::vector<std::pair<profile::Key, profile::Counters>> &counters,
+      profile::Operation operation) {
+    for (const auto &entry : counters) {
+      if (entry.first.operation == operation) {
+        return &entry.second;
+      }
+    }
+    return nullptr;
+  }
+}
+#endif
+
+go_bandit([] {
+  describe("profile", [] {
+    before_each([] {
+      profile::reset();
+      profile::set_enabled(true);
+    });
+    after_each([] { profile::set_enabled(false); });
+
+    it("should bucket shapes by powers of two", [] {
+      profile::get_bucket(1, 1) must equal(0u);
+      profile::get_bucket(3, 2) must equal(2u);
+      profile::get_bucket(64, 5) must equal(6u);
+      profile::get_bucket(5, 65) must equal(7u);
+    });
+
+#ifndef KETCPP_NO_PROFILE
+    it("should count MatrixBase operations", [] {
+      MatrixVector<double> a(4, 4), b(4, 4);
+      b(0, 0) = 1;
+      MatrixBase<double> &base = a;
+      base += b;
+      base += b;
+      base *= 2.;
+      (base == b) must be_falsy;
+      auto c = base.copy();
+      auto d = a * b;
+      const auto counters = profile::get_counters();
+      const auto *add = find(counters, profile::Operation::add);
+      const auto *multiply = find(counters, profile::Operation::multiply);
+      (add != nullptr) must be_truthy;
+      add->calls must equal(2u);
+      add->flops must equal(32.);
+      add->bytes must equal(2 * 3 * 16. * sizeof(double));
+      find(counters, profile::Operation::scale)->calls must equal(1u);
+      find(counters, profile::Operation::compare)->calls must equal(1u);
+      find(counters, profile::Operation::copy)->allocations must equal(1u);
+      multiply->flops must equal(2. * 4 * 4 * 4);
+      multiply->allocations must equal(1u);
+    });
+
+    it("should key operations by backend and shape", [] {
+      MatrixVector<double> a(4, 4), b(100, 100);
+      MatrixSymmetric<double> s(4);
+      a *= 2.;
+      b *= 2.;
+      s *= 2.;
+      profile::get_counters().size() must equal(3u);
+    });
+
+    it("should report names and rates", [] {
+      MatrixSymmetric<double> s(4);
+      MatrixVector<double> a(4, 4);
+      Dispatcher<double>::multiply(s, a);
+      std::ostringstream out;
+      profile::report(out);
+      const std::string text = out.str();
+      (text.find("multiply") != std::string::npos) must be_truthy;
+      (text.find("MatrixSymmetric<double>") != std::string::npos)
+          must be_truthy;
+    });
+#endif
+
+    it("should record nothing when disabled", [] {
+      profile::set_enabled(false);
+      MatrixVector<double> a(4, 4);
+      a *= 2.;
+      profile::get_counters().empty() must be_truthy;
+    });
+
+    it("should not evaluate its arguments when disabled", [] {
+      profile::set_enabled(false);
+      MatrixVector<double> a(4, 4);
+      size_t evaluations = 0;
+      auto count = [&] { return ++evaluations; };
+      { KETCPP_PROFILE_UNARY(scale, a, count(), count(), count()); }
+      static_cast<void>(count);
+      evaluations must equal(0);
+    });
+  });
+});
@@ -0,0 +1,123 @@
+/*
+ * ketcpp: Quantum chemical toolset made of C++
+ * Copyright (C) 2015 Katsuhiko Nishimra
+ *
+ * This file is part of ketcpp.
+ *
+ * ketcpp is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or any later version.
+ *
+ * ketcpp is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of  MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * ketcpp.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <bandit/bandit.h>
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+#include "wrapper/thread/pool.h"
+using namespace bandit;
+using namespace bandit::Matchers;
+using namespace ketcpp::wrapper::thread;
+
+go_bandit([] {
+  describe("ThreadPool", [] {
+    const size_t num_threads = get_num_threads();
+    before_each([] { set_num_threads(4); });
+    after_each([num_threads] { set_num_threads(num_threads); });
+
+    it("should report the configured number of threads", [] {
+      get_num_threads() must equal(4u);
+      get_pool().get_num_threads() must equal(4u);
+    });
+
+    it("should run every task of a group", [] {
+      std::atomic<int> count(0);
+      TaskGroup group;
+      for (int i = 0; i < 100; ++i) {
+        group.run([&count] { ++count; });
+      }
+      group.wait();
+      count.load() must equal(100);
+    });
+
+    it("should rethrow the exception of a task", [] {
+      [] {
+        TaskGroup group;
+        group.run([] { throw std::runtime_error("task"); });
+        group.wait();
+      } must throw_exception;
+    });
+  });
+
+  describe("parallel_for", [] {
+    const size_t num_threads = get_num_threads();
+    before_each([] { set_num_threads(4); });
+    after_each([num_threads] { set_num_threads(num_threads); });
+
+    it("should visit every index exactly once", [] {
+      std::vector<int> visits(10000);
+      parallel_for(0, visits.size(), 16, [&visits](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+          ++visits[i];
+        }
+      });
+      std::vector<int>(visits.size(), 1) must equal(visits);
+    });
+
+    it("should run small ranges as one call", [] {
+      int calls = 0;
+      parallel_for(0, 100, 100, [&calls](size_t, size_t) { ++calls; });
+      calls must equal(1);
+    });
+
+    it("should allow nesting", [] {
+      std::atomic<int> count(0);
+      parallel_for(0, 8, 1, [&count](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+          parallel_for(0, 8, 1, [&count](size_t f, size_t l) {
+            count += l - f;
+          });
+        }
+      });
+      count.load() must equal(64);
+    });
+  });
+
+  describe("parallel_reduce", [] {
+    const size_t num_threads = get_num_threads();
+    before_each([] { set_num_threads(3); });
+    after_each([num_threads] { set_num_threads(num_threads); });
+
+    it("should sum a range", [] {
+      const size_t sum = parallel_reduce(
+          1, 1001, 7, size_t(0),
+          [](size_t first, size_t last) {
+            size_t s = 0;
+            for (size_t i = first; i < last; ++i) {
+              s += i;
+            }
+            return s;
+          },
+          [](size_t l, size_t r) { return l + r; });
+      sum must equal(500500u);
+    });
+
+    it("should keep one boolean result per chunk", [] {
+      set_num_threads(8);
+      for (size_t k = 0; k < 64; ++k) {
+        const bool all = parallel_reduce(
+            0, 64, 1, true,
+            [k](size_t first, size_t last) { return k < first || k >= last; },
+            [](bool l, bool r) { return l && r; });
+        all must be_falsy;
+      }
+    });
+  });
+});